@@ -7,6 +7,9 @@
 #include "light.h"
 #include "pwm_driver.h"
 #include "skylab2_boards.h"
+#include "skylab2_dispatch.h"
+#include "skylab2_schedule.h"
+#include "skylab2_views.h"
 #include "timer.h"
 
 namespace umnsvp {
@@ -18,6 +21,7 @@ class Application : public ApplicationBase {
     void main(void);
     void send_status(void);
     void send_ID(void);
+    void can_tick(void);
     void blinky_handler(void);
 
     Light &front_left;
@@ -32,7 +36,7 @@ class Application : public ApplicationBase {
     Light &accent_left;
     Light &accent_right;
     
-    umnsvp::timer<2, 500> timFDCan;
+    umnsvp::timer<2, 1> timFDCan;
     umnsvp::timer<7, 500> timBlinky;
 
     void can_rx_callback(void);
@@ -43,6 +47,10 @@ class Application : public ApplicationBase {
    private:
     void init();
     void system_clock_config(void);
+    static void rx_timeout(void* context, std::size_t msg);
+    static void on_headlights(void* context, const can::packet& packet);
+    static void on_turn_signals(void* context, const can::packet& packet);
+    static void on_brake_lights(void* context, const can::packet& packet);
     bool front;
     bool bms_fault;
 
@@ -58,8 +66,18 @@ class Application : public ApplicationBase {
     can::fdcan_driver can_device;
     static constexpr uint16_t can_rx_pin = GPIO_PIN_11;
     static constexpr uint16_t can_tx_pin = GPIO_PIN_12;
+    /// can::report_packet() nodes of the front and back boards.
+    static constexpr uint8_t bus_report_front = 0x10;
+    static constexpr uint8_t bus_report_back = 0x11;
 
     umnsvp::skylab2::lights_can skylab;
+    umnsvp::skylab2::periodic_scheduler<
+        umnsvp::skylab2::lights_schedule::table.size()>
+        schedule{umnsvp::skylab2::lights_schedule::table};
+    umnsvp::skylab2::rx_monitor<
+        umnsvp::skylab2::lights_deadlines::table.size()>
+        monitor{umnsvp::skylab2::lights_deadlines::table};
+    umnsvp::skylab2::lights_main_rx::subscriptions rx;
     umnsvp::dip_switch dip = dip_switch(PORT_DIP, PIN_DIP);
 };
 
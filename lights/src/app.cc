@@ -1,5 +1,6 @@
 #include "app.h"
 
+#include "deferred_work.h"
 #include "main.h"
 namespace umnsvp {
 namespace lights {
@@ -27,107 +28,94 @@ Application::Application()
 }
 /**
  * @brief Main method of Lights application
+ *
+ * Light commands are handled by the subscriber callbacks below as they
+ * arrive; the main loop only sleeps until the BMS reports a kill.
  */
 void Application::main() {
     init();
 
-    // Check front or Back
-    if (front) {
-        // front: DRL Left:0, DRL Right:1, Left Turn:2,
-        //  Right Turn:3, Accent Left:4, Accent Right:5
-
-        // forever loop
-        while (1) {
-            // check headlights
-            if (skylab.vision_headlights_command_buffer.pop()) {
-                skylab2::can_packet_vision_headlights_command cmd =
-                    skylab.vision_headlights_command_buffer.output();
-                float brightness = cmd.brightness;
-
-                if (cmd.lights.high_beams) {
-                    drl_left.set_brightness(brightness);
-                    drl_right.set_brightness(brightness);
-                    drl_left.on();
-                    drl_right.on();
-                } else {
-                    drl_left.off();
-                    drl_right.off();
-                }
-
-                if (cmd.lights.headlights) {
-                    accent_left.set_brightness(brightness);
-                    accent_right.set_brightness(brightness);
-                    accent_left.on();
-                    accent_right.on();
-                } else {
-                    accent_left.off();
-                    accent_right.off();
-                }
-            }
-
-            // check turn signals
-            if (skylab.vision_turn_signals_command_buffer.pop()) {
-                skylab2::can_packet_vision_turn_signals_command cmd =
-                    skylab.vision_turn_signals_command_buffer.output();
-                if (cmd.lights.left_turn_signal) {
-                    front_left.on();
-                } else {
-                    front_left.off();
-                }
-                if (cmd.lights.right_turn_signal) {
-                    front_right.on();
-                } else {
-                    front_right.off();
-                }
-            }
+    // Front: DRL Left:0, DRL Right:1, Left Turn:2, Right Turn:3,
+    // Accent Left:4, Accent Right:5
+    // Back: Brake Lights:0, Blinky Light:1, Left Turn:3, Right Turn:4,
+    // Camera:5
+
+    // forever loop
+    while (1) {
+        rx.wait(1U << skylab2::lights_main_rx::bms_kill_reason);
+        // battery fault indicator, on the back board's blinky light
+        if (!front) {
+            bms_fault = true;
         }
+    }
+}
+
+/**
+ * @brief Set the high beams and headlights, on the front board.
+ */
+void Application::on_headlights(void* context, const can::packet& packet) {
+    Application& self = *static_cast<Application*>(context);
+    if (!self.front) {
+        return;
+    }
+    const skylab2::can_view_vision_headlights_command cmd(packet);
+    const float brightness = cmd.brightness();
+
+    if (cmd.lights_high_beams()) {
+        self.drl_left.set_brightness(brightness);
+        self.drl_right.set_brightness(brightness);
+        self.drl_left.on();
+        self.drl_right.on();
     } else {
-        // Back: Brake Lights:0, Blinky Light:1, Left Turn:3
-        // Right Turn:4, Camera:5
-
-        // init can bus
-
-        // forever loop
-        while (1) {
-            // camera.toggle();
-            // brake.toggle();
-            // back_left.toggle();
-            // back_right.toggle();
-            // blink_light.toggle();
-            // HAL_Delay(2000);
-
-            if (skylab.vision_brake_lights_command_buffer.pop()) {
-                skylab2::can_packet_vision_brake_lights_command cmd =
-                    skylab.vision_brake_lights_command_buffer.output();
-                if (cmd.lights.brake_lights) {
-                    brake.on();
-
-                } else {
-                    brake.off();
-                }
-            }
-
-            // check turn signals
-            if (skylab.vision_turn_signals_command_buffer.pop()) {
-                skylab2::can_packet_vision_turn_signals_command cmd =
-                    skylab.vision_turn_signals_command_buffer.output();
-                if (cmd.lights.left_turn_signal) {
-                    back_left.on();
-                } else {
-                    back_left.off();
-                }
-                if (cmd.lights.right_turn_signal) {
-                    back_right.on();
-                } else {
-                    back_right.off();
-                }
-            }
+        self.drl_left.off();
+        self.drl_right.off();
+    }
 
-            // battery fault indicator
-            if (skylab.bms_kill_reason_buffer.pop()) {
-                bms_fault = true;
-            }
-        }
+    if (cmd.lights_headlights()) {
+        self.accent_left.set_brightness(brightness);
+        self.accent_right.set_brightness(brightness);
+        self.accent_left.on();
+        self.accent_right.on();
+    } else {
+        self.accent_left.off();
+        self.accent_right.off();
+    }
+}
+
+/**
+ * @brief Set the turn signals of whichever board this is.
+ */
+void Application::on_turn_signals(void* context, const can::packet& packet) {
+    Application& self = *static_cast<Application*>(context);
+    const skylab2::can_view_vision_turn_signals_command cmd(packet);
+    Light& left = self.front ? self.front_left : self.back_left;
+    Light& right = self.front ? self.front_right : self.back_right;
+
+    if (cmd.lights_left_turn_signal()) {
+        left.on();
+    } else {
+        left.off();
+    }
+    if (cmd.lights_right_turn_signal()) {
+        right.on();
+    } else {
+        right.off();
+    }
+}
+
+/**
+ * @brief Set the brake lights, on the back board.
+ */
+void Application::on_brake_lights(void* context, const can::packet& packet) {
+    Application& self = *static_cast<Application*>(context);
+    if (self.front) {
+        return;
+    }
+    const skylab2::can_view_vision_brake_lights_command cmd(packet);
+    if (cmd.lights_brake_lights()) {
+        self.brake.on();
+    } else {
+        self.brake.off();
     }
 }
 
@@ -150,15 +138,29 @@ void Application::init() {
 
     // Initialize HAL, clock, etc...
     sys_init();
-
-    skylab.init();
-
-    // initialize telemetry manager
+    irq::init_deferred();
 
     // read DIP switch and set FRONT
     dip.init();
 
     front = dip.get_state();
+
+    // Subscribe before the bus starts so the first packets are handled.
+    rx.subscribe(skylab2::lights_main_rx::vision_headlights_command,
+                 &on_headlights, this);
+    rx.subscribe(skylab2::lights_main_rx::vision_turn_signals_command,
+                 &on_turn_signals, this);
+    rx.subscribe(skylab2::lights_main_rx::vision_brake_lights_command,
+                 &on_brake_lights, this);
+    skylab.add_rx_observer(&decltype(rx)::observe, &rx);
+
+    monitor.set_timeout_callback(&rx_timeout, this);
+    monitor.start(HAL_GetTick());
+    skylab.add_rx_observer(&decltype(monitor)::observe, &monitor);
+    skylab.init();
+
+    // initialize telemetry manager
+
     // initialize GPIO ports
 
     if (front) {
@@ -191,6 +193,7 @@ void Application::init() {
     enable.on();
 
     // start timers
+    schedule.start(HAL_GetTick());
     timFDCan.start_timer(&timer_handler_callback);
     timBlinky.start_timer(&timer_handler_callback);
 }
@@ -243,6 +246,56 @@ void Application::send_status() {
     }
 }
 
+/**
+ * @brief Called when a periodic command stops arriving. Turn signals are
+ * switched off rather than left on from the last command; the other lights
+ * keep their state.
+ */
+void Application::rx_timeout(void* context, std::size_t msg) {
+    Application& self = *static_cast<Application*>(context);
+    if (msg == skylab2::lights_deadlines::vision_turn_signals_command) {
+        if (self.front) {
+            self.front_left.off();
+            self.front_right.off();
+        } else {
+            self.back_left.off();
+            self.back_right.off();
+        }
+    }
+}
+
+/**
+ * @brief Check the RX deadlines and send whichever periodic packets are
+ * due, each at the rate and phase given in the packet definitions. A front
+ * board skips the rear board's packets and the other way round. Once per
+ * statistics window the bus health report goes out as well.
+ */
+void Application::can_tick() {
+    using namespace skylab2::lights_schedule;
+    monitor.tick(HAL_GetTick());
+    schedule.tick(HAL_GetTick(), [this](std::size_t msg) {
+        switch (msg) {
+            case vision_status_front:
+            case lights_front_id:
+                if (front) {
+                    msg == lights_front_id ? send_ID() : send_status();
+                }
+                break;
+            case vision_status_rear:
+            case lights_back_id:
+                if (!front) {
+                    msg == lights_back_id ? send_ID() : send_status();
+                }
+                break;
+        }
+    });
+    if (can_device.poll_stats(HAL_GetTick())) {
+        skylab.send_packet(
+            can::report_packet(can_device.get_stats().get_report(),
+                               front ? bus_report_front : bus_report_back));
+    }
+}
+
 void Application::send_ID() {
     static skylab2::can_packet_lights_front_id front_id =
         skylab2::can_packet_lights_front_id();
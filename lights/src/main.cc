@@ -12,8 +12,18 @@
 #include "main.h"
 
 #include "app.h"
+#include "deferred_work.h"
 
 umnsvp::lights::Application app;
+
+/**
+ * @brief Bottom half of the TIM2 1 ms CAN tick. Packing and queueing the
+ * periodic packets runs on PendSV rather than in the timer interrupt itself.
+ */
+static void can_tick_work(void* context) {
+    app.can_tick();
+}
+
 /**
  * @brief  Main program.
  * @param  None
@@ -28,8 +38,7 @@ int main(void) {
 
 void timer_handler_callback(TIM_HandleTypeDef* htim) {
     if (htim->Instance == TIM2) {
-        app.send_status();
-        app.send_ID();
+        umnsvp::irq::post(&can_tick_work);
     }
     if (htim->Instance == TIM7) {
         app.blinky_handler();
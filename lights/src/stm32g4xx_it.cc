@@ -23,6 +23,7 @@
 #include "main.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "deferred_work.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -158,7 +159,7 @@ void DebugMon_Handler(void) {
  */
 void PendSV_Handler(void) {
     /* USER CODE BEGIN PendSV_IRQn 0 */
-
+    umnsvp::irq::run_deferred();
     /* USER CODE END PendSV_IRQn 0 */
     /* USER CODE BEGIN PendSV_IRQn 1 */
 
@@ -5,8 +5,16 @@
 
 #define READ_REG_OPCODE 0001
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 HAL_StatusTypeDef read_registers(uint8_t addr, uint8_t num, uint8_t size, uint8_t *results);
 HAL_StatusTypeDef write_registers(uint8_t addr, uint8_t num, uint8_t size, const uint8_t *data);
 HAL_StatusTypeDef set_mux(uint8_t PSEL);
 HAL_StatusTypeDef adc_init(void);
 HAL_StatusTypeDef adc_read(uint32_t *result);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// One set of converter measurements, already scaled to engineering units.
+typedef struct {
+    float vin;         // Input voltage [V]
+    float vout;        // Output voltage [V]
+    float iout;        // Output current [A]
+    int32_t vin_code;  // Raw input voltage ADC code (feed-forward index)
+} BoostMeasurements;
+
+// Reset the output voltage loop. The PWM must already be initialised with
+// MOSFET_PWM_Init().
+void BoostControl_Init(void);
+
+// Read input voltage, output voltage and output current from the external
+// SPI ADC.
+void BoostControl_Sample(BoostMeasurements* meas);
+
+// Run one step of the output voltage loop and update the MOSFET duty. The
+// TIM1 compare is the feed-forward duty for meas->vin_code plus the PI
+// correction, so the PI loop only has to trim out losses. vref_trim is added
+// to BOOST_VOUT_SETPOINT_V (droop / current sharing) and dt_s is the time
+// since the previous step in seconds.
+void BoostControl_Step(const BoostMeasurements* meas, float vref_trim,
+                       float dt_s);
+
+// Last duty cycle commanded by BoostControl_Step, in [0, BOOST_MAX_DUTY].
+float BoostControl_GetDuty(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,63 @@
+/**
+ * @file current_share.h
+ * @brief Average current sharing between paralleled boost modules.
+ *
+ * Every module broadcasts its own output current. Each module then trims its
+ * own voltage reference with a static droop term plus an integrating
+ * share-bus correction that pulls its current towards the average of all
+ * live modules. Peers that stop talking fall out of the average after a
+ * timeout, so a missing node degrades to plain droop sharing.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace umnsvp {
+namespace boost {
+
+class current_share {
+   public:
+    /**
+     * @brief Maximum number of modules on one share bus, including this one.
+     */
+    static constexpr std::size_t max_nodes = 8;
+
+    current_share(uint8_t node_id, uint32_t timeout_ms, float droop_ohms,
+                  float share_gain, float max_trim_v, float decay_s);
+
+    void update_peer(uint8_t node_id, float current_a, uint32_t now_ms);
+    float vref_trim(float own_current_a, uint32_t now_ms, float dt_s);
+
+    float get_average_current() const;
+    uint8_t get_active_nodes() const;
+    uint8_t get_node_id() const;
+    void set_node_id(uint8_t node_id);
+
+   private:
+    struct peer {
+        float current_a = 0.0f;
+        uint32_t last_seen_ms = 0;
+        bool seen = false;
+    };
+
+    bool is_alive(const peer& p, uint32_t now_ms) const;
+
+    uint8_t node_id;
+    const uint32_t timeout_ms;
+    const float droop_ohms;
+    const float share_gain;
+    const float max_trim_v;
+    const float decay_s;
+
+    std::array<peer, max_nodes> peers = {};
+
+    float integrator = 0.0f;
+    float average_current = 0.0f;
+    uint8_t active_nodes = 1;
+};
+
+}  // namespace boost
+}  // namespace umnsvp
@@ -0,0 +1,115 @@
+/**
+ * @file duty_feedforward.h
+ * @brief Compile time boost feed-forward duty table.
+ *
+ * In continuous conduction the ideal boost duty is D = 1 - Vin / Vout. The
+ * divide is done once, at compile time, for the nominal output setpoint and
+ * stored as TIM1 compare counts indexed by the raw input voltage ADC code.
+ * At run time the feed-forward is a table lookup plus an integer linear
+ * interpolation, so a line transient moves the duty on the very next step
+ * instead of waiting for the voltage loop integrator.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "main.h"
+#include "mosfet_pwm.h"
+
+namespace umnsvp {
+namespace boost {
+namespace feedforward_detail {
+
+// Bits of the positive 23-bit ADC range consumed by the interpolation
+// fraction; the rest select the table segment.
+constexpr uint32_t index_shift = 16;
+constexpr std::size_t segments = (1UL << 23) >> index_shift;
+constexpr uint32_t max_counts =
+    static_cast<uint32_t>(BOOST_MAX_DUTY * (MOSFET_PWM_PERIOD_TICKS + 1U));
+
+constexpr uint16_t duty_counts(float vin) {
+    float duty = 1.0f - vin / BOOST_VOUT_SETPOINT_V;
+    if (duty < 0.0f) {
+        duty = 0.0f;
+    } else if (duty > BOOST_MAX_DUTY) {
+        duty = BOOST_MAX_DUTY;
+    }
+    const uint32_t counts = static_cast<uint32_t>(
+        duty * (MOSFET_PWM_PERIOD_TICKS + 1U) + 0.5f);
+    return static_cast<uint16_t>(counts < max_counts ? counts : max_counts);
+}
+
+constexpr std::array<uint16_t, segments + 1> make_table() {
+    std::array<uint16_t, segments + 1> t = {};
+    for (std::size_t i = 0; i <= segments; i++) {
+        const float vin = static_cast<float>(i << index_shift) *
+                          BOOST_ADC_VIN_VOLTS_PER_COUNT;
+        t[i] = duty_counts(vin);
+    }
+    return t;
+}
+
+}  // namespace feedforward_detail
+
+class duty_feedforward {
+   public:
+    static constexpr uint32_t index_shift = feedforward_detail::index_shift;
+    static constexpr std::size_t segments = feedforward_detail::segments;
+
+    /**
+     * @brief Highest compare value the loop may command.
+     */
+    static constexpr uint32_t max_counts = feedforward_detail::max_counts;
+
+    /**
+     * @brief Feed-forward compare counts for a raw input voltage ADC code.
+     *
+     * @param vin_code Sign extended 24-bit input voltage code.
+     * @return int32_t Compare counts in [0, max_counts].
+     */
+    static constexpr int32_t lookup(int32_t vin_code) {
+        if (vin_code <= 0) {
+            return table[0];
+        }
+        const uint32_t code = static_cast<uint32_t>(vin_code);
+        const uint32_t index = code >> index_shift;
+        if (index >= segments) {
+            return table[segments];
+        }
+        const int32_t frac = static_cast<int32_t>(code & frac_mask);
+        const int32_t a = table[index];
+        const int32_t b = table[index + 1];
+        return a + (((b - a) * frac) >> index_shift);
+    }
+
+    /**
+     * @brief Check that the table never rises with Vin.
+     */
+    static constexpr bool is_monotonic() {
+        for (std::size_t i = 0; i < segments; i++) {
+            if (table[i + 1] > table[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+   private:
+    static constexpr uint32_t frac_mask = (1UL << index_shift) - 1;
+
+    static constexpr std::array<uint16_t, segments + 1> table =
+        feedforward_detail::make_table();
+};
+
+// The table has to fall monotonically with Vin and never exceed the duty
+// limit, otherwise the interpolation could command an unsafe compare value.
+static_assert(duty_feedforward::is_monotonic());
+static_assert(duty_feedforward::lookup(0) ==
+              static_cast<int32_t>(duty_feedforward::max_counts));
+static_assert(duty_feedforward::lookup(INT32_MAX) == 0);
+
+}  // namespace boost
+}  // namespace umnsvp
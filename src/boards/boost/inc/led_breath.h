@@ -1,7 +0,0 @@
-#ifndef LED_BREATH_H
-#define LED_BREATH_H
-
-void LED2_Breath_Init(void);
-void LED2_Breath_Update(void);
-
-#endif  // LED_BREATH_H
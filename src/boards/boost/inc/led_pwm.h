@@ -6,15 +6,24 @@
 extern "C" {
 #endif
 
+// Highest LED2 brightness level. Levels in a pattern table run from 0 (off)
+// to LED2_PWM_MAX_LEVEL (fully on).
+#define LED2_PWM_MAX_LEVEL (255U)
+
+// PWM frequency, and so the rate at which LED2_PWM_Play() advances through a
+// pattern table: one entry per PWM period.
+#define LED2_PWM_FREQUENCY_HZ (1000U)
+
 // Initialise PWM hardware that drives LED2 (PA5 on the Nucleo-L476RG).
 // Must be called after HAL_Init and SystemClock_Config so the timer reads
-// the correct clock tree configuration.
+// the correct clock tree configuration. The LED starts off.
 void LED2_PWM_Init(void);
 
-// Update LED2 brightness. Pass a value in the range [0.0f, 1.0f], where 0
-// turns the LED off and 1 drives it at full duty cycle. Values outside the
-// range are clamped to keep the timer in a valid state.
-void LED2_SetBrightness(float brightness);
+// Loop a table of brightness levels on LED2 forever. DMA copies one entry
+// into TIM2 CCR1 on every timer update, so playback needs no CPU time and
+// no interrupts. The table must stay valid until the next call, so it
+// normally lives in flash. Calls before LED2_PWM_Init() are ignored.
+void LED2_PWM_Play(const uint8_t* levels, uint16_t length);
 
 #ifdef __cplusplus
 }
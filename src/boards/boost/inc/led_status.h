@@ -0,0 +1,29 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// What LED2 shows. Every pattern is a precomputed table that the DMA loops
+// on its own, so a pattern keeps running while the core is busy, asleep or
+// halted in Error_Handler().
+typedef enum {
+    LED2_STATUS_OFF = 0,
+    LED2_STATUS_ON,
+    LED2_STATUS_BREATH,   // Running alone
+    LED2_STATUS_SHARING,  // Running with peers on the current share bus
+    LED2_STATUS_FAULT_1,  // Fault codes: N short flashes, then a pause
+    LED2_STATUS_FAULT_2,
+    LED2_STATUS_FAULT_3,
+    LED2_STATUS_FAULT_4,
+    LED2_STATUS_COUNT
+} LED2_Status;
+
+// Show a status pattern on LED2. Selecting the pattern that is already
+// playing does nothing, so this can be called every main loop pass.
+// LED2_PWM_Init() must have been called first.
+void LED2_Status_Set(LED2_Status status);
+
+#ifdef __cplusplus
+}
+#endif
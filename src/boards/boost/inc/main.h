@@ -31,7 +31,7 @@ extern "C" {
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
-
+#include "irq_tier.h"
 /* USER CODE END Includes */
 
 /* Exported types ------------------------------------------------------------*/
@@ -60,7 +60,7 @@ void Error_Handler(void);
 
 /* USER CODE BEGIN Private defines */
 #define BOOST_I2C1_INSTANCE I2C1
-#define BOOST_I2C1_TIMING 0x00100D14U
+#define BOOST_I2C1_TIMING 0x10909CECU
 #define BOOST_I2C1_OWN_ADDRESS1 0U
 #define BOOST_I2C1_ADDRESSING_MODE I2C_ADDRESSINGMODE_7BIT
 #define BOOST_I2C1_DUAL_ADDRESS_MODE I2C_DUALADDRESS_DISABLE
@@ -76,7 +76,9 @@ void Error_Handler(void);
 #define BOOST_SPI1_CLK_POLARITY SPI_POLARITY_LOW
 #define BOOST_SPI1_CLK_PHASE SPI_PHASE_1EDGE
 #define BOOST_SPI1_NSS SPI_NSS_SOFT
-#define BOOST_SPI1_BAUDRATE_PRESCALER SPI_BAUDRATEPRESCALER_2
+/* 80 MHz / 64 = 1.25 MHz. The ADC ran at 2 MHz (4 MHz MSI / 2), which no
+ * power of two divides 80 MHz into; /32 would be 2.5 MHz, above that. */
+#define BOOST_SPI1_BAUDRATE_PRESCALER SPI_BAUDRATEPRESCALER_64
 #define BOOST_SPI1_FIRST_BIT SPI_FIRSTBIT_MSB
 #define BOOST_SPI1_TI_MODE SPI_TIMODE_DISABLE
 #define BOOST_SPI1_CRC_CALCULATION SPI_CRCCALCULATION_DISABLE
@@ -91,27 +93,69 @@ void Error_Handler(void);
 #define BOOST_USB_OTG_FS_PHY_INTERFACE HCD_PHY_EMBEDDED
 #define BOOST_USB_OTG_FS_SOF_ENABLE ENABLE
 
+/* The bxCAN prescalers in UMNSVP baud_rate.h assume an 80 MHz APB1 clock, so
+ * the 4 MHz MSI is multiplied up by the PLL: 4 MHz * 40 / 2 = 80 MHz. */
 #define BOOST_VOLTAGE_SCALING PWR_REGULATOR_VOLTAGE_SCALE1
 #define BOOST_RCC_OSCILLATOR_TYPE RCC_OSCILLATORTYPE_MSI
 #define BOOST_RCC_MSI_STATE RCC_MSI_ON
 #define BOOST_RCC_MSI_CALIBRATION 0U
 #define BOOST_RCC_MSI_CLOCK_RANGE RCC_MSIRANGE_6
-#define BOOST_RCC_PLL_STATE RCC_PLL_NONE
+#define BOOST_RCC_PLL_STATE RCC_PLL_ON
+#define BOOST_RCC_PLL_SOURCE RCC_PLLSOURCE_MSI
+#define BOOST_RCC_PLLM 1U
+#define BOOST_RCC_PLLN 40U
+#define BOOST_RCC_PLLP RCC_PLLP_DIV7
+#define BOOST_RCC_PLLQ RCC_PLLQ_DIV2
+#define BOOST_RCC_PLLR RCC_PLLR_DIV2
 #define BOOST_RCC_CLOCK_TYPE (RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_SYSCLK | RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2)
-#define BOOST_RCC_SYSCLK_SOURCE RCC_SYSCLKSOURCE_MSI
+#define BOOST_RCC_SYSCLK_SOURCE RCC_SYSCLKSOURCE_PLLCLK
 #define BOOST_RCC_AHBCLK_DIVIDER RCC_SYSCLK_DIV1
 #define BOOST_RCC_APB1CLK_DIVIDER RCC_HCLK_DIV1
 #define BOOST_RCC_APB2CLK_DIVIDER RCC_HCLK_DIV1
-#define BOOST_FLASH_LATENCY FLASH_LATENCY_0
+#define BOOST_FLASH_LATENCY FLASH_LATENCY_4
 #define BOOST_I2C1_ANALOG_FILTER I2C_ANALOGFILTER_ENABLE
 #define BOOST_I2C1_DIGITAL_FILTER 0U
 #define BOOST_DMA1_ENABLE_CLOCK() do { __HAL_RCC_DMA1_CLK_ENABLE(); } while (0)
-#define BOOST_DMA1_CH2_PRIORITY 0U
+#define BOOST_DMA1_CH2_PRIORITY UMNSVP_IRQ_PRIORITY_DRIVER
 #define BOOST_DMA1_CH2_SUBPRIORITY 0U
-#define BOOST_DMA1_CH3_PRIORITY 0U
+#define BOOST_DMA1_CH3_PRIORITY UMNSVP_IRQ_PRIORITY_DRIVER
 #define BOOST_DMA1_CH3_SUBPRIORITY 0U
 #define BOOST_GPIO_ENABLE_PORTS() do { __HAL_RCC_GPIOA_CLK_ENABLE(); __HAL_RCC_GPIOB_CLK_ENABLE(); } while (0)
 #define BOOST_MAIN_LOOP_DELAY_MS 5U
+
+/* External SPI ADC channel assignment and scaling (24-bit bipolar codes). */
+#define BOOST_ADC_VIN_CHANNEL 0U
+#define BOOST_ADC_VOUT_CHANNEL 1U
+#define BOOST_ADC_IOUT_CHANNEL 2U
+#define BOOST_ADC_VIN_VOLTS_PER_COUNT (100.0f / 8388608.0f)
+#define BOOST_ADC_VOUT_VOLTS_PER_COUNT (100.0f / 8388608.0f)
+#define BOOST_ADC_IOUT_AMPS_PER_COUNT (20.0f / 8388608.0f)
+
+/* Output voltage loop. */
+#define BOOST_VOUT_SETPOINT_V 48.0f
+#define BOOST_VLOOP_KP 0.002f
+#define BOOST_VLOOP_KI 0.5f
+#define BOOST_MAX_DUTY 0.85f
+
+/* Current sharing between paralleled modules over CAN1. Every module sends
+ * its output current on BOOST_SHARE_CAN_BASE_ID + node id; the low IDs win
+ * arbitration over the regular telemetry. The node id is strapped per unit
+ * on three DIP switches, bit 0 first, read once at ShareBus_Init(). */
+#define BOOST_SHARE_ID_PORT GPIOC
+#define BOOST_SHARE_ID0_PIN GPIO_PIN_0
+#define BOOST_SHARE_ID1_PIN GPIO_PIN_1
+#define BOOST_SHARE_ID2_PIN GPIO_PIN_2
+#define BOOST_SHARE_MAX_NODES 8U
+#define BOOST_SHARE_CAN_BASE_ID 0x020U
+#define BOOST_SHARE_PERIOD_MS 10U
+#define BOOST_SHARE_TIMEOUT_MS 50U
+#define BOOST_SHARE_DROOP_OHMS 0.010f
+#define BOOST_SHARE_GAIN 0.5f
+#define BOOST_SHARE_MAX_TRIM_V 1.0f
+#define BOOST_SHARE_DECAY_S 1.0f
+/* CAN1 health is sent every window as a can::report_packet() from node
+ * BOOST_BUS_REPORT_NODE + node id. */
+#define BOOST_BUS_REPORT_NODE 0x20U
 /* USER CODE END Private defines */
 
 #ifdef __cplusplus
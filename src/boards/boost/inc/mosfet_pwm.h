@@ -3,9 +3,25 @@
 
 #include "main.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 80 MHz / (19 + 1) / 256 keeps the switching frequency at ~15.6 kHz.
+#define MOSFET_PWM_PRESCALER      (19U)
+#define MOSFET_PWM_PERIOD_TICKS   (255U)
+
 void MOSFET_PWM_Init(void);
 void MOSFET_PWM_SetDutyCycle(float duty_cycle);
 
+// Write a compare value straight into TIM1 CCR1, clamped to the period. This
+// is the hot path used by the control loop.
+void MOSFET_PWM_SetCompare(uint32_t compare);
+
 extern TIM_HandleTypeDef htim1;
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif  // MOSFET_PWM_H
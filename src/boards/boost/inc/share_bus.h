@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Read this module's node id from its DIP switches and bring up CAN1 and the
+// current share filters. Call once after the system clock is configured.
+void ShareBus_Init(void);
+
+// Broadcast this module's output current to the other modules, and the CAN1
+// health report once per statistics window.
+void ShareBus_Publish(float own_current_a);
+
+// Voltage reference trim (droop plus share-bus correction) for this module.
+// dt_s is the time since the previous call in seconds.
+float ShareBus_VrefTrim(float own_current_a, float dt_s);
+
+// Average output current of all live modules, including this one.
+float ShareBus_GetAverageCurrent(void);
+
+// Number of live modules on the share bus, including this one.
+uint8_t ShareBus_GetActiveNodes(void);
+
+// This module's node id, as strapped on its DIP switches.
+uint8_t ShareBus_GetNodeId(void);
+
+// Whether another module was heard sending with this module's node id. Both
+// modules then stay off the share bus until they are re-strapped and reset,
+// and run on droop alone.
+bool ShareBus_HasIdConflict(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,91 @@
+/**
+ * @file boost_control.cc
+ * @brief Output voltage loop of the boost converter.
+ *
+ * The MOSFET compare value is the sum of a feed-forward term looked up from
+ * the input voltage and a PI correction on the output voltage error. Both are
+ * kept in TIM1 compare counts so the result goes straight into CCR1.
+ */
+
+#include "boost_control.h"
+
+#include <algorithm>
+
+#include "adc.h"
+#include "duty_feedforward.h"
+#include "main.h"
+#include "mosfet_pwm.h"
+
+namespace umnsvp {
+namespace boost {
+namespace {
+
+constexpr float counts_per_duty = MOSFET_PWM_PERIOD_TICKS + 1U;
+constexpr int32_t max_counts =
+    static_cast<int32_t>(duty_feedforward::max_counts);
+
+// The PI correction may move the compare anywhere in the allowed range
+// relative to the feed-forward, so a bad table entry cannot lock the loop
+// out. The integrator is clamped to the same range to stop windup.
+constexpr float max_correction = BOOST_MAX_DUTY;
+
+float integrator = 0.0f;
+int32_t compare = 0;
+
+/**
+ * @brief Read one channel of the external ADC as a signed code.
+ *
+ * The ADC returns a 24-bit two's complement code; sign extend it to 32 bits.
+ */
+int32_t read_code(uint8_t channel) {
+    uint32_t raw = 0U;
+    set_mux(channel);
+    adc_read(&raw);
+    return static_cast<int32_t>(raw << 8) >> 8;
+}
+
+}  // namespace
+}  // namespace boost
+}  // namespace umnsvp
+
+using namespace umnsvp::boost;
+
+extern "C" {
+
+void BoostControl_Init(void) {
+    integrator = 0.0f;
+    compare = 0;
+    MOSFET_PWM_SetCompare(0U);
+}
+
+void BoostControl_Sample(BoostMeasurements* meas) {
+    meas->vin_code = read_code(BOOST_ADC_VIN_CHANNEL);
+    meas->vin = meas->vin_code * BOOST_ADC_VIN_VOLTS_PER_COUNT;
+    meas->vout =
+        read_code(BOOST_ADC_VOUT_CHANNEL) * BOOST_ADC_VOUT_VOLTS_PER_COUNT;
+    meas->iout =
+        read_code(BOOST_ADC_IOUT_CHANNEL) * BOOST_ADC_IOUT_AMPS_PER_COUNT;
+}
+
+void BoostControl_Step(const BoostMeasurements* meas, float vref_trim,
+                       float dt_s) {
+    const float error = (BOOST_VOUT_SETPOINT_V + vref_trim) - meas->vout;
+
+    integrator = std::clamp(integrator + BOOST_VLOOP_KI * error * dt_s,
+                            -max_correction, max_correction);
+    const float correction = std::clamp(BOOST_VLOOP_KP * error + integrator,
+                                        -max_correction, max_correction);
+
+    const int32_t feedback =
+        static_cast<int32_t>(correction * counts_per_duty);
+    compare = std::clamp(duty_feedforward::lookup(meas->vin_code) + feedback,
+                         static_cast<int32_t>(0), max_counts);
+
+    MOSFET_PWM_SetCompare(static_cast<uint32_t>(compare));
+}
+
+float BoostControl_GetDuty(void) {
+    return compare / counts_per_duty;
+}
+
+}  // extern "C"
@@ -0,0 +1,130 @@
+/**
+ * @file current_share.cc
+ * @brief Average current sharing between paralleled boost modules.
+ */
+
+#include "current_share.h"
+
+#include <algorithm>
+
+namespace umnsvp {
+namespace boost {
+
+/**
+ * @brief Construct the current share controller for this module.
+ *
+ * @param node_id Position of this module on the share bus, [0, max_nodes).
+ * @param timeout_ms Age after which a silent peer is dropped from the average.
+ * @param droop_ohms Static droop resistance applied to the own current.
+ * @param share_gain Integral gain of the share-bus correction [V/(A*s)].
+ * @param max_trim_v Limit of the share-bus correction in either direction.
+ * @param decay_s Time constant used to bleed the correction off while no
+ * peers are alive.
+ */
+current_share::current_share(uint8_t node_id, uint32_t timeout_ms,
+                             float droop_ohms, float share_gain,
+                             float max_trim_v, float decay_s)
+    : node_id(node_id),
+      timeout_ms(timeout_ms),
+      droop_ohms(droop_ohms),
+      share_gain(share_gain),
+      max_trim_v(max_trim_v),
+      decay_s(decay_s) {
+}
+
+/**
+ * @brief Record a current report from another module.
+ *
+ * Reports carrying our own node id or an out of range id are ignored.
+ *
+ * @param node_id Sender of the report.
+ * @param current_a Output current of the sender.
+ * @param now_ms Reception time in milliseconds.
+ */
+void current_share::update_peer(uint8_t node_id, float current_a,
+                                uint32_t now_ms) {
+    if (node_id >= max_nodes || node_id == this->node_id) {
+        return;
+    }
+    peer& p = peers[node_id];
+    p.current_a = current_a;
+    p.last_seen_ms = now_ms;
+    p.seen = true;
+}
+
+/**
+ * @brief Compute the voltage reference trim for this module.
+ *
+ * trim = -droop * I_own + integral(gain * (I_avg - I_own))
+ *
+ * A module carrying less than the average raises its reference and vice
+ * versa, so all live modules converge on the same current.
+ *
+ * @param own_current_a Output current of this module.
+ * @param now_ms Current time in milliseconds, used to expire silent peers.
+ * @param dt_s Time since the previous call in seconds.
+ * @return float Trim to add to the nominal voltage reference [V].
+ */
+float current_share::vref_trim(float own_current_a, uint32_t now_ms,
+                               float dt_s) {
+    float sum = own_current_a;
+    uint8_t count = 1;
+    for (const peer& p : peers) {
+        if (is_alive(p, now_ms)) {
+            sum += p.current_a;
+            count++;
+        }
+    }
+    average_current = sum / static_cast<float>(count);
+    active_nodes = count;
+
+    if (count > 1) {
+        integrator += share_gain * (average_current - own_current_a) * dt_s;
+        integrator = std::clamp(integrator, -max_trim_v, max_trim_v);
+    } else {
+        // Alone on the bus: let the old correction fade out instead of
+        // holding whatever offset the last peer left behind.
+        integrator -= integrator * std::min(1.0f, dt_s / decay_s);
+    }
+
+    return integrator - droop_ohms * own_current_a;
+}
+
+/**
+ * @brief Average output current of all live modules, including this one, as
+ * of the last call to vref_trim().
+ */
+float current_share::get_average_current() const {
+    return average_current;
+}
+
+/**
+ * @brief Number of live modules, including this one, as of the last call to
+ * vref_trim().
+ */
+uint8_t current_share::get_active_nodes() const {
+    return active_nodes;
+}
+
+uint8_t current_share::get_node_id() const {
+    return node_id;
+}
+
+/**
+ * @brief Move this module to another position on the share bus, forgetting
+ * every peer report received so far.
+ *
+ * @param node_id New position, [0, max_nodes).
+ */
+void current_share::set_node_id(uint8_t node_id) {
+    this->node_id = node_id;
+    peers = {};
+}
+
+bool current_share::is_alive(const peer& p, uint32_t now_ms) const {
+    // Unsigned subtraction keeps this correct across the tick wrap.
+    return p.seen && (now_ms - p.last_seen_ms) <= timeout_ms;
+}
+
+}  // namespace boost
+}  // namespace umnsvp
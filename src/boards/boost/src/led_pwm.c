@@ -3,11 +3,15 @@
  * @brief PWM driver for Nucleo-L476RG LED2 (PA5 → TIM2_CH1).
  *
  * This code configures TIM2 channel 1 to generate a 1 kHz PWM signal
- * with 1000 steps of resolution (0.1% brightness steps).
+ * with 256 brightness levels. The compare value is never written by the CPU:
+ * DMA1 channel 5 copies the next level of a pattern table into CCR1 on every
+ * timer update, looping over the table in circular mode.
  */
 
 #include "led_pwm.h"
 
+#include <stdbool.h>
+
 #include "main.h"
 
 // ------------------------------------------------------------
@@ -21,19 +25,28 @@
 #define LED2_TIMER TIM2
 #define LED2_TIMER_CHANNEL TIM_CHANNEL_1
 
+// TIM2_CH1 is request 4 on DMA1 channel 5. With TIM2 CR2.CCDS set the CC1
+// DMA request is raised on the update event instead of the compare match, so
+// every PWM period fetches exactly one level. (TIM2_UP itself sits on DMA1
+// channel 2, which SPI1 RX already uses.)
+#define LED2_DMA_CHANNEL DMA1_Channel5
+#define LED2_DMA_REQUEST DMA_REQUEST_4
+
 // ------------------------------------------------------------
 // PWM configuration
 // ------------------------------------------------------------
 
-// We target a 1 kHz PWM frequency with 1000 steps of resolution.
-// -> Timer runs at 1 MHz (1 µs per tick)
-// -> Auto-reload value = 999 (counts 0..999)
-// -> Period = 1000 µs = 1 kHz frequency
-static const uint32_t kDesiredPwmFrequencyHz = 1000U;
-static const uint32_t kTimerResolution = 1000U;  // 0..999 duty-cycle steps
+// We target a 1 kHz PWM frequency with 256 brightness levels.
+// -> Timer runs at 255 kHz
+// -> Auto-reload value = 254 (counts 0..254), so level 255 is fully on
+// -> Period = ~1000 µs = 1 kHz frequency
+static const uint32_t kDesiredPwmFrequencyHz = LED2_PWM_FREQUENCY_HZ;
+static const uint32_t kTimerResolution = LED2_PWM_MAX_LEVEL;  // 0..254 count
 
-// HAL timer handle
+// HAL timer and DMA handles
 static TIM_HandleTypeDef s_ledTimer = {0};
+static DMA_HandleTypeDef s_ledDma = {0};
+static bool s_ledReady = false;
 
 // ------------------------------------------------------------
 // Internal helpers
@@ -95,10 +108,10 @@ static void ConfigureLedTimer(void) {
     s_ledTimer.Instance = LED2_TIMER;
     s_ledTimer.Init.Prescaler = prescaler;
     s_ledTimer.Init.CounterMode = TIM_COUNTERMODE_UP;
-    s_ledTimer.Init.Period = (kTimerResolution - 1U);  // 999
+    s_ledTimer.Init.Period = (kTimerResolution - 1U);  // 254
     s_ledTimer.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
     s_ledTimer.Init.RepetitionCounter = 0U;
-    s_ledTimer.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_DISABLE;
+    s_ledTimer.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
 
     if (HAL_TIM_PWM_Init(&s_ledTimer) != HAL_OK) {
         Error_Handler();  // Provided by CubeMX template
@@ -106,6 +119,8 @@ static void ConfigureLedTimer(void) {
 
     // PWM channel setup
     TIM_OC_InitTypeDef config = {0};
+    // PWM config enables CCR1 preload, so a level written by DMA takes effect
+    // on the next update and never cuts a period short.
     config.OCMode = TIM_OCMODE_PWM1;  // Active when counter < compare
     config.Pulse = 0U;                // Start off (0% duty)
     config.OCPolarity = TIM_OCPOLARITY_HIGH;
@@ -117,6 +132,35 @@ static void ConfigureLedTimer(void) {
     }
 }
 
+/**
+ * @brief Configure DMA1 channel 5 to feed TIM2 CCR1 from a level table.
+ *
+ * The table holds bytes and CCR1 is a word register; the DMA zero extends
+ * each byte on the way.
+ */
+static void ConfigureLedDma(void) {
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    s_ledDma.Instance = LED2_DMA_CHANNEL;
+    s_ledDma.Init.Request = LED2_DMA_REQUEST;
+    s_ledDma.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    s_ledDma.Init.PeriphInc = DMA_PINC_DISABLE;
+    s_ledDma.Init.MemInc = DMA_MINC_ENABLE;
+    s_ledDma.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+    s_ledDma.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    s_ledDma.Init.Mode = DMA_CIRCULAR;
+    s_ledDma.Init.Priority = DMA_PRIORITY_LOW;
+
+    if (HAL_DMA_Init(&s_ledDma) != HAL_OK) {
+        Error_Handler();
+    }
+
+    // Raise the CC1 DMA request on update events and enable it. The DMA
+    // channel interrupt stays disabled: nothing needs to run per transfer.
+    SET_BIT(LED2_TIMER->CR2, TIM_CR2_CCDS);
+    __HAL_TIM_ENABLE_DMA(&s_ledTimer, TIM_DMA_CC1);
+}
+
 // ------------------------------------------------------------
 // Public API
 // ------------------------------------------------------------
@@ -127,30 +171,33 @@ static void ConfigureLedTimer(void) {
 void LED2_PWM_Init(void) {
     ConfigureLedGpio();   // Setup PA5
     ConfigureLedTimer();  // Setup TIM2 CH1
+    ConfigureLedDma();    // Setup DMA1 CH5 -> TIM2 CCR1
 
-    // Start PWM generation
+    // Start PWM generation with the LED off
     if (HAL_TIM_PWM_Start(&s_ledTimer, LED2_TIMER_CHANNEL) != HAL_OK) {
         Error_Handler();
     }
 
-    // Ensure the LED starts OFF
-    LED2_SetBrightness(0.0f);
+    s_ledReady = true;
 }
 
 /**
- * @brief Set LED brightness as float [0.0 .. 1.0].
+ * @brief Loop a brightness level table on LED2.
+ *
+ * Switching patterns only retargets the DMA channel; the timer keeps running,
+ * so the current PWM period finishes with the old level.
  *
- * @param brightness 0.0 = off, 1.0 = max brightness
+ * @param levels Table of levels in [0, LED2_PWM_MAX_LEVEL].
+ * @param length Number of entries, one per PWM period.
  */
-void LED2_SetBrightness(float brightness) {
-    if (brightness < 0.0f) {
-        brightness = 0.0f;
-    } else if (brightness > 1.0f) {
-        brightness = 1.0f;
+void LED2_PWM_Play(const uint8_t* levels, uint16_t length) {
+    // Error_Handler() shows a fault pattern, so this must not call it back.
+    if (!s_ledReady || levels == NULL || length == 0U) {
+        return;
     }
 
-    const uint32_t compare =
-        (uint32_t)(brightness * (float)(kTimerResolution - 1U));
-
-    __HAL_TIM_SET_COMPARE(&s_ledTimer, LED2_TIMER_CHANNEL, compare);
+    // Abort fails harmlessly if no table is playing yet.
+    (void)HAL_DMA_Abort(&s_ledDma);
+    (void)HAL_DMA_Start(&s_ledDma, (uint32_t)levels,
+                        (uint32_t)&LED2_TIMER->CCR1, length);
 }
@@ -0,0 +1,135 @@
+/**
+ * @file led_status.cc
+ * @brief LED2 status patterns.
+ *
+ * The patterns are built at compile time as tables of brightness levels, one
+ * entry per LED PWM period, and live in flash. Showing a pattern just points
+ * the LED DMA channel at its table.
+ */
+
+#include "led_status.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "led_pwm.h"
+
+namespace umnsvp {
+namespace boost {
+namespace {
+
+constexpr uint32_t entries_per_ms = LED2_PWM_FREQUENCY_HZ / 1000U;
+static_assert(entries_per_ms * 1000U == LED2_PWM_FREQUENCY_HZ,
+              "status tables assume a whole number of PWM periods per ms");
+
+constexpr std::size_t entries(uint32_t ms) {
+    return ms * entries_per_ms;
+}
+
+constexpr uint8_t full = LED2_PWM_MAX_LEVEL;
+
+constexpr uint32_t breath_ms = 1000;
+constexpr uint32_t sharing_ms = 1000;
+constexpr uint32_t flash_on_ms = 150;
+constexpr uint32_t flash_off_ms = 250;
+constexpr uint32_t fault_pause_ms = 1000;
+
+/**
+ * @brief Fade in and out over one period. The level follows the square of
+ * the ramp so the fade looks even to the eye instead of lingering near full.
+ */
+template <std::size_t N>
+constexpr std::array<uint8_t, N> make_breath() {
+    std::array<uint8_t, N> levels = {};
+    for (std::size_t i = 0; i < N; i++) {
+        const std::size_t ramp = i < N / 2 ? i : N - 1 - i;
+        const uint32_t x = static_cast<uint32_t>(ramp * full / (N / 2 - 1));
+        levels[i] = static_cast<uint8_t>(x * x / full);
+    }
+    return levels;
+}
+
+/**
+ * @brief Turn the LED fully on for [on_ms) at each of the given offsets.
+ */
+template <std::size_t N, std::size_t Flashes>
+constexpr std::array<uint8_t, N> make_flashes(
+    const std::array<uint32_t, Flashes>& start_ms, uint32_t on_ms) {
+    std::array<uint8_t, N> levels = {};
+    for (uint32_t start : start_ms) {
+        for (std::size_t i = entries(start);
+             i < entries(start + on_ms) && i < N; i++) {
+            levels[i] = full;
+        }
+    }
+    return levels;
+}
+
+template <uint32_t Count>
+constexpr std::array<uint32_t, Count> flash_starts() {
+    std::array<uint32_t, Count> starts = {};
+    for (uint32_t i = 0; i < Count; i++) {
+        starts[i] = i * (flash_on_ms + flash_off_ms);
+    }
+    return starts;
+}
+
+template <uint32_t Count>
+constexpr std::size_t fault_entries =
+    entries(Count * (flash_on_ms + flash_off_ms) + fault_pause_ms);
+
+template <uint32_t Count>
+constexpr std::array<uint8_t, fault_entries<Count>> make_fault() {
+    return make_flashes<fault_entries<Count>>(flash_starts<Count>(),
+                                              flash_on_ms);
+}
+
+constexpr std::array<uint8_t, 1> off = {0};
+constexpr std::array<uint8_t, 1> on = {full};
+constexpr auto breath = make_breath<entries(breath_ms)>();
+// Double blink, like a heartbeat.
+constexpr auto sharing = make_flashes<entries(sharing_ms)>(
+    std::array<uint32_t, 2>{0, 200}, 100);
+constexpr auto fault_1 = make_fault<1>();
+constexpr auto fault_2 = make_fault<2>();
+constexpr auto fault_3 = make_fault<3>();
+constexpr auto fault_4 = make_fault<4>();
+
+struct pattern {
+    const uint8_t* levels;
+    uint16_t length;
+};
+
+template <std::size_t N>
+constexpr pattern make_pattern(const std::array<uint8_t, N>& levels) {
+    // The DMA transfer counter is 16 bits wide.
+    static_assert(N > 0 && N <= UINT16_MAX);
+    return {levels.data(), static_cast<uint16_t>(N)};
+}
+
+// Indexed by LED2_Status.
+constexpr std::array<pattern, LED2_STATUS_COUNT> patterns = {
+    make_pattern(off),     make_pattern(on),      make_pattern(breath),
+    make_pattern(sharing), make_pattern(fault_1), make_pattern(fault_2),
+    make_pattern(fault_3), make_pattern(fault_4),
+};
+
+static_assert(breath[0] == 0 && breath[entries(breath_ms) / 2] == full);
+static_assert(fault_2[entries(flash_on_ms + flash_off_ms)] == full);
+
+LED2_Status current = LED2_STATUS_COUNT;
+
+}  // namespace
+}  // namespace boost
+}  // namespace umnsvp
+
+extern "C" void LED2_Status_Set(LED2_Status status) {
+    using namespace umnsvp::boost;
+
+    if (status >= LED2_STATUS_COUNT || status == current) {
+        return;
+    }
+    current = status;
+    LED2_PWM_Play(patterns[status].levels, patterns[status].length);
+}
@@ -1,10 +1,12 @@
 
 #include "main.h"
 
+#include "boost_control.h"
 #include "enable1.h"
-#include "led_breath.h"
 #include "led_pwm.h"
+#include "led_status.h"
 #include "mosfet_pwm.h"
+#include "share_bus.h"
 
 I2C_HandleTypeDef hi2c1;
 
@@ -43,12 +45,32 @@ int main(void) {
     enable_gpio_pin_always_high();  // Configure PA2 to output 3.3V
     LED2_PWM_Init();
     MOSFET_PWM_Init();
-    LED2_Breath_Init();
+    BoostControl_Init();
+    ShareBus_Init();
+
+    const float loop_dt_s = (float)BOOST_MAIN_LOOP_DELAY_MS / 1000.0f;
+    uint32_t last_share_ms = HAL_GetTick();
 
     /* Infinite loop */
     while (1) {
-        LED2_Breath_Update();
-        HAL_Delay(BOOST_MAIN_LOOP_DELAY_MS); /* Pace the breathing animation. */
+        BoostMeasurements meas;
+        BoostControl_Sample(&meas);
+        BoostControl_Step(&meas, ShareBus_VrefTrim(meas.iout, loop_dt_s),
+                          loop_dt_s);
+
+        if ((HAL_GetTick() - last_share_ms) >= BOOST_SHARE_PERIOD_MS) {
+            last_share_ms = HAL_GetTick();
+            ShareBus_Publish(meas.iout);
+        }
+
+        if (ShareBus_HasIdConflict()) {
+            LED2_Status_Set(LED2_STATUS_FAULT_2); /* Node id strapped twice. */
+        } else {
+            LED2_Status_Set(ShareBus_GetActiveNodes() > 1U
+                                ? LED2_STATUS_SHARING
+                                : LED2_STATUS_BREATH);
+        }
+        HAL_Delay(BOOST_MAIN_LOOP_DELAY_MS); /* Pace the control loop. */
     }
 }
 
@@ -74,6 +96,12 @@ void SystemClock_Config(void) {
     RCC_OscInitStruct.MSICalibrationValue = BOOST_RCC_MSI_CALIBRATION;
     RCC_OscInitStruct.MSIClockRange = BOOST_RCC_MSI_CLOCK_RANGE;
     RCC_OscInitStruct.PLL.PLLState = BOOST_RCC_PLL_STATE;
+    RCC_OscInitStruct.PLL.PLLSource = BOOST_RCC_PLL_SOURCE;
+    RCC_OscInitStruct.PLL.PLLM = BOOST_RCC_PLLM;
+    RCC_OscInitStruct.PLL.PLLN = BOOST_RCC_PLLN;
+    RCC_OscInitStruct.PLL.PLLP = BOOST_RCC_PLLP;
+    RCC_OscInitStruct.PLL.PLLQ = BOOST_RCC_PLLQ;
+    RCC_OscInitStruct.PLL.PLLR = BOOST_RCC_PLLR;
     if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK) {
         Error_Handler();
     }
@@ -177,6 +205,7 @@ static void MX_GPIO_Init(void) {
 void Error_Handler(void) {
     /* User can add his own implementation to report the HAL error return state
      */
+    LED2_Status_Set(LED2_STATUS_FAULT_1); /* Keeps flashing with IRQs off. */
     __disable_irq();
     while (1) {
     }
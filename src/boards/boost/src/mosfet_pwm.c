@@ -1,6 +1,5 @@
 #include "mosfet_pwm.h"
 
-#define MOSFET_PWM_PERIOD_TICKS   (255U)
 #define MOSFET_PWM_DEFAULT_COMPARE (125U)
 #define MOSFET_PWM_CHANNEL        TIM_CHANNEL_1
 #define MOSFET_PWM_MIN_DUTY       (0.0f)
@@ -16,7 +15,7 @@ static void MX_TIM1_Init(void)
   TIM_BreakDeadTimeConfigTypeDef sBreakDeadTimeConfig = {0};
 
   htim1.Instance = TIM1;
-  htim1.Init.Prescaler = 0;
+  htim1.Init.Prescaler = MOSFET_PWM_PRESCALER;
   htim1.Init.CounterMode = TIM_COUNTERMODE_UP;
   htim1.Init.Period = MOSFET_PWM_PERIOD_TICKS;
   htim1.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
@@ -108,3 +107,13 @@ void MOSFET_PWM_SetDutyCycle(float duty_cycle)
 
   __HAL_TIM_SET_COMPARE(&htim1, MOSFET_PWM_CHANNEL, compare);
 }
+
+void MOSFET_PWM_SetCompare(uint32_t compare)
+{
+  if (compare > MOSFET_PWM_PERIOD_TICKS)
+  {
+    compare = MOSFET_PWM_PERIOD_TICKS;
+  }
+
+  htim1.Instance->CCR1 = compare;
+}
@@ -0,0 +1,213 @@
+/**
+ * @file share_bus.cc
+ * @brief CAN transport for the boost current share.
+ *
+ * Each module sends a 2 byte frame on BOOST_SHARE_CAN_BASE_ID + node id
+ * carrying its output current as a little endian int16 in 10 mA steps. The
+ * share IDs sit below the regular telemetry so they win arbitration.
+ *
+ * The node id comes from three DIP switches so identical boards can be
+ * paralleled. Two modules strapped alike would send the same ID with
+ * different data and corrupt each other's frames in arbitration, so a
+ * module that hears its own ID from the bus stops sending for good.
+ */
+
+#include "share_bus.h"
+
+#include <array>
+
+#include "bxcan.h"
+#include "critical_section.h"
+#include "current_share.h"
+#include "dip_switch.h"
+#include "main.h"
+#include "skylab2_can_base.h"
+
+namespace umnsvp {
+namespace boost {
+namespace {
+
+static_assert(BOOST_SHARE_MAX_NODES <= current_share::max_nodes);
+// Three strap bits address every node.
+static_assert(BOOST_SHARE_MAX_NODES <= 8);
+
+constexpr float amps_per_lsb = 0.01f;
+constexpr uint8_t share_frame_length = 2;
+
+/**
+ * @brief Minimal can_base for the share bus; the share frames are not part of
+ * the generated skylab2 packet set. Bound to the bxCAN driver so the RX and
+ * TX interrupt paths make direct calls.
+ */
+class share_can : public skylab2::basic_can_base<can::bxcan_driver> {
+   public:
+    explicit share_can(can::bxcan_driver& driver)
+        : basic_can_base(driver, can::fifo::FIFO0) {
+    }
+};
+
+constexpr std::array<uint32_t, BOOST_SHARE_MAX_NODES> make_rx_ids() {
+    std::array<uint32_t, BOOST_SHARE_MAX_NODES> ids = {};
+    for (std::size_t i = 0; i < ids.size(); i++) {
+        ids[i] = BOOST_SHARE_CAN_BASE_ID + i;
+    }
+    return ids;
+}
+
+constexpr std::array<uint32_t, BOOST_SHARE_MAX_NODES> rx_ids = make_rx_ids();
+
+can::bxcan_driver can_device(CAN1);
+share_can share_bus(can_device);
+// The node id is set from the straps in ShareBus_Init().
+current_share share(0, BOOST_SHARE_TIMEOUT_MS, BOOST_SHARE_DROOP_OHMS,
+                    BOOST_SHARE_GAIN, BOOST_SHARE_MAX_TRIM_V,
+                    BOOST_SHARE_DECAY_S);
+
+std::array<dip_switch, 3> id_straps = {
+    dip_switch(BOOST_SHARE_ID_PORT, BOOST_SHARE_ID0_PIN),
+    dip_switch(BOOST_SHARE_ID_PORT, BOOST_SHARE_ID1_PIN),
+    dip_switch(BOOST_SHARE_ID_PORT, BOOST_SHARE_ID2_PIN),
+};
+
+/// Set from the RX interrupt once a frame with our own ID is received.
+volatile bool id_conflict = false;
+
+uint8_t read_node_id() {
+    uint8_t node_id = 0;
+    for (std::size_t bit = 0; bit < id_straps.size(); bit++) {
+        id_straps[bit].init();
+        if (id_straps[bit].get_state()) {
+            node_id |= static_cast<uint8_t>(1U << bit);
+        }
+    }
+    return node_id;
+}
+
+int16_t encode_current(float current_a) {
+    float lsb = current_a / amps_per_lsb;
+    if (lsb > INT16_MAX) {
+        lsb = INT16_MAX;
+    } else if (lsb < INT16_MIN) {
+        lsb = INT16_MIN;
+    }
+    return static_cast<int16_t>(lsb);
+}
+
+/**
+ * @brief Drain every pending share frame from the receive FIFO.
+ */
+void rx_handler() {
+    // The bxCAN FIFO is three deep, so one burst empties it.
+    std::array<can::packet, 3> burst;
+    const std::size_t count = share_bus.receive_burst(burst);
+    for (std::size_t i = 0; i < count; i++) {
+        const can::packet& received = burst[i];
+        const uint32_t id = received.get_id();
+        if (id < BOOST_SHARE_CAN_BASE_ID ||
+            id >= BOOST_SHARE_CAN_BASE_ID + BOOST_SHARE_MAX_NODES ||
+            received.get_length() < share_frame_length) {
+            continue;
+        }
+        const uint8_t node_id = id - BOOST_SHARE_CAN_BASE_ID;
+        if (node_id == share.get_node_id()) {
+            // bxCAN does not receive its own frames, so another module is
+            // strapped to our ID.
+            id_conflict = true;
+            continue;
+        }
+        const uint8_t* data = received.get_data();
+        const int16_t raw = static_cast<int16_t>(data[0] | (data[1] << 8));
+        share.update_peer(node_id, raw * amps_per_lsb, HAL_GetTick());
+    }
+}
+
+}  // namespace
+}  // namespace boost
+}  // namespace umnsvp
+
+using umnsvp::boost::can_device;
+using umnsvp::boost::id_conflict;
+using umnsvp::boost::share;
+using umnsvp::boost::share_bus;
+
+extern "C" {
+
+void ShareBus_Init(void) {
+    share.set_node_id(umnsvp::boost::read_node_id());
+    share_bus.init(umnsvp::can::baud_rate::BAUD_RATE_500, false,
+                   umnsvp::boost::rx_ids.data(), umnsvp::boost::rx_ids.size());
+}
+
+void ShareBus_Publish(float own_current_a) {
+    if (id_conflict) {
+        return;
+    }
+    const int16_t raw = umnsvp::boost::encode_current(own_current_a);
+    const uint8_t data[umnsvp::boost::share_frame_length] = {
+        static_cast<uint8_t>(raw), static_cast<uint8_t>(raw >> 8)};
+    share_bus.send_packet(umnsvp::can::packet(
+        BOOST_SHARE_CAN_BASE_ID + share.get_node_id(),
+        umnsvp::boost::share_frame_length, data));
+
+    if (can_device.poll_stats(HAL_GetTick())) {
+        share_bus.send_packet(umnsvp::can::report_packet(
+            can_device.get_stats().get_report(),
+            BOOST_BUS_REPORT_NODE + share.get_node_id()));
+    }
+}
+
+float ShareBus_VrefTrim(float own_current_a, float dt_s) {
+    // The peer table is written from the CAN RX interrupt.
+    umnsvp::irq::critical_section lock;
+    return share.vref_trim(own_current_a, HAL_GetTick(), dt_s);
+}
+
+float ShareBus_GetAverageCurrent(void) {
+    return share.get_average_current();
+}
+
+uint8_t ShareBus_GetActiveNodes(void) {
+    return share.get_active_nodes();
+}
+
+uint8_t ShareBus_GetNodeId(void) {
+    return share.get_node_id();
+}
+
+bool ShareBus_HasIdConflict(void) {
+    return id_conflict;
+}
+
+void CAN1_RX0_IRQHandler(void) {
+    HAL_CAN_IRQHandler(can_device.get_handle());
+}
+
+void CAN1_TX_IRQHandler(void) {
+    HAL_CAN_IRQHandler(can_device.get_handle());
+}
+
+void CAN1_SCE_IRQHandler(void) {
+    HAL_CAN_IRQHandler(can_device.get_handle());
+}
+
+void HAL_CAN_ErrorCallback(CAN_HandleTypeDef* hcan) {
+    can_device.handle_error();
+}
+
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef* hcan) {
+    umnsvp::boost::rx_handler();
+}
+
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef* hcan) {
+    share_bus.tx_handler();
+}
+
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef* hcan) {
+    share_bus.tx_handler();
+}
+
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef* hcan) {
+    share_bus.tx_handler();
+}
+
+}  // extern "C"
@@ -1,8 +1,8 @@
-from dataclasses import dataclass
+from dataclasses import dataclass, field
 import os
 import yaml
 from pathlib import Path
-from typing import List, Dict, Union
+from typing import List, Dict, Optional, Union
 
 
 @dataclass
@@ -56,11 +56,26 @@ class CANMessageDef:
     data: List[Union[CANMessageFieldDef, CANMessageBitfieldDef]]
 
 
+@dataclass
+class CANRouteDef:
+    """A packet a gateway board forwards from its bus to another."""
+
+    packet: str
+    to: str
+    # ID to send it with on the other bus; None keeps the ID.
+    id: Optional[int] = None
+    # Forward at most one every min_interval_ms; 0 forwards every one.
+    min_interval_ms: int = 0
+    # Forward one in every decimate.
+    decimate: int = 1
+
+
 @dataclass
 class CANBoardDef:
     name: str
     transmit: List[str]
     receive: List[str]
+    routes: List[CANRouteDef] = field(default_factory=list)
 
 
 c_lengths = {
@@ -241,7 +256,23 @@ def load_all(path: Path):
             name = raw_board_def["name"]
             transmit = raw_board_def["transmit"]
             receive = raw_board_def["receive"]
-            board = CANBoardDef(name=name, transmit=transmit, receive=receive)
+            routes = []
+            for raw_route_def in raw_board_def.get("routes", []):
+                route = CANRouteDef(
+                    packet=raw_route_def["packet"],
+                    to=raw_route_def["to"],
+                    id=raw_route_def.get("id"),
+                    min_interval_ms=raw_route_def.get("min_interval_ms", 0),
+                    decimate=raw_route_def.get("decimate", 1),
+                )
+                if not 0 <= route.min_interval_ms <= 0xFFFF:
+                    raise ValueError(f"{name}: min_interval_ms out of range")
+                if not 1 <= route.decimate <= 0xFF:
+                    raise ValueError(f"{name}: decimate out of range")
+                routes.append(route)
+            board = CANBoardDef(
+                name=name, transmit=transmit, receive=receive, routes=routes
+            )
             all_boards[board.name] = board
 
     return all_packets, all_types, all_busses, all_boards
@@ -1,5 +1,6 @@
 import sys
 import os
+import math
 from typing import List, Dict, Optional
 import can_parser
 from subprocess import call
@@ -101,6 +102,363 @@ def generate_boards(env: Environment, boards, packets, busses, types):
     env_args = {"boards": boards,"packets": packets,"busses": busses,"types": types}
     return h_tmpl.render(**env_args), cc_tmpl.render(**env_args)
 
+# A received periodic message times out after this many periods, so one lost
+# frame is tolerated but a sender that stops is noticed within a few periods.
+RX_DEADLINE_PERIODS = 3
+
+# Longest hyperperiod the phase planner will look at; schedules whose periods
+# do not repeat within this are planned over a window of this length.
+MAX_HYPERPERIOD_MS = 60000
+
+
+def frame_bits_estimate(packet: CANMessageDef, types) -> int:
+    """Worst case bits a classic data frame of this packet takes on the bus,
+    including stuff bits and the intermission, so heavier frames weigh more
+    when spreading the load."""
+    length = min(packet_length(packet, types), 8)
+    stuffed = (54 if packet.is_extended else 34) + 8 * length
+    return stuffed + (stuffed - 1) // 4 + 13
+
+
+def plan_schedule(board: CANBoardDef, packets: Packets, types) -> List[dict]:
+    """Build the periodic transmit schedule of a board.
+
+    Every transmitted packet with a frequency gets a period in ms and a phase
+    offset within that period. Packets are placed shortest period first, each
+    at the phase where the busiest ms slot over the hyperperiod is least
+    loaded, ties going to the phase with the least total load and then the
+    earliest. Boards sending several messages at one rate then spread them
+    out instead of queueing them all in the same ms.
+    """
+    entries = []
+    for name in board.transmit:
+        packet = packet_def_from_name(name, packets)
+        if packet is None or packet.frequency <= 0:
+            continue
+        period = max(1, min(0xFFFF, round(1000 / packet.frequency)))
+        entries.append(
+            {
+                "name": packet.name,
+                "id": packet.id,
+                "period_ms": period,
+                "phase_ms": 0,
+                "bits": frame_bits_estimate(packet, types),
+            }
+        )
+    if not entries:
+        return entries
+
+    hyperperiod = 1
+    for entry in entries:
+        hyperperiod = math.lcm(hyperperiod, entry["period_ms"])
+        if hyperperiod > MAX_HYPERPERIOD_MS:
+            hyperperiod = MAX_HYPERPERIOD_MS
+            break
+
+    load = [0] * hyperperiod
+    for entry in sorted(entries, key=lambda e: (e["period_ms"], e["id"])):
+        period = entry["period_ms"]
+        best = None
+        for phase in range(min(period, hyperperiod)):
+            slots = load[phase::period]
+            score = (max(slots), sum(slots), phase)
+            if best is None or score < best:
+                best = score
+        entry["phase_ms"] = best[2]
+        for slot in range(best[2], hyperperiod, period):
+            load[slot] += entry["bits"]
+
+    return entries
+
+
+def plan_deadlines(board: CANBoardDef, packets: Packets) -> List[dict]:
+    """Build the RX deadlines of a board.
+
+    Every received packet with a frequency gets a deadline of
+    RX_DEADLINE_PERIODS periods. Entries are sorted by rx_key() (the ID with
+    bit 31 set for extended IDs) so the monitor can look arrivals up with a
+    binary search.
+    """
+    entries = []
+    for name in board.receive:
+        packet = packet_def_from_name(name, packets)
+        if packet is None or packet.frequency <= 0:
+            continue
+        deadline = math.ceil(RX_DEADLINE_PERIODS * 1000 / packet.frequency)
+        entries.append(
+            {
+                "name": packet.name,
+                "id": packet.id,
+                "extended": packet.is_extended,
+                "deadline_ms": max(1, min(0xFFFF, deadline)),
+            }
+        )
+    return sorted(
+        entries, key=lambda e: e["id"] | (0x80000000 if e["extended"] else 0)
+    )
+
+
+def rx_mix(x: int) -> int:
+    """Same mixer as skylab2::rx_mix() in skylab2_rx_dispatch.h."""
+    x ^= x >> 16
+    x = (x * 0x7FEB352D) & 0xFFFFFFFF
+    x ^= x >> 15
+    x = (x * 0x846CA68B) & 0xFFFFFFFF
+    x ^= x >> 16
+    return x
+
+
+def next_power_of_two(n: int) -> int:
+    return 1 << max(0, n - 1).bit_length()
+
+
+def build_rx_hash(keys: List[int]) -> dict:
+    """Find a hash and displace perfect hash for the given keys, matching
+    skylab2::rx_hash. Buckets are placed largest first, each at the smallest
+    displacement that puts all of its keys in free slots; if one cannot be
+    placed the table is doubled and the search starts again."""
+    slots = next_power_of_two(max(2, len(keys) + len(keys) // 4))
+    buckets = next_power_of_two(max(1, len(keys) // 2))
+    while slots <= 4096:
+        grouped = [[] for _ in range(buckets)]
+        for key in keys:
+            grouped[rx_mix(key) & (buckets - 1)].append(key)
+        order = sorted(range(buckets), key=lambda b: -len(grouped[b]))
+        displacement = [0] * buckets
+        table = [None] * slots
+        placed_all = True
+        for bucket in order:
+            if not grouped[bucket]:
+                break
+            for d in range(0x10000):
+                mixed = (d * 0x9E3779B9) & 0xFFFFFFFF
+                targets = [rx_mix(key ^ mixed) & (slots - 1) for key in grouped[bucket]]
+                if len(set(targets)) == len(targets) and all(
+                    table[t] is None for t in targets
+                ):
+                    displacement[bucket] = d
+                    for key, t in zip(grouped[bucket], targets):
+                        table[t] = key
+                    break
+            else:
+                placed_all = False
+                break
+        if placed_all:
+            return {"displacement": displacement, "table": table}
+        slots *= 2
+    raise RuntimeError("Could not build an RX hash for " + str(len(keys)) + " IDs")
+
+
+def plan_dispatch(board: CANBoardDef, packets: Packets) -> Dict[str, dict]:
+    """Build the RX dispatch table of a board, one perfect hash per bus.
+
+    Messages are numbered in the order the board lists them; the hash maps
+    each ID to that number."""
+    by_bus: Dict[str, List[CANMessageDef]] = dict()
+    for name in board.receive:
+        packet = packet_def_from_name(name, packets)
+        if packet is None:
+            continue
+        by_bus.setdefault(packet.bus, []).append(packet)
+
+    plans = dict()
+    for bus, bus_packets in by_bus.items():
+        if len(bus_packets) >= 0xFF:
+            raise RuntimeError(f"{board.name} receives too many {bus} packets")
+        keys = [p.id | (0x80000000 if p.is_extended else 0) for p in bus_packets]
+        if len(set(keys)) != len(keys):
+            raise RuntimeError(f"{board.name} receives an ID twice on {bus}")
+        hashed = build_rx_hash(keys)
+        index = {key: i for i, key in enumerate(keys)}
+        plans[bus] = {
+            "messages": [p.name for p in bus_packets],
+            "displacement": hashed["displacement"],
+            "table": [
+                None if key is None else {"key": key, "index": index[key]}
+                for key in hashed["table"]
+            ],
+        }
+    return plans
+
+
+def plan_routes(board: CANBoardDef, packets: Packets, busses) -> Optional[dict]:
+    """Build the gateway route table of a board, or None if it has no
+    routes.
+
+    The board's buses are numbered in the order of the busses file. Routes
+    are sorted by source bus and ID so the routes of one frame are
+    contiguous, and a perfect hash maps each source bus and ID to its first
+    route. A routed packet must also be in the board's receive list, or the
+    board's RX filter drops it before the gateway sees it."""
+    if not board.routes:
+        return None
+    used = set()
+    for name in board.transmit + board.receive:
+        bus = bus_from_packet_name(name, packets)
+        if bus is not None:
+            used.add(bus)
+    routes = []
+    for route in board.routes:
+        packet = packet_def_from_name(route.packet, packets)
+        if packet is None:
+            raise RuntimeError(f"{board.name} routes unknown packet {route.packet}")
+        if route.to not in [bus.name for bus in busses]:
+            raise RuntimeError(f"{board.name} routes {route.packet} to unknown bus {route.to}")
+        if route.to == packet.bus:
+            raise RuntimeError(f"{board.name} routes {route.packet} back onto {route.to}")
+        if route.packet not in board.receive:
+            raise RuntimeError(f"{board.name} routes {route.packet} but does not receive it")
+        used.update([packet.bus, route.to])
+        routes.append((packet, route))
+    bus_names = bus_sort(list(used), busses)
+    if len(bus_names) > 4:
+        raise RuntimeError(f"{board.name} routes between more than 4 busses")
+
+    entries = []
+    for packet, route in routes:
+        source = bus_names.index(packet.bus)
+        key = packet.id | (0x80000000 if packet.is_extended else 0) | (source << 29)
+        entries.append(
+            {
+                "name": packet.name,
+                "key": key,
+                "from": packet.bus,
+                "to": route.to,
+                "to_id": packet.id if route.id is None else route.id,
+                "to_extended": packet.is_extended,
+                "min_interval_ms": route.min_interval_ms,
+                "decimate": route.decimate,
+            }
+        )
+    entries.sort(key=lambda e: (e["key"], bus_names.index(e["to"])))
+    if len(entries) >= 0xFF:
+        raise RuntimeError(f"{board.name} has too many routes")
+
+    first = dict()
+    for i, entry in enumerate(entries):
+        first.setdefault(entry["key"], i)
+    hashed = build_rx_hash(list(first.keys()))
+    return {
+        "busses": bus_names,
+        "routes": entries,
+        "displacement": hashed["displacement"],
+        "table": [
+            None if key is None else {"key": key, "index": first[key]}
+            for key in hashed["table"]
+        ],
+    }
+
+
+def generate_dispatch(env: Environment, boards, packets: Packets, busses):
+    dispatch = {
+        name: plan_dispatch(board, packets) for name, board in boards.items()
+    }
+    routes = dict()
+    for name, board in boards.items():
+        plan = plan_routes(board, packets, busses)
+        if plan is not None:
+            routes[name] = plan
+    tmpl = env.get_template("skylab2_dispatch.h.j2")
+    return tmpl.render(dispatch=dispatch, routes=routes)
+
+
+# Longest classic frame, extended ID and 8 bytes: the most a frame that has
+# already won arbitration can hold up the next one.
+MAX_FRAME_BITS = 160
+
+
+def schedule_report(
+    schedules: Dict[str, List[dict]], packets: Packets, busses
+) -> str:
+    """Describe the planned transmit schedules for review.
+
+    For every board and bus: the load of each ms slot of the hyperperiod
+    that has something due, as a share of the bus bit rate, and for every
+    packet its worst-case lateness. That is the time from its slot starting
+    to its last bit, with every frame the board has due in the same slot on
+    the same bus and a lower ID sent first, after one longest frame already
+    on the bus. Traffic from other boards is not included.
+    """
+    rates = {bus.name: bus.baud_rate for bus in busses}
+    lines = [
+        "skylab2 transmit schedule report",
+        "",
+        "Slot loads are bits due in that ms over the bus bits per ms.",
+        "Lateness is from the start of the packet's slot to its last bit,",
+        f"after one {MAX_FRAME_BITS} bit frame already on the bus and every",
+        "lower ID this board has due in the same slot; other boards'",
+        "traffic is not included.",
+    ]
+    for board, entries in schedules.items():
+        if not entries:
+            continue
+        hyperperiod = 1
+        for entry in entries:
+            hyperperiod = min(
+                math.lcm(hyperperiod, entry["period_ms"]), MAX_HYPERPERIOD_MS
+            )
+        by_bus: Dict[str, List[dict]] = {}
+        for entry in entries:
+            bus = bus_from_packet_name(entry["name"], packets)
+            by_bus.setdefault(bus, []).append(entry)
+
+        for bus, bus_entries in by_bus.items():
+            rate = rates[bus]  # kb/s, so also bits per ms
+            bit_us = 1000 / rate
+            slots: List[List[dict]] = [[] for _ in range(hyperperiod)]
+            for entry in bus_entries:
+                for slot in range(
+                    entry["phase_ms"], hyperperiod, entry["period_ms"]
+                ):
+                    slots[slot].append(entry)
+
+            lines += ["", f"{board} on {bus} ({rate} kb/s, {hyperperiod} ms)"]
+            busiest = max(sum(e["bits"] for e in due) for due in slots)
+            lines.append(f"  busiest slot: {100 * busiest / rate:.1f}%")
+            for slot, due in enumerate(slots):
+                if due:
+                    bits = sum(e["bits"] for e in due)
+                    lines.append(
+                        f"  slot {slot:5} ms: {bits:5} bits"
+                        f" {100 * bits / rate:5.1f}%"
+                    )
+
+            lines.append(
+                f"  {'packet':32} {'id':>10} {'period':>8} {'phase':>7}"
+                f" {'bits':>5} {'lateness':>10}"
+            )
+            for entry in sorted(bus_entries, key=lambda e: e["id"]):
+                worst = 0
+                for due in slots:
+                    if entry in due:
+                        ahead = sum(
+                            e["bits"] for e in due if e["id"] < entry["id"]
+                        )
+                        worst = max(worst, ahead)
+                lateness = (MAX_FRAME_BITS + worst + entry["bits"]) * bit_us
+                lines.append(
+                    f"  {entry['name']:32} {entry['id']:#10x}"
+                    f" {entry['period_ms']:5} ms {entry['phase_ms']:+4} ms"
+                    f" {entry['bits']:5} {lateness:7.0f} us"
+                )
+    return "\n".join(lines) + "\n"
+
+
+def generate_schedule(env: Environment, boards, packets: Packets, types, busses):
+    """Render the schedule header, and the report that goes with it."""
+    schedules = {
+        name: plan_schedule(board, packets, types)
+        for name, board in boards.items()
+    }
+    deadlines = {
+        name: plan_deadlines(board, packets) for name, board in boards.items()
+    }
+    tmpl = env.get_template("skylab2_schedule.h.j2")
+    return (
+        tmpl.render(schedules=schedules, deadlines=deadlines),
+        schedule_report(schedules, packets, busses),
+    )
+
 
 # ---------------Custom Filters ------------------
 def bus_sort(busses: list[str], all_busses: List[CANBusDef]) -> List[str]:
@@ -131,9 +489,8 @@ def gen_packing_code(packet: CANMessageDef, types) -> str:
             dlc += 1
         else:
             if field.data_type == "float":
-                for i in range(4):
-                    packing_code += '\tdata['+str(dlc)+'] = ((can_float_union_t){.f=msg.'+field.name+'}).b['+str(i)+'];\n'
-                    dlc += 1
+                packing_code += '\tstore_field<float, '+str(dlc)+'>(&data[0], msg.'+field.name+');\n'
+                dlc += 4
             elif field.data_type in can_parser.c_lengths: # standard values
                 for i in range(can_parser.c_lengths[field.data_type]):
                     packing_code += '\tdata['+str(dlc)+'] = msg.' + field.name+'>>'+str(i*8)+';\n'       
@@ -159,10 +516,7 @@ def gen_unpacking_code(packet: CANMessageDef, types) -> str:
                 bitcount += 1
             dlc += 1
         elif field.data_type == "float":
-            unpacking_code += f"\t\tcan_float_union_t {field.name} = {{0}};\n"
-            for idx in range(can_parser.c_lengths[field.data_type]):
-                unpacking_code += f"{field.name}.b[{idx}] = data[{dlc + idx}];\n"
-            unpacking_code += f"msg.{field.name} = {field.name}.f;\n"
+            unpacking_code += f"msg.{field.name} = load_field<float, {dlc}>(&data[0]);\n"
             dlc += can_parser.c_lengths[field.data_type]
         elif field.data_type in can_parser.c_lengths:
             blist = []
@@ -181,12 +535,81 @@ def gen_unpacking_code(packet: CANMessageDef, types) -> str:
 
     return unpacking_code
 
+def view_fields(packet: CANMessageDef, types) -> List[dict]:
+    """This filter lays out a packet for the generated views: the byte
+    offset and C++ type of every field, and the bit of every bitfield
+    subfield, in the same order gen_packing_code() packs them."""
+    fields = []
+    dlc = 0
+    for field in packet.data:
+        if type(field) == CANMessageBitfieldDef:
+            for bit, subfield in enumerate(field.bits):
+                fields.append(
+                    {
+                        "name": f"{field.name}_{subfield.name}",
+                        "kind": "bit",
+                        "offset": dlc,
+                        "bit": bit,
+                    }
+                )
+            dlc += 1
+        elif field.data_type in can_parser.c_lengths:
+            fields.append(
+                {
+                    "name": field.name,
+                    "kind": "value",
+                    "type": field.data_type,
+                    "wire_type": field.data_type,
+                    "offset": dlc,
+                }
+            )
+            dlc += can_parser.c_lengths[field.data_type]
+        else:
+            base_type = types[field.data_type].base_type
+            fields.append(
+                {
+                    "name": field.name,
+                    "kind": "value",
+                    "type": field.data_type,
+                    "wire_type": base_type,
+                    "offset": dlc,
+                }
+            )
+            dlc += can_parser.c_lengths[base_type]
+    if dlc > 8:
+        raise RuntimeError(f"{packet.name} is longer than 8 bytes")
+    return fields
+
+
+def packet_length(packet: CANMessageDef, types) -> int:
+    """This filter returns the number of data bytes of a packet."""
+    length = 0
+    for field in packet.data:
+        if type(field) == CANMessageBitfieldDef:
+            length += 1
+        elif field.data_type in can_parser.c_lengths:
+            length += can_parser.c_lengths[field.data_type]
+        else:
+            length += can_parser.c_lengths[types[field.data_type].base_type]
+    return length
+
+
+def generate_views(env: Environment, packets: Packets, types):
+    ps = []
+    for bus, vals in packets.items():
+        ps += list(vals.values())
+    tmpl = env.get_template("skylab2_views.h.j2")
+    return tmpl.render(packets=sorted(ps, key=lambda p: p.id), types=types)
+
+
 def load_environment(path: str):
     e = Environment(loader=FileSystemLoader(path), autoescape=select_autoescape())
     e.filters['name2packet'] = packet_def_from_name
     e.filters['gen_packing_code'] = gen_packing_code
     e.filters['gen_unpacking_code'] = gen_unpacking_code
     e.filters['bus_sort'] = bus_sort
+    e.filters['view_fields'] = view_fields
+    e.filters['packet_length'] = packet_length
     return e
     
 def main():
@@ -238,6 +661,12 @@ def main():
     skylab2_types_h_path = args.source_path / "inc" / "skylab2_types.h"
     skylab2_boards_h_path = args.source_path / "inc" / "skylab2_boards.h"
     skylab2_boards_cc_path = args.source_path / "src" / "skylab2_boards.cc"
+    skylab2_schedule_h_path = args.source_path / "inc" / "skylab2_schedule.h"
+    skylab2_schedule_report_path = (
+        args.source_path / "inc" / "skylab2_schedule_report.txt"
+    )
+    skylab2_dispatch_h_path = args.source_path / "inc" / "skylab2_dispatch.h"
+    skylab2_views_h_path = args.source_path / "inc" / "skylab2_views.h"
 
     h = generate_packets(env, all_packets)
     with open(skylab2_packets_h_path, "w") as f:
@@ -257,6 +686,22 @@ def main():
     with open(skylab2_boards_cc_path, "w") as f:
         f.write(cc)
 
+    h, report = generate_schedule(
+        env, all_boards, all_packets, all_types, all_busses
+    )
+    with open(skylab2_schedule_h_path, "w") as f:
+        f.write(h)
+    with open(skylab2_schedule_report_path, "w") as f:
+        f.write(report)
+
+    h = generate_dispatch(env, all_boards, all_packets, all_busses)
+    with open(skylab2_dispatch_h_path, "w") as f:
+        f.write(h)
+
+    h = generate_views(env, all_packets, all_types)
+    with open(skylab2_views_h_path, "w") as f:
+        f.write(h)
+
     print("\nSuccess!")
     # sys.exit(retcode)
 
@@ -15,9 +15,16 @@ function(add_umnsvp targ)
 		    ${UMNSVP_DIR}/uid.cc
 		    ${UMNSVP_DIR}/dip_switch.cc
 		    ${UMNSVP_DIR}/can_packet.cc
+		    ${UMNSVP_DIR}/can_frame.cc
+		    ${UMNSVP_DIR}/can_fd_packet.cc
+		    ${UMNSVP_DIR}/can_bus_stats.cc
+		    ${UMNSVP_DIR}/isotp.cc
+		    ${UMNSVP_DIR}/can_bootloader.cc
 		    ${UMNSVP_DIR}/application_base.cc
 		    ${UMNSVP_DIR}/fdcan.cc
 		    ${UMNSVP_DIR}/bxcan.cc
+		    ${UMNSVP_DIR}/deferred_work.cc
+		    ${UMNSVP_DIR}/micros.cc
 		)
 		
 		# add includes
@@ -23,8 +23,38 @@
 
 #include "bxcan.h"
 
+#include <cstring>
+
+#include "filter_compiler.h"
+#include "irq_tier.h"
+#include "micros.h"
+
 namespace umnsvp {
 namespace can {
+namespace {
+
+/**
+ * @brief NVIC lines of one bxCAN peripheral.
+ */
+struct instance_irqs {
+    IRQn_Type rx0;
+    IRQn_Type rx1;
+    IRQn_Type tx;
+    IRQn_Type sce;
+};
+
+instance_irqs irqs_for(const CAN_TypeDef* instance) {
+#ifdef CAN2
+    if (instance == CAN2) {
+        return {CAN2_RX0_IRQn, CAN2_RX1_IRQn, CAN2_TX_IRQn, CAN2_SCE_IRQn};
+    }
+#endif
+    return {CAN1_RX0_IRQn, CAN1_RX1_IRQn, CAN1_TX_IRQn, CAN1_SCE_IRQn};
+}
+
+}  // namespace
+
+filter_bank_allocator bxcan_driver::banks;
 
 /**
  * @brief Construct a new bxcan driver for the specified peripheral.
@@ -45,7 +75,9 @@ bxcan_driver::bxcan_driver(CAN_TypeDef* can_peripheral, bool config_isr)
     handle.Init.TimeSeg1 = time_segment_1;
     handle.Init.TimeSeg2 = time_segment_2;
 
-    handle.Init.TimeTriggeredMode = DISABLE;
+    // Time triggered mode only turns on the RX timestamp counter; TX frames
+    // are not stamped unless TransmitGlobalTime is set per frame.
+    handle.Init.TimeTriggeredMode = ENABLE;
     handle.Init.AutoBusOff = ENABLE;
     handle.Init.AutoWakeUp = DISABLE;
     handle.Init.AutoRetransmission = ENABLE;
@@ -62,6 +94,8 @@ HAL_StatusTypeDef bxcan_driver::init(baud_rate rate, bool extended) {
     // Hardcoded prescaler from: http://www.bittiming.can-wiki.info/
     // See @ref baud_ref documentation for more information.
     handle.Init.Prescaler = static_cast<uint32_t>(rate);
+    clock.set_rate(rate);
+    stats.set_rate(rate);
 
     if (handle.Instance == CAN1) {
         // Enable CAN1 clock.
@@ -78,16 +112,11 @@ HAL_StatusTypeDef bxcan_driver::init(baud_rate rate, bool extended) {
 
         // Initialize the GPIO pins for CAN1.
         HAL_GPIO_Init(can1_port, &GPIO_InitStruct);
-        if (config_isr) {
-            HAL_NVIC_SetPriority(CAN1_RX0_IRQn, 1, 0);
-            HAL_NVIC_EnableIRQ(CAN1_RX0_IRQn);
-            HAL_NVIC_SetPriority(CAN1_TX_IRQn, 1, 0);
-            HAL_NVIC_EnableIRQ(CAN1_TX_IRQn);
-        }
     }
 #ifdef STM32F405xx
     else if (handle.Instance == CAN2) {
-        // Enable CAN1 clock.
+        // Enable CAN1 and CAN2 clocks; the filter banks live in CAN1.
+        __HAL_RCC_CAN1_CLK_ENABLE();
         __HAL_RCC_CAN2_CLK_ENABLE();
         // Enable GPIOB clock since the CAN pins are on GPIOB.
         CAN2_GPIO_CLOCK_ENABLE();
@@ -98,18 +127,12 @@ HAL_StatusTypeDef bxcan_driver::init(baud_rate rate, bool extended) {
         GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
         GPIO_InitStruct.Alternate = can2_af;
 
-        // Initialize the GPIO pins for CAN1.
+        // Initialize the GPIO pins for CAN2.
         HAL_GPIO_Init(can2_port, &GPIO_InitStruct);
-        if (config_isr) {
-            HAL_NVIC_SetPriority(CAN2_RX1_IRQn, 2, 1);
-            HAL_NVIC_EnableIRQ(CAN2_RX1_IRQn);
-            HAL_NVIC_SetPriority(CAN2_TX_IRQn, 2, 1);
-            HAL_NVIC_EnableIRQ(CAN2_TX_IRQn);
-        }
     }
 #elif STM32F469xx
     else if (handle.Instance == CAN2) {
-        // Enable CAN1 and CAN2 clocks.
+        // Enable CAN1 and CAN2 clocks; the filter banks live in CAN1.
         __HAL_RCC_CAN1_CLK_ENABLE();
         __HAL_RCC_CAN2_CLK_ENABLE();
         // Enable GPIOB clock since the CAN pins are on GPIOB.
@@ -121,14 +144,17 @@ HAL_StatusTypeDef bxcan_driver::init(baud_rate rate, bool extended) {
         GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
         GPIO_InitStruct.Alternate = can2_af;
 
-        // Initialize the GPIO pins for CAN1.
+        // Initialize the GPIO pins for CAN2.
         HAL_GPIO_Init(can2_port, &GPIO_InitStruct);
-        if (config_isr) {
-            HAL_NVIC_SetPriority(CAN2_RX0_IRQn, 5, 0);
-            HAL_NVIC_EnableIRQ(CAN2_RX0_IRQn);
-        }
     }
 #endif
+    if (config_isr) {
+        const instance_irqs irqs = irqs_for(handle.Instance);
+        irq::enable(default_fifo() == CAN_RX_FIFO0 ? irqs.rx0 : irqs.rx1,
+                    irq::tier::DRIVER);
+        irq::enable(irqs.tx, irq::tier::DRIVER);
+        irq::enable(irqs.sce, irq::tier::DRIVER);
+    }
     return HAL_CAN_Init(&handle);
 }
 
@@ -145,21 +171,25 @@ HAL_StatusTypeDef bxcan_driver::start() {
     HAL_StatusTypeDef notif_status = HAL_OK;
 
     if (config_isr) {
-        if (handle.Instance == CAN1) {
-            notif_status = HAL_CAN_ActivateNotification(
-                &handle, CAN_IT_RX_FIFO0_MSG_PENDING);
-        }
-#ifdef STM32F405xx
-        else if (handle.Instance == CAN2) {
+        notif_status = HAL_CAN_ActivateNotification(
+            &handle, default_fifo() == CAN_RX_FIFO0
+                         ? CAN_IT_RX_FIFO0_MSG_PENDING
+                         : CAN_IT_RX_FIFO1_MSG_PENDING);
+        if (split_fifos && notif_status == HAL_OK) {
+            // Urgent IDs arrive in FIFO1 and pre-empt the bulk FIFO0.
+            const instance_irqs irqs = irqs_for(handle.Instance);
             notif_status = HAL_CAN_ActivateNotification(
                 &handle, CAN_IT_RX_FIFO1_MSG_PENDING);
+            irq::enable(irqs.rx1, irq::tier::DRIVER);
+            irq::enable(irqs.rx0, irq::tier::BULK);
         }
-#elif STM32F469xx
-        else if (handle.Instance == CAN2) {
+        if (notif_status == HAL_OK) {
+            // Fault confinement changes feed the bus statistics through
+            // handle_error().
             notif_status = HAL_CAN_ActivateNotification(
-                &handle, CAN_IT_RX_FIFO0_MSG_PENDING);
+                &handle, CAN_IT_ERROR_WARNING | CAN_IT_ERROR_PASSIVE |
+                             CAN_IT_BUSOFF | CAN_IT_ERROR);
         }
-#endif
     }
 
     if (start_status != HAL_OK)
@@ -183,86 +213,292 @@ HAL_StatusTypeDef bxcan_driver::stop() {
 }
 
 /**
- * @brief
- *
- * @param filter_index
- * @param id0
- * @param id1
- * @param id2
- * @param id3
- * @return constexpr CAN_FilterTypeDef
+ * @brief Whether this is CAN2, which filters with the upper banks.
  */
-constexpr CAN_FilterTypeDef make_filter_from_ids(std::size_t filter_index,
-                                                 uint16_t id0, uint16_t id1,
-                                                 uint16_t id2, uint16_t id3) {
-    return {
-        .FilterIdHigh = static_cast<uint32_t>(id0) << 5,
-        .FilterIdLow = static_cast<uint32_t>(id1) << 5,
-        .FilterMaskIdHigh = static_cast<uint32_t>(id2) << 5,
-        .FilterMaskIdLow = static_cast<uint32_t>(id3) << 5,
+bool bxcan_driver::is_slave() const {
+#ifdef CAN2
+    return handle.Instance == CAN2;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief The FIFO filter_list() and filter_all() route frames to.
+ *
+ * CAN2 on the F405 has always received in FIFO1; every other peripheral
+ * uses FIFO0.
+ */
+uint32_t bxcan_driver::default_fifo() const {
+#ifdef STM32F405xx
+    if (is_slave()) {
+        return CAN_RX_FIFO1;
+    }
+#endif
+    return CAN_RX_FIFO0;
+}
+
+/**
+ * @brief Release this peripheral's filter banks and claim count new ones.
+ *
+ * @param count Banks needed.
+ * @param first Set to the first bank of the claim.
+ * @return HAL_StatusTypeDef HAL_ERROR if the other peripheral holds too
+ * many banks.
+ */
+HAL_StatusTypeDef bxcan_driver::claim_banks(std::size_t count,
+                                            uint32_t& first) {
+    const bool slave = is_slave();
+    CAN_FilterTypeDef config = {
         .FilterFIFOAssignment = CAN_RX_FIFO0,
-        .FilterBank = filter_index,
-        .FilterMode = CAN_FILTERMODE_IDLIST,
-        .FilterScale = CAN_FILTERSCALE_16BIT,
+        .FilterMode = CAN_FILTERMODE_IDMASK,
+        .FilterScale = CAN_FILTERSCALE_32BIT,
+        .FilterActivation = DISABLE,
+        .SlaveStartFilterBank = banks.slave_start(),
+    };
+    for (std::size_t i = 0; i < banks.count(slave); i++) {
+        config.FilterBank = banks.first(slave) + i;
+        HAL_StatusTypeDef filter_status = set_filter(config);
+        if (filter_status != HAL_OK) {
+            return filter_status;
+        }
+    }
+    return banks.claim(slave, count, first) ? HAL_OK : HAL_ERROR;
+}
+
+/**
+ * @brief Filter register value for a standard ID in a 16-bit scale bank.
+ *
+ * STID sits in the top 11 bits; RTR, IDE and EXID[17:15] are left 0.
+ */
+constexpr uint32_t standard_filter_reg(uint32_t id) {
+    return (id & filter::standard_id_mask) << 5;
+}
+
+/**
+ * @brief Filter register value for an extended ID in a 32-bit scale bank.
+ *
+ * The ID sits above IDE, RTR and a reserved bit, with IDE set.
+ */
+constexpr uint32_t extended_filter_reg(uint32_t id) {
+    return ((id & filter::extended_id_mask) << 3) | CAN_ID_EXT;
+}
+
+/**
+ * @brief Program a compiled filter into consecutive filter banks.
+ *
+ * Standard IDs use 16-bit scale banks (four listed IDs or two masks per
+ * bank), extended IDs use 32-bit scale banks (two listed IDs or one mask per
+ * bank).
+ *
+ * @param program Output of filter::compile_masks().
+ * @param fifo_assignment CAN_RX_FIFO0 or CAN_RX_FIFO1.
+ * @param bank First bank to use, advanced past the banks used.
+ * @return HAL_StatusTypeDef
+ */
+HAL_StatusTypeDef bxcan_driver::apply_filters(const filter::program& program,
+                                              uint32_t fifo_assignment,
+                                              uint32_t& bank) {
+    const bool is_extended = program.extended;
+
+    // Collect the register values per filter mode. Unused slots in a bank
+    // repeat the first entry of that bank.
+    std::array<uint32_t, filter::max_ids> lists = {};
+    std::array<uint32_t, filter::max_ids> ids = {};
+    std::array<uint32_t, filter::max_ids> masks = {};
+    std::size_t list_count = 0;
+    std::size_t mask_count = 0;
+    for (std::size_t i = 0; i < program.count; i++) {
+        const filter::rule& rule = program.rules[i];
+        if (rule.type == filter::kind::LIST) {
+            lists[list_count++] = is_extended ? extended_filter_reg(rule.id)
+                                              : standard_filter_reg(rule.id);
+        } else if (is_extended) {
+            ids[mask_count] = extended_filter_reg(rule.id);
+            // Also match IDE and RTR, so only extended data frames pass.
+            masks[mask_count++] =
+                ((rule.arg & filter::extended_id_mask) << 3) | 0x6;
+        } else {
+            ids[mask_count] = standard_filter_reg(rule.id);
+            // Also match RTR and IDE, so only standard data frames pass.
+            masks[mask_count++] = standard_filter_reg(rule.arg) | 0x18;
+        }
+    }
+
+    CAN_FilterTypeDef config = {
+        .FilterFIFOAssignment = fifo_assignment,
+        .FilterBank = bank,
+        .FilterScale =
+            is_extended ? CAN_FILTERSCALE_32BIT : CAN_FILTERSCALE_16BIT,
+        .FilterActivation = ENABLE,
+        .SlaveStartFilterBank = banks.slave_start(),
+    };
+    const auto apply = [&]() {
+        HAL_StatusTypeDef filter_status = set_filter(config);
+        config.FilterBank++;
+        bank = config.FilterBank;
+        return filter_status;
+    };
+
+    const std::size_t lists_per_bank = is_extended ? 2 : 4;
+    config.FilterMode = CAN_FILTERMODE_IDLIST;
+    for (std::size_t i = 0; i < list_count; i += lists_per_bank) {
+        std::array<uint32_t, 4> slot;
+        for (std::size_t j = 0; j < slot.size(); j++) {
+            slot[j] = i + j < list_count ? lists[i + j] : lists[i];
+        }
+        if (is_extended) {
+            config.FilterIdHigh = slot[0] >> 16;
+            config.FilterIdLow = slot[0] & 0xFFFF;
+            config.FilterMaskIdHigh = slot[1] >> 16;
+            config.FilterMaskIdLow = slot[1] & 0xFFFF;
+        } else {
+            config.FilterIdLow = slot[0];
+            config.FilterMaskIdLow = slot[1];
+            config.FilterIdHigh = slot[2];
+            config.FilterMaskIdHigh = slot[3];
+        }
+        HAL_StatusTypeDef filter_status = apply();
+        if (filter_status != HAL_OK) {
+            return filter_status;
+        }
+    }
+
+    config.FilterMode = CAN_FILTERMODE_IDMASK;
+    for (std::size_t i = 0; i < mask_count; i += is_extended ? 1 : 2) {
+        if (is_extended) {
+            config.FilterIdHigh = ids[i] >> 16;
+            config.FilterIdLow = ids[i] & 0xFFFF;
+            config.FilterMaskIdHigh = masks[i] >> 16;
+            config.FilterMaskIdLow = masks[i] & 0xFFFF;
+        } else {
+            // The HAL takes the first 16-bit filter from the Low fields and
+            // the second from the High fields.
+            const std::size_t second = i + 1 < mask_count ? i + 1 : i;
+            config.FilterIdLow = ids[i];
+            config.FilterMaskIdLow = masks[i];
+            config.FilterIdHigh = ids[second];
+            config.FilterMaskIdHigh = masks[second];
+        }
+        HAL_StatusTypeDef filter_status = apply();
+        if (filter_status != HAL_OK) {
+            return filter_status;
+        }
+    }
+    return HAL_OK;
+}
+
+/**
+ * @brief Accept every ID not matched by a lower bank.
+ *
+ * The bank uses the same scale as the filters before it. Among banks of one
+ * scale, list banks and then lower bank numbers win, so IDs already routed
+ * to FIFO1 stay there.
+ *
+ * @param is_extended Scale of the banks before this one.
+ * @param fifo_assignment CAN_RX_FIFO0 or CAN_RX_FIFO1.
+ * @param bank Bank to use.
+ * @return HAL_StatusTypeDef
+ */
+HAL_StatusTypeDef bxcan_driver::accept_rest(bool is_extended,
+                                            uint32_t fifo_assignment,
+                                            uint32_t bank) {
+    CAN_FilterTypeDef config = {
+        .FilterIdHigh = 0x0000,
+        .FilterIdLow = 0x0000,
+        // Require that none of the bits match.
+        .FilterMaskIdHigh = 0x0000,
+        .FilterMaskIdLow = 0x0000,
+        .FilterFIFOAssignment = fifo_assignment,
+        .FilterBank = bank,
+        .FilterMode = CAN_FILTERMODE_IDMASK,
+        .FilterScale =
+            is_extended ? CAN_FILTERSCALE_32BIT : CAN_FILTERSCALE_16BIT,
         .FilterActivation = ENABLE,
+        .SlaveStartFilterBank = banks.slave_start(),
     };
+    return set_filter(config);
 }
 
 /**
- * @brief
+ * @brief Setup filters for the provided list of IDs.
+ *
+ * The IDs are compiled into list and mask banks, see filter_compiler.h, using
+ * as many banks as the other peripheral leaves free. Only if the IDs cannot
+ * be compiled is everything accepted.
  *
+ * @param rx_ids
  * @param length
+ * @param is_extended
  * @return HAL_StatusTypeDef
  */
 HAL_StatusTypeDef bxcan_driver::filter_list(const uint32_t* rx_ids,
                                             std::size_t length,
-                                            bool is_extended = false) {
-    // Check if the quantity of RX ids can fit into the filters
-    if (is_extended) {
-        return HAL_ERROR;
+                                            bool is_extended) {
+    const filter::program program = filter::compile_masks(
+        rx_ids, length, banks.available(is_slave()), is_extended);
+    if (!program.ok || !filter::covers(program, rx_ids, length)) {
+        // If the IDs do not fit just filter all the ID's
+        return filter_all();
     }
 
-    constexpr std::size_t filter_count = 13;
-    constexpr std::size_t ids_per_filter = 4;
-
-    if (handle.Instance == CAN1) {
-        if (length < filter_count * ids_per_filter) {
-            std::size_t rx_id_index = 0;
-            std::size_t filter_index = 0;
-
-            // Loop through RX ids while they are available and filters are
-            // still available
-            while (rx_id_index < length) {
-                std::array<uint32_t, 4> ids = {
-                    rx_ids[rx_id_index], rx_ids[rx_id_index],
-                    rx_ids[rx_id_index], rx_ids[rx_id_index]};
-
-                rx_id_index++;
-
-                // Add ids to the array of ids
-                for (int j = 1; j < 4 && rx_id_index < length;
-                     j++, rx_id_index++) {
-                    if (rx_id_index < length) {
-                        ids[j] = rx_ids[rx_id_index];
-                    }
-                }
-
-                // use list of ids to create another filter
-                set_filter(make_filter_from_ids(filter_index, ids[0], ids[1],
-                                                ids[2], ids[3]));
-                filter_index++;
-            }
+    uint32_t bank = 0;
+    HAL_StatusTypeDef claim_status = claim_banks(program.slots, bank);
+    if (claim_status != HAL_OK) {
+        return claim_status;
+    }
+    return apply_filters(program, default_fifo(), bank);
+}
 
-        } else {
-            // For now if you need more IDs than this, everything will be
-            // filtered
-            filter_all();
-        }
-        return HAL_OK;
-    } else {
-        // TODO: support other CAN devices
+/**
+ * @brief Setup filters routing urgent IDs to FIFO1 and bulk IDs to FIFO0.
+ *
+ * See can_driver_base::filter_priority_list(). Not supported on CAN2 of the
+ * F405, which already uses FIFO1 for all of its traffic.
+ *
+ * @param urgent_ids
+ * @param urgent_length
+ * @param bulk_ids
+ * @param bulk_length
+ * @param is_extended
+ * @return HAL_StatusTypeDef
+ */
+HAL_StatusTypeDef bxcan_driver::filter_priority_list(
+    const uint32_t* urgent_ids, std::size_t urgent_length,
+    const uint32_t* bulk_ids, std::size_t bulk_length, bool is_extended) {
+    if (default_fifo() != CAN_RX_FIFO0) {
         return HAL_ERROR;
     }
+
+    // Keep at least one bank for the bulk traffic.
+    const std::size_t available = banks.available(is_slave());
+    const filter::program urgent = filter::compile_masks(
+        urgent_ids, urgent_length, available - 1, is_extended);
+    if (!urgent.ok || !filter::covers(urgent, urgent_ids, urgent_length)) {
+        split_fifos = false;
+        return filter_all();
+    }
+    split_fifos = true;
+
+    const filter::program bulk = filter::compile_masks(
+        bulk_ids, bulk_length, available - urgent.slots, is_extended);
+    const bool bulk_fits =
+        bulk.ok && filter::covers(bulk, bulk_ids, bulk_length);
+
+    uint32_t bank = 0;
+    HAL_StatusTypeDef filter_status =
+        claim_banks(urgent.slots + (bulk_fits ? bulk.slots : 1), bank);
+    if (filter_status != HAL_OK) {
+        return filter_status;
+    }
+    filter_status = apply_filters(urgent, CAN_RX_FIFO1, bank);
+    if (filter_status != HAL_OK) {
+        return filter_status;
+    }
+    if (!bulk_fits) {
+        return accept_rest(is_extended, CAN_RX_FIFO0, bank);
+    }
+    return apply_filters(bulk, CAN_RX_FIFO0, bank);
 }
 
 /**
@@ -271,70 +507,38 @@ HAL_StatusTypeDef bxcan_driver::filter_list(const uint32_t* rx_ids,
  * @return HAL_StatusTypeDef HAL return status for configuration.
  */
 HAL_StatusTypeDef bxcan_driver::filter_all() {
-    // A filter that accepts all packets.
-    if (handle.Instance == CAN1) {
-        CAN_FilterTypeDef filter = {
-            // The lower 3 bits are matched against other CAN
-            // packet fields that change packet to packet and should not be
-            // matched
-            // against. So these are set to 0
-            .FilterIdHigh = 0xffff << 5,
-            .FilterIdLow = 0xfff8,
-
-            // Require that none of the bits match.
-            .FilterMaskIdHigh = 0x0000,
-            .FilterMaskIdLow = 0x0000,
-            // Put the packets that match this filter into FIFO 0.
-            .FilterFIFOAssignment = 0,
-            // This is the only filter so use the first filter bank.
-            .FilterBank = 0,
-            // Use an ID and a Mask to match packet IDs.
-            .FilterMode = CAN_FILTERMODE_IDMASK,
-            // Use a 32 bit scale to include all the ID's extended or not
-            .FilterScale = CAN_FILTERSCALE_32BIT,
-            // Enable this filter.
-            .FilterActivation = ENABLE,
-            // Start the slave filter banks at #14
-            .SlaveStartFilterBank = 14,
-        };
-        // Apply the filter on the hardware.
-        return HAL_CAN_ConfigFilter(&handle, &filter);
-    } else {
-        CAN_FilterTypeDef filter = {
-            // The lower 3 bits are matched against other CAN
-            // packet fields that change packet to packet and should not be
-            // matched
-            // against. So these are set to 0
-            .FilterIdHigh = 0xffff << 5,
-            .FilterIdLow = 0xfff8,
-
-            // Require that none of the bits match.
-            .FilterMaskIdHigh = 0x0000,
-            .FilterMaskIdLow = 0x0000,
-            // Put the packets that match this filter into FIFO 1.
-            #ifdef STM32F469xx
-            .FilterFIFOAssignment = 0,
-            #else
-            .FilterFIFOAssignment = 1,
-            #endif
-            // I like the number 20 and it's above 14
-            .FilterBank = 20,
-            // Use an ID and a Mask to match packet IDs.
-            .FilterMode = CAN_FILTERMODE_IDMASK,
-            // Use a 32 bit scale to include all the ID's extended or not
-            .FilterScale = CAN_FILTERSCALE_32BIT,
-            // Enable this filter.
-            .FilterActivation = ENABLE,
-            // Start the slave filter banks at #14
-            .SlaveStartFilterBank = 14,
-        };
-        // Apply the filter on the hardware.
-        // handle.Instance = CAN1;
-        HAL_StatusTypeDef status = HAL_CAN_ConfigFilter(&handle, &filter);
-        // handle.Instance = CAN2;
-
-        return status;
+    uint32_t bank = 0;
+    HAL_StatusTypeDef claim_status = claim_banks(1, bank);
+    if (claim_status != HAL_OK) {
+        return claim_status;
     }
+
+    // A filter that accepts all packets.
+    CAN_FilterTypeDef filter = {
+        // The lower 3 bits are matched against other CAN
+        // packet fields that change packet to packet and should not be
+        // matched
+        // against. So these are set to 0
+        .FilterIdHigh = 0xffff << 5,
+        .FilterIdLow = 0xfff8,
+
+        // Require that none of the bits match.
+        .FilterMaskIdHigh = 0x0000,
+        .FilterMaskIdLow = 0x0000,
+        // Put the packets that match this filter into the default FIFO.
+        .FilterFIFOAssignment = default_fifo(),
+        // This is the only filter of this peripheral.
+        .FilterBank = bank,
+        // Use an ID and a Mask to match packet IDs.
+        .FilterMode = CAN_FILTERMODE_IDMASK,
+        // Use a 32 bit scale to include all the ID's extended or not
+        .FilterScale = CAN_FILTERSCALE_32BIT,
+        // Enable this filter.
+        .FilterActivation = ENABLE,
+        .SlaveStartFilterBank = banks.slave_start(),
+    };
+    // Apply the filter on the hardware.
+    return set_filter(filter);
 }
 
 /**
@@ -371,6 +575,7 @@ status bxcan_driver::send(const packet& send_packet) {
 
     // Check the response.
     if (send_status == HAL_OK) {
+        stats.record_tx(send_packet);
         return status::OK;
     }
 
@@ -403,6 +608,9 @@ status bxcan_driver::receive(packet& received_packet, const fifo fifo) {
             return status::ERROR;
     }
 
+    check_overrun(RxFifo == CAN_RX_FIFO0 ? handle.Instance->RF0R
+                                         : handle.Instance->RF1R);
+
     // Check if packets are available to read.
     uint32_t fill_level = HAL_CAN_GetRxFifoFillLevel(&handle, RxFifo);
 
@@ -425,10 +633,125 @@ status bxcan_driver::receive(packet& received_packet, const fifo fifo) {
     }
     // Update the received packet to the freshly read packet.
     received_packet = packet(header, data);
+    // The bit time counter cannot be read back, so a lone frame is stamped
+    // with the time it leaves the FIFO. receive_burst() does better.
+    received_packet.set_timestamp(time::micros());
+    stats.record_rx(received_packet);
 
     return status::OK;
 }
 
+/**
+ * @brief Drain up to packets.size() frames from a receive FIFO.
+ *
+ * Reads the FIFO output mailbox registers directly instead of going through
+ * HAL_CAN_GetRxMessage(), so the three frames the bxCAN FIFO can hold are
+ * all taken in one interrupt before the next one overruns it. Call it from
+ * the RX interrupt so the newest frame's timestamp is accurate.
+ *
+ * @param packets Destination for the frames, filled from the front.
+ * @param fifo The FIFO to read from.
+ * @return std::size_t Number of frames written to packets.
+ */
+std::size_t bxcan_driver::receive_burst(std::span<packet> packets,
+                                        const fifo fifo) {
+    CAN_TypeDef* const can = handle.Instance;
+    const uint32_t index = fifo == fifo::FIFO0 ? CAN_RX_FIFO0 : CAN_RX_FIFO1;
+    // RF0R and RF1R share the same bit layout.
+    volatile uint32_t& rfr = index == CAN_RX_FIFO0 ? can->RF0R : can->RF1R;
+    const CAN_FIFOMailBox_TypeDef& mailbox = can->sFIFOMailBox[index];
+
+    check_overrun(rfr);
+
+    std::size_t count = 0;
+    while (count < packets.size() && (rfr & CAN_RF0R_FMP0) != 0) {
+        const uint32_t rir = mailbox.RIR;
+        const bool extended = (rir & CAN_RI0R_IDE) != 0;
+        const uint32_t id =
+            extended ? (rir & (CAN_RI0R_EXID | CAN_RI0R_STID)) >>
+                           CAN_RI0R_EXID_Pos
+                     : (rir & CAN_RI0R_STID) >> CAN_RI0R_STID_Pos;
+        const uint32_t rdtr = mailbox.RDTR;
+        const uint8_t length = (rdtr & CAN_RDT0R_DLC) >> CAN_RDT0R_DLC_Pos;
+        const uint32_t payload[2] = {mailbox.RDLR, mailbox.RDHR};
+        packet_data_t data;
+        std::memcpy(data.data(), payload, data.size());
+
+        packets[count] = packet(id, length, data, extended);
+        // Hold the raw start of frame counter until the burst is complete.
+        packets[count].set_timestamp((rdtr & CAN_RDT0R_TIME) >>
+                                     CAN_RDT0R_TIME_Pos);
+        count++;
+        // Release the output mailbox so the next frame moves into it.
+        rfr = CAN_RF0R_RFOM0;
+    }
+
+    // The counter cannot be read live, so anchor it to the newest frame,
+    // which started at least its own length before now, and place the
+    // older ones by their bit time distance from it. The 16-bit counter
+    // wraps every 65536 bits (131 ms at 500 kb/s), so frames that waited
+    // longer than half of that are placed a wrap off.
+    if (count > 0) {
+        const packet& newest = packets[count - 1];
+        clock.anchor(newest.get_timestamp(), time::micros(),
+                     frame_bits_min(newest.is_extended(),
+                                    newest.get_length()));
+        for (std::size_t i = 0; i < count; i++) {
+            packets[i].set_timestamp(clock.to_us(packets[i].get_timestamp()));
+            stats.record_rx(packets[i]);
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Count and clear an RX FIFO overrun.
+ *
+ * @param rfr RF0R or RF1R; both share the same bit layout.
+ */
+void bxcan_driver::check_overrun(volatile uint32_t& rfr) {
+    if ((rfr & CAN_RF0R_FOVR0) != 0) {
+        // The flag is cleared by writing 1; RFOM0 is left 0.
+        rfr = CAN_RF0R_FOVR0;
+        stats.record_overrun();
+    }
+}
+
+/**
+ * @brief Read the error counters and state from the error status register.
+ *
+ * @return error_state
+ */
+error_state bxcan_driver::get_error_state() {
+    const uint32_t esr = handle.Instance->ESR;
+    return {
+        .tec = static_cast<uint8_t>((esr & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos),
+        .rec = static_cast<uint8_t>((esr & CAN_ESR_REC) >> CAN_ESR_REC_Pos),
+        .warning = (esr & CAN_ESR_EWGF) != 0,
+        .passive = (esr & CAN_ESR_EPVF) != 0,
+        .bus_off = (esr & CAN_ESR_BOFF) != 0,
+    };
+}
+
+/**
+ * @brief Record the errors the HAL collected for HAL_CAN_ErrorCallback().
+ *
+ * Bus off recovery is automatic (AutoBusOff), so the end of a bus off period
+ * is seen by the next handle_error() or poll_stats().
+ */
+void bxcan_driver::handle_error() {
+    const uint32_t error = HAL_CAN_GetError(&handle);
+    if ((error & (HAL_CAN_ERROR_TX_ALST0 | HAL_CAN_ERROR_TX_ALST1 |
+                  HAL_CAN_ERROR_TX_ALST2)) != 0) {
+        stats.record_lost_arbitration();
+    }
+    if ((error & (HAL_CAN_ERROR_RX_FOV0 | HAL_CAN_ERROR_RX_FOV1)) != 0) {
+        stats.record_overrun();
+    }
+    HAL_CAN_ResetError(&handle);
+    stats.update_error_state(get_error_state(), HAL_GetTick());
+}
+
 /**
  * @brief Get a reference to the CAN HAL handle.
  *
@@ -449,6 +772,13 @@ void bxcan_driver::disable_tx_it() {
     __HAL_CAN_DISABLE_IT(get_handle(), 0x01);
 }
 
+/**
+ * @brief True once all three TX mailboxes are empty.
+ */
+bool bxcan_driver::tx_idle() {
+    return HAL_CAN_GetTxMailboxesFreeLevel(&handle) == 3;
+}
+
 }  // namespace can
 }  // namespace umnsvp
 
@@ -7,6 +7,8 @@
 #include "baud_rate.h"
 #include "can_driver_base.h"
 #include "can_packet.h"
+#include "can_rx_clock.h"
+#include "filter_compiler.h"
 
 namespace umnsvp {
 namespace can {
@@ -70,12 +72,98 @@ GPIO_TypeDef* const can2_port = GPIOB;
  * @}
  */
 
+/**
+ * @brief Splits the bxCAN filter banks between CAN1 and CAN2.
+ *
+ * On parts with CAN2 the two peripherals share one set of banks, which CAN1
+ * owns: banks below the slave start bank filter CAN1, the rest CAN2. Each
+ * peripheral claims the number of banks its filters need when they are
+ * applied; CAN1 takes them from bank 0 up and CAN2 from the last bank down,
+ * and the slave start bank is moved to the boundary. Parts with only CAN1
+ * hand it every bank.
+ *
+ * The hardware needs at least one bank on each side of the boundary, so CAN1
+ * can hold at most num_banks - 1 banks on dual parts.
+ */
+class filter_bank_allocator {
+   public:
+#ifdef CAN2
+    static constexpr std::size_t num_banks = 28;
+#else
+    static constexpr std::size_t num_banks = 14;
+#endif
+
+    /**
+     * @brief Banks the given peripheral could claim, including its own.
+     */
+    constexpr std::size_t available(bool slave) const {
+#ifdef CAN2
+        // CAN1 always keeps bank 0, even before it claims any.
+        const std::size_t other =
+            slave ? (can1_count > 0 ? can1_count : 1) : can2_count;
+        const std::size_t limit = num_banks - 1;
+        const std::size_t left = num_banks - other;
+        return left < limit ? left : limit;
+#else
+        return slave ? 0 : num_banks;
+#endif
+    }
+
+    /**
+     * @brief Claim count banks for a peripheral, replacing its last claim.
+     *
+     * @param slave True for CAN2.
+     * @param count Banks needed.
+     * @param first Set to the first bank of the claim.
+     * @return false Not enough banks are free; nothing changes.
+     */
+    constexpr bool claim(bool slave, std::size_t count, uint32_t& first) {
+        if (count > available(slave)) {
+            return false;
+        }
+        if (slave) {
+            can2_count = count;
+        } else {
+            can1_count = count;
+        }
+        first = this->first(slave);
+        return true;
+    }
+
+    /**
+     * @brief First bank of the peripheral's current claim.
+     */
+    constexpr uint32_t first(bool slave) const {
+        return slave ? num_banks - can2_count : 0;
+    }
+
+    /**
+     * @brief Banks in the peripheral's current claim.
+     */
+    constexpr std::size_t count(bool slave) const {
+        return slave ? can2_count : can1_count;
+    }
+
+    /**
+     * @brief Value for CAN_FilterTypeDef::SlaveStartFilterBank.
+     */
+    constexpr uint32_t slave_start() const {
+        return can2_count > 0 ? num_banks - can2_count : num_banks - 1;
+    }
+
+   private:
+    std::size_t can1_count = 0;
+    std::size_t can2_count = 0;
+};
+
 /**
  * @brief A driver for the STM32 bxCAN peripheral.
  *
- * This driver currently is a loose wrapper around the HAL driver.
+ * This driver currently is a loose wrapper around the HAL driver. CAN1 and,
+ * where present, CAN2 are supported; both filter in hardware with banks
+ * from a shared filter_bank_allocator.
  */
-class bxcan_driver : public can_driver_base {
+class bxcan_driver final : public can_driver_base {
    private:
     /**
      * @brief The HAL CAN handle for interacting with the hardware.
@@ -84,6 +172,32 @@ class bxcan_driver : public can_driver_base {
 
     const bool config_isr;
 
+    /**
+     * @brief Converts the time triggered mode RX timestamps to micros(),
+     * anchored to the newest frame of each drained burst.
+     */
+    rx_clock clock;
+
+    /**
+     * @brief Set by filter_priority_list(); start() then enables the FIFO1
+     * interrupt for urgent IDs.
+     */
+    bool split_fifos = false;
+
+    /**
+     * @brief The filter banks shared by every bxCAN peripheral.
+     */
+    static filter_bank_allocator banks;
+
+    bool is_slave() const;
+    uint32_t default_fifo() const;
+    HAL_StatusTypeDef claim_banks(std::size_t count, uint32_t& first);
+    HAL_StatusTypeDef apply_filters(const filter::program& program,
+                                    uint32_t fifo_assignment, uint32_t& bank);
+    HAL_StatusTypeDef accept_rest(bool is_extended, uint32_t fifo_assignment,
+                                  uint32_t bank);
+    void check_overrun(volatile uint32_t& rfr);
+
    public:
     /**
      * @brief Hardcoded Time Segment 1 and 2.
@@ -113,9 +227,9 @@ class bxcan_driver : public can_driver_base {
      */
 
     /**
-     * Number of filter banks in STM32L4 CAN Peripheral.
+     * Number of filter banks shared by the CAN peripherals.
      */
-    static constexpr auto num_filter_banks = 14;
+    static constexpr auto num_filter_banks = filter_bank_allocator::num_banks;
 
     /**
      * Number of IDs that can be listed in a filter bank when using 16-bit
@@ -138,19 +252,31 @@ class bxcan_driver : public can_driver_base {
 
     virtual HAL_StatusTypeDef filter_all() override;
     virtual HAL_StatusTypeDef filter_list(const uint32_t*, std::size_t length,
-                                          bool is_extended) override;
+                                          bool is_extended = false) override;
+    virtual HAL_StatusTypeDef filter_priority_list(
+        const uint32_t* urgent_ids, std::size_t urgent_length,
+        const uint32_t* bulk_ids, std::size_t bulk_length,
+        bool is_extended = false) override;
 
     virtual status send(const packet& send_packet) override;
     virtual status receive(packet& received_packet,
                            const fifo fifo = fifo::FIFO0) override;
+    virtual std::size_t receive_burst(std::span<packet> packets,
+                                      const fifo fifo = fifo::FIFO0) override;
+
+    virtual error_state get_error_state() override;
+    virtual void handle_error() override;
 
     virtual void enable_tx_it() override;
     virtual void disable_tx_it() override;
+    virtual bool tx_idle() override;
 
     CAN_HandleTypeDef* get_handle();
     HAL_StatusTypeDef set_filter(const CAN_FilterTypeDef& filter);
 };
 
+static_assert(can_driver<bxcan_driver>);
+
 }  // namespace can
 }  // namespace umnsvp
 
@@ -0,0 +1,508 @@
+/**
+ * @file can_bootloader.cc
+ * @brief Firmware updates over CAN into the inactive flash bank.
+ *
+ * Dual bank flash and the BFB2 boot option are described in RM0351 section
+ * 3.3.8 (STM32L47x) and RM0440 section 5.4.7 (STM32G4).
+ */
+
+#include "can_bootloader.h"
+
+#if defined(STM32L476xx) || defined(STM32G474xx) || defined(STM32G473xx)
+
+#include <cstring>
+
+namespace umnsvp {
+namespace can {
+namespace {
+
+/**
+ * @brief Boot record layout, in doublewords from the start of the last page
+ * of a bank. Flash bits only go from 1 to 0 between erases, so each state
+ * change programs a fresh doubleword.
+ *
+ * @{
+ */
+constexpr uint32_t record_magic = 0x55504431;  // "UPD1"
+constexpr uint32_t slot_header = 0;            // magic, image size
+constexpr uint32_t slot_crc = 1;               // image crc, ~crc
+constexpr uint32_t slot_confirmed = 2;
+constexpr uint32_t slot_first_attempt = 3;
+constexpr uint64_t erased = ~uint64_t{0};
+/**
+ * @}
+ */
+
+/**
+ * @brief Message commands.
+ *
+ * @{
+ */
+constexpr uint8_t cmd_start = 0x01;
+constexpr uint8_t cmd_data = 0x02;
+constexpr uint8_t cmd_commit = 0x03;
+constexpr uint8_t cmd_abort = 0x04;
+constexpr uint8_t cmd_reply = 0x80;
+/**
+ * @}
+ */
+
+constexpr std::size_t header_size = 9;
+
+/**
+ * @brief IWDG keys and setup. The LSI runs at 32 kHz, so the /64 prescaler
+ * counts 2 ms per tick.
+ *
+ * @{
+ */
+constexpr uint32_t iwdg_key_reload = 0xAAAA;
+constexpr uint32_t iwdg_key_enable = 0xCCCC;
+constexpr uint32_t iwdg_key_write_access = 0x5555;
+constexpr uint32_t iwdg_prescaler_64 = 4;
+constexpr uint32_t iwdg_tick_ms = 2;
+static_assert(bootloader::trial_watchdog_ms / iwdg_tick_ms <= IWDG_RLR_RL);
+/**
+ * @}
+ */
+
+/// Set once check_boot() has started the IWDG for a trial boot.
+bool watchdog_started = false;
+
+uint32_t read32(const uint8_t* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint64_t read64(uint32_t address) {
+    return *reinterpret_cast<const volatile uint64_t*>(address);
+}
+
+/**
+ * @brief Whether bank 2 is mapped at 0x08000000, i.e. we booted from it.
+ */
+bool booted_from_bank_2() {
+    __HAL_RCC_SYSCFG_CLK_ENABLE();
+    return READ_BIT(SYSCFG->MEMRMP, SYSCFG_MEMRMP_FB_MODE) != 0;
+}
+
+/**
+ * @brief Whether the flash is organised as two banks.
+ */
+bool dual_bank() {
+#if defined(FLASH_OPTR_DBANK)
+    return READ_BIT(FLASH->OPTR, FLASH_OPTR_DBANK) != 0;
+#else
+    return true;
+#endif
+}
+
+/**
+ * @brief Address the inactive bank is mapped at, whichever bank it is.
+ */
+uint32_t inactive_base() {
+    return FLASH_BASE + FLASH_BANK_SIZE;
+}
+
+/**
+ * @brief Offset of the boot record page from the start of a bank.
+ */
+uint32_t record_offset() {
+    return FLASH_BANK_SIZE - FLASH_PAGE_SIZE;
+}
+
+uint32_t slot_address(uint32_t bank_base, uint32_t slot) {
+    return bank_base + record_offset() + slot * sizeof(uint64_t);
+}
+
+/**
+ * @brief Program one doubleword; the flash must already be unlocked.
+ */
+bool program64(uint32_t address, uint64_t value) {
+    return HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, address, value) ==
+           HAL_OK;
+}
+
+/**
+ * @brief Program one doubleword of the running bank's boot record.
+ */
+bool program_record(uint32_t slot, uint64_t value) {
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+    const bool ok = program64(slot_address(FLASH_BASE, slot), value);
+    HAL_FLASH_Lock();
+    return ok;
+}
+
+/**
+ * @brief Erase one page of the inactive bank; the flash must be unlocked.
+ *
+ * @param offset Offset of the page from the start of the bank.
+ */
+bool erase_page(uint32_t offset) {
+    FLASH_EraseInitTypeDef erase = {
+        .TypeErase = FLASH_TYPEERASE_PAGES,
+        .Banks = booted_from_bank_2() ? FLASH_BANK_1 : FLASH_BANK_2,
+        .Page = offset / FLASH_PAGE_SIZE,
+        .NbPages = 1,
+    };
+    uint32_t page_error = 0;
+    return HAL_FLASHEx_Erase(&erase, &page_error) == HAL_OK;
+}
+
+/**
+ * @brief Whether a bank starts with a plausible vector table.
+ */
+bool looks_bootable(uint32_t bank_base) {
+    const uint32_t stack = *reinterpret_cast<const volatile uint32_t*>(
+        bank_base);
+    return (stack & 0xFF000000U) == SRAM1_BASE;
+}
+
+/**
+ * @brief Start the IWDG with a trial_watchdog_ms timeout.
+ *
+ * Starting it also turns the LSI on.
+ */
+void start_watchdog() {
+    IWDG->KR = iwdg_key_enable;
+    IWDG->KR = iwdg_key_write_access;
+    IWDG->PR = iwdg_prescaler_64;
+    IWDG->RLR = bootloader::trial_watchdog_ms / iwdg_tick_ms;
+    // The new values take a few LSI cycles to reach the watchdog's clock
+    // domain.
+    while ((IWDG->SR & (IWDG_SR_PVU | IWDG_SR_RVU | IWDG_SR_WVU)) != 0) {
+    }
+    IWDG->KR = iwdg_key_reload;
+    watchdog_started = true;
+}
+
+/**
+ * @brief Boot the inactive bank by flipping BFB2. Resets on success.
+ *
+ * With BFB2 set the system memory boots bank 2; clear, bank 1.
+ */
+void swap_banks() {
+    HAL_FLASH_Unlock();
+    HAL_FLASH_OB_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+    FLASH_OBProgramInitTypeDef option = {};
+    option.OptionType = OPTIONBYTE_USER;
+    option.USERType = OB_USER_BFB2;
+    option.USERConfig = booted_from_bank_2() ? OB_BFB2_DISABLE : OB_BFB2_ENABLE;
+    if (HAL_FLASHEx_OBProgram(&option) == HAL_OK) {
+        // Reloads the option bytes, which resets the device.
+        HAL_FLASH_OB_Launch();
+    }
+    HAL_FLASH_OB_Lock();
+    HAL_FLASH_Lock();
+}
+
+}  // namespace
+
+/**
+ * @brief Construct the bootloader on an ISO-TP session.
+ *
+ * @param session Session for the update protocol. Its receive buffer should
+ * hold message_size bytes.
+ * @param tx_drained Tells when the session's CAN bus has sent everything, so
+ * the COMMIT answer is not lost to the reset. Without it the reset waits the
+ * full reset_drain_ms.
+ * @param drained_context Passed to tx_drained.
+ */
+bootloader::bootloader(isotp::session& session, drained_check tx_drained,
+                       void* drained_context)
+    : session(session),
+      tx_drained(tx_drained),
+      drained_context(drained_context) {
+}
+
+/**
+ * @brief Handle update messages and program the pending block.
+ *
+ * Call from the main loop. Programming is split over calls, but erasing a
+ * page (about 20 ms) blocks its call; interrupts keep running from the
+ * active bank meanwhile. On a trial boot this also refreshes the watchdog.
+ */
+void bootloader::poll() {
+    if (watchdog_started) {
+        IWDG->KR = iwdg_key_reload;
+    }
+    if (session.tx_result() == status::FULL) {
+        // Wait for the last answer to go out.
+        return;
+    }
+    if (current == state::RESETTING) {
+        // The answer is handed to the driver, but may still sit in a
+        // mailbox; a reset now would cut it off.
+        const bool drained =
+            tx_drained != nullptr && tx_drained(drained_context);
+        if (!drained &&
+            static_cast<int32_t>(HAL_GetTick() - reset_deadline) < 0) {
+            return;
+        }
+        swap_banks();
+        // Only reached if the option bytes could not be written.
+        current = state::IDLE;
+        return;
+    }
+    if (current == state::PROGRAMMING) {
+        program();
+        return;
+    }
+    const std::span<const uint8_t> message = session.received();
+    if (!message.empty()) {
+        handle(message);
+        session.release();
+    }
+}
+
+/**
+ * @brief Dispatch one update message.
+ */
+void bootloader::handle(std::span<const uint8_t> message) {
+    switch (message[0]) {
+        case cmd_start:
+            start(message);
+            break;
+        case cmd_data:
+            data(message);
+            break;
+        case cmd_commit:
+            commit();
+            break;
+        case cmd_abort:
+            current = state::IDLE;
+            answer(cmd_abort, result::OK);
+            break;
+        default:
+            answer(message[0], result::BAD_STATE);
+            break;
+    }
+}
+
+/**
+ * @brief Begin a transfer: check the size and clear the record page.
+ */
+void bootloader::start(std::span<const uint8_t> message) {
+    if (message.size() < header_size || !dual_bank()) {
+        answer(cmd_start, result::BAD_STATE);
+        return;
+    }
+    const uint32_t size = read32(&message[1]);
+    if (size == 0 || size > record_offset()) {
+        answer(cmd_start, result::TOO_LARGE);
+        return;
+    }
+
+    image_size = size;
+    image_crc = read32(&message[5]);
+    written = 0;
+    erased_to = inactive_base();
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+    const bool ok = erase_page(record_offset());
+    HAL_FLASH_Lock();
+    if (!ok) {
+        current = state::IDLE;
+        answer(cmd_start, result::FLASH_ERROR);
+        return;
+    }
+    current = state::RECEIVING;
+    answer(cmd_start, result::OK);
+}
+
+/**
+ * @brief Check a block and hand it to program().
+ */
+void bootloader::data(std::span<const uint8_t> message) {
+    if (current != state::RECEIVING || message.size() < header_size) {
+        answer(cmd_data, result::BAD_STATE);
+        return;
+    }
+    const uint32_t offset = read32(&message[1]);
+    const uint32_t crc = read32(&message[5]);
+    const std::span<const uint8_t> payload = message.subspan(header_size);
+
+    if (payload.size() > block_size || offset + payload.size() > image_size) {
+        answer(cmd_data, result::TOO_LARGE);
+        return;
+    }
+    const bool last = offset + payload.size() == image_size;
+    if (offset != written || payload.empty() ||
+        (!last && payload.size() % sizeof(uint64_t) != 0)) {
+        // The answer carries the offset to resume from.
+        answer(cmd_data, result::BAD_OFFSET);
+        return;
+    }
+    if (crc32(payload.data(), payload.size()) != crc) {
+        answer(cmd_data, result::BAD_CRC);
+        return;
+    }
+
+    std::memcpy(block.data(), payload.data(), payload.size());
+    // Pad the last doubleword as erased flash.
+    std::memset(block.data() + payload.size(), 0xFF,
+                block.size() - payload.size());
+    block_length = payload.size();
+    block_done = 0;
+    block_crc = crc;
+    current = state::PROGRAMMING;
+}
+
+/**
+ * @brief Program the next few doublewords of the pending block, erasing
+ * pages just ahead of them, and answer once the block reads back correctly.
+ *
+ * A flash failure aborts the transfer; programmed flash cannot be rewritten
+ * without erasing the data before it in the page.
+ */
+void bootloader::program() {
+    const uint32_t base = inactive_base() + written;
+    const uint32_t padded =
+        (block_length + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+    bool ok = true;
+    for (std::size_t i = 0;
+         ok && i < doublewords_per_poll && block_done < padded; i++) {
+        const uint32_t address = base + block_done;
+        uint64_t value;
+        std::memcpy(&value, &block[block_done], sizeof(value));
+        ok = erase_through(address + sizeof(value) - 1) &&
+             program64(address, value);
+        block_done += sizeof(value);
+    }
+    HAL_FLASH_Lock();
+
+    if (!ok) {
+        current = state::IDLE;
+        answer(cmd_data, result::FLASH_ERROR);
+        return;
+    }
+    if (block_done < padded) {
+        return;
+    }
+
+    current = state::RECEIVING;
+    if (crc32(reinterpret_cast<const uint8_t*>(base), block_length) !=
+        block_crc) {
+        current = state::IDLE;
+        answer(cmd_data, result::FLASH_ERROR);
+        return;
+    }
+    written += block_length;
+    answer(cmd_data, result::OK);
+}
+
+/**
+ * @brief Erase pages of the inactive bank up to and including address.
+ *
+ * @param address Last address about to be programmed.
+ * @return false An erase failed.
+ */
+bool bootloader::erase_through(uint32_t address) {
+    while (erased_to <= address) {
+        if (!erase_page(erased_to - inactive_base())) {
+            return false;
+        }
+        erased_to += FLASH_PAGE_SIZE;
+    }
+    return true;
+}
+
+/**
+ * @brief Check the whole image, write its boot record and reset into it.
+ */
+void bootloader::commit() {
+    if (current != state::RECEIVING || written != image_size) {
+        answer(cmd_commit, result::BAD_STATE);
+        return;
+    }
+    const uint32_t base = inactive_base();
+    if (crc32(reinterpret_cast<const uint8_t*>(base), image_size) !=
+        image_crc) {
+        current = state::IDLE;
+        answer(cmd_commit, result::BAD_CRC);
+        return;
+    }
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+    const bool ok =
+        program64(slot_address(base, slot_header),
+                  record_magic | (static_cast<uint64_t>(image_size) << 32)) &&
+        program64(slot_address(base, slot_crc),
+                  image_crc | (static_cast<uint64_t>(~image_crc) << 32));
+    HAL_FLASH_Lock();
+    if (!ok) {
+        current = state::IDLE;
+        answer(cmd_commit, result::FLASH_ERROR);
+        return;
+    }
+    // poll() swaps banks once the answer is out.
+    current = state::RESETTING;
+    reset_deadline = HAL_GetTick() + reset_drain_ms;
+    answer(cmd_commit, result::OK);
+}
+
+/**
+ * @brief Send {command | 0x80, result, next offset}.
+ */
+void bootloader::answer(uint8_t command, result outcome) {
+    reply[0] = command | cmd_reply;
+    reply[1] = static_cast<uint8_t>(outcome);
+    std::memcpy(&reply[2], &written, sizeof(written));
+    session.send(reply);
+}
+
+/**
+ * @brief Count a boot of an unconfirmed image and roll back after too many.
+ *
+ * Call early in main(), before anything that could hang. Images with no
+ * boot record, such as ones flashed with a debugger, are left alone. An
+ * unconfirmed image is booted with the IWDG running, so that a hang counts
+ * as a failed boot too.
+ */
+void bootloader::check_boot() {
+    const uint64_t header = read64(slot_address(FLASH_BASE, slot_header));
+    if (static_cast<uint32_t>(header) != record_magic ||
+        read64(slot_address(FLASH_BASE, slot_confirmed)) != erased) {
+        return;
+    }
+
+    uint32_t slot = slot_first_attempt;
+    while (slot < slot_first_attempt + max_trial_boots &&
+           read64(slot_address(FLASH_BASE, slot)) != erased) {
+        slot++;
+    }
+    if (slot == slot_first_attempt + max_trial_boots) {
+        // Never confirmed: go back to the previous image if there is one.
+        if (looks_bootable(inactive_base())) {
+            swap_banks();
+        }
+        return;
+    }
+    program_record(slot, 0);
+    start_watchdog();
+}
+
+/**
+ * @brief Mark the running image as good so it is never rolled back.
+ *
+ * Call once the application is up and talking on the bus.
+ */
+void bootloader::confirm() {
+    const uint64_t header = read64(slot_address(FLASH_BASE, slot_header));
+    if (static_cast<uint32_t>(header) == record_magic &&
+        read64(slot_address(FLASH_BASE, slot_confirmed)) == erased) {
+        program_record(slot_confirmed, 0);
+    }
+}
+
+}  // namespace can
+}  // namespace umnsvp
+
+#endif
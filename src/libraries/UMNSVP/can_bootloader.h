@@ -0,0 +1,198 @@
+/**
+ * @file can_bootloader.h
+ * @brief Firmware updates over CAN into the inactive flash bank.
+ */
+
+#pragma once
+
+#include "hal.h"
+
+#if defined(STM32L476xx) || defined(STM32G474xx) || defined(STM32G473xx)
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "isotp.h"
+
+namespace umnsvp {
+namespace can {
+
+/**
+ * @brief CRC-32 (IEEE 802.3, reflected, as zlib's crc32()).
+ *
+ * @param data Bytes to add.
+ * @param length Number of bytes.
+ * @param crc CRC of the bytes before these, 0 to start.
+ * @return uint32_t
+ */
+constexpr uint32_t crc32(const uint8_t* data, std::size_t length,
+                         uint32_t crc = 0) {
+    constexpr std::array<uint32_t, 16> table = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+        0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+    crc = ~crc;
+    for (std::size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+namespace detail {
+
+constexpr std::array<uint8_t, 9> crc_check = {'1', '2', '3', '4', '5',
+                                              '6', '7', '8', '9'};
+
+}  // namespace detail
+
+static_assert(crc32(detail::crc_check.data(), detail::crc_check.size()) ==
+              0xCBF43926);
+
+/**
+ * @brief Receives a firmware image over an ISO-TP session and boots it.
+ *
+ * The image is written to the flash bank that is not running, so the board
+ * keeps working, and keeps talking on the bus, for the whole transfer. Once
+ * the full image checks out the BFB2 option bit is flipped and the board
+ * resets into the new bank. The old image stays in the other bank: if the
+ * new one does not call confirm() within max_trial_boots resets, check_boot()
+ * swaps back to it.
+ *
+ * A new image that hangs rather than resets would never be rolled back, so
+ * check_boot() starts the independent watchdog (IWDG) on every unconfirmed
+ * boot, with a timeout of trial_watchdog_ms. It is started through its
+ * registers; the board does not need HAL_IWDG_MODULE_ENABLED. Once started
+ * the IWDG cannot be stopped until the next reset, so poll() refreshes it
+ * and must run at least every trial_watchdog_ms for the rest of that boot,
+ * confirmed or not. A board that already runs the IWDG itself gets it set
+ * to this timeout on trial boots.
+ *
+ * Images are linked for 0x08000000 as usual; the booted bank is always
+ * mapped there. The last page of each bank holds its boot record and is not
+ * available to the image.
+ *
+ * Protocol. Every message is one ISO-TP message, little endian, and is
+ * answered with {command | 0x80, result, next offset (u32)}:
+ * - START {0x01, size (u32), crc32 (u32)} erases the record page and
+ *   expects the image from offset 0.
+ * - DATA {0x02, offset (u32), crc32 (u32), up to block_size bytes} adds a
+ *   block; offsets must follow on and blocks must be a multiple of 8 bytes
+ *   except the last. The answer comes once the block is in flash and read
+ *   back, and the next block can be sent before it, so one block is always
+ *   arriving while the previous one is being programmed.
+ * - COMMIT {0x03} checks the CRC of the whole image in flash, then resets
+ *   into it once the answer has left the CAN controller (or after
+ *   reset_drain_ms if the bus never takes it).
+ * - ABORT {0x04} drops the transfer.
+ *
+ * Example Usage:
+   ........................
+   int main() {
+       HAL_Init();
+       can::bootloader::check_boot();
+       ...
+   }
+   ........................
+   std::array<uint8_t, can::bootloader::message_size> update_buffer;
+   can::isotp::session update_session(
+       {.tx_id = 0x7F1, .rx_id = 0x7F0, .block_size = 0}, update_buffer);
+   can::bootloader update(
+       update_session,
+       [](void* context) {
+           return static_cast<skylab2::lights_can*>(context)->tx_idle();
+       },
+       &skylab);
+   ........................
+   // Main loop, after isotp.poll()
+   update.poll();
+   if (healthy) {
+       can::bootloader::confirm();
+   }
+   ........................
+ */
+class bootloader {
+   public:
+    /// Largest DATA payload.
+    static constexpr std::size_t block_size = 1024;
+    /// Largest message; size the session's receive buffer to this.
+    static constexpr std::size_t message_size = 9 + block_size;
+    /// Resets a new image gets to call confirm() before it is rolled back.
+    static constexpr uint8_t max_trial_boots = 3;
+    /// Doublewords programmed per poll(), to keep the main loop moving.
+    static constexpr std::size_t doublewords_per_poll = 16;
+    /// Longest a reset waits for the COMMIT answer to leave the controller.
+    static constexpr uint32_t reset_drain_ms = 100;
+    /// IWDG timeout on a trial boot; poll() has to run at least this often.
+    static constexpr uint32_t trial_watchdog_ms = 2000;
+
+    /// True once nothing is left to transmit on the update's CAN bus.
+    using drained_check = bool (*)(void* context);
+
+    enum class result : uint8_t
+    {
+        OK,
+        BAD_STATE,
+        BAD_CRC,
+        BAD_OFFSET,
+        TOO_LARGE,
+        FLASH_ERROR,
+    };
+
+   private:
+    enum class state : uint8_t
+    {
+        IDLE,
+        RECEIVING,
+        PROGRAMMING,
+        RESETTING,
+    };
+
+    isotp::session& session;
+    drained_check tx_drained;
+    void* drained_context;
+    state current = state::IDLE;
+    /// HAL tick the reset waits for the bus until.
+    uint32_t reset_deadline = 0;
+
+    uint32_t image_size = 0;
+    uint32_t image_crc = 0;
+    /// Bytes of the image in flash and verified.
+    uint32_t written = 0;
+    /// First address of the inactive bank not yet erased.
+    uint32_t erased_to = 0;
+
+    /// The block being programmed, copied out of the session so the next
+    /// block can be received meanwhile.
+    alignas(8) std::array<uint8_t, block_size> block = {};
+    uint32_t block_length = 0;
+    uint32_t block_done = 0;
+    uint32_t block_crc = 0;
+
+    std::array<uint8_t, 6> reply = {};
+
+    void handle(std::span<const uint8_t> message);
+    void start(std::span<const uint8_t> message);
+    void data(std::span<const uint8_t> message);
+    void commit();
+    void program();
+    void answer(uint8_t command, result outcome);
+    bool erase_through(uint32_t address);
+
+   public:
+    explicit bootloader(isotp::session& session,
+                        drained_check tx_drained = nullptr,
+                        void* drained_context = nullptr);
+
+    void poll();
+
+    static void check_boot();
+    static void confirm();
+};
+
+}  // namespace can
+}  // namespace umnsvp
+
+#endif
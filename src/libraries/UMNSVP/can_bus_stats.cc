@@ -0,0 +1,258 @@
+/**
+ * @file can_bus_stats.cc
+ * @brief CAN bus health statistics.
+ */
+
+#include "can_bus_stats.h"
+
+#include "can_rx_clock.h"
+#include "critical_section.h"
+
+namespace umnsvp {
+namespace can {
+
+/**
+ * @brief Set the bit time used to turn frame bits into bus load.
+ *
+ * @param rate The nominal baud rate of the bus.
+ */
+void bus_stats::set_rate(baud_rate rate) {
+    bit_us = bit_time_us(rate);
+}
+
+/**
+ * @brief Set the bit time of the CAN FD data phase.
+ *
+ * @param bit_ns Length of one data phase bit in nanoseconds.
+ */
+void bus_stats::set_data_bit_ns(uint32_t bit_ns) {
+    data_bit_ns = bit_ns;
+}
+
+/**
+ * @brief Count a frame against the current window.
+ *
+ * @param id Frame ID.
+ * @param extended True for a 29-bit ID.
+ * @param frames Counter of the frame's format and length.
+ * @param transmitted True if this node sent it.
+ */
+void bus_stats::record(uint32_t id, bool extended, uint32_t& frames,
+                       bool transmitted) {
+    irq::critical_section lock;
+    frames++;
+    if (transmitted) {
+        tx_frames++;
+    } else {
+        rx_frames++;
+    }
+
+    std::size_t i = 0;
+    while (i < id_count && (ids[i].id != id || ids[i].extended != extended)) {
+        i++;
+    }
+    if (i == id_count) {
+        if (id_count == ids.size()) {
+            untracked++;
+            return;
+        }
+        ids[id_count++] = {id, extended, 0, 0};
+    }
+    if (transmitted) {
+        ids[i].tx++;
+    } else {
+        ids[i].rx++;
+    }
+}
+
+namespace {
+
+std::size_t classic_index(const packet& frame) {
+    const uint8_t length =
+        frame.get_length() > MAX_SIZE ? MAX_SIZE : frame.get_length();
+    return (frame.is_extended() ? MAX_SIZE + 1U : 0U) + length;
+}
+
+}  // namespace
+
+/**
+ * @brief Count a frame accepted by this node.
+ */
+void bus_stats::record_rx(const packet& received) {
+    record(received.get_id(), received.is_extended(),
+           classic_frames[classic_index(received)], false);
+}
+
+/**
+ * @brief Count a frame handed to the hardware by this node.
+ */
+void bus_stats::record_tx(const packet& sent) {
+    record(sent.get_id(), sent.is_extended(),
+           classic_frames[classic_index(sent)], true);
+}
+
+/**
+ * @brief Count a CAN FD frame sent or accepted by this node.
+ *
+ * @param id Frame ID.
+ * @param extended True for a 29-bit ID.
+ * @param dlc DLC code of the frame.
+ * @param brs True if the data phase ran at the data bit rate.
+ * @param transmitted True if this node sent it.
+ */
+void bus_stats::record_fd(uint32_t id, bool extended, uint8_t dlc, bool brs,
+                          bool transmitted) {
+    const std::size_t index =
+        ((extended ? 2U : 0U) + (brs ? 1U : 0U)) * 16U + (dlc & 0xFU);
+    record(id, extended, fd_frames[index], transmitted);
+}
+
+/**
+ * @brief Time the frames counted in the window took on the bus.
+ */
+uint64_t bus_stats::window_busy_ns() const {
+    uint64_t nominal_bits = 0;
+    uint64_t data_bits = 0;
+    for (std::size_t i = 0; i < classic_frames.size(); i++) {
+        const bool extended = i > MAX_SIZE;
+        const uint8_t length =
+            static_cast<uint8_t>(extended ? i - (MAX_SIZE + 1U) : i);
+        nominal_bits += static_cast<uint64_t>(classic_frames[i]) *
+                        frame_bits_max(extended, length);
+    }
+    for (std::size_t i = 0; i < fd_frames.size(); i++) {
+        const fd_frame_bits_t bits =
+            fd_frame_bits_max(i >= 32, static_cast<uint8_t>(i % 16),
+                              (i / 16) % 2 != 0);
+        nominal_bits += static_cast<uint64_t>(fd_frames[i]) * bits.nominal;
+        data_bits += static_cast<uint64_t>(fd_frames[i]) * bits.data;
+    }
+    return nominal_bits * bit_us * 1000 + data_bits * data_bit_ns;
+}
+
+/**
+ * @brief Count a transmission that lost arbitration.
+ */
+void bus_stats::record_lost_arbitration() {
+    irq::critical_section lock;
+    lost_arbitration++;
+}
+
+/**
+ * @brief Count a frame dropped because an RX FIFO was full.
+ */
+void bus_stats::record_overrun() {
+    irq::critical_section lock;
+    overruns++;
+}
+
+/**
+ * @brief Store the latest error state and count the transitions into error
+ * passive and bus off.
+ *
+ * @param state The state read from the hardware.
+ * @param now_ms Current HAL tick.
+ */
+void bus_stats::update_error_state(const error_state& state,
+                                   uint32_t now_ms) {
+    irq::critical_section lock;
+    if (state.passive && !errors.passive) {
+        error_passive_events++;
+    }
+    if (state.bus_off && !errors.bus_off) {
+        bus_off_events++;
+        bus_off_since_ms = now_ms;
+    } else if (!state.bus_off && errors.bus_off) {
+        last_recovery_ms = now_ms - bus_off_since_ms;
+        if (last_recovery_ms > max_recovery_ms) {
+            max_recovery_ms = last_recovery_ms;
+        }
+    }
+    errors = state;
+}
+
+/**
+ * @brief Close the window once it has run its length.
+ *
+ * @param now_ms Current HAL tick.
+ * @return true A new report is available from get_report().
+ * @return false The window is still open.
+ */
+bool bus_stats::poll(uint32_t now_ms) {
+    const uint32_t elapsed_ms = now_ms - window_start_ms;
+    if (elapsed_ms < window_ms) {
+        return false;
+    }
+
+    irq::critical_section lock;
+    report.window_ms = elapsed_ms;
+    const uint64_t busy_ns = window_busy_ns();
+    // busy_ns / (elapsed_ms * 1000000) in tenths of a percent.
+    const uint64_t load = busy_ns / (static_cast<uint64_t>(elapsed_ms) * 1000);
+    report.load_permille = load > 1000 ? 1000 : static_cast<uint16_t>(load);
+    report.rx_frames = rx_frames;
+    report.tx_frames = tx_frames;
+    report.ids = ids;
+    report.id_count = id_count;
+    report.untracked = untracked;
+
+    report.errors = errors;
+    report.error_passive_events = error_passive_events;
+    report.bus_off_events = bus_off_events;
+    report.last_recovery_ms = last_recovery_ms;
+    report.max_recovery_ms = max_recovery_ms;
+    report.lost_arbitration = lost_arbitration;
+    report.overruns = overruns;
+
+    window_start_ms = now_ms;
+    classic_frames.fill(0);
+    fd_frames.fill(0);
+    rx_frames = 0;
+    tx_frames = 0;
+    id_count = 0;
+    untracked = 0;
+    return true;
+}
+
+/**
+ * @brief The report of the last closed window.
+ */
+const bus_report& bus_stats::get_report() const {
+    return report;
+}
+
+/**
+ * @brief Pack the health part of a report into one frame on
+ * bus_report_base_id + node:
+ * - bytes 0-1: load in tenths of a percent, little endian
+ * - byte 2: TEC, byte 3: REC
+ * - byte 4: bit 0 error warning, bit 1 error passive, bit 2 bus off
+ * - byte 5: bus off events, saturating
+ * - bytes 6-7: RX FIFO overruns, little endian, saturating
+ *
+ * @param report The report to send.
+ * @param node Low byte of the ID, naming the sender.
+ */
+packet report_packet(const bus_report& report, uint8_t node) {
+    const uint8_t flags = (report.errors.warning ? 0x01U : 0U) |
+                          (report.errors.passive ? 0x02U : 0U) |
+                          (report.errors.bus_off ? 0x04U : 0U);
+    const uint8_t bus_offs = report.bus_off_events > UINT8_MAX
+                                 ? UINT8_MAX
+                                 : static_cast<uint8_t>(report.bus_off_events);
+    const uint16_t overruns = report.overruns > UINT16_MAX
+                                  ? UINT16_MAX
+                                  : static_cast<uint16_t>(report.overruns);
+    const packet_data_t data = {static_cast<uint8_t>(report.load_permille),
+                                static_cast<uint8_t>(report.load_permille >> 8),
+                                report.errors.tec,
+                                report.errors.rec,
+                                flags,
+                                bus_offs,
+                                static_cast<uint8_t>(overruns),
+                                static_cast<uint8_t>(overruns >> 8)};
+    return packet(bus_report_base_id + node, MAX_SIZE, data, true);
+}
+
+}  // namespace can
+}  // namespace umnsvp
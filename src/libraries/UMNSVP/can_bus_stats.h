@@ -0,0 +1,248 @@
+/**
+ * @file can_bus_stats.h
+ * @brief CAN bus health statistics: error state, events and bus load.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "baud_rate.h"
+#include "can_fd_packet.h"
+#include "can_packet.h"
+
+namespace umnsvp {
+namespace can {
+
+/**
+ * @brief Longest a classic data frame can be on the bus.
+ *
+ * Every bit from SOF to the end of the CRC is taken as stuffed as often as
+ * possible (one stuff bit per four after the first), then the fixed CRC
+ * delimiter, ACK, EOF and intermission are added. skylab2.py's
+ * frame_bits_estimate() uses the same formula.
+ *
+ * @param extended True for a 29-bit ID.
+ * @param length Number of data bytes, at most MAX_SIZE.
+ * @return uint32_t Frame length in bits, including the 3 bit intermission.
+ */
+constexpr uint32_t frame_bits_max(bool extended, uint8_t length) {
+    length = length > MAX_SIZE ? MAX_SIZE : length;
+    const uint32_t stuffable = (extended ? 54U : 34U) + 8U * length;
+    return stuffable + (stuffable - 1U) / 4U + 1U + 2U + 7U + 3U;
+}
+
+/**
+ * @brief Shortest a classic data frame can be from SOF until the receiver
+ * accepts it.
+ *
+ * No stuff bits, and the count stops at the end of EOF: the frame is valid
+ * at the last EOF bit, before the intermission.
+ *
+ * @param extended True for a 29-bit ID.
+ * @param length Number of data bytes, at most MAX_SIZE.
+ * @return uint32_t Frame length in bits, up to the end of EOF.
+ */
+constexpr uint32_t frame_bits_min(bool extended, uint8_t length) {
+    length = length > MAX_SIZE ? MAX_SIZE : length;
+    return (extended ? 64U : 44U) + 8U * length;
+}
+
+/**
+ * @brief Bits a CAN FD data frame occupies in each bit rate phase.
+ */
+struct fd_frame_bits_t {
+    /// Bits at the nominal rate: arbitration up to BRS and the ACK to the
+    /// end of the intermission.
+    uint32_t nominal;
+    /// Bits at the data rate: ESI to the end of the CRC. Zero without bit
+    /// rate switching, where every bit counts as nominal.
+    uint32_t data;
+};
+
+/**
+ * @brief Longest a CAN FD data frame can be on the bus.
+ *
+ * Dynamic stuffing is taken at its worst from SOF to the end of the data,
+ * then the stuff count, the CRC-17 or CRC-21 and their fixed stuff bits (one
+ * every four bits) and the fixed tail are added. The split at the BRS bit and
+ * at the CRC delimiter is approximated to the whole bit.
+ *
+ * @param extended True for a 29-bit ID.
+ * @param dlc DLC code of the frame.
+ * @param brs True if the data phase runs at the data bit rate.
+ * @return fd_frame_bits_t Bits in each phase, including the intermission.
+ */
+constexpr fd_frame_bits_t fd_frame_bits_max(bool extended, uint8_t dlc,
+                                            bool brs) {
+    // SOF, ID, SRR and IDE or IDE, RRS, FDF, res and BRS.
+    const uint32_t header = extended ? 36U : 17U;
+    const uint32_t arbitration = header + (header - 1U) / 4U;
+    // ESI, DLC and data, then the stuff count and CRC.
+    const uint32_t length = dlc_to_length(dlc);
+    const uint32_t payload = 1U + 4U + 8U * length;
+    const uint32_t crc_length = length > 16 ? 21U : 17U;
+    const uint32_t data_phase = payload + payload / 4U + 4U + crc_length +
+                                (4U + crc_length + 3U) / 4U;
+
+    // CRC delimiter, ACK slot and delimiter, EOF and intermission.
+    const uint32_t tail = 1U + 2U + 7U + 3U;
+    if (!brs) {
+        return {arbitration + data_phase + tail, 0};
+    }
+    return {arbitration + tail, data_phase};
+}
+
+// Unstuffed lengths are 47 + 8n (standard) and 67 + 8n (extended); stuffing
+// adds at most one bit per four after the first.
+static_assert(frame_bits_max(false, 0) == 47 + 8);
+static_assert(frame_bits_max(false, 8) == 111 + 24);
+static_assert(frame_bits_max(true, 8) == 131 + 29);
+static_assert(frame_bits_min(false, 8) == frame_bits_max(false, 8) - 24 - 3);
+
+// Unstuffed FD lengths: 17 arbitration bits (standard), then ESI, DLC, data,
+// stuff count, CRC and fixed stuff bits, then the 13 bit tail.
+static_assert(fd_frame_bits_max(false, 15, true).data >=
+              1 + 4 + 512 + 4 + 21 + 7);
+static_assert(fd_frame_bits_max(false, 0, true).nominal == 21 + 13);
+static_assert(fd_frame_bits_max(false, 8, false).data == 0);
+
+/**
+ * @brief Error counters and fault confinement state read from the hardware.
+ */
+struct error_state {
+    uint8_t tec = 0;
+    uint8_t rec = 0;
+    bool warning = false;
+    bool passive = false;
+    bool bus_off = false;
+};
+
+/**
+ * @brief Frames seen for one ID during a window.
+ */
+struct id_rate {
+    uint32_t id = 0;
+    bool extended = false;
+    uint16_t rx = 0;
+    uint16_t tx = 0;
+};
+
+/// IDs tracked per window; frames from further IDs are only counted in
+/// bus_report::untracked.
+constexpr std::size_t max_tracked_ids = 16;
+
+/**
+ * @brief Snapshot published at the end of every window.
+ *
+ * Frame counts, rates and load cover the last window; event counters and
+ * recovery times are totals since start up.
+ */
+struct bus_report {
+    uint32_t window_ms = 0;
+    /// Bits on the bus over the window, in tenths of a percent.
+    uint16_t load_permille = 0;
+    uint32_t rx_frames = 0;
+    uint32_t tx_frames = 0;
+    std::array<id_rate, max_tracked_ids> ids = {};
+    std::size_t id_count = 0;
+    uint32_t untracked = 0;
+
+    error_state errors = {};
+    uint32_t error_passive_events = 0;
+    uint32_t bus_off_events = 0;
+    /// Time from entering bus off to being back on the bus, in ms.
+    uint32_t last_recovery_ms = 0;
+    uint32_t max_recovery_ms = 0;
+    uint32_t lost_arbitration = 0;
+    uint32_t overruns = 0;
+};
+
+/**
+ * @brief Base of the extended IDs bus reports are sent on. The low byte is
+ * the sending node, and being extended they stay clear of the standard ID
+ * skylab2 packets.
+ */
+constexpr uint32_t bus_report_base_id = 0x1FF0CA00U;
+
+packet report_packet(const bus_report& report, uint8_t node);
+
+/**
+ * @brief Collects CAN health statistics for one controller.
+ *
+ * The driver feeds it from its TX, RX and error paths. The bus load is the
+ * time every frame the node sent or accepted takes on the bus at its
+ * worst case stuffed length, divided by the window, so it errs high by at
+ * most the stuff bits that were not needed; CAN FD data phase bits are
+ * timed at the data bit rate. Frames dropped by the acceptance filters are
+ * not seen, so the load is the whole bus only when filter_all() is used;
+ * otherwise it is this node's share of it.
+ *
+ * The record functions may be called from any interrupt and only bump the
+ * counters of the frame's format and length. Call poll() periodically from
+ * the main loop; it turns those counts into bits, closes the window and
+ * returns true when a new report is ready to publish.
+ *
+ * Example Usage:
+   ........................
+   if (can_device.poll_stats(HAL_GetTick())) {
+       skylab.send_packet(can::report_packet(
+           can_device.get_stats().get_report(), node));
+   }
+   ........................
+ */
+class bus_stats {
+   private:
+    uint32_t window_ms;
+    uint32_t bit_us = 0;
+    uint32_t data_bit_ns = 0;
+
+    uint32_t window_start_ms = 0;
+    /// Classic frames of the window by ID length and data length.
+    std::array<uint32_t, 2 * (MAX_SIZE + 1)> classic_frames = {};
+    /// CAN FD frames of the window by ID length, bit rate switching and DLC.
+    std::array<uint32_t, 2 * 2 * 16> fd_frames = {};
+    uint32_t rx_frames = 0;
+    uint32_t tx_frames = 0;
+    std::array<id_rate, max_tracked_ids> ids = {};
+    std::size_t id_count = 0;
+    uint32_t untracked = 0;
+
+    error_state errors = {};
+    uint32_t error_passive_events = 0;
+    uint32_t bus_off_events = 0;
+    uint32_t bus_off_since_ms = 0;
+    uint32_t last_recovery_ms = 0;
+    uint32_t max_recovery_ms = 0;
+    uint32_t lost_arbitration = 0;
+    uint32_t overruns = 0;
+
+    bus_report report = {};
+
+    void record(uint32_t id, bool extended, uint32_t& frames,
+                bool transmitted);
+    uint64_t window_busy_ns() const;
+
+   public:
+    explicit bus_stats(uint32_t window_ms = 1000) : window_ms(window_ms) {
+    }
+
+    void set_rate(baud_rate rate);
+    void set_data_bit_ns(uint32_t bit_ns);
+
+    void record_rx(const packet& received);
+    void record_tx(const packet& sent);
+    void record_fd(uint32_t id, bool extended, uint8_t dlc, bool brs,
+                   bool transmitted);
+    void record_lost_arbitration();
+    void record_overrun();
+    void update_error_state(const error_state& state, uint32_t now_ms);
+
+    bool poll(uint32_t now_ms);
+    const bus_report& get_report() const;
+};
+
+}  // namespace can
+}  // namespace umnsvp
@@ -21,7 +21,12 @@
 #error "can_driver_base.h requires that the microcontroller be defined."
 #endif
 
+#include <concepts>
+#include <cstddef>
+#include <span>
+
 #include "baud_rate.h"
+#include "can_bus_stats.h"
 #include "can_packet.h"
 
 namespace umnsvp {
@@ -71,6 +76,12 @@ enum class fifo : uint32_t
 };
 
 class can_driver_base {
+   protected:
+    /**
+     * @brief Health statistics, fed by the driver's TX, RX and error paths.
+     */
+    bus_stats stats;
+
    public:
     /**
      * @brief Initialize the driver.
@@ -109,6 +120,33 @@ class can_driver_base {
     virtual HAL_StatusTypeDef filter_list(const uint32_t*, std::size_t length,
                                           bool is_extended = false) = 0;
 
+    /**
+     * @brief Allow the provided lists of packets to be received, split over
+     * the two receive FIFOs by urgency.
+     *
+     * Urgent IDs (kill, brake, ...) are filtered into FIFO1 and bulk IDs into
+     * FIFO0. start() then puts the FIFO1 interrupt in the DRIVER tier and the
+     * FIFO0 interrupt in the lower BULK tier, so an urgent frame never waits
+     * behind a burst of bulk frames. The FIFO1 handler should drain FIFO1
+     * with receive_burst() directly; the HAL IRQ handlers service every
+     * enabled source and would drain FIFO0 at the urgent priority as well.
+     *
+     * Urgent IDs are given filters first. If the bulk IDs do not fit in what
+     * is left, every other ID is accepted into FIFO0.
+     *
+     * @param urgent_ids IDs to receive in FIFO1.
+     * @param urgent_length
+     * @param bulk_ids IDs to receive in FIFO0.
+     * @param bulk_length
+     * @param is_extended
+     * @return HAL_StatusTypeDef
+     */
+    virtual HAL_StatusTypeDef filter_priority_list(const uint32_t* urgent_ids,
+                                                   std::size_t urgent_length,
+                                                   const uint32_t* bulk_ids,
+                                                   std::size_t bulk_length,
+                                                   bool is_extended = false) = 0;
+
     /**
      * @brief Transmit the packet on the CAN bus.
      *
@@ -127,6 +165,62 @@ class can_driver_base {
     virtual status receive(packet& received_packet,
                            const fifo fifo = fifo::FIFO0) = 0;
 
+    /**
+     * @brief Drain up to packets.size() frames from a receive FIFO.
+     *
+     * Meant to be called once per RX interrupt so every frame that arrived
+     * since the last one is taken in a single entry. Drivers override this to
+     * read the mailbox registers directly; the default falls back to calling
+     * receive() until the FIFO is empty.
+     *
+     * @param packets Destination for the frames, filled from the front.
+     * @param fifo
+     * @return std::size_t Number of frames written to packets.
+     */
+    virtual std::size_t receive_burst(std::span<packet> packets,
+                                      const fifo fifo = fifo::FIFO0) {
+        std::size_t count = 0;
+        while (count < packets.size() &&
+               receive(packets[count], fifo) == status::OK) {
+            count++;
+        }
+        return count;
+    }
+
+    /**
+     * @brief Read the error counters and fault confinement state.
+     *
+     * @return error_state
+     */
+    virtual error_state get_error_state() = 0;
+
+    /**
+     * @brief Record the cause of an error or status interrupt.
+     *
+     * Call from the HAL error callbacks (HAL_CAN_ErrorCallback,
+     * HAL_FDCAN_ErrorStatusCallback). Also starts bus off recovery where the
+     * hardware does not do so itself.
+     */
+    virtual void handle_error() = 0;
+
+    /**
+     * @brief Refresh the error state and close the statistics window.
+     *
+     * @param now_ms Current HAL tick.
+     * @return true A new report is available from get_stats().
+     */
+    bool poll_stats(uint32_t now_ms) {
+        stats.update_error_state(get_error_state(), now_ms);
+        return stats.poll(now_ms);
+    }
+
+    /**
+     * @brief The bus health statistics of this controller.
+     */
+    const bus_stats& get_stats() const {
+        return stats;
+    }
+
     /**
      * @brief Enable the CAN transmit interrupt.
      *
@@ -138,7 +232,45 @@ class can_driver_base {
      *
      */
     virtual void disable_tx_it() = 0;
+
+    /**
+     * @brief Whether every frame handed to send() has left the controller.
+     *
+     * send() returns as soon as the frame is in a mailbox, so use this before
+     * a reset that must not cut off a last frame.
+     */
+    virtual bool tx_idle() = 0;
+};
+
+/**
+ * @brief What a board class needs from a CAN driver.
+ *
+ * Board classes take the driver as a template parameter constrained by this
+ * concept. Given a final driver (bxcan_driver, fdcan_driver) every call is
+ * bound at compile time and can be inlined into the interrupt handlers;
+ * given can_driver_base the same code goes through the vtable, for boards
+ * that pick the driver at run time.
+ */
+template <typename T>
+concept can_driver = requires(T& driver, const packet& send_packet,
+                              packet& received_packet, std::span<packet> burst,
+                              const uint32_t* ids, std::size_t length,
+                              baud_rate rate, fifo fifo) {
+    { driver.init(rate, true) } -> std::same_as<HAL_StatusTypeDef>;
+    { driver.start() } -> std::same_as<HAL_StatusTypeDef>;
+    { driver.filter_list(ids, length) } -> std::same_as<HAL_StatusTypeDef>;
+    {
+        driver.filter_priority_list(ids, length, ids, length)
+    } -> std::same_as<HAL_StatusTypeDef>;
+    { driver.send(send_packet) } -> std::same_as<status>;
+    { driver.receive(received_packet, fifo) } -> std::same_as<status>;
+    { driver.receive_burst(burst, fifo) } -> std::same_as<std::size_t>;
+    driver.enable_tx_it();
+    driver.disable_tx_it();
+    { driver.tx_idle() } -> std::same_as<bool>;
 };
 
+static_assert(can_driver<can_driver_base>);
+
 }  // namespace can
 }  // namespace umnsvp
\ No newline at end of file
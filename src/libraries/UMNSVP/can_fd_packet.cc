@@ -0,0 +1,161 @@
+/**
+ * @file can_fd_packet.cc
+ * @brief Define CAN FD packet class methods.
+ */
+
+#include "can_fd_packet.h"
+
+#if defined(FDCAN1)
+
+#include <algorithm>
+#include <cstring>
+
+namespace umnsvp {
+namespace can {
+
+/**
+ * @brief Construct a new CAN FD packet object.
+ *
+ * @param id CAN packet ID.
+ * @param length CAN packet length in bytes, at most 64. Classic packets are
+ * limited to 8.
+ * @param data Pointer to CAN packet data, or nullptr for zeros.
+ * @param format Classic, FD, or FD with bit rate switching.
+ * @param is_extended_id True if the CAN packet ID is extended, false if it is
+ * standard.
+ */
+fd_packet::fd_packet(const uint32_t id, const uint8_t length,
+                     const uint8_t* data, const frame_format format,
+                     const bool is_extended_id)
+    : id(is_extended_id ? (id & 0x1FFFFFFF) : (id & 0x7FF)),
+      length(std::min(length, format == frame_format::CLASSIC ? MAX_SIZE
+                                                               : FD_MAX_SIZE)),
+      format(format),
+      is_extended_id(is_extended_id) {
+    if (data != nullptr) {
+        memcpy(this->data.data(), data, this->length);
+    }
+}
+
+/**
+ * @brief Construct a classic frame from a packet.
+ *
+ * @param classic The packet to copy.
+ */
+fd_packet::fd_packet(const packet& classic)
+    : fd_packet(classic.get_id(), classic.get_length(), classic.get_data(),
+                frame_format::CLASSIC, classic.is_extended()) {
+    timestamp_us = classic.get_timestamp();
+}
+
+/**
+ * @brief Construct a CAN FD packet object with header.
+ *
+ * @param header CAN packet header.
+ * @param data Pointer to CAN packet data, dlc_to_length() bytes long.
+ */
+fd_packet::fd_packet(const FDCAN_RxHeaderTypeDef& header, const uint8_t* data)
+    : id((header.IdType == FDCAN_STANDARD_ID)
+             ? header.Identifier & 0x7FF
+             : header.Identifier & 0x1FFFFFFF),
+      length(dlc_to_length(header.DataLength / DATA_LENGTH_SCALAR)),
+      format(header.FDFormat != FDCAN_FD_CAN ? frame_format::CLASSIC
+             : header.BitRateSwitch == FDCAN_BRS_ON ? frame_format::FD_BRS
+                                                    : frame_format::FD),
+      is_extended_id(header.IdType == FDCAN_EXTENDED_ID) {
+    memcpy(this->data.data(), data, this->length);
+}
+
+/**
+ * @brief Get CAN packet ID.
+ *
+ * @return uint32_t ID
+ */
+uint32_t fd_packet::get_id() const {
+    return id;
+}
+
+/**
+ * @brief Get CAN packet length in bytes.
+ *
+ * @return uint8_t Length in bytes.
+ */
+uint8_t fd_packet::get_length() const {
+    return length;
+}
+
+/**
+ * @brief Get the wire format of the packet.
+ *
+ * @return frame_format Classic, FD, or FD with bit rate switching.
+ */
+frame_format fd_packet::get_format() const {
+    return format;
+}
+
+/**
+ * @brief Check whether the packet uses an extended ID.
+ *
+ * @return true The ID is extended.
+ * @return false The ID is standard.
+ */
+bool fd_packet::is_extended() const {
+    return is_extended_id;
+}
+
+/**
+ * @brief Get the receive timestamp.
+ *
+ * @return uint32_t time::micros() time, 0 for packets built in software.
+ */
+uint32_t fd_packet::get_timestamp() const {
+    return timestamp_us;
+}
+
+/**
+ * @brief Set the receive timestamp.
+ *
+ * @param timestamp_us time::micros() time the driver stamped the packet with.
+ */
+void fd_packet::set_timestamp(uint32_t timestamp_us) {
+    this->timestamp_us = timestamp_us;
+}
+
+/**
+ * @brief Get the CAN packet header.
+ *
+ * @return FDCAN_TxHeaderTypeDef CAN packet header.
+ */
+FDCAN_TxHeaderTypeDef fd_packet::get_header() const {
+    const bool fd = format != frame_format::CLASSIC;
+    FDCAN_TxHeaderTypeDef header = {
+        .Identifier = id,
+        .IdType = is_extended_id ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID,
+        .TxFrameType = FDCAN_DATA_FRAME,
+        .DataLength = length_to_dlc(length) * DATA_LENGTH_SCALAR,
+        .ErrorStateIndicator = FDCAN_ESI_ACTIVE,
+        .BitRateSwitch =
+            format == frame_format::FD_BRS ? FDCAN_BRS_ON : FDCAN_BRS_OFF,
+        .FDFormat = fd ? FDCAN_FD_CAN : FDCAN_CLASSIC_CAN,
+        .TxEventFifoControl = FDCAN_NO_TX_EVENTS,
+        .MessageMarker = 0,
+    };
+    return header;
+}
+
+/**
+ * @brief Get pointer to the CAN packet data.
+ *
+ * The buffer is always 64 bytes, zero past the length, so the padding sent
+ * for non-FD lengths is zeros.
+ *
+ * @return const uint8_t* Pointer to CAN packet data.
+ */
+const uint8_t* fd_packet::get_data() const {
+    return data.data();
+}
+
+}  // namespace can
+}  // namespace umnsvp
+
+#endif
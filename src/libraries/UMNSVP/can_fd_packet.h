@@ -0,0 +1,123 @@
+/**
+ * @file can_fd_packet.h
+ * @brief CAN FD packet class and DLC mapping.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "can_packet.h"
+#include "hal.h"
+
+namespace umnsvp {
+namespace can {
+
+/**
+ * @brief Payload length of a DLC code. Codes 0-8 are the length itself; 9-15
+ * map to the CAN FD sizes 12, 16, 20, 24, 32, 48 and 64.
+ */
+constexpr uint8_t dlc_to_length(uint8_t dlc) {
+    constexpr std::array<uint8_t, 16> lengths = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+    return lengths[dlc & 0xFU];
+}
+
+/**
+ * @brief Smallest DLC code whose payload holds length bytes.
+ */
+constexpr uint8_t length_to_dlc(uint8_t length) {
+    uint8_t dlc = 0;
+    while (dlc < 15 && dlc_to_length(dlc) < length) {
+        dlc++;
+    }
+    return dlc;
+}
+
+static_assert(length_to_dlc(8) == 8);
+static_assert(length_to_dlc(9) == 9);
+static_assert(length_to_dlc(64) == 15);
+static_assert(dlc_to_length(length_to_dlc(33)) == 48);
+
+}  // namespace can
+}  // namespace umnsvp
+
+#if defined(FDCAN1)
+
+namespace umnsvp {
+namespace can {
+
+/// Max size of the data in a CAN FD packet in bytes.
+static constexpr uint8_t FD_MAX_SIZE = 64;
+using fd_packet_data_t = std::array<uint8_t, FD_MAX_SIZE>;
+
+/**
+ * @brief How a packet goes on the wire. Chosen per packet.
+ */
+enum class frame_format : uint8_t
+{
+    /**
+     * @brief Classic CAN frame, at most 8 bytes.
+     */
+    CLASSIC,
+    /**
+     * @brief CAN FD frame at the nominal bit rate.
+     */
+    FD,
+    /**
+     * @brief CAN FD frame with the data phase at the data bit rate.
+     */
+    FD_BRS,
+};
+
+/**
+ * @brief A CAN FD capable packet with up to 64 bytes of payload.
+ *
+ * This is separate from packet so the classic API and its queues keep their
+ * 8 byte storage. Lengths that are not a valid FD size are padded with zeros
+ * up to the next one when sent.
+ */
+class fd_packet {
+   private:
+    /// CAN packet ID.
+    uint32_t id;
+
+    /// CAN packet data length in bytes.
+    uint8_t length;
+
+    frame_format format;
+
+    bool is_extended_id;
+
+    /// Receive time in time::micros() microseconds, as can::packet's. Under
+    /// bit rate switching the start of frame is captured on TIM3 to 1 us.
+    uint32_t timestamp_us = 0;
+
+    fd_packet_data_t data = {};
+
+   public:
+    fd_packet(const uint32_t id = 0, const uint8_t length = FD_MAX_SIZE,
+              const uint8_t* data = nullptr,
+              const frame_format format = frame_format::FD_BRS,
+              const bool is_extended_id = false);
+    explicit fd_packet(const packet& classic);
+    fd_packet(const FDCAN_RxHeaderTypeDef& header, const uint8_t* data);
+
+    uint32_t get_id() const;
+    uint8_t get_length() const;
+    frame_format get_format() const;
+    bool is_extended() const;
+
+    uint32_t get_timestamp() const;
+    void set_timestamp(uint32_t timestamp_us);
+
+    FDCAN_TxHeaderTypeDef get_header() const;
+
+    const uint8_t* get_data() const;
+};
+
+}  // namespace can
+}  // namespace umnsvp
+
+#endif
@@ -0,0 +1,84 @@
+/**
+ * @file can_frame.cc
+ * @brief Define packed CAN frame methods.
+ */
+
+#include "can_frame.h"
+
+#include <algorithm>
+
+namespace umnsvp {
+namespace can {
+
+/**
+ * @brief Pack a packet into a frame.
+ *
+ * @param source The packet to pack.
+ */
+frame::frame(const packet& source)
+    : id_word((source.get_id() & id_mask) |
+              (source.is_extended() ? ide_flag : 0)),
+      meta_word((source.get_timestamp() & timestamp_mask) |
+                (source.get_length() & dlc_mask)) {
+    std::copy_n(source.get_data(), source.get_length(), data.begin());
+}
+
+/**
+ * @brief Unpack the frame back into a packet.
+ *
+ * @return packet The packet, with the timestamp rounded down to 16 us.
+ */
+packet frame::to_packet() const {
+    packet unpacked(get_id(), get_length(), data, is_extended());
+    unpacked.set_timestamp(get_timestamp());
+    return unpacked;
+}
+
+/**
+ * @brief Get CAN frame ID.
+ *
+ * @return uint32_t ID
+ */
+uint32_t frame::get_id() const {
+    return id_word & id_mask;
+}
+
+/**
+ * @brief Get CAN frame length in bytes.
+ *
+ * @return uint8_t Length in bytes.
+ */
+uint8_t frame::get_length() const {
+    return meta_word & dlc_mask;
+}
+
+/**
+ * @brief Check whether the frame uses an extended ID.
+ *
+ * @return true The ID is extended.
+ * @return false The ID is standard.
+ */
+bool frame::is_extended() const {
+    return (id_word & ide_flag) != 0;
+}
+
+/**
+ * @brief Get the receive timestamp, rounded down to 16 us.
+ *
+ * @return uint32_t The packet's time::micros() timestamp.
+ */
+uint32_t frame::get_timestamp() const {
+    return meta_word & timestamp_mask;
+}
+
+/**
+ * @brief Get pointer to the CAN frame data.
+ *
+ * @return const uint8_t* Pointer to CAN frame data.
+ */
+const uint8_t* frame::get_data() const {
+    return data.data();
+}
+
+}  // namespace can
+}  // namespace umnsvp
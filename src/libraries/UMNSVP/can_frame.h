@@ -0,0 +1,61 @@
+/**
+ * @file can_frame.h
+ * @brief Packed 16 byte CAN frame for queues.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "can_packet.h"
+
+namespace umnsvp {
+namespace can {
+
+/**
+ * @brief Compact storage form of a packet.
+ *
+ * A packet is 20 bytes, mostly padding around the length and extended ID
+ * flag. A frame packs the same information into 16 bytes, which matters for
+ * queues that hold dozens of frames:
+ *
+ * - word 0: bits 0-28 ID, bit 29 IDE (extended ID).
+ * - word 1: bits 0-3 DLC, bits 4-31 timestamp.
+ * - 8 data bytes.
+ *
+ * The DLC nibble takes the low bits of the micros() timestamp, so a frame
+ * keeps its timestamp to 16 us, which is still shorter than the shortest
+ * frame on the bus. The timestamp wraps the same way micros() does, so
+ * unsigned subtraction from micros() still gives the frame age.
+ *
+ * Use packet for the driver API and convert at the queue boundary.
+ */
+class frame {
+   private:
+    static constexpr uint32_t id_mask = 0x1FFFFFFFU;
+    static constexpr uint32_t ide_flag = 1UL << 29;
+    static constexpr uint32_t dlc_mask = 0xFU;
+    static constexpr uint32_t timestamp_mask = ~dlc_mask;
+
+    uint32_t id_word = 0;
+    uint32_t meta_word = 0;
+    packet_data_t data = default_data;
+
+   public:
+    frame() = default;
+    explicit frame(const packet& source);
+
+    packet to_packet() const;
+
+    uint32_t get_id() const;
+    uint8_t get_length() const;
+    bool is_extended() const;
+    uint32_t get_timestamp() const;
+    const uint8_t* get_data() const;
+};
+
+static_assert(sizeof(frame) == 16, "frame must stay packed to 16 bytes");
+
+}  // namespace can
+}  // namespace umnsvp
@@ -63,13 +63,19 @@ packet::packet(const FDCAN_RxHeaderTypeDef& header, const uint8_t* data)
     : id((header.IdType == FDCAN_STANDARD_ID)
              ? header.Identifier & 0b0000011111111111
              : header.Identifier & 0x1FFFFFFF),
-      length(header.DataLength / DATA_LENGTH_SCALAR) {
+      // CAN FD payloads are cut to the classic 8 bytes; use fd_packet to
+      // keep them.
+      length(std::min(static_cast<uint8_t>(header.DataLength /
+                                           DATA_LENGTH_SCALAR),
+                      MAX_SIZE)),
+      is_extended_id(header.IdType == FDCAN_EXTENDED_ID) {
     memcpy(this->data.data(), data, this->length);
 }
 #elif defined(CAN1)
 packet::packet(const CAN_RxHeaderTypeDef& header, const uint8_t* data)
     : id((header.IDE == CAN_ID_STD) ? header.StdId : header.ExtId),
-      length(header.DLC) {
+      length(header.DLC),
+      is_extended_id(header.IDE == CAN_ID_EXT) {
     memcpy(this->data.data(), data, this->length);
 }  // n
 #else
@@ -95,21 +101,32 @@ uint8_t packet::get_length() const {
 }
 
 /**
- * @brief Get the timestamp the packet was received at.
+ * @brief Check whether the packet uses an extended ID.
  *
- * @return const time::time_point& The timestamp the packet was received at.
+ * @return true The ID is extended.
+ * @return false The ID is standard.
  */
-const time::time_point& packet::get_timestamp() const {
-    return timestamp;
+bool packet::is_extended() const {
+    return is_extended_id;
 }
 
 /**
- * @brief Set the timestamp the packet was received at.
+ * @brief Get the receive timestamp; see timestamp_us for how close it is
+ * to the arrival on the bus.
  *
- * @param timestamp The timestamp to set as the received timestamp.
+ * @return uint32_t time::micros() time, 0 for packets built in software.
  */
-void packet::set_timestamp(const time::time_point& timestamp) {
-    this->timestamp = timestamp;
+uint32_t packet::get_timestamp() const {
+    return timestamp_us;
+}
+
+/**
+ * @brief Set the receive timestamp.
+ *
+ * @param timestamp_us time::micros() time the driver stamped the packet with.
+ */
+void packet::set_timestamp(uint32_t timestamp_us) {
+    this->timestamp_us = timestamp_us;
 }
 
 /**
@@ -123,8 +140,8 @@ FDCAN_TxHeaderTypeDef packet::get_header() const {
         .Identifier = id,
         .IdType = is_extended_id ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID,
         .TxFrameType = FDCAN_DATA_FRAME,
-        // this is a scalar value of type: FDCAN_data_length_code. If data
-        // length is over 8 this simple scalar WILL NOT WORK!!!! TODO:
+        // Up to 8 bytes the DLC code is the length itself. Longer CAN FD
+        // payloads go through fd_packet, which maps lengths to DLC codes.
         .DataLength = length * DATA_LENGTH_SCALAR,
         .FDFormat = FDCAN_CLASSIC_CAN,
     };
@@ -154,6 +171,16 @@ const uint8_t* packet::get_data() const {
     return static_cast<const uint8_t*>(data.data());
 }
 
+/**
+ * @brief Get a writable pointer to the CAN packet data, to fill a packet in
+ * place.
+ *
+ * @return uint8_t* Pointer to CAN packet data.
+ */
+uint8_t* packet::get_data() {
+    return data.data();
+}
+
 /**
  * @brief Insert the hexidecimal representation of the payload into a string.
  *
@@ -10,7 +10,6 @@
 #include <array>
 
 #include "hal.h"
-#include "time_point.h"
 
 namespace umnsvp {
 namespace can {
@@ -42,9 +41,16 @@ class packet {
     bool is_extended_id;
 
     /**
-     * @brief The timestamp of the packet
+     * @brief Receive time in time::micros() microseconds, zero for packets
+     * built in software.
+     *
+     * The start of frame time captured by the controller. FDCAN's is exact.
+     * bxCAN's is exact relative to other frames, and late in absolute
+     * terms by the shortest delay seen between a frame ending and its
+     * burst being read, plus that frame's stuff bits: a few bit times once
+     * the bus has carried some traffic.
      */
-    time::time_point timestamp;
+    uint32_t timestamp_us = 0;
 
    public:
     packet(const uint32_t id, const uint8_t length, const uint8_t* data,
@@ -61,9 +67,10 @@ class packet {
 
     uint32_t get_id() const;
     uint8_t get_length() const;
+    bool is_extended() const;
 
-    const time::time_point& get_timestamp() const;
-    void set_timestamp(const time::time_point& timestamp);
+    uint32_t get_timestamp() const;
+    void set_timestamp(uint32_t timestamp_us);
 
 #if defined(FDCAN1) || defined(FDCAN2)
     FDCAN_TxHeaderTypeDef get_header() const;
@@ -72,6 +79,7 @@ class packet {
 #endif
 
     const uint8_t* get_data() const;
+    uint8_t* get_data();
     void get_hex(char* str) const;
 };
 }  // namespace can
@@ -0,0 +1,123 @@
+/**
+ * @file can_rx_clock.h
+ * @brief Map CAN hardware receive timestamps onto time::micros().
+ */
+#pragma once
+
+#include <stdint.h>
+
+#include "baud_rate.h"
+
+namespace umnsvp {
+namespace can {
+
+/**
+ * @brief Length of one nominal bit in microseconds.
+ *
+ * Every baud rate table doubles the prescaler to halve the rate, so the bit
+ * time scales with the enum value. The tables are anchored at 500 kb/s,
+ * which every micro supports.
+ */
+constexpr uint32_t bit_time_us(baud_rate rate) {
+    return 2U * static_cast<uint32_t>(rate) /
+           static_cast<uint32_t>(baud_rate::BAUD_RATE_500);
+}
+
+static_assert(bit_time_us(baud_rate::BAUD_RATE_500) == 2U);
+static_assert(bit_time_us(baud_rate::BAUD_RATE_125) == 8U);
+
+/**
+ * @brief Converts the 16-bit timestamp counters of bxCAN and FDCAN into the
+ * 32-bit microsecond time base.
+ *
+ * FDCAN can read its counter live, so the driver sync()s the clock to a
+ * pair of (counter, micros()) samples taken together and converts each
+ * frame's captured counter relative to that pair. Frames must be converted
+ * within half a counter wrap of the sync point: 32768 ticks, or 65 ms at
+ * 500 kb/s.
+ *
+ * bxCAN cannot read its counter live and anchor()s to the newest frame of
+ * each burst instead. The bit counter and micros() run from the same
+ * oscillator, so the offset between them is fixed; anchor() keeps the
+ * earliest offset any frame allows, which converges on the true start of
+ * frame once one burst is read promptly.
+ */
+class rx_clock {
+   private:
+    uint32_t tick_us = 0;
+    uint16_t ref_ticks = 0;
+    uint32_t ref_us = 0;
+    bool anchored = false;
+
+   public:
+    /**
+     * @brief Set the counter period from the configured baud rate, for a
+     * counter that ticks once per nominal bit.
+     */
+    void set_rate(baud_rate rate) {
+        tick_us = bit_time_us(rate);
+        anchored = false;
+    }
+
+    /**
+     * @brief Set the counter period directly, for a counter driven by a
+     * timer (FDCAN's external timestamp under bit rate switching).
+     */
+    void set_tick_us(uint32_t us) {
+        tick_us = us;
+        anchored = false;
+    }
+
+    /**
+     * @brief Record a counter value and the micros() time it was read at.
+     */
+    void sync(uint16_t ticks, uint32_t now_us) {
+        ref_ticks = ticks;
+        ref_us = now_us;
+    }
+
+    /**
+     * @brief Anchor the counter to a frame that has already been received.
+     *
+     * The frame started no later than now_us less its shortest length, so
+     * that bounds the offset from above. The previous anchor, carried
+     * forward by the elapsed ticks, is kept if it is earlier. It is let
+     * slip by 15 ppm so that a drifting clock is still followed.
+     *
+     * @param ticks Start of frame counter value captured with the frame.
+     * @param now_us micros() time, read after the frame was.
+     * @param frame_bits The frame's shortest possible length in bits, from
+     * SOF until it is accepted.
+     */
+    void anchor(uint16_t ticks, uint32_t now_us, uint32_t frame_bits) {
+        uint32_t start_us = now_us - frame_bits * tick_us;
+        const uint32_t elapsed_us = start_us - ref_us;
+        if (anchored && static_cast<int32_t>(elapsed_us) >= 0) {
+            // The 16-bit counter has wrapped an unknown number of times;
+            // pick the count closest to what the elapsed time predicts.
+            const uint16_t delta = ticks - ref_ticks;
+            const int32_t excess = static_cast<int32_t>(elapsed_us / tick_us) -
+                                   static_cast<int32_t>(delta) + 32768;
+            const uint32_t wraps = excess < 0 ? 0 : excess >> 16;
+            const uint32_t carried_us =
+                ref_us + ((wraps << 16) + delta) * tick_us + (elapsed_us >> 16);
+            if (static_cast<int32_t>(carried_us - start_us) < 0) {
+                start_us = carried_us;
+            }
+        }
+        sync(ticks, start_us);
+        anchored = true;
+    }
+
+    /**
+     * @brief Convert a captured counter value to micros() time.
+     */
+    uint32_t to_us(uint16_t ticks) const {
+        const int16_t delta = static_cast<int16_t>(ticks - ref_ticks);
+        return ref_us + static_cast<int32_t>(delta) *
+                            static_cast<int32_t>(tick_us);
+    }
+};
+
+}  // namespace can
+}  // namespace umnsvp
@@ -0,0 +1,235 @@
+/**
+ * @file can_tx_queue.h
+ * @brief CAN transmit queue ordered by arbitration priority.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "can_driver_base.h"
+#include "can_frame.h"
+#include "critical_section.h"
+
+namespace umnsvp {
+namespace can {
+
+/**
+ * @brief Arbitration key of a frame; lower keys win the bus.
+ *
+ * Standard IDs are compared against the top 11 bits of extended IDs, and a
+ * standard frame beats an extended one with the same base ID because its IDE
+ * bit is dominant. Shifting both into a 30-bit key with IDE as the last bit
+ * gives the same order.
+ */
+constexpr uint32_t arbitration_key(uint32_t id, bool is_extended) {
+    return is_extended ? ((id & 0x1FFFFFFFU) << 1) | 1U
+                       : (id & 0x7FFU) << 19;
+}
+
+static_assert(arbitration_key(0x100, false) < arbitration_key(0x101, false));
+static_assert(arbitration_key(0x100, false) <
+              arbitration_key(0x100U << 18, true));
+static_assert(arbitration_key(0x0FFU << 18, true) <
+              arbitration_key(0x100, false));
+
+/**
+ * @brief Fixed size binary min-heap of frames waiting for a TX mailbox.
+ *
+ * The hardware arbitrates by ID, so a queued status frame must not hold back
+ * a command that was queued after it. send_next() always offers the driver
+ * the pending frame that would win arbitration, and frames with equal IDs
+ * leave in the order they were pushed.
+ *
+ * Frames may carry a deadline in HAL ticks (ms). A frame still queued after
+ * its deadline is dropped instead of being sent late. Deadlines use 16-bit
+ * wrapping arithmetic, so the maximum age must stay under 32 seconds.
+ *
+ * Every operation runs inside a short critical section so the queue can be
+ * pushed from the main loop or any ISR while the TX interrupt drains it.
+ *
+ * Example Usage:
+   ........................
+   // When the driver is busy
+   if (!queue.push(packet, HAL_GetTick(), 50)) {
+       // full, packet dropped
+   }
+   ........................
+   // In the TX complete interrupt
+   queue.send_next(HAL_GetTick(), driver);
+   ........................
+ *
+ * @tparam capacity Maximum number of queued frames, at most 255.
+ */
+template <std::size_t capacity>
+class tx_queue {
+    static_assert(capacity > 0 && capacity <= UINT8_MAX);
+
+   private:
+    /**
+     * @brief A queued frame with its ordering and expiry data. Kept to
+     * 20 bytes, the same as a packet.
+     */
+    struct entry {
+        frame queued;
+        /// Push order, compared with wrapping arithmetic to keep FIFO order
+        /// between frames with the same ID.
+        uint16_t sequence;
+        /// HAL tick the frame expires at, or 0 for no deadline.
+        uint16_t deadline_ms;
+    };
+
+    std::array<entry, capacity> heap;
+    uint8_t count = 0;
+    uint16_t next_sequence = 0;
+    uint32_t dropped = 0;
+    uint32_t expired = 0;
+
+    static bool before(const entry& a, const entry& b) {
+        const uint32_t key_a =
+            arbitration_key(a.queued.get_id(), a.queued.is_extended());
+        const uint32_t key_b =
+            arbitration_key(b.queued.get_id(), b.queued.is_extended());
+        if (key_a != key_b) {
+            return key_a < key_b;
+        }
+        return static_cast<int16_t>(a.sequence - b.sequence) < 0;
+    }
+
+    static bool is_expired(const entry& e, uint16_t now_ms) {
+        return e.deadline_ms != 0 &&
+               static_cast<int16_t>(now_ms - e.deadline_ms) > 0;
+    }
+
+    void sift_up(std::size_t i) {
+        while (i > 0) {
+            const std::size_t parent = (i - 1) / 2;
+            if (!before(heap[i], heap[parent])) {
+                return;
+            }
+            std::swap(heap[i], heap[parent]);
+            i = parent;
+        }
+    }
+
+    void sift_down(std::size_t i) {
+        while (true) {
+            const std::size_t left = 2 * i + 1;
+            const std::size_t right = left + 1;
+            std::size_t best = i;
+            if (left < count && before(heap[left], heap[best])) {
+                best = left;
+            }
+            if (right < count && before(heap[right], heap[best])) {
+                best = right;
+            }
+            if (best == i) {
+                return;
+            }
+            std::swap(heap[i], heap[best]);
+            i = best;
+        }
+    }
+
+    void remove_top() {
+        count--;
+        if (count > 0) {
+            heap[0] = heap[count];
+            sift_down(0);
+        }
+    }
+
+   public:
+    /**
+     * @brief Queue a packet.
+     *
+     * @param packet The packet to send.
+     * @param now_ms Current HAL tick.
+     * @param max_age_ms Drop the packet if it has not been handed to the
+     * hardware this many ms from now. 0 keeps it until it is sent.
+     * @return true The packet was queued.
+     * @return false The queue was full and the packet was dropped.
+     */
+    bool push(const packet& packet, uint32_t now_ms, uint16_t max_age_ms = 0) {
+        irq::critical_section lock;
+        if (count == capacity) {
+            dropped++;
+            return false;
+        }
+        uint16_t deadline = 0;
+        if (max_age_ms != 0) {
+            deadline = static_cast<uint16_t>(now_ms + max_age_ms);
+            // 0 means no deadline, so expire one tick late instead.
+            if (deadline == 0) {
+                deadline = 1;
+            }
+        }
+        heap[count] = {frame(packet), next_sequence++, deadline};
+        count++;
+        sift_up(count - 1);
+        return true;
+    }
+
+    /**
+     * @brief Hand the highest priority live frame to the driver.
+     *
+     * Expired frames at the front are dropped first. The frame is only
+     * removed from the queue once the driver accepts it.
+     *
+     * @param now_ms Current HAL tick.
+     * @param driver Driver to send through.
+     * @return status EMPTY if nothing is left to send, otherwise the result
+     * of driver.send().
+     */
+    template <can_driver Driver>
+    status send_next(uint32_t now_ms, Driver& driver) {
+        irq::critical_section lock;
+        while (count > 0 &&
+               is_expired(heap[0], static_cast<uint16_t>(now_ms))) {
+            expired++;
+            remove_top();
+        }
+        if (count == 0) {
+            return status::EMPTY;
+        }
+        const status result = driver.send(heap[0].queued.to_packet());
+        if (result == status::OK) {
+            remove_top();
+        }
+        return result;
+    }
+
+    /**
+     * @brief Check whether any frames are waiting.
+     */
+    bool empty() const {
+        return count == 0;
+    }
+
+    /**
+     * @brief Number of frames waiting.
+     */
+    std::size_t size() const {
+        return count;
+    }
+
+    /**
+     * @brief Number of packets rejected because the queue was full.
+     */
+    uint32_t get_dropped() const {
+        return dropped;
+    }
+
+    /**
+     * @brief Number of frames dropped because their deadline passed.
+     */
+    uint32_t get_expired() const {
+        return expired;
+    }
+};
+
+}  // namespace can
+}  // namespace umnsvp
@@ -128,9 +128,10 @@ class CircularBuffer {
      * Fresh data is not available here until a pop() or peek() that returns
      * true occurs. See the example in the class docs above.
      *
-     * @return T Current consumable element.
+     * @return const T& Current consumable element. Valid until the next
+     * pop() or peek().
      */
-    T output() const {
+    const T& output() const {
         return buffer[consuming];
     }
 
@@ -267,9 +268,10 @@ class CircularBuffer {
      * Fresh data is not available here until a pop() or peek() that returns
      * true occurs. See the example in the class docs above.
      *
-     * @return T Current consumable element.
+     * @return const T& Current consumable element. Valid until the next
+     * pop() or peek().
      */
-    T output() const {
+    const T& output() const {
         uint8_t index = consuming.load();
         return buffer[index];
     }
@@ -0,0 +1,36 @@
+/**
+ * @file critical_section.h
+ * @brief Scoped PRIMASK critical section.
+ */
+#pragma once
+
+#include "hal.h"
+
+namespace umnsvp {
+namespace irq {
+
+/**
+ * @brief Masks every interrupt for the lifetime of the object and restores
+ * the previous PRIMASK on exit, so sections nest.
+ *
+ * Keep the guarded code short and bounded: the CONTROL tier is masked too.
+ * Use it where any tier may touch the data, which rules out BASEPRI.
+ */
+class critical_section {
+   public:
+    critical_section() : primask(__get_PRIMASK()) {
+        __disable_irq();
+    }
+    ~critical_section() {
+        __set_PRIMASK(primask);
+    }
+
+    critical_section(const critical_section&) = delete;
+    critical_section& operator=(const critical_section&) = delete;
+
+   private:
+    const uint32_t primask;
+};
+
+}  // namespace irq
+}  // namespace umnsvp
@@ -0,0 +1,114 @@
+/**
+ * @file data_rate.h
+ * @brief CAN FD data phase bit rates and their bit timing.
+ *
+ * The data phase runs with its own prescaler and segments; the arbitration
+ * phase keeps using baud_rate. Values are for the same FDCAN kernel clocks
+ * listed in baud_rate.h, with a sample point near 80% as recommended for
+ * the data phase.
+ *
+ * The transmitter delay compensation offset is placed at the data phase
+ * sample point, in FDCAN clock periods (DataPrescaler * (1 + DataTimeSeg1)).
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace umnsvp {
+namespace can {
+
+/**
+ * @brief Bit timing for the data phase of bit rate switched frames.
+ */
+struct data_timing {
+    uint32_t prescaler;
+    uint32_t time_segment_1;
+    uint32_t time_segment_2;
+    uint32_t sync_jump_width;
+
+    /**
+     * @brief Transmitter delay compensation offset in FDCAN clock periods.
+     */
+    constexpr uint32_t tdc_offset() const {
+        return prescaler * (1U + time_segment_1);
+    }
+};
+
+#if defined(STM32G474xx) || defined(STM32G473xx)
+// 160 MHz FDCAN clock.
+enum class data_rate : uint32_t
+{
+    DATA_RATE_2000,
+    DATA_RATE_4000,
+    DATA_RATE_5000,
+};
+
+constexpr data_timing get_data_timing(data_rate rate) {
+    switch (rate) {
+        case data_rate::DATA_RATE_2000:
+            return {4, 15, 4, 4};  // 20 tq, 80%
+        case data_rate::DATA_RATE_4000:
+            return {2, 15, 4, 4};  // 20 tq, 80%
+        case data_rate::DATA_RATE_5000:
+        default:
+            return {1, 25, 6, 6};  // 32 tq, 81%
+    }
+}
+#elif defined(STM32L562xx)
+// 96 MHz FDCAN clock. 5 Mb/s does not divide evenly.
+enum class data_rate : uint32_t
+{
+    DATA_RATE_2000,
+    DATA_RATE_4000,
+};
+
+constexpr data_timing get_data_timing(data_rate rate) {
+    switch (rate) {
+        case data_rate::DATA_RATE_2000:
+            return {2, 18, 5, 5};  // 24 tq, 79%
+        case data_rate::DATA_RATE_4000:
+        default:
+            return {1, 18, 5, 5};  // 24 tq, 79%
+    }
+}
+#elif defined(STM32G0B1xx)
+// 64 MHz FDCAN clock. 5 Mb/s does not divide evenly.
+enum class data_rate : uint32_t
+{
+    DATA_RATE_2000,
+    DATA_RATE_4000,
+};
+
+constexpr data_timing get_data_timing(data_rate rate) {
+    switch (rate) {
+        case data_rate::DATA_RATE_2000:
+            return {1, 25, 6, 6};  // 32 tq, 81%
+        case data_rate::DATA_RATE_4000:
+        default:
+            return {1, 12, 3, 3};  // 16 tq, 81%
+    }
+}
+#else
+#error "data_rate.h requires an FDCAN microcontroller."
+#endif
+
+/**
+ * @brief Length of one data phase bit in nanoseconds.
+ */
+constexpr uint32_t data_bit_ns(data_rate rate) {
+    switch (rate) {
+        case data_rate::DATA_RATE_2000:
+            return 500;
+#if defined(STM32G474xx) || defined(STM32G473xx)
+        case data_rate::DATA_RATE_5000:
+            return 200;
+#endif
+        case data_rate::DATA_RATE_4000:
+        default:
+            return 250;
+    }
+}
+
+}  // namespace can
+}  // namespace umnsvp
@@ -0,0 +1,70 @@
+/**
+ * @file deferred_work.cc
+ * @brief Bottom half work queue run from PendSV.
+ */
+
+#include "deferred_work.h"
+
+#include <array>
+
+#include "critical_section.h"
+
+namespace umnsvp {
+namespace irq {
+namespace {
+
+struct work_item {
+    work_fn fn;
+    void* context;
+};
+
+std::array<work_item, deferred_capacity> queue;
+std::size_t head = 0;  // Next item to run.
+std::size_t count = 0;
+uint32_t dropped = 0;
+
+}  // namespace
+
+void init_deferred() {
+    HAL_NVIC_SetPriority(PendSV_IRQn, priority_of(tier::DEFERRED), 0);
+}
+
+bool post(work_fn fn, void* context) {
+    if (fn == nullptr) {
+        return false;
+    }
+    {
+        critical_section lock;
+        if (count == queue.size()) {
+            dropped++;
+            return false;
+        }
+        queue[(head + count) % queue.size()] = {fn, context};
+        count++;
+    }
+    SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;
+    return true;
+}
+
+void run_deferred() {
+    while (true) {
+        work_item item;
+        {
+            critical_section lock;
+            if (count == 0) {
+                return;
+            }
+            item = queue[head];
+            head = (head + 1) % queue.size();
+            count--;
+        }
+        item.fn(item.context);
+    }
+}
+
+uint32_t get_dropped() {
+    return dropped;
+}
+
+}  // namespace irq
+}  // namespace umnsvp
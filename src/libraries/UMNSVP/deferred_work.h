@@ -0,0 +1,70 @@
+/**
+ * @file deferred_work.h
+ * @brief Bottom half work queue run from PendSV.
+ *
+ * Interrupts in the CONTROL and DRIVER tiers post short work items here
+ * instead of doing slow work (packing and queueing CAN packets, updating
+ * outputs) inside the ISR. PendSV runs at the DEFERRED tier, so the queued
+ * work never delays a higher tier, and it tail-chains straight after the
+ * posting ISR returns, so it still runs well before the main loop would.
+ *
+ * Usage:
+ *
+ *   // once, after HAL_Init()
+ *   irq::init_deferred();
+ *
+ *   // in stm32xxxx_it.cc
+ *   void PendSV_Handler(void) {
+ *       umnsvp::irq::run_deferred();
+ *   }
+ *
+ *   // in any ISR
+ *   irq::post(&send_status_work, &app);
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "irq_tier.h"
+
+namespace umnsvp {
+namespace irq {
+
+using work_fn = void (*)(void* context);
+
+/**
+ * @brief Maximum number of work items waiting at once. Posting more than
+ * this before PendSV gets to run drops the extra items.
+ */
+constexpr std::size_t deferred_capacity = 16;
+
+/**
+ * @brief Set PendSV to the DEFERRED tier priority.
+ */
+void init_deferred();
+
+/**
+ * @brief Queue a work item and pend PendSV. Safe to call from any ISR at or
+ * above the DEFERRED tier and from thread mode.
+ *
+ * @param fn Function to run.
+ * @param context Argument passed to fn.
+ * @return true The item was queued.
+ * @return false The queue was full; the item was dropped.
+ */
+bool post(work_fn fn, void* context = nullptr);
+
+/**
+ * @brief Run every queued work item in posting order. Call this from
+ * PendSV_Handler only.
+ */
+void run_deferred();
+
+/**
+ * @brief Number of items dropped because the queue was full.
+ */
+uint32_t get_dropped();
+
+}  // namespace irq
+}  // namespace umnsvp
@@ -13,6 +13,671 @@
 
 // Include Header to prevent compilation with non FDCAN micro's
 #include "fdcan.h"
+#include "filter_compiler.h"
+#include "irq_tier.h"
+#include "micros.h"
+
+#if defined(STM32G4) || defined(STM32G0) || defined(STM32L5)
+
+#include <cstring>
+
+#include "can_tx_queue.h"
+
+namespace umnsvp {
+namespace can {
+namespace {
+
+/**
+ * @brief Layout of an RX FIFO element in message RAM.
+ *
+ * The G0, G4 and L5 parts all use the fixed SRAMCAN layout, where every RX
+ * element is 18 words regardless of the payload size. The first word holds
+ * the identifier, the second the DLC, and the payload starts at the third.
+ *
+ * @{
+ */
+constexpr uint32_t rx_element_size = 18U * 4U;
+constexpr uint32_t rx_element_xtd = 1UL << 30;
+constexpr uint32_t rx_element_std_id_pos = 18U;
+constexpr uint32_t rx_element_ext_id_mask = 0x1FFFFFFFU;
+constexpr uint32_t rx_element_dlc_pos = 16U;
+constexpr uint32_t rx_element_dlc_mask = 0xFU << rx_element_dlc_pos;
+constexpr uint32_t rx_element_brs = 1UL << 20;
+constexpr uint32_t rx_element_fdf = 1UL << 21;
+constexpr uint32_t rx_element_ts_mask = 0xFFFFU;
+/// Remote frame and error state indicator flags of the first word.
+constexpr uint32_t rx_element_rtr = 1UL << 29;
+constexpr uint32_t rx_element_esi = 1UL << 31;
+/**
+ * @}
+ */
+
+/**
+ * @brief CAN ID held in the first word of an RX element. The flag bits above
+ * the ID are masked off, so RTR and ESI frames keep their ID.
+ */
+constexpr uint32_t rx_element_id(uint32_t r0) {
+    return (r0 & rx_element_xtd) != 0
+               ? (r0 & rx_element_ext_id_mask)
+               : (r0 >> rx_element_std_id_pos) & filter::standard_id_mask;
+}
+
+static_assert(rx_element_id(0x123U << rx_element_std_id_pos) == 0x123);
+static_assert(rx_element_id((0x123U << rx_element_std_id_pos) |
+                            rx_element_rtr | rx_element_esi) == 0x123);
+static_assert(rx_element_id(0x7FFU << rx_element_std_id_pos |
+                            rx_element_esi) == 0x7FF);
+static_assert(rx_element_id(0x1ABCDEF0U | rx_element_xtd | rx_element_rtr |
+                            rx_element_esi) == 0x1ABCDEF0U);
+
+/// TX buffers of the fixed SRAMCAN layout, all used as the TX queue.
+constexpr std::size_t tx_buffer_count = 3;
+
+/**
+ * @brief Identifier field of a TX buffer element, which the TX queue mode
+ * compares to pick the next buffer: standard IDs sit in bits 28:18.
+ */
+constexpr uint32_t tx_element_id(uint32_t id, bool extended) {
+    return extended ? id : id << 18;
+}
+
+/**
+ * @brief Queue mode sends the buffer with the lowest identifier field first,
+ * which is the order tx_queue's arbitration_key() pops frames in, so the
+ * software heap and the hardware agree on priority. The one exception is a
+ * standard frame and an extended frame whose top 11 bits match it exactly,
+ * which the hardware leaves to buffer order.
+ */
+constexpr bool tx_order_agrees(uint32_t a, bool a_ext, uint32_t b,
+                               bool b_ext) {
+    return (tx_element_id(a, a_ext) < tx_element_id(b, b_ext)) ==
+           (arbitration_key(a, a_ext) < arbitration_key(b, b_ext));
+}
+
+static_assert(tx_order_agrees(0x100, false, 0x101, false));
+static_assert(tx_order_agrees(0x101, false, 0x100, false));
+static_assert(tx_order_agrees(0x100, false, 0x0FFU << 18, true));
+static_assert(tx_order_agrees(0x0FFU << 18, true, 0x100, false));
+static_assert(tx_order_agrees(0x100, false, (0x100U << 18) | 1U, true));
+static_assert(tx_order_agrees(0x1234, true, 0x1235, true));
+
+/**
+ * @brief Interrupt lines and pin alternate function of one FDCAN peripheral.
+ */
+struct instance_map {
+    IRQn_Type line0;
+    IRQn_Type line1;
+    uint8_t af;
+    bool valid;
+};
+
+/**
+ * @brief Look up the interrupt lines and alternate function of a peripheral.
+ *
+ * FDCAN1 and FDCAN2 share both lines on the G0. FDCAN3 is only present on the
+ * G473 and G474, and uses AF11 rather than AF9.
+ *
+ * @param instance The FDCAN peripheral.
+ * @return instance_map valid is false for a peripheral this part lacks.
+ */
+instance_map map_instance(const FDCAN_GlobalTypeDef* instance) {
+#if defined(STM32G0)
+    if (instance == FDCAN1) {
+        return {TIM16_FDCAN_IT0_IRQn, TIM17_FDCAN_IT1_IRQn, GPIO_AF3_FDCAN1,
+                true};
+    }
+    if (instance == FDCAN2) {
+        return {TIM16_FDCAN_IT0_IRQn, TIM17_FDCAN_IT1_IRQn, GPIO_AF3_FDCAN2,
+                true};
+    }
+#else
+    if (instance == FDCAN1) {
+        return {FDCAN1_IT0_IRQn, FDCAN1_IT1_IRQn, GPIO_AF9_FDCAN1, true};
+    }
+#if defined(FDCAN2)
+    if (instance == FDCAN2) {
+        return {FDCAN2_IT0_IRQn, FDCAN2_IT1_IRQn, GPIO_AF9_FDCAN2, true};
+    }
+#endif
+#if defined(FDCAN3)
+    if (instance == FDCAN3) {
+        return {FDCAN3_IT0_IRQn, FDCAN3_IT1_IRQn, GPIO_AF11_FDCAN3, true};
+    }
+#endif
+#endif
+    return {};
+}
+
+/**
+ * @brief Run TIM3 as a free-running 16-bit counter at 1 MHz, for the
+ * external timestamp source of FDCAN.
+ *
+ * The internal counter counts bit times, which have no fixed period once
+ * the data phase runs at its own rate. The boards leave APB1 undivided, as
+ * timer.h assumes, so TIM3 runs from the core clock.
+ */
+void start_timestamp_timer() {
+    __HAL_RCC_TIM3_CLK_ENABLE();
+    TIM3->CR1 = 0;
+    TIM3->PSC = SystemCoreClock / 1000000U - 1U;
+    TIM3->ARR = 0xFFFFU;
+    // Load the prescaler now rather than at the first overflow.
+    TIM3->EGR = TIM_EGR_UG;
+    TIM3->CR1 = TIM_CR1_CEN;
+}
+
+/**
+ * @brief Sample the timestamp counter and micros() together.
+ *
+ * Interrupts are masked so a higher tier cannot land between the two reads.
+ *
+ * @param handle Handle of a started FDCAN peripheral.
+ * @param clock The clock to sync.
+ */
+void sync_clock(const FDCAN_HandleTypeDef& handle, rx_clock& clock) {
+    const bool external = (handle.Instance->TSCC & FDCAN_TSCC_TSS) ==
+                          FDCAN_TIMESTAMP_EXTERNAL;
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    const uint16_t ticks =
+        external ? TIM3->CNT : handle.Instance->TSCV & FDCAN_TSCV_TSC;
+    clock.sync(ticks, time::micros());
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Count and clear a message lost (overrun) flag of an RX FIFO.
+ */
+void check_overrun(FDCAN_HandleTypeDef& handle, const fifo fifo,
+                   bus_stats& stats) {
+    const uint32_t lost = fifo == fifo::FIFO0
+                              ? FDCAN_FLAG_RX_FIFO0_MESSAGE_LOST
+                              : FDCAN_FLAG_RX_FIFO1_MESSAGE_LOST;
+    if (__HAL_FDCAN_GET_FLAG(&handle, lost) != 0) {
+        __HAL_FDCAN_CLEAR_FLAG(&handle, lost);
+        stats.record_overrun();
+    }
+}
+
+/**
+ * @brief Copy frames straight out of the message RAM of an RX FIFO.
+ *
+ * Bypasses HAL_FDCAN_GetRxMessage() and its intermediate header so a full
+ * FIFO can be emptied in one interrupt.
+ *
+ * CAN FD elements do not fit a classic packet; they are released from the
+ * FIFO and counted in fd_dropped rather than handed out truncated.
+ *
+ * @param handle Handle of a started FDCAN peripheral.
+ * @param clock Converts the RX timestamps; synced before the first read.
+ * @param stats Counts the frames and any overrun.
+ * @param fd_dropped Counts the CAN FD elements skipped.
+ * @param fifo The RX FIFO to drain.
+ * @param packets Destination for the frames.
+ * @return std::size_t Number of frames read.
+ */
+std::size_t drain_rx_fifo(FDCAN_HandleTypeDef& handle, rx_clock& clock,
+                          bus_stats& stats, uint32_t& fd_dropped,
+                          const fifo fifo, std::span<packet> packets) {
+    FDCAN_GlobalTypeDef* const fdcan = handle.Instance;
+    const bool fifo0 = fifo == fifo::FIFO0;
+    volatile uint32_t& status = fifo0 ? fdcan->RXF0S : fdcan->RXF1S;
+    volatile uint32_t& ack = fifo0 ? fdcan->RXF0A : fdcan->RXF1A;
+    const uint32_t base =
+        fifo0 ? handle.msgRam.RxFIFO0SA : handle.msgRam.RxFIFO1SA;
+
+    // Clear the new message flag before reading, so the interrupt only
+    // fires again for frames that arrive after this point. This lets the
+    // FIFO1 line be serviced without HAL_FDCAN_IRQHandler().
+    __HAL_FDCAN_CLEAR_FLAG(&handle, fifo0 ? FDCAN_FLAG_RX_FIFO0_NEW_MESSAGE
+                                          : FDCAN_FLAG_RX_FIFO1_NEW_MESSAGE);
+    check_overrun(handle, fifo, stats);
+    sync_clock(handle, clock);
+
+    std::size_t count = 0;
+    while (count < packets.size()) {
+        // Fill level and get index sit at the same positions in RXF0S and
+        // RXF1S.
+        const uint32_t fifo_status = status;
+        if ((fifo_status & FDCAN_RXF0S_F0FL) == 0) {
+            break;
+        }
+        const uint32_t index =
+            (fifo_status & FDCAN_RXF0S_F0GI) >> FDCAN_RXF0S_F0GI_Pos;
+        const volatile uint32_t* element =
+            reinterpret_cast<const volatile uint32_t*>(
+                base + index * rx_element_size);
+
+        const uint32_t r0 = element[0];
+        const bool extended = (r0 & rx_element_xtd) != 0;
+        const uint32_t id = rx_element_id(r0);
+        const uint32_t r1 = element[1];
+        if ((r1 & rx_element_fdf) != 0) {
+            // Still on the bus, so still counted in the load.
+            stats.record_fd(
+                id, extended,
+                static_cast<uint8_t>((r1 & rx_element_dlc_mask) >>
+                                     rx_element_dlc_pos),
+                (r1 & rx_element_brs) != 0, false);
+            fd_dropped++;
+            ack = index;
+            continue;
+        }
+        const uint8_t length = (r1 & rx_element_dlc_mask) >> rx_element_dlc_pos;
+        const uint32_t payload[2] = {element[2], element[3]};
+        packet_data_t data;
+        std::memcpy(data.data(), payload, data.size());
+
+        packets[count] = packet(id, length, data, extended);
+        packets[count].set_timestamp(clock.to_us(r1 & rx_element_ts_mask));
+        stats.record_rx(packets[count]);
+        count++;
+        ack = index;
+    }
+    return count;
+}
+
+}  // namespace
+
+/**
+ * @brief Enable CAN FD with bit rate switching at the given data rate.
+ *
+ * Call before init(). Classic frames can still be sent and received; the
+ * format is picked per packet by fd_packet. RX timestamps then come from
+ * TIM3, which the board must leave free.
+ *
+ * @param rate The data phase bit rate.
+ */
+void fdcan_driver::set_data_rate(data_rate rate) {
+    fd_enabled = true;
+    fd_timing = get_data_timing(rate);
+    stats.set_data_bit_ns(data_bit_ns(rate));
+}
+
+/**
+ * @brief Apply the frame format and data phase timing, then initialize the
+ * peripheral and its transmitter delay compensation.
+ *
+ * @return HAL_StatusTypeDef HAL return status for init.
+ */
+HAL_StatusTypeDef fdcan_driver::init_peripheral() {
+    if (fd_enabled) {
+        handle.Init.FrameFormat = FDCAN_FRAME_FD_BRS;
+        handle.Init.DataPrescaler = fd_timing.prescaler;
+        handle.Init.DataTimeSeg1 = fd_timing.time_segment_1;
+        handle.Init.DataTimeSeg2 = fd_timing.time_segment_2;
+        handle.Init.DataSyncJumpWidth = fd_timing.sync_jump_width;
+        // Stamp from TIM3 instead of the bit time counter (see start()).
+        start_timestamp_timer();
+        clock.set_tick_us(1);
+    }
+
+    HAL_StatusTypeDef init_status = HAL_FDCAN_Init(&handle);
+    if (init_status != HAL_OK || !fd_enabled) {
+        return init_status;
+    }
+
+    // At data rates above ~1 Mb/s the transceiver loop delay is longer than
+    // the data bit sample point, so the transmitter has to check its own bits
+    // at a delayed point.
+    HAL_StatusTypeDef tdc_status = HAL_FDCAN_ConfigTxDelayCompensation(
+        &handle, fd_timing.tdc_offset(), 0);
+    if (tdc_status != HAL_OK) {
+        return tdc_status;
+    }
+    return HAL_FDCAN_EnableTxDelayCompensation(&handle);
+}
+
+/**
+ * @brief Program a compiled filter into consecutive filter elements.
+ *
+ * List IDs are paired up into dual ID elements, ranges take one element
+ * each.
+ *
+ * @param program Output of filter::compile_ranges().
+ * @param filter_config FDCAN_FILTER_TO_RXFIFO0 or FDCAN_FILTER_TO_RXFIFO1.
+ * @param index First element to use, advanced past the elements used.
+ * @return HAL_StatusTypeDef
+ */
+HAL_StatusTypeDef fdcan_driver::apply_filters(const filter::program& program,
+                                              uint32_t filter_config,
+                                              uint32_t& index) {
+    FDCAN_FilterTypeDef element = {
+        .IdType = program.extended ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID,
+        .FilterIndex = index,
+        .FilterType = FDCAN_FILTER_DUAL,
+        .FilterConfig = filter_config,
+        .FilterID1 = 0,
+        .FilterID2 = 0,
+    };
+    const auto apply = [&](uint32_t type, uint32_t id1, uint32_t id2) {
+        element.FilterType = type;
+        element.FilterID1 = id1;
+        element.FilterID2 = id2;
+        HAL_StatusTypeDef filter_status =
+            HAL_FDCAN_ConfigFilter(&handle, &element);
+        element.FilterIndex++;
+        index = element.FilterIndex;
+        return filter_status;
+    };
+
+    bool pending = false;
+    uint32_t pending_id = 0;
+    for (std::size_t i = 0; i < program.count; i++) {
+        const filter::rule& rule = program.rules[i];
+        HAL_StatusTypeDef filter_status = HAL_OK;
+        if (rule.type == filter::kind::RANGE) {
+            filter_status = apply(FDCAN_FILTER_RANGE, rule.id, rule.arg);
+        } else if (pending) {
+            filter_status = apply(FDCAN_FILTER_DUAL, pending_id, rule.id);
+            pending = false;
+        } else {
+            pending_id = rule.id;
+            pending = true;
+        }
+        if (filter_status != HAL_OK) {
+            return filter_status;
+        }
+    }
+    if (pending) {
+        return apply(FDCAN_FILTER_DUAL, pending_id, pending_id);
+    }
+    return HAL_OK;
+}
+
+/**
+ * @brief Setup filters for the provided list of IDs.
+ *
+ * The IDs are compiled into the list and range elements reserved for their
+ * ID type, see filter_compiler.h. Close IDs share a range element, so a list
+ * that used to overflow into filter_all() now only lets a few extra IDs
+ * through.
+ *
+ * @param rx_ids
+ * @param length
+ * @param is_extended
+ * @return HAL_StatusTypeDef
+ */
+HAL_StatusTypeDef fdcan_driver::filter_list(const uint32_t* rx_ids,
+                                            std::size_t length,
+                                            bool is_extended) {
+    const std::size_t elements =
+        is_extended ? handle.Init.ExtFiltersNbr : handle.Init.StdFiltersNbr;
+    const filter::program program =
+        filter::compile_ranges(rx_ids, length, elements, is_extended);
+    if (!program.ok || !filter::covers(program, rx_ids, length)) {
+        // If the IDs do not fit just filter all the ID's
+        return filter_all();
+    }
+
+    uint32_t index = 0;
+    return apply_filters(program, FDCAN_FILTER_TO_RXFIFO0, index);
+}
+
+/**
+ * @brief Setup filters routing urgent IDs to FIFO1 and bulk IDs to FIFO0.
+ *
+ * See can_driver_base::filter_priority_list(). Elements are matched in
+ * order, so the urgent elements come first and an ID in both lists is
+ * treated as urgent.
+ *
+ * @param urgent_ids
+ * @param urgent_length
+ * @param bulk_ids
+ * @param bulk_length
+ * @param is_extended
+ * @return HAL_StatusTypeDef
+ */
+HAL_StatusTypeDef fdcan_driver::filter_priority_list(
+    const uint32_t* urgent_ids, std::size_t urgent_length,
+    const uint32_t* bulk_ids, std::size_t bulk_length, bool is_extended) {
+    const std::size_t elements =
+        is_extended ? handle.Init.ExtFiltersNbr : handle.Init.StdFiltersNbr;
+    if (elements < 2) {
+        return HAL_ERROR;
+    }
+
+    // Keep at least one element for the bulk traffic.
+    const filter::program urgent = filter::compile_ranges(
+        urgent_ids, urgent_length, elements - 1, is_extended);
+    if (!urgent.ok || !filter::covers(urgent, urgent_ids, urgent_length)) {
+        split_fifos = false;
+        return filter_all();
+    }
+    split_fifos = true;
+
+    uint32_t index = 0;
+    HAL_StatusTypeDef filter_status =
+        apply_filters(urgent, FDCAN_FILTER_TO_RXFIFO1, index);
+    if (filter_status != HAL_OK) {
+        return filter_status;
+    }
+
+    const filter::program bulk = filter::compile_ranges(
+        bulk_ids, bulk_length, elements - index, is_extended);
+    if (bulk.ok && filter::covers(bulk, bulk_ids, bulk_length)) {
+        return apply_filters(bulk, FDCAN_FILTER_TO_RXFIFO0, index);
+    }
+
+    // Accept every other ID into FIFO0.
+    FDCAN_FilterTypeDef rest = {
+        .IdType = is_extended ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID,
+        .FilterIndex = index,
+        .FilterType = FDCAN_FILTER_MASK,
+        .FilterConfig = FDCAN_FILTER_TO_RXFIFO0,
+        .FilterID1 = 0x0000,
+        .FilterID2 = 0x0000,
+    };
+    return HAL_FDCAN_ConfigFilter(&handle, &rest);
+}
+
+/**
+ * @brief Give urgent FIFO1 traffic its own interrupt line.
+ *
+ * Called by start() after filter_priority_list(). FIFO1 joins the TX
+ * interrupts on line 1 in the DRIVER tier, and line 0 with the bulk FIFO0
+ * drops to the BULK tier.
+ *
+ * @return HAL_StatusTypeDef
+ */
+HAL_StatusTypeDef fdcan_driver::route_urgent_fifo() {
+    HAL_StatusTypeDef line_status = HAL_FDCAN_ConfigInterruptLines(
+        &handle, FDCAN_IT_GROUP_RX_FIFO1, FDCAN_INTERRUPT_LINE1);
+    HAL_StatusTypeDef notif_status = HAL_FDCAN_ActivateNotification(
+        &handle, FDCAN_IT_RX_FIFO1_NEW_MESSAGE, 0);
+
+    if (config_isr) {
+        // On the G0 both peripherals share these lines.
+        const instance_map lines = map_instance(handle.Instance);
+        irq::enable(lines.line1, irq::tier::DRIVER);
+        irq::enable(lines.line0, irq::tier::BULK);
+    }
+
+    if (line_status != HAL_OK) {
+        return line_status;
+    }
+    return notif_status;
+}
+
+/**
+ * @brief Enable the fault confinement interrupts on line 1.
+ *
+ * Error warning, error passive and bus off changes reach
+ * HAL_FDCAN_ErrorStatusCallback(), which should call handle_error().
+ *
+ * @return HAL_StatusTypeDef
+ */
+HAL_StatusTypeDef fdcan_driver::enable_error_it() {
+    HAL_StatusTypeDef line_status = HAL_FDCAN_ConfigInterruptLines(
+        &handle, FDCAN_IT_GROUP_PROTOCOL_ERROR | FDCAN_IT_GROUP_BIT_LINE_ERROR,
+        FDCAN_INTERRUPT_LINE1);
+    HAL_StatusTypeDef notif_status = HAL_FDCAN_ActivateNotification(
+        &handle,
+        FDCAN_IT_ERROR_WARNING | FDCAN_IT_ERROR_PASSIVE | FDCAN_IT_BUS_OFF, 0);
+    if (line_status != HAL_OK) {
+        return line_status;
+    }
+    return notif_status;
+}
+
+/**
+ * @brief Read the error counters and protocol status.
+ *
+ * @return error_state
+ */
+error_state fdcan_driver::get_error_state() {
+    FDCAN_ErrorCountersTypeDef counters = {};
+    FDCAN_ProtocolStatusTypeDef protocol = {};
+    HAL_FDCAN_GetErrorCounters(&handle, &counters);
+    HAL_FDCAN_GetProtocolStatus(&handle, &protocol);
+    return {
+        .tec = static_cast<uint8_t>(counters.TxErrorCnt),
+        .rec = static_cast<uint8_t>(counters.RxErrorCnt),
+        .warning = protocol.Warning != 0,
+        .passive = protocol.ErrorPassive != 0,
+        .bus_off = protocol.BusOff != 0,
+    };
+}
+
+/**
+ * @brief Record a fault confinement change and recover from bus off.
+ *
+ * Unlike bxCAN there is no automatic bus off recovery: the peripheral sets
+ * INIT and stays off the bus. Clearing INIT starts the recovery sequence of
+ * 129 times 11 recessive bits.
+ */
+void fdcan_driver::handle_error() {
+    const error_state state = get_error_state();
+    if (state.bus_off) {
+        CLEAR_BIT(handle.Instance->CCCR, FDCAN_CCCR_INIT);
+    }
+    stats.update_error_state(state, HAL_GetTick());
+}
+
+/**
+ * @brief Transmit a classic or CAN FD packet.
+ *
+ * FD packets are only valid after set_data_rate(); before that they are
+ * rejected.
+ *
+ * @param send_packet The packet to send.
+ * @return status OK if the packet was queued in hardware, ERROR otherwise.
+ */
+status fdcan_driver::send(const fd_packet& send_packet) {
+    if (send_packet.get_format() != frame_format::CLASSIC && !fd_enabled) {
+        return status::ERROR;
+    }
+
+    FDCAN_TxHeaderTypeDef header = send_packet.get_header();
+
+    // Same as the classic send().
+    handle.Instance->CCCR &= ~(0x01);
+    HAL_StatusTypeDef send_status =
+        add_to_tx_queue(header, send_packet.get_data());
+
+    if (send_status == HAL_OK) {
+        record_fd(send_packet, true);
+        return status::OK;
+    }
+
+    return status::ERROR;
+}
+
+/**
+ * @brief Put a frame in the hardware TX queue.
+ *
+ * The queue picks buffers by ID, and among equal IDs by buffer index, not by
+ * age. A frame whose ID is already pending is therefore refused, and waits
+ * in the board's tx_queue (which keeps pushes with one ID in order) until
+ * the earlier one is on the bus, so ISO-TP consecutive frames cannot swap.
+ *
+ * @return HAL_StatusTypeDef HAL_ERROR if the queue is full or holds this ID.
+ */
+HAL_StatusTypeDef fdcan_driver::add_to_tx_queue(FDCAN_TxHeaderTypeDef& header,
+                                                const uint8_t* data) {
+    const uint32_t key =
+        tx_element_id(header.Identifier, header.IdType == FDCAN_EXTENDED_ID) |
+        (header.IdType == FDCAN_EXTENDED_ID ? 1UL << 31 : 0U);
+    const uint32_t pending = handle.Instance->TXBRP;
+    for (std::size_t i = 0; i < tx_buffer_count; i++) {
+        if ((pending & (1UL << i)) != 0 && tx_keys[i] == key) {
+            return HAL_ERROR;
+        }
+    }
+    const HAL_StatusTypeDef result = HAL_FDCAN_AddMessageToTxFifoQ(
+        &handle, &header, const_cast<uint8_t*>(data));
+    if (result == HAL_OK) {
+        const uint32_t buffer = HAL_FDCAN_GetLatestTxFifoQRequestBuffer(&handle);
+        tx_keys[__builtin_ctz(buffer)] = key;
+    }
+    return result;
+}
+
+/**
+ * @brief True once no TX buffer has a transmission request pending.
+ */
+bool fdcan_driver::tx_idle() {
+    return handle.Instance->TXBRP == 0;
+}
+
+/**
+ * @brief Count a classic or CAN FD packet in the bus statistics.
+ *
+ * @param frame The packet.
+ * @param transmitted True if this node sent it.
+ */
+void fdcan_driver::record_fd(const fd_packet& frame, bool transmitted) {
+    if (frame.get_format() == frame_format::CLASSIC) {
+        const packet classic(frame.get_id(), frame.get_length(),
+                             frame.get_data(), frame.is_extended());
+        if (transmitted) {
+            stats.record_tx(classic);
+        } else {
+            stats.record_rx(classic);
+        }
+        return;
+    }
+    // Sent padded to the next FD size.
+    stats.record_fd(frame.get_id(), frame.is_extended(),
+                    length_to_dlc(frame.get_length()),
+                    frame.get_format() == frame_format::FD_BRS, transmitted);
+}
+
+/**
+ * @brief Read a classic or CAN FD packet from the receive FIFO.
+ *
+ * @param received_packet The variable to store the received packet in.
+ * @param fifo The FIFO to read from.
+ * @return status OK if a packet was read, EMPTY if the FIFO was empty, or
+ * ERROR.
+ */
+status fdcan_driver::receive(fd_packet& received_packet, const fifo fifo) {
+    const uint32_t RxFifo =
+        fifo == fifo::FIFO0 ? FDCAN_RX_FIFO0 : FDCAN_RX_FIFO1;
+
+    check_overrun(handle, fifo, stats);
+    if (HAL_FDCAN_GetRxFifoFillLevel(&handle, RxFifo) == 0) {
+        return status::EMPTY;
+    }
+
+    FDCAN_RxHeaderTypeDef header = {0};
+    uint8_t data[FD_MAX_SIZE] = {0};
+
+    if (HAL_FDCAN_GetRxMessage(&handle, RxFifo, &header, data) != HAL_OK) {
+        return status::ERROR;
+    }
+    received_packet = fd_packet(header, data);
+    sync_clock(handle, clock);
+    received_packet.set_timestamp(clock.to_us(header.RxTimestamp));
+    record_fd(received_packet, false);
+
+    return status::OK;
+}
+
+}  // namespace can
+}  // namespace umnsvp
+
+#endif
 
 #if defined(STM32G4) || defined(STM32G0)
 
@@ -47,8 +712,9 @@ fdcan_driver::fdcan_driver(FDCAN_GlobalTypeDef* can_peripheral, fdcan_gpio gpio,
     handle.Init.StdFiltersNbr = num_filter_banks;
     handle.Init.ExtFiltersNbr = extended_num_filter_banks;
 
-    handle.Init.TxFifoQueueMode = FDCAN_TX_FIFO_OPERATION;
-    // handle.Init.ProtocolException = ENABLE;  // We should probably have this
+    // Send the pending buffer with the lowest ID first, as the bus would.
+    handle.Init.TxFifoQueueMode = FDCAN_TX_QUEUE_OPERATION;
+    handle.Init.ProtocolException = ENABLE;
     handle.Init.AutoRetransmission = ENABLE;
 }
 
@@ -66,7 +732,7 @@ HAL_StatusTypeDef fdcan_driver::clock_enable() const {
         __HAL_RCC_GPIOD_CLK_ENABLE();
         return HAL_OK;
     } else if (gpio.port == GPIOB) {
-        __HAL_RCC_GPIOD_CLK_ENABLE();
+        __HAL_RCC_GPIOB_CLK_ENABLE();
         return HAL_OK;
     } else {
         return HAL_ERROR;
@@ -91,91 +757,35 @@ HAL_StatusTypeDef fdcan_driver::init(baud_rate rate, bool extended) {
     // Hardcoded prescaler from: http://www.bittiming.can-wiki.info/
     // See @ref baud_ref documentation for more information.
     handle.Init.NominalPrescaler = static_cast<uint32_t>(rate);
+    clock.set_rate(rate);
+    stats.set_rate(rate);
     handle.Init.DataPrescaler = static_cast<uint32_t>(rate);
 
-    // Currently useless check but will be used when FDCAN2 & 3 are added
-    if (handle.Instance == FDCAN1) {
-        // Enable CAN1 clock.
-
-        // Enable the GPIO Clock for the gpio pins
-        HAL_StatusTypeDef clock_status = clock_enable();
-        if (clock_status != HAL_OK) {
-            return clock_status;
-        }
-
-// alternate function configuration
-#if defined(STM32G4)
-        const uint8_t af = GPIO_AF9_FDCAN1;
-#elif defined(STM32G0)
-        const uint8_t af = GPIO_AF3_FDCAN1;
-#endif
-
-        GPIO_InitStruct.Pin = gpio.rx_pin | gpio.tx_pin;
-        GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
-        GPIO_InitStruct.Pull = GPIO_NOPULL;
-        GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
-        GPIO_InitStruct.Alternate = af;
-
-        // Initialize the GPIO pins for CAN1.
-        HAL_GPIO_Init(gpio.port, &GPIO_InitStruct);
-        if (config_isr) {
-// Set and enable the interupts
-#if defined(STM32G4)
-            HAL_NVIC_SetPriority(FDCAN1_IT0_IRQn, 1, 0);
-            HAL_NVIC_EnableIRQ(FDCAN1_IT0_IRQn);
-            HAL_NVIC_SetPriority(FDCAN1_IT1_IRQn, 1, 0);
-            HAL_NVIC_EnableIRQ(FDCAN1_IT1_IRQn);
-#elif defined(STM32G0)  // NOTE: FDCAN1 and TWO Share interupts on G0!!!!
-            HAL_NVIC_SetPriority(TIM16_FDCAN_IT0_IRQn, 1, 0);
-            HAL_NVIC_EnableIRQ(TIM16_FDCAN_IT0_IRQn);
-            HAL_NVIC_SetPriority(TIM17_FDCAN_IT1_IRQn, 1, 0);
-            HAL_NVIC_EnableIRQ(TIM17_FDCAN_IT1_IRQn);
-#endif
-        }
-    } else if (handle.Instance == FDCAN2) {
-        // Enable CAN2 clock.
-
-        // Enable the GPIO Clock for the gpio pins
-        HAL_StatusTypeDef clock_status = clock_enable();
-        if (clock_status != HAL_OK) {
-            return clock_status;
-        }
-
-// alternate function configuration
-#if defined(STM32G4)
-        const uint8_t af = GPIO_AF9_FDCAN2;
-#elif defined(STM32G0)
-        const uint8_t af = GPIO_AF3_FDCAN2;
-#endif
+    const instance_map map = map_instance(handle.Instance);
+    if (!map.valid) {
+        // Not a peripheral of this part.
+        return HAL_ERROR;
+    }
 
-        GPIO_InitStruct.Pin = gpio.rx_pin | gpio.tx_pin;
-        GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
-        GPIO_InitStruct.Pull = GPIO_NOPULL;
-        GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
-        GPIO_InitStruct.Alternate = af;
-
-        // Initialize the GPIO pins for CAN2.
-        HAL_GPIO_Init(gpio.port, &GPIO_InitStruct);
-        if (config_isr) {
-// Set and enable the interupts
-#if defined(STM32G4)
-            HAL_NVIC_SetPriority(FDCAN2_IT0_IRQn, 1, 1);
-            HAL_NVIC_EnableIRQ(FDCAN2_IT0_IRQn);
-            HAL_NVIC_SetPriority(FDCAN2_IT1_IRQn, 1, 1);
-            HAL_NVIC_EnableIRQ(FDCAN2_IT1_IRQn);
-#elif defined(STM32G0)  // NOTE: FDCAN1 and TWO Share interupts on G0!!!!
-            HAL_NVIC_SetPriority(TIM16_FDCAN_IT0_IRQn, 1, 0);
-            HAL_NVIC_EnableIRQ(TIM16_FDCAN_IT0_IRQn);
-            HAL_NVIC_SetPriority(TIM17_FDCAN_IT1_IRQn, 1, 0);
-            HAL_NVIC_EnableIRQ(TIM17_FDCAN_IT1_IRQn);
-#endif
-        }
+    // Enable the GPIO Clock for the gpio pins
+    HAL_StatusTypeDef clock_status = clock_enable();
+    if (clock_status != HAL_OK) {
+        return clock_status;
+    }
 
-    } else {
-        // Return ERROR for invalid can peripherals. (FDCAN3 is not supported.)
-        return HAL_ERROR;
+    GPIO_InitStruct.Pin = gpio.rx_pin | gpio.tx_pin;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+    GPIO_InitStruct.Alternate = map.af;
+    HAL_GPIO_Init(gpio.port, &GPIO_InitStruct);
+
+    if (config_isr) {
+        // Set and enable the interupts. NOTE: FDCAN1 and 2 share them on G0.
+        irq::enable(map.line0, irq::tier::DRIVER);
+        irq::enable(map.line1, irq::tier::DRIVER);
     }
-    return HAL_FDCAN_Init(&handle);
+    return init_peripheral();
 }
 
 /**
@@ -192,54 +802,44 @@ HAL_StatusTypeDef fdcan_driver::start() {
     HAL_FDCAN_ConfigGlobalFilter(&handle, FDCAN_REJECT, FDCAN_REJECT,
                                  FDCAN_REJECT_REMOTE, FDCAN_REJECT_REMOTE);
 
-    if (handle.Instance == FDCAN1) {
-        // Configure the interupts. This is done even if config ISR is false bc
-        // it doesn't matter Configure interupt vector 0 for the Received new
-        // message intupt. The last input on the first function
-        // (FDCAN_TX_BUFFER0) is ignored bc not aplicible
-        HAL_StatusTypeDef FIFO0_inter_status = HAL_FDCAN_ConfigInterruptLines(
-            &handle, FDCAN_IT_GROUP_RX_FIFO0, FDCAN_INTERRUPT_LINE0);
-        HAL_StatusTypeDef FIFO0_notif_status = HAL_FDCAN_ActivateNotification(
-            &handle, FDCAN_FLAG_RX_FIFO0_NEW_MESSAGE, 0);
-
-        // Configure interupt vector 1 for the transmit empty intupt. The
-        // last input is ignored bc not aplicible (FDCAN_TX_BUFFER0)
-        HAL_StatusTypeDef tx_inter_status = HAL_FDCAN_ConfigInterruptLines(
-            &handle, FDCAN_IT_GROUP_TX_FIFO_ERROR, FDCAN_INTERRUPT_LINE1);
-        HAL_StatusTypeDef tx_notif_status = HAL_FDCAN_ActivateNotification(
-            &handle, FDCAN_FLAG_TX_FIFO_EMPTY, FDCAN_TX_BUFFER0);
-
-        HAL_StatusTypeDef start_status = HAL_FDCAN_Start(&handle);
-
-        if (start_status == HAL_OK && FIFO0_notif_status == HAL_OK &&
-            FIFO0_inter_status == HAL_OK && tx_notif_status == HAL_OK &&
-            tx_inter_status == HAL_OK) {
-            return HAL_OK;
-        }
-    } else if (handle.Instance == FDCAN2) {
-        // Configure the interupts. This is done even if config ISR is false bc
-        // it doesn't matter Configure interupt vector 0 for the Received new
-        // message intupt. The last input on the first function
-        // (FDCAN_TX_BUFFER0) is ignored bc not aplicible
-        HAL_StatusTypeDef FIFO0_inter_status = HAL_FDCAN_ConfigInterruptLines(
-            &handle, FDCAN_IT_GROUP_RX_FIFO0, FDCAN_INTERRUPT_LINE0);
-        HAL_StatusTypeDef FIFO0_notif_status = HAL_FDCAN_ActivateNotification(
-            &handle, FDCAN_FLAG_RX_FIFO0_NEW_MESSAGE, 0);
-
-        // Configure interupt vector 1 for the transmit empty intupt. The
-        // last input is ignored bc not aplicible (FDCAN_TX_BUFFER0)
-        HAL_StatusTypeDef tx_inter_status = HAL_FDCAN_ConfigInterruptLines(
-            &handle, FDCAN_IT_GROUP_TX_FIFO_ERROR, FDCAN_INTERRUPT_LINE1);
-        HAL_StatusTypeDef tx_notif_status = HAL_FDCAN_ActivateNotification(
-            &handle, FDCAN_FLAG_TX_FIFO_EMPTY, FDCAN_TX_BUFFER0);
+    // Count RX timestamps in nominal bit times; rx_clock maps them onto
+    // micros(). With bit rate switching the internal counter also counts
+    // the faster data phase bits, so it has no fixed period and the 1 MHz
+    // TIM3 started by init_peripheral() is captured instead.
+    HAL_FDCAN_ConfigTimestampCounter(&handle, FDCAN_TIMESTAMP_PRESC_1);
+    HAL_FDCAN_EnableTimestampCounter(&handle, fd_enabled
+                                                  ? FDCAN_TIMESTAMP_EXTERNAL
+                                                  : FDCAN_TIMESTAMP_INTERNAL);
 
-        HAL_StatusTypeDef start_status = HAL_FDCAN_Start(&handle);
+    if (split_fifos && route_urgent_fifo() != HAL_OK) {
+        return HAL_ERROR;
+    }
+    if (enable_error_it() != HAL_OK) {
+        return HAL_ERROR;
+    }
 
-        if (start_status == HAL_OK && FIFO0_notif_status == HAL_OK &&
-            FIFO0_inter_status == HAL_OK && tx_notif_status == HAL_OK &&
-            tx_inter_status == HAL_OK) {
-            return HAL_OK;
-        }
+    // Configure the interupts. This is done even if config ISR is false bc
+    // it doesn't matter Configure interupt vector 0 for the Received new
+    // message intupt. The last input on the first function
+    // (FDCAN_TX_BUFFER0) is ignored bc not aplicible
+    HAL_StatusTypeDef FIFO0_inter_status = HAL_FDCAN_ConfigInterruptLines(
+        &handle, FDCAN_IT_GROUP_RX_FIFO0, FDCAN_INTERRUPT_LINE0);
+    HAL_StatusTypeDef FIFO0_notif_status = HAL_FDCAN_ActivateNotification(
+        &handle, FDCAN_FLAG_RX_FIFO0_NEW_MESSAGE, 0);
+
+    // Configure interupt vector 1 for the transmit empty intupt. The
+    // last input is ignored bc not aplicible (FDCAN_TX_BUFFER0)
+    HAL_StatusTypeDef tx_inter_status = HAL_FDCAN_ConfigInterruptLines(
+        &handle, FDCAN_IT_GROUP_TX_FIFO_ERROR, FDCAN_INTERRUPT_LINE1);
+    HAL_StatusTypeDef tx_notif_status = HAL_FDCAN_ActivateNotification(
+        &handle, FDCAN_FLAG_TX_FIFO_EMPTY, FDCAN_TX_BUFFER0);
+
+    HAL_StatusTypeDef start_status = HAL_FDCAN_Start(&handle);
+
+    if (start_status == HAL_OK && FIFO0_notif_status == HAL_OK &&
+        FIFO0_inter_status == HAL_OK && tx_notif_status == HAL_OK &&
+        tx_inter_status == HAL_OK) {
+        return HAL_OK;
     }
     return HAL_ERROR;
 }
@@ -255,110 +855,13 @@ HAL_StatusTypeDef fdcan_driver::stop() {
 }
 
 /**
- * @brief Build FDCAN filter with the filter index and the IDs to filter.
- *
- * @param filter_index
- * @param id1
- * @param id2
- * @return constexpr FDCAN_FilterTypeDef
- */
-FDCAN_FilterTypeDef make_filter_from_ids(std::size_t filter_index, uint32_t id1,
-                                         uint32_t id2,
-                                         bool is_extended = false) {
-    if (is_extended) {
-        return {
-            .IdType = FDCAN_EXTENDED_ID,  // Filter Standard ID's
-            .FilterIndex =
-                filter_index,  // Only filter so put this in the first bank
-            .FilterType = FDCAN_FILTER_DUAL,  // Make it a dual discrete ID type
-            // TODO: in the future we will want to explicitly provide the
-            // FIFO
-            .FilterConfig = FDCAN_FILTER_TO_RXFIFO0,  // Put this in FIFO0
-            .FilterID1 = id1,
-            .FilterID2 = id2};
-    } else {
-        return {
-            .IdType = FDCAN_STANDARD_ID,  // Filter Standard ID's
-            .FilterIndex =
-                filter_index,  // Only filter so put this in the first bank
-            .FilterType = FDCAN_FILTER_DUAL,  // Make it a dual discrete ID type
-            // TODO: in the future we will want to explicitly provide the
-            // FIFO
-            .FilterConfig = FDCAN_FILTER_TO_RXFIFO0,  // Put this in FIFO0
-            .FilterID1 = id1,
-            .FilterID2 = id2};
-    }
-}
-
-/**
- * @brief Setup filters for the provided list of IDs.
- *
- * @param rx_ids
- * @param length
- * @return HAL_StatusTypeDef
- */
-HAL_StatusTypeDef fdcan_driver::filter_list(const uint32_t* rx_ids,
-                                            std::size_t length,
-                                            bool is_extended) {
-    if (length == 0) {
-        // return because you didin't input a value
-        return HAL_StatusTypeDef::HAL_OK;
-    } else if (is_extended) {
-        if (length > handle.Init.ExtFiltersNbr * id_filter_bank_cnt) {
-            // If too many inputs just filter all the ID's
-            return filter_all();
-        }
-    } else {
-        if (length > handle.Init.StdFiltersNbr * id_filter_bank_cnt) {
-            // If too many inputs just filter all the ID's
-            return filter_all();
-        }
-    }
-
-    FDCAN_FilterTypeDef filter;
-
-    std::size_t filter_index = 0;
-    std::size_t can_id_filter_index = 0;
-    while (can_id_filter_index < length) {
-        if (can_id_filter_index <= length - 2) {
-            filter = make_filter_from_ids(
-                filter_index, rx_ids[can_id_filter_index],
-                rx_ids[can_id_filter_index + 1], is_extended);
-            can_id_filter_index += 2;
-        } else {
-            // After this you are done since it's the last ID by
-            // definition of entering this branch
-            filter =
-                make_filter_from_ids(filter_index, rx_ids[can_id_filter_index],
-                                     rx_ids[can_id_filter_index], is_extended);
-            can_id_filter_index += 1;
-        }
-
-        // Apply the filter
-        HAL_StatusTypeDef filter_status =
-            HAL_FDCAN_ConfigFilter(&handle, &filter);
-        if (filter_status == HAL_StatusTypeDef::HAL_OK) {
-            // If succesful, increment to the next filter
-            filter_index += 1;
-        } else {
-            // Return an error if it occurs
-            return filter_status;
-        }
-    }
-    // Reached the end of the ID's without an error so return true
-    return HAL_OK;
-}
-
-/**
- * @brief Apply a filter to the CAN peripheral that accepts all STANDARD
- * ID packets. NOT currently set up for extended ID's
- *  TODO: Set up for extended ID's
+ * @brief Apply filters to the CAN peripheral that accept all standard and
+ * extended ID packets.
  *
  * @return HAL_StatusTypeDef HAL return status for configuration.
  */
 HAL_StatusTypeDef fdcan_driver::filter_all() {
     // A filter that accepts all packets.
-    // TODO: Update to work for extended ID's
     FDCAN_FilterTypeDef filterStd = {
         .IdType = FDCAN_STANDARD_ID,  // Filter Standard ID's
         .FilterIndex = 0,  // Only filter so put this in the first bank
@@ -418,13 +921,13 @@ status fdcan_driver::send(const packet& send_packet) {
 
     // Attempt to add the message into a transmit mailbox.
     // TODO: Double check inputs to this to make sure structs line up
-    // TODO: We should not be using const_cast like this.
     handle.Instance->CCCR &= ~(0x01);
-    HAL_StatusTypeDef send_status = HAL_FDCAN_AddMessageToTxFifoQ(
-        &handle, &header, const_cast<uint8_t*>(send_packet.get_data()));
+    HAL_StatusTypeDef send_status =
+        add_to_tx_queue(header, send_packet.get_data());
 
     // Check the response.
     if (send_status == HAL_OK) {
+        stats.record_tx(send_packet);
         return status::OK;
     }
 
@@ -457,6 +960,8 @@ status fdcan_driver::receive(packet& received_packet, const fifo fifo) {
             return status::ERROR;
     }
 
+    check_overrun(handle, fifo, stats);
+
     // Check if packets are available to read.
     const uint32_t fill_level = HAL_FDCAN_GetRxFifoFillLevel(&handle, RxFifo);
 
@@ -467,7 +972,8 @@ status fdcan_driver::receive(packet& received_packet, const fifo fifo) {
 
     // Prepare a header and data structure to load a packet into.
     FDCAN_RxHeaderTypeDef header = {0};
-    uint8_t data[8] = {0};
+    // Sized for FD frames; packet keeps the first 8 bytes.
+    uint8_t data[FD_MAX_SIZE] = {0};
 
     // Read a packet into the prepared data structures.
     HAL_StatusTypeDef receive_status =
@@ -479,10 +985,37 @@ status fdcan_driver::receive(packet& received_packet, const fifo fifo) {
     }
     // Update the received packet to the freshly read packet.
     received_packet = packet(header, data);
+    sync_clock(handle, clock);
+    received_packet.set_timestamp(clock.to_us(header.RxTimestamp));
+    stats.record_rx(received_packet);
 
     return status::OK;
 }
 
+/**
+ * @brief Drain up to packets.size() frames from a receive FIFO.
+ *
+ * Reads the RX elements straight from message RAM instead of going through
+ * HAL_FDCAN_GetRxMessage(), so all frames pending in the FIFO are taken in
+ * one call. CAN FD frames are skipped and counted in get_fd_dropped(); read
+ * those with receive(fd_packet&).
+ *
+ * @param packets Destination for the frames, filled from the front.
+ * @param fifo The FIFO to read from.
+ * @return std::size_t Number of frames written to packets.
+ */
+std::size_t fdcan_driver::receive_burst(std::span<packet> packets,
+                                        const fifo fifo) {
+    return drain_rx_fifo(handle, clock, stats, fd_dropped, fifo, packets);
+}
+
+/**
+ * @brief Number of CAN FD frames receive_burst() skipped.
+ */
+uint32_t fdcan_driver::get_fd_dropped() const {
+    return fd_dropped;
+}
+
 /**
  * @brief Get a reference to the CAN HAL handle.
  *
@@ -545,9 +1078,9 @@ fdcan_driver::fdcan_driver(FDCAN_GlobalTypeDef* can_peripheral, fdcan_gpio gpio,
     handle.Init.StdFiltersNbr = num_filter_banks;
     handle.Init.ExtFiltersNbr = extended_num_filter_banks;
 
-    handle.Init.TxFifoQueueMode = FDCAN_TX_FIFO_OPERATION;
-    // handle.Init.ProtocolException = ENABLE;  // We should
-    // probably have this
+    // Send the pending buffer with the lowest ID first, as the bus would.
+    handle.Init.TxFifoQueueMode = FDCAN_TX_QUEUE_OPERATION;
+    handle.Init.ProtocolException = ENABLE;
     handle.Init.AutoRetransmission = DISABLE;
 }
 
@@ -565,7 +1098,7 @@ HAL_StatusTypeDef fdcan_driver::clock_enable() const {
         __HAL_RCC_GPIOD_CLK_ENABLE();
         return HAL_OK;
     } else if (gpio.port == GPIOB) {
-        __HAL_RCC_GPIOD_CLK_ENABLE();
+        __HAL_RCC_GPIOB_CLK_ENABLE();
         return HAL_OK;
     } else {
         return HAL_ERROR;
@@ -590,43 +1123,35 @@ HAL_StatusTypeDef fdcan_driver::init(baud_rate rate, bool extended) {
     // Hardcoded prescaler from: http://www.bittiming.can-wiki.info/
     // See @ref baud_ref documentation for more information.
     handle.Init.NominalPrescaler = static_cast<uint32_t>(rate);
+    clock.set_rate(rate);
+    stats.set_rate(rate);
     handle.Init.DataPrescaler = static_cast<uint32_t>(rate);
 
-    // Currently useless check but will be used when FDCAN2 & 3 are
-    // added
-    if (handle.Instance == FDCAN1) {
-        // Enable CAN1 clock.
+    const instance_map map = map_instance(handle.Instance);
+    if (!map.valid) {
+        // The L5 only has FDCAN1.
+        return HAL_ERROR;
+    }
 
-        // Enable the GPIO Clock for the gpio pins
-        HAL_StatusTypeDef clock_status = clock_enable();
-        if (clock_status != HAL_OK) {
-            return clock_status;
-        }
+    // Enable the GPIO Clock for the gpio pins
+    HAL_StatusTypeDef clock_status = clock_enable();
+    if (clock_status != HAL_OK) {
+        return clock_status;
+    }
 
-        // alternate function configuration
-        const uint8_t af = GPIO_AF9_FDCAN1;
-
-        GPIO_InitStruct.Pin = gpio.rx_pin | gpio.tx_pin;
-        GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
-        GPIO_InitStruct.Pull = GPIO_NOPULL;
-        GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
-        GPIO_InitStruct.Alternate = af;
-
-        // Initialize the GPIO pins for CAN1.
-        HAL_GPIO_Init(gpio.port, &GPIO_InitStruct);
-        if (config_isr) {
-            // Set and enable the interupts
-            HAL_NVIC_SetPriority(FDCAN1_IT0_IRQn, 1, 0);
-            HAL_NVIC_EnableIRQ(FDCAN1_IT0_IRQn);
-            HAL_NVIC_SetPriority(FDCAN1_IT1_IRQn, 1, 0);
-            HAL_NVIC_EnableIRQ(FDCAN1_IT1_IRQn);
-        }
-    } else {
-        // Return ERROR for invalid can peripherals. (FDCAN3 is not
-        // supported.)
-        return HAL_ERROR;
+    GPIO_InitStruct.Pin = gpio.rx_pin | gpio.tx_pin;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+    GPIO_InitStruct.Alternate = map.af;
+    HAL_GPIO_Init(gpio.port, &GPIO_InitStruct);
+
+    if (config_isr) {
+        // Set and enable the interupts
+        irq::enable(map.line0, irq::tier::DRIVER);
+        irq::enable(map.line1, irq::tier::DRIVER);
     }
-    return HAL_FDCAN_Init(&handle);
+    return init_peripheral();
 }
 
 /**
@@ -644,6 +1169,22 @@ HAL_StatusTypeDef fdcan_driver::start() {
     HAL_FDCAN_ConfigGlobalFilter(&handle, FDCAN_REJECT, FDCAN_REJECT,
                                  FDCAN_REJECT_REMOTE, FDCAN_REJECT_REMOTE);
 
+    // Count RX timestamps in nominal bit times; rx_clock maps them onto
+    // micros(). With bit rate switching the internal counter also counts
+    // the faster data phase bits, so it has no fixed period and the 1 MHz
+    // TIM3 started by init_peripheral() is captured instead.
+    HAL_FDCAN_ConfigTimestampCounter(&handle, FDCAN_TIMESTAMP_PRESC_1);
+    HAL_FDCAN_EnableTimestampCounter(&handle, fd_enabled
+                                                  ? FDCAN_TIMESTAMP_EXTERNAL
+                                                  : FDCAN_TIMESTAMP_INTERNAL);
+
+    if (split_fifos && route_urgent_fifo() != HAL_OK) {
+        return HAL_ERROR;
+    }
+    if (enable_error_it() != HAL_OK) {
+        return HAL_ERROR;
+    }
+
     if (handle.Instance == FDCAN1) {
         // Configure the interupts. This is done even if config ISR
         // is false bc it doesn't matter Configure interupt vector 0
@@ -685,111 +1226,13 @@ HAL_StatusTypeDef fdcan_driver::stop() {
 }
 
 /**
- * @brief Build FDCAN filter with the filter index and the IDs to
- * filter.
- *
- * @param filter_index
- * @param id1
- * @param id2
- * @return constexpr FDCAN_FilterTypeDef
- */
-FDCAN_FilterTypeDef make_filter_from_ids(std::size_t filter_index, uint32_t id1,
-                                         uint32_t id2,
-                                         bool is_extended = false) {
-    if (is_extended) {
-        return {.IdType = FDCAN_EXTENDED_ID,      // Filter Standard ID's
-                .FilterIndex = filter_index,      // Only filter so put this
-                                                  // in the first bank
-                .FilterType = FDCAN_FILTER_DUAL,  // Make it a dual
-                                                  // discrete ID type
-                // TODO: in the future we will want to explicitly
-                // provide the FIFO
-                .FilterConfig = FDCAN_FILTER_TO_RXFIFO0,  // Put this in FIFO0
-                .FilterID1 = id1,
-                .FilterID2 = id2};
-    } else {
-        return {.IdType = FDCAN_STANDARD_ID,      // Filter Standard ID's
-                .FilterIndex = filter_index,      // Only filter so put this
-                                                  // in the first bank
-                .FilterType = FDCAN_FILTER_DUAL,  // Make it a dual
-                                                  // discrete ID type
-                // TODO: in the future we will want to explicitly
-                // provide the FIFO
-                .FilterConfig = FDCAN_FILTER_TO_RXFIFO0,  // Put this in FIFO0
-                .FilterID1 = id1,
-                .FilterID2 = id2};
-    }
-}
-
-/**
- * @brief Setup filters for the provided list of IDs.
- *
- * @param rx_ids
- * @param length
- * @return HAL_StatusTypeDef
- */
-HAL_StatusTypeDef fdcan_driver::filter_list(const uint32_t* rx_ids,
-                                            std::size_t length,
-                                            bool is_extended) {
-    if (length == 0) {
-        // return because you didin't input a value
-        return HAL_StatusTypeDef::HAL_OK;
-    } else if (is_extended) {
-        if (length > handle.Init.ExtFiltersNbr * id_filter_bank_cnt) {
-            // If too many inputs just filter all the ID's
-            return filter_all();
-        }
-    } else {
-        if (length > handle.Init.StdFiltersNbr * id_filter_bank_cnt) {
-            // If too many inputs just filter all the ID's
-            return filter_all();
-        }
-    }
-
-    FDCAN_FilterTypeDef filter;
-
-    std::size_t filter_index = 0;
-    std::size_t can_id_filter_index = 0;
-    while (can_id_filter_index < length) {
-        if (can_id_filter_index <= length - 2) {
-            filter = make_filter_from_ids(
-                filter_index, rx_ids[can_id_filter_index],
-                rx_ids[can_id_filter_index + 1], is_extended);
-            can_id_filter_index += 2;
-        } else {
-            // After this you are done since it's the last ID by
-            // definition of entering this branch
-            filter =
-                make_filter_from_ids(filter_index, rx_ids[can_id_filter_index],
-                                     rx_ids[can_id_filter_index], is_extended);
-            can_id_filter_index += 1;
-        }
-
-        // Apply the filter
-        HAL_StatusTypeDef filter_status =
-            HAL_FDCAN_ConfigFilter(&handle, &filter);
-        if (filter_status == HAL_StatusTypeDef::HAL_OK) {
-            // If succesful, increment to the next filter
-            filter_index += 1;
-        } else {
-            // Return an error if it occurs
-            return filter_status;
-        }
-    }
-    // Reached the end of the ID's without an error so return true
-    return HAL_OK;
-}
-
-/**
- * @brief Apply a filter to the CAN peripheral that accepts all
- * STANDARD ID packets. NOT currently set up for extended ID's
- *  TODO: Set up for extended ID's
+ * @brief Apply filters to the CAN peripheral that accept all standard and
+ * extended ID packets.
  *
  * @return HAL_StatusTypeDef HAL return status for configuration.
  */
 HAL_StatusTypeDef fdcan_driver::filter_all() {
     // A filter that accepts all packets.
-    // TODO: Update to work for extended ID's
     FDCAN_FilterTypeDef filterStd = {
         .IdType = FDCAN_STANDARD_ID,  // Filter Standard ID's
         .FilterIndex = 0,  // Only filter so put this in the first bank
@@ -851,12 +1294,12 @@ status fdcan_driver::send(const packet& send_packet) {
     // Attempt to add the message into a transmit mailbox.
     // TODO: Double check inputs to this to make sure structs line
     // up
-    // TODO: We should not be using const_cast like this.
-    HAL_StatusTypeDef send_status = HAL_FDCAN_AddMessageToTxFifoQ(
-        &handle, &header, const_cast<uint8_t*>(send_packet.get_data()));
+    HAL_StatusTypeDef send_status =
+        add_to_tx_queue(header, send_packet.get_data());
 
     // Check the response.
     if (send_status == HAL_OK) {
+        stats.record_tx(send_packet);
         return status::OK;
     }
 
@@ -890,6 +1333,8 @@ status fdcan_driver::receive(packet& received_packet, const fifo fifo) {
             return status::ERROR;
     }
 
+    check_overrun(handle, fifo, stats);
+
     // Check if packets are available to read.
     const uint32_t fill_level = HAL_FDCAN_GetRxFifoFillLevel(&handle, RxFifo);
 
@@ -900,7 +1345,8 @@ status fdcan_driver::receive(packet& received_packet, const fifo fifo) {
 
     // Prepare a header and data structure to load a packet into.
     FDCAN_RxHeaderTypeDef header = {0};
-    uint8_t data[8] = {0};
+    // Sized for FD frames; packet keeps the first 8 bytes.
+    uint8_t data[FD_MAX_SIZE] = {0};
 
     // Read a packet into the prepared data structures.
     HAL_StatusTypeDef receive_status =
@@ -912,10 +1358,37 @@ status fdcan_driver::receive(packet& received_packet, const fifo fifo) {
     }
     // Update the received packet to the freshly read packet.
     received_packet = packet(header, data);
+    sync_clock(handle, clock);
+    received_packet.set_timestamp(clock.to_us(header.RxTimestamp));
+    stats.record_rx(received_packet);
 
     return status::OK;
 }
 
+/**
+ * @brief Drain up to packets.size() frames from a receive FIFO.
+ *
+ * Reads the RX elements straight from message RAM instead of going through
+ * HAL_FDCAN_GetRxMessage(), so all frames pending in the FIFO are taken in
+ * one call. CAN FD frames are skipped and counted in get_fd_dropped(); read
+ * those with receive(fd_packet&).
+ *
+ * @param packets Destination for the frames, filled from the front.
+ * @param fifo The FIFO to read from.
+ * @return std::size_t Number of frames written to packets.
+ */
+std::size_t fdcan_driver::receive_burst(std::span<packet> packets,
+                                        const fifo fifo) {
+    return drain_rx_fifo(handle, clock, stats, fd_dropped, fifo, packets);
+}
+
+/**
+ * @brief Number of CAN FD frames receive_burst() skipped.
+ */
+uint32_t fdcan_driver::get_fd_dropped() const {
+    return fd_dropped;
+}
+
 /**
  * @brief Get a reference to the CAN HAL handle.
  *
@@ -15,9 +15,15 @@
 #include "hal.h"
 #if defined(STM32G4) || defined(STM32L5) || defined(STM32G0)
 
+#include <array>
+
 #include "baud_rate.h"
+#include "data_rate.h"
 #include "can_driver_base.h"
+#include "can_fd_packet.h"
 #include "can_packet.h"
+#include "can_rx_clock.h"
+#include "filter_compiler.h"
 namespace umnsvp {
 namespace can {
 
@@ -31,7 +37,7 @@ struct fdcan_gpio {
     GPIO_TypeDef* const port;
 };
 
-class fdcan_driver : public can_driver_base {
+class fdcan_driver final : public can_driver_base {
    private:
     FDCAN_HandleTypeDef handle;
 
@@ -39,7 +45,45 @@ class fdcan_driver : public can_driver_base {
 
     bool config_isr;
 
+    /**
+     * @brief Converts the timestamp counter RX timestamps to micros().
+     */
+    rx_clock clock;
+
     HAL_StatusTypeDef clock_enable() const;
+    HAL_StatusTypeDef init_peripheral();
+
+    /**
+     * @brief Set by filter_priority_list(); start() then routes the FIFO1
+     * interrupt for urgent IDs to its own line.
+     */
+    bool split_fifos = false;
+
+    HAL_StatusTypeDef apply_filters(const filter::program& program,
+                                    uint32_t filter_config, uint32_t& index);
+    HAL_StatusTypeDef route_urgent_fifo();
+    void record_fd(const fd_packet& frame, bool transmitted);
+    HAL_StatusTypeDef add_to_tx_queue(FDCAN_TxHeaderTypeDef& header,
+                                      const uint8_t* data);
+    HAL_StatusTypeDef enable_error_it();
+
+    /**
+     * @brief Data phase timing, used once set_data_rate() enables CAN FD.
+     */
+    bool fd_enabled = false;
+    data_timing fd_timing = {};
+
+    /**
+     * @brief CAN FD frames receive_burst() skipped, as they do not fit a
+     * classic packet.
+     */
+    uint32_t fd_dropped = 0;
+
+    /**
+     * @brief ID of the frame last put in each TX buffer, with bit 31 set
+     * for extended IDs, so a second frame with a pending ID is held back.
+     */
+    std::array<uint32_t, 3> tx_keys = {};
 
     /**
      * Number of filter banks a single FIFO can use.
@@ -93,18 +137,36 @@ class fdcan_driver : public can_driver_base {
     virtual HAL_StatusTypeDef filter_all() override;
     virtual HAL_StatusTypeDef filter_list(const uint32_t*, std::size_t length,
                                           bool is_extended = false) override;
+    virtual HAL_StatusTypeDef filter_priority_list(
+        const uint32_t* urgent_ids, std::size_t urgent_length,
+        const uint32_t* bulk_ids, std::size_t bulk_length,
+        bool is_extended = false) override;
 
     virtual status send(const packet& send_packet) override;
     virtual status receive(packet& received_packet,
                            const fifo fifo = fifo::FIFO0) override;
+    virtual std::size_t receive_burst(std::span<packet> packets,
+                                      const fifo fifo = fifo::FIFO0) override;
+
+    virtual error_state get_error_state() override;
+    virtual void handle_error() override;
 
     virtual void enable_tx_it() override;
     virtual void disable_tx_it() override;
+    virtual bool tx_idle() override;
+
+    void set_data_rate(data_rate rate);
+    status send(const fd_packet& send_packet);
+    status receive(fd_packet& received_packet, const fifo fifo = fifo::FIFO0);
+
+    uint32_t get_fd_dropped() const;
 
     FDCAN_HandleTypeDef* get_handle();
     HAL_StatusTypeDef set_filter(const FDCAN_FilterTypeDef& filter);
 };
 
+static_assert(can_driver<fdcan_driver>);
+
 }  // namespace can
 }  // namespace umnsvp
 
@@ -0,0 +1,371 @@
+/**
+ * @file filter_compiler.h
+ * @brief Compile an RX ID set into a small set of acceptance filter rules.
+ *
+ * The drivers used to program one exact ID per filter slot and gave up
+ * (accept everything) once the list did not fit. The compiler instead trades
+ * exactness for space only as far as the filter budget forces it to:
+ *
+ * - compile_ranges() is for FDCAN, which has list and range elements. It
+ *   splits the sorted IDs at the largest gaps; each piece becomes a range,
+ *   or one or two list entries when that is exact. Cutting at the k - 1
+ *   largest gaps is the fewest false accepts possible with k pieces, and
+ *   every k is tried.
+ * - compile_masks() is for bxCAN, which has list and mask banks. It starts
+ *   from exact list entries and greedily merges the pair whose shared-bit
+ *   mask adds the fewest accepted IDs until the entries fit the banks.
+ *
+ * Every result is checked with covers(), so a program is never applied if it
+ * would drop one of the requested IDs. If the IDs cannot be compiled (more
+ * than max_ids of them) ok is false and the driver accepts everything, which
+ * is what it did before.
+ *
+ * Everything is constexpr, so a board with a constexpr ID table can compile
+ * and check its filters at build time:
+ *
+ *   constexpr auto rules = can::filter::compile_ranges(ids.data(),
+ *                                                      ids.size(), 14);
+ *   static_assert(rules.ok && can::filter::covers(rules, ids.data(),
+ *                                                 ids.size()));
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+namespace umnsvp {
+namespace can {
+namespace filter {
+
+/// Largest ID set the compiler takes. Sized for the init stack.
+constexpr std::size_t max_ids = 64;
+
+constexpr uint32_t standard_id_mask = 0x7FF;
+constexpr uint32_t extended_id_mask = 0x1FFFFFFF;
+
+enum class kind : uint8_t
+{
+    /**
+     * @brief Accept exactly id.
+     */
+    LIST,
+    /**
+     * @brief Accept every ID equal to id on the bits set in arg.
+     */
+    MASK,
+    /**
+     * @brief Accept every ID from id to arg inclusive.
+     */
+    RANGE,
+};
+
+struct rule {
+    kind type = kind::LIST;
+    uint32_t id = 0;
+    uint32_t arg = 0;
+};
+
+/**
+ * @brief A compiled filter program.
+ */
+struct program {
+    std::array<rule, max_ids> rules = {};
+    std::size_t count = 0;
+    /// Upper bound on the number of accepted IDs not in the input set.
+    uint32_t false_accepts = 0;
+    /// Hardware slots (FDCAN elements or bxCAN banks) the program uses.
+    std::size_t slots = 0;
+    bool extended = false;
+    bool ok = false;
+};
+
+constexpr bool accepts(const rule& r, uint32_t id) {
+    switch (r.type) {
+        case kind::LIST:
+            return id == r.id;
+        case kind::MASK:
+            return (id & r.arg) == (r.id & r.arg);
+        case kind::RANGE:
+        default:
+            return r.id <= id && id <= r.arg;
+    }
+}
+
+/**
+ * @brief Check that a program accepts every ID in the set.
+ */
+constexpr bool covers(const program& p, const uint32_t* ids,
+                      std::size_t length) {
+    for (std::size_t i = 0; i < length; i++) {
+        bool accepted = false;
+        for (std::size_t r = 0; r < p.count && !accepted; r++) {
+            accepted = accepts(p.rules[r], ids[i]);
+        }
+        if (!accepted) {
+            return false;
+        }
+    }
+    return true;
+}
+
+namespace detail {
+
+/**
+ * @brief Copy, mask, sort and deduplicate the IDs.
+ *
+ * @return std::size_t Number of unique IDs, or 0 if there are too many.
+ */
+constexpr std::size_t prepare(const uint32_t* ids, std::size_t length,
+                              bool extended,
+                              std::array<uint32_t, max_ids>& sorted) {
+    if (length > max_ids) {
+        return 0;
+    }
+    const uint32_t id_mask = extended ? extended_id_mask : standard_id_mask;
+    for (std::size_t i = 0; i < length; i++) {
+        sorted[i] = ids[i] & id_mask;
+    }
+    std::sort(sorted.begin(), sorted.begin() + length);
+    return static_cast<std::size_t>(
+        std::unique(sorted.begin(), sorted.begin() + length) -
+        sorted.begin());
+}
+
+constexpr std::size_t div_up(std::size_t value, std::size_t divisor) {
+    return (value + divisor - 1) / divisor;
+}
+
+}  // namespace detail
+
+/**
+ * @brief Compile IDs into list and range rules for FDCAN.
+ *
+ * Cost model: a range takes one filter element, list entries take one
+ * element per two IDs (dual ID filters).
+ *
+ * @param ids RX IDs, in any order, duplicates allowed.
+ * @param length Number of IDs.
+ * @param elements Filter elements available.
+ * @param extended True for 29-bit IDs.
+ * @return program The rules, with ok false if they do not fit.
+ */
+constexpr program compile_ranges(const uint32_t* ids, std::size_t length,
+                                 std::size_t elements, bool extended = false) {
+    program best;
+    best.extended = extended;
+    if (length == 0) {
+        best.ok = true;
+        return best;
+    }
+
+    std::array<uint32_t, max_ids> sorted = {};
+    const std::size_t n = detail::prepare(ids, length, extended, sorted);
+    if (n == 0 || elements == 0) {
+        return best;
+    }
+
+    // Gap indices, largest gap first. Gap i sits between sorted[i] and
+    // sorted[i + 1].
+    std::array<std::size_t, max_ids> order = {};
+    for (std::size_t i = 0; i + 1 < n; i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.begin() + (n - 1),
+              [&sorted](std::size_t a, std::size_t b) {
+                  const uint32_t gap_a = sorted[a + 1] - sorted[a];
+                  const uint32_t gap_b = sorted[b + 1] - sorted[b];
+                  return gap_a != gap_b ? gap_a > gap_b : a < b;
+              });
+
+    for (std::size_t pieces = 1; pieces <= n; pieces++) {
+        std::array<bool, max_ids> cut = {};
+        for (std::size_t i = 0; i + 1 < pieces; i++) {
+            cut[order[i]] = true;
+        }
+
+        program candidate;
+        candidate.extended = extended;
+        std::size_t ranges = 0;
+        std::size_t listed = 0;
+        std::size_t start = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            if (i + 1 < n && !cut[i]) {
+                continue;
+            }
+            // sorted[start..i] is one piece.
+            const std::size_t points = i - start + 1;
+            if (points <= 2) {
+                for (std::size_t j = start; j <= i; j++) {
+                    candidate.rules[candidate.count++] = {kind::LIST,
+                                                          sorted[j], 0};
+                    listed++;
+                }
+            } else {
+                candidate.rules[candidate.count++] = {kind::RANGE,
+                                                      sorted[start],
+                                                      sorted[i]};
+                candidate.false_accepts +=
+                    sorted[i] - sorted[start] + 1 - points;
+                ranges++;
+            }
+            start = i + 1;
+        }
+        candidate.slots = ranges + detail::div_up(listed, 2);
+        candidate.ok = candidate.slots <= elements;
+
+        if (candidate.ok &&
+            (!best.ok || candidate.false_accepts < best.false_accepts ||
+             (candidate.false_accepts == best.false_accepts &&
+              candidate.slots < best.slots))) {
+            best = candidate;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Compile IDs into list and mask rules for bxCAN.
+ *
+ * Cost model, per filter bank: 16-bit scale holds four standard list IDs or
+ * two standard masks; 32-bit scale holds two extended list IDs or one
+ * extended mask. List and mask entries use separate banks.
+ *
+ * @param ids RX IDs, in any order, duplicates allowed.
+ * @param length Number of IDs.
+ * @param banks Filter banks available.
+ * @param extended True for 29-bit IDs.
+ * @return program The rules, with ok false if they do not fit.
+ */
+constexpr program compile_masks(const uint32_t* ids, std::size_t length,
+                                std::size_t banks, bool extended = false) {
+    program result;
+    result.extended = extended;
+    if (length == 0) {
+        result.ok = true;
+        return result;
+    }
+
+    std::array<uint32_t, max_ids> sorted = {};
+    const std::size_t n = detail::prepare(ids, length, extended, sorted);
+    if (n == 0 || banks == 0) {
+        return result;
+    }
+
+    const uint32_t full = extended ? extended_id_mask : standard_id_mask;
+    const std::size_t lists_per_bank = extended ? 2 : 4;
+    const std::size_t masks_per_bank = extended ? 1 : 2;
+
+    struct entry {
+        uint32_t id;
+        uint32_t mask;
+        uint32_t covered;
+    };
+    std::array<entry, max_ids> entries = {};
+    std::size_t count = n;
+    for (std::size_t i = 0; i < n; i++) {
+        entries[i] = {sorted[i], full, 1};
+    }
+
+    const auto cube_size = [full](uint32_t mask) -> uint32_t {
+        return 1U << std::popcount(full & ~mask);
+    };
+    const auto bank_cost = [&]() {
+        std::size_t lists = 0;
+        for (std::size_t i = 0; i < count; i++) {
+            lists += entries[i].mask == full ? 1 : 0;
+        }
+        return detail::div_up(lists, lists_per_bank) +
+               detail::div_up(count - lists, masks_per_bank);
+    };
+
+    while (bank_cost() > banks && count > 1) {
+        // Pick the merge that adds the fewest accepted IDs.
+        std::size_t best_a = 0;
+        std::size_t best_b = 1;
+        uint32_t best_added = UINT32_MAX;
+        for (std::size_t a = 0; a < count; a++) {
+            for (std::size_t b = a + 1; b < count; b++) {
+                const uint32_t mask = entries[a].mask & entries[b].mask &
+                                      ~(entries[a].id ^ entries[b].id) & full;
+                // Cubes may overlap, so the covered counts can add up to
+                // more than the merged cube holds.
+                const uint32_t size = cube_size(mask);
+                const uint32_t covered =
+                    entries[a].covered + entries[b].covered;
+                const uint32_t added = size > covered ? size - covered : 0;
+                if (added < best_added) {
+                    best_added = added;
+                    best_a = a;
+                    best_b = b;
+                }
+            }
+        }
+
+        entry merged;
+        merged.mask = entries[best_a].mask & entries[best_b].mask &
+                      ~(entries[best_a].id ^ entries[best_b].id) & full;
+        merged.id = entries[best_a].id & merged.mask;
+        merged.covered = 0;
+        for (std::size_t i = 0; i < n; i++) {
+            merged.covered += (sorted[i] & merged.mask) == merged.id ? 1 : 0;
+        }
+
+        // Drop every entry the merged one now contains, then add it.
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < count; i++) {
+            const entry& e = entries[i];
+            const bool inside = (e.mask & merged.mask) == merged.mask &&
+                                (e.id & merged.mask) == merged.id;
+            if (!inside) {
+                entries[kept++] = e;
+            }
+        }
+        entries[kept++] = merged;
+        count = kept;
+    }
+
+    for (std::size_t i = 0; i < count; i++) {
+        const entry& e = entries[i];
+        if (e.mask == full) {
+            result.rules[result.count++] = {kind::LIST, e.id, 0};
+        } else {
+            result.rules[result.count++] = {kind::MASK, e.id, e.mask};
+            result.false_accepts += cube_size(e.mask) - e.covered;
+        }
+    }
+    result.slots = bank_cost();
+    result.ok = result.slots <= banks;
+    return result;
+}
+
+namespace detail {
+
+constexpr std::array<uint32_t, 9> sample_ids = {0x100, 0x101, 0x102, 0x103,
+                                                0x104, 0x200, 0x210, 0x300,
+                                                0x7FF};
+
+}  // namespace detail
+
+static_assert(compile_ranges(detail::sample_ids.data(),
+                             detail::sample_ids.size(), 3)
+                  .ok);
+static_assert(covers(compile_ranges(detail::sample_ids.data(),
+                                    detail::sample_ids.size(), 3),
+                     detail::sample_ids.data(), detail::sample_ids.size()));
+static_assert(compile_ranges(detail::sample_ids.data(),
+                             detail::sample_ids.size(), 4)
+                  .false_accepts == 0);
+static_assert(covers(compile_masks(detail::sample_ids.data(),
+                                   detail::sample_ids.size(), 2),
+                     detail::sample_ids.data(), detail::sample_ids.size()));
+static_assert(compile_masks(detail::sample_ids.data(),
+                            detail::sample_ids.size(), 1)
+                  .slots <= 1);
+
+}  // namespace filter
+}  // namespace can
+}  // namespace umnsvp
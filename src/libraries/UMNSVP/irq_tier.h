@@ -0,0 +1,128 @@
+/**
+ * @file irq_tier.h
+ * @brief Interrupt priority tiers shared by every board.
+ *
+ * All NVIC pre-emption priorities come from this table instead of being
+ * picked per driver. Work is split into five tiers, highest first:
+ *
+ * - CONTROL: hard real-time control loops (PWM synchronous ADC, current
+ *   loops). Nothing else may pre-empt them or mask them for long.
+ * - DRIVER: peripheral top halves (CAN, timers, DMA). These only move data
+ *   between hardware and buffers and post anything longer as deferred work.
+ * - BULK: top halves for traffic that may wait behind DRIVER, such as the
+ *   bulk CAN RX FIFO once urgent IDs are routed to the other FIFO. Cores
+ *   with fewer than 3 priority bits (Cortex-M0+) have no level to spare for
+ *   it, so there BULK shares DRIVER's level and no longer pre-empts it.
+ * - DEFERRED: bottom halves, run from PendSV. See deferred_work.h.
+ * - BACKGROUND: thread mode, i.e. the main loop. Not an NVIC priority; the
+ *   value is one past the lowest level so it compares below every exception.
+ *
+ * The numbers are macros so the CubeMX generated C sources can use them as
+ * well. Lower numbers pre-empt higher ones. Sub-priorities are not used: the
+ * HAL sets NVIC_PRIORITYGROUP_4, so all priority bits are pre-emption bits.
+ *
+ * Boards running FreeRTOS must not use the DEFERRED tier; the kernel owns
+ * PendSV there.
+ */
+#pragma once
+
+#include "hal.h"
+
+#define UMNSVP_IRQ_PRIORITY_CONTROL 0U
+#define UMNSVP_IRQ_PRIORITY_DRIVER 1U
+#if __NVIC_PRIO_BITS < 3
+#define UMNSVP_IRQ_PRIORITY_BULK UMNSVP_IRQ_PRIORITY_DRIVER
+#else
+#define UMNSVP_IRQ_PRIORITY_BULK (UMNSVP_IRQ_PRIORITY_DRIVER + 1U)
+#endif
+// One above the lowest level, which is left to SysTick (TICK_INT_PRIORITY)
+// so the HAL tick never pre-empts deferred work halfway through.
+#define UMNSVP_IRQ_PRIORITY_DEFERRED ((1U << __NVIC_PRIO_BITS) - 2U)
+#define UMNSVP_IRQ_PRIORITY_BACKGROUND (1U << __NVIC_PRIO_BITS)
+
+#ifdef __cplusplus
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace umnsvp {
+namespace irq {
+
+enum class tier : uint8_t { CONTROL, DRIVER, BULK, DEFERRED, BACKGROUND };
+
+struct tier_info {
+    tier level;
+    uint32_t priority;
+};
+
+/**
+ * @brief The tier table, ordered from highest to lowest priority.
+ */
+constexpr std::array<tier_info, 5> tiers = {{
+    {tier::CONTROL, UMNSVP_IRQ_PRIORITY_CONTROL},
+    {tier::DRIVER, UMNSVP_IRQ_PRIORITY_DRIVER},
+    {tier::BULK, UMNSVP_IRQ_PRIORITY_BULK},
+    {tier::DEFERRED, UMNSVP_IRQ_PRIORITY_DEFERRED},
+    {tier::BACKGROUND, UMNSVP_IRQ_PRIORITY_BACKGROUND},
+}};
+
+/**
+ * @brief NVIC pre-emption priority of a tier.
+ */
+constexpr uint32_t priority_of(tier level) {
+    return tiers[static_cast<std::size_t>(level)].priority;
+}
+
+/**
+ * @brief Whether BULK is folded into DRIVER's level on this core.
+ */
+constexpr bool bulk_shares_driver =
+    UMNSVP_IRQ_PRIORITY_BULK == UMNSVP_IRQ_PRIORITY_DRIVER;
+
+namespace detail {
+
+constexpr bool table_is_ordered() {
+    for (std::size_t i = 0; i < tiers.size(); i++) {
+        if (static_cast<std::size_t>(tiers[i].level) != i) {
+            return false;
+        }
+        if (i == 0) {
+            continue;
+        }
+        const bool may_share =
+            tiers[i].level == tier::BULK && bulk_shares_driver;
+        if (may_share ? tiers[i].priority < tiers[i - 1].priority
+                      : tiers[i].priority <= tiers[i - 1].priority) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace detail
+
+static_assert(detail::table_is_ordered(),
+              "irq tiers must be listed in order with strictly decreasing "
+              "priority, save BULK sharing DRIVER's level");
+static_assert(priority_of(tier::DEFERRED) < (1U << __NVIC_PRIO_BITS) - 1U,
+              "the deferred tier must sit above the SysTick level");
+static_assert(priority_of(tier::BACKGROUND) == (1U << __NVIC_PRIO_BITS),
+              "background is thread mode, below every NVIC level");
+
+/**
+ * @brief Set an interrupt to the priority of a tier and enable it.
+ *
+ * @param irqn Interrupt to configure.
+ * @param level Tier it runs in. BACKGROUND and DEFERRED are not valid for
+ * peripheral interrupts; DEFERRED belongs to PendSV alone.
+ */
+inline void enable(IRQn_Type irqn, tier level) {
+    HAL_NVIC_SetPriority(irqn, priority_of(level), 0);
+    HAL_NVIC_EnableIRQ(irqn);
+}
+
+}  // namespace irq
+}  // namespace umnsvp
+
+#endif  // __cplusplus
@@ -0,0 +1,447 @@
+/**
+ * @file isotp.cc
+ * @brief ISO-TP (ISO 15765-2) transport for messages larger than one frame.
+ */
+
+#include "isotp.h"
+
+#include <cstring>
+
+#include "critical_section.h"
+
+namespace umnsvp {
+namespace can {
+namespace isotp {
+namespace {
+
+/**
+ * @brief Protocol control information, the high nibble of the first byte.
+ *
+ * @{
+ */
+constexpr uint8_t pci_single = 0x00;
+constexpr uint8_t pci_first = 0x10;
+constexpr uint8_t pci_consecutive = 0x20;
+constexpr uint8_t pci_flow_control = 0x30;
+constexpr uint8_t pci_mask = 0xF0;
+/**
+ * @}
+ */
+
+/**
+ * @brief Flow status of a flow control frame.
+ *
+ * @{
+ */
+constexpr uint8_t fc_continue = 0;
+constexpr uint8_t fc_wait = 1;
+constexpr uint8_t fc_overflow = 2;
+/**
+ * @}
+ */
+
+/// Payload bytes in a single, first and consecutive frame.
+constexpr std::size_t single_payload = MAX_SIZE - 1;
+constexpr std::size_t first_payload = MAX_SIZE - 2;
+constexpr std::size_t consecutive_payload = MAX_SIZE - 1;
+
+/**
+ * @brief Whether a HAL tick deadline has passed, across tick wraparound.
+ */
+constexpr bool reached(uint32_t now_ms, uint32_t deadline_ms) {
+    return static_cast<int32_t>(now_ms - deadline_ms) >= 0;
+}
+
+/**
+ * @brief Decode the STmin byte of a flow control frame into ms.
+ *
+ * 0xF1-0xF9 (100-900 us) round up to 1 ms, which frame_sent() turns into a
+ * wait of one to two ticks. Reserved values mean the
+ * maximum, 127 ms, as the standard requires.
+ */
+constexpr uint8_t decode_st_min(uint8_t st_min) {
+    if (st_min <= 0x7F) {
+        return st_min;
+    }
+    if (st_min >= 0xF1 && st_min <= 0xF9) {
+        return 1;
+    }
+    return 0x7F;
+}
+
+}  // namespace
+
+/**
+ * @brief Construct a session.
+ *
+ * @param config IDs and flow control parameters.
+ * @param rx_buffer Buffer received messages are reassembled into. Messages
+ * longer than the buffer are refused with a flow control overflow.
+ */
+session::session(const session_config& config, std::span<uint8_t> rx_buffer)
+    : config(config), rx_buffer(rx_buffer) {
+}
+
+/**
+ * @brief Start sending a message.
+ *
+ * @param data The message, read in place while the transfer runs.
+ * @return status OK if the transfer started, FULL if one is already running,
+ * ERROR if the message is empty or too long.
+ */
+status session::send(std::span<const uint8_t> data) {
+    if (data.empty() || data.size() > max_message_size) {
+        return status::ERROR;
+    }
+    irq::critical_section lock;
+    if (tx == tx_state::FIRST || tx == tx_state::WAIT_FC ||
+        tx == tx_state::CONSECUTIVE) {
+        return status::FULL;
+    }
+    tx_data = data;
+    tx_offset = 0;
+    tx_waits = 0;
+    tx = tx_state::FIRST;
+    return status::OK;
+}
+
+/**
+ * @brief State of the last transfer started with send().
+ *
+ * @return status EMPTY if nothing was sent yet, FULL while the transfer
+ * runs, OK once it completed, ERROR if it was aborted.
+ */
+status session::tx_result() const {
+    switch (tx) {
+        case tx_state::IDLE:
+            return status::EMPTY;
+        case tx_state::DONE:
+            return status::OK;
+        case tx_state::FAILED:
+            return status::ERROR;
+        default:
+            return status::FULL;
+    }
+}
+
+/**
+ * @brief The last message received, or an empty span until one completes.
+ *
+ * New messages are refused until release() is called.
+ */
+std::span<const uint8_t> session::received() const {
+    if (rx != rx_state::COMPLETE) {
+        return {};
+    }
+    return rx_buffer.first(rx_size);
+}
+
+/**
+ * @brief Hand the receive buffer back for the next message.
+ */
+void session::release() {
+    irq::critical_section lock;
+    if (rx == rx_state::COMPLETE) {
+        rx = rx_state::IDLE;
+    }
+}
+
+/**
+ * @brief Transfers aborted in either direction since start up.
+ */
+uint32_t session::get_failures() const {
+    return failures;
+}
+
+/**
+ * @brief Take a received frame if it belongs to this session.
+ *
+ * @param frame A frame taken off the bus.
+ * @param now_ms Current HAL tick.
+ * @return true The frame was for this session.
+ */
+bool session::handle(const packet& frame, uint32_t now_ms) {
+    if (frame.get_id() != config.rx_id ||
+        frame.is_extended() != config.extended || frame.get_length() == 0) {
+        return false;
+    }
+
+    const uint8_t* data = frame.get_data();
+    const uint8_t length = frame.get_length();
+    irq::critical_section lock;
+    switch (data[0] & pci_mask) {
+        case pci_single:
+            handle_single(data, length);
+            break;
+        case pci_first:
+            handle_first(data, length, now_ms);
+            break;
+        case pci_consecutive:
+            handle_consecutive(data, length, now_ms);
+            break;
+        case pci_flow_control:
+            handle_flow_control(data, length, now_ms);
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief A whole message in one frame.
+ */
+void session::handle_single(const uint8_t* data, uint8_t length) {
+    const std::size_t size = data[0] & 0x0F;
+    if (size == 0 || size > single_payload || size > length - 1U ||
+        size > rx_buffer.size() || rx == rx_state::COMPLETE) {
+        return;
+    }
+    if (rx == rx_state::RECEIVING) {
+        // A new message replaces the one in progress.
+        failures++;
+    }
+    std::memcpy(rx_buffer.data(), data + 1, size);
+    rx_size = size;
+    rx = rx_state::COMPLETE;
+}
+
+/**
+ * @brief The start of a segmented message; answered with flow control.
+ */
+void session::handle_first(const uint8_t* data, uint8_t length,
+                           uint32_t now_ms) {
+    if (length < MAX_SIZE) {
+        return;
+    }
+    const std::size_t size = ((data[0] & 0x0FU) << 8) | data[1];
+    if (size <= single_payload) {
+        return;
+    }
+    if (size > rx_buffer.size() || rx == rx_state::COMPLETE) {
+        queue_flow_control(fc_overflow);
+        return;
+    }
+    if (rx == rx_state::RECEIVING) {
+        failures++;
+    }
+    std::memcpy(rx_buffer.data(), data + 2, first_payload);
+    rx_size = size;
+    rx_offset = first_payload;
+    rx_sequence = 1;
+    rx_block_count = 0;
+    rx_deadline_ms = now_ms + config.timeout_ms;
+    rx = rx_state::RECEIVING;
+    queue_flow_control(fc_continue);
+}
+
+/**
+ * @brief The next piece of a segmented message.
+ */
+void session::handle_consecutive(const uint8_t* data, uint8_t length,
+                                 uint32_t now_ms) {
+    if (rx != rx_state::RECEIVING) {
+        return;
+    }
+    if ((data[0] & 0x0F) != rx_sequence) {
+        // A lost or repeated frame; the message cannot be rebuilt.
+        rx = rx_state::IDLE;
+        failures++;
+        return;
+    }
+
+    std::size_t size = rx_size - rx_offset;
+    if (size > consecutive_payload) {
+        size = consecutive_payload;
+    }
+    if (size > length - 1U) {
+        rx = rx_state::IDLE;
+        failures++;
+        return;
+    }
+    std::memcpy(rx_buffer.data() + rx_offset, data + 1, size);
+    rx_offset += size;
+    rx_sequence = (rx_sequence + 1) & 0x0F;
+    rx_deadline_ms = now_ms + config.timeout_ms;
+
+    if (rx_offset == rx_size) {
+        rx = rx_state::COMPLETE;
+    } else if (config.block_size != 0 &&
+               ++rx_block_count == config.block_size) {
+        rx_block_count = 0;
+        queue_flow_control(fc_continue);
+    }
+}
+
+/**
+ * @brief The peer's answer to a first frame or a finished block.
+ */
+void session::handle_flow_control(const uint8_t* data, uint8_t length,
+                                  uint32_t now_ms) {
+    if (tx != tx_state::WAIT_FC || length < 3) {
+        return;
+    }
+    switch (data[0] & 0x0F) {
+        case fc_continue:
+            tx_block_left = data[1];
+            tx_block_limited = data[1] != 0;
+            tx_st_min_ms = decode_st_min(data[2]);
+            tx_waits = 0;
+            tx_next_ms = now_ms;
+            tx = tx_state::CONSECUTIVE;
+            break;
+        case fc_wait:
+            if (++tx_waits > max_wait_frames) {
+                tx = tx_state::FAILED;
+                failures++;
+            } else {
+                tx_deadline_ms = now_ms + config.timeout_ms;
+            }
+            break;
+        default:
+            // Overflow or an invalid flow status.
+            tx = tx_state::FAILED;
+            failures++;
+            break;
+    }
+}
+
+/**
+ * @brief Abort transfers whose peer has gone quiet.
+ *
+ * @param now_ms Current HAL tick.
+ */
+void session::poll(uint32_t now_ms) {
+    irq::critical_section lock;
+    if (tx == tx_state::WAIT_FC && reached(now_ms, tx_deadline_ms)) {
+        tx = tx_state::FAILED;
+        failures++;
+    }
+    if (rx == rx_state::RECEIVING && reached(now_ms, rx_deadline_ms)) {
+        rx = rx_state::IDLE;
+        failures++;
+    }
+}
+
+/**
+ * @brief The frame this session wants on the bus now, if any.
+ *
+ * Flow control goes first so the peer is never held up by our own
+ * transfer. The frame is only consumed by frame_sent(); until then the same
+ * frame is offered again.
+ *
+ * @param now_ms Current HAL tick.
+ * @param frame Set to the frame to send.
+ * @return true A frame is due.
+ */
+bool session::next_frame(uint32_t now_ms, packet& frame) {
+    irq::critical_section lock;
+    offered = offer::NONE;
+
+    if (fc_pending) {
+        frame = make_frame(3);
+        uint8_t* data = frame.get_data();
+        data[0] = static_cast<uint8_t>(pci_flow_control | fc_status);
+        data[1] = config.block_size;
+        data[2] = config.st_min_ms;
+        offered = offer::FLOW_CONTROL;
+        offered_fc_sequence = fc_sequence;
+        return true;
+    }
+
+    // The payload is copied once, from the caller's buffer straight into
+    // the frame.
+    if (tx == tx_state::FIRST) {
+        if (tx_data.size() <= single_payload) {
+            const std::size_t size = tx_data.size();
+            frame = make_frame(static_cast<uint8_t>(size + 1));
+            uint8_t* data = frame.get_data();
+            data[0] = pci_single | static_cast<uint8_t>(size);
+            std::memcpy(&data[1], tx_data.data(), size);
+        } else {
+            frame = make_frame(MAX_SIZE);
+            uint8_t* data = frame.get_data();
+            data[0] = pci_first | static_cast<uint8_t>(tx_data.size() >> 8);
+            data[1] = static_cast<uint8_t>(tx_data.size());
+            std::memcpy(&data[2], tx_data.data(), first_payload);
+        }
+    } else if (tx == tx_state::CONSECUTIVE && reached(now_ms, tx_next_ms)) {
+        std::size_t size = tx_data.size() - tx_offset;
+        if (size > consecutive_payload) {
+            size = consecutive_payload;
+        }
+        frame = make_frame(static_cast<uint8_t>(size + 1));
+        uint8_t* data = frame.get_data();
+        data[0] = pci_consecutive | tx_sequence;
+        std::memcpy(&data[1], tx_data.data() + tx_offset, size);
+    } else {
+        return false;
+    }
+
+    offered = offer::DATA;
+    return true;
+}
+
+/**
+ * @brief Consume the frame last returned by next_frame(); the bus took it.
+ *
+ * @param now_ms Current HAL tick.
+ */
+void session::frame_sent(uint32_t now_ms) {
+    irq::critical_section lock;
+    if (offered == offer::FLOW_CONTROL) {
+        // The lock is released between next_frame() and here; if the RX
+        // interrupt queued a newer flow control meanwhile, that one is
+        // still to be sent.
+        if (fc_sequence == offered_fc_sequence) {
+            fc_pending = false;
+        }
+    } else if (offered == offer::DATA && tx == tx_state::FIRST) {
+        if (tx_data.size() <= single_payload) {
+            tx = tx_state::DONE;
+        } else {
+            tx_offset = first_payload;
+            tx_sequence = 1;
+            tx_deadline_ms = now_ms + config.timeout_ms;
+            tx = tx_state::WAIT_FC;
+        }
+    } else if (offered == offer::DATA && tx == tx_state::CONSECUTIVE) {
+        const std::size_t left = tx_data.size() - tx_offset;
+        tx_offset += left < consecutive_payload ? left : consecutive_payload;
+        tx_sequence = (tx_sequence + 1) & 0x0F;
+        if (tx_offset == tx_data.size()) {
+            tx = tx_state::DONE;
+        } else if (tx_block_limited && --tx_block_left == 0) {
+            tx_deadline_ms = now_ms + config.timeout_ms;
+            tx = tx_state::WAIT_FC;
+        } else if (tx_st_min_ms != 0) {
+            // now_ms may be about to tick over, so wait one tick more than
+            // STmin to leave at least STmin between the frames.
+            tx_next_ms = now_ms + tx_st_min_ms + 1;
+        } else {
+            tx_next_ms = now_ms;
+        }
+    }
+    offered = offer::NONE;
+}
+
+/**
+ * @brief Queue a flow control frame with the given flow status.
+ */
+void session::queue_flow_control(uint8_t status) {
+    fc_pending = true;
+    fc_status = status;
+    fc_sequence++;
+}
+
+/**
+ * @brief An empty frame of the given length on this session's TX ID, for
+ * the caller to fill in place.
+ */
+packet session::make_frame(uint8_t length) const {
+    return packet(config.tx_id, length, default_data, config.extended);
+}
+
+}  // namespace isotp
+}  // namespace can
+}  // namespace umnsvp
@@ -0,0 +1,249 @@
+/**
+ * @file isotp.h
+ * @brief ISO-TP (ISO 15765-2) transport for messages larger than one frame.
+ */
+
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "can_driver_base.h"
+#include "can_packet.h"
+
+namespace umnsvp {
+namespace can {
+namespace isotp {
+
+/// Largest message a classic CAN ISO-TP transfer can carry.
+constexpr std::size_t max_message_size = 4095;
+
+/// Flow control WAIT frames accepted in a row before a transfer is aborted.
+constexpr uint8_t max_wait_frames = 16;
+
+/**
+ * @brief IDs and flow control parameters of one ISO-TP session.
+ */
+struct session_config {
+    /// ID of the frames this node sends.
+    uint32_t tx_id;
+    /// ID of the frames the peer sends.
+    uint32_t rx_id;
+    bool extended = false;
+    /// Consecutive frames the peer may send before waiting for another flow
+    /// control frame; 0 sends the whole message in one block.
+    uint8_t block_size = 0;
+    /// Minimum gap the peer must leave between consecutive frames, 0-127 ms.
+    uint8_t st_min_ms = 0;
+    /// How long to wait for the peer's next flow control or consecutive
+    /// frame before aborting (N_Bs and N_Cr).
+    uint16_t timeout_ms = 1000;
+};
+
+/**
+ * @brief One ISO-TP connection: a transmit and a receive transfer that can
+ * run at the same time.
+ *
+ * Received messages are reassembled into a buffer owned by the caller, so
+ * the memory use is fixed at compile time. Sent messages are read straight
+ * from the caller's buffer into each frame; the buffer must stay untouched
+ * until tx_result() is no longer FULL.
+ *
+ * The session does not talk to the bus itself. A transport feeds it the
+ * frames it receives and sends the frames it produces, which keeps it
+ * independent of the board class. Use a transport rather than calling
+ * next_frame() and frame_sent() directly.
+ *
+ * STmin values below 1 ms are rounded up to 1 ms, as the session runs off
+ * HAL ticks. The gap is measured in whole ticks and padded by one, so the
+ * peer always gets at least its STmin and at most one tick more.
+ */
+class session {
+   private:
+    enum class tx_state : uint8_t
+    {
+        IDLE,
+        FIRST,
+        WAIT_FC,
+        CONSECUTIVE,
+        DONE,
+        FAILED,
+    };
+
+    enum class rx_state : uint8_t
+    {
+        IDLE,
+        RECEIVING,
+        COMPLETE,
+    };
+
+    /// Which frame next_frame() last offered.
+    enum class offer : uint8_t
+    {
+        NONE,
+        FLOW_CONTROL,
+        DATA,
+    };
+
+    const session_config config;
+
+    std::span<const uint8_t> tx_data;
+    std::size_t tx_offset = 0;
+    tx_state tx = tx_state::IDLE;
+    uint8_t tx_sequence = 0;
+    uint8_t tx_block_left = 0;
+    bool tx_block_limited = false;
+    uint8_t tx_st_min_ms = 0;
+    uint8_t tx_waits = 0;
+    uint32_t tx_next_ms = 0;
+    uint32_t tx_deadline_ms = 0;
+
+    std::span<uint8_t> rx_buffer;
+    std::size_t rx_size = 0;
+    std::size_t rx_offset = 0;
+    rx_state rx = rx_state::IDLE;
+    uint8_t rx_sequence = 0;
+    uint8_t rx_block_count = 0;
+    uint32_t rx_deadline_ms = 0;
+
+    /// Flow status of a flow control frame waiting to be sent.
+    bool fc_pending = false;
+    uint8_t fc_status = 0;
+    /// Bumped for every flow control frame queued, so frame_sent() can tell
+    /// whether the one offered is still the one pending.
+    uint8_t fc_sequence = 0;
+    uint8_t offered_fc_sequence = 0;
+
+    offer offered = offer::NONE;
+
+    uint32_t failures = 0;
+
+    void queue_flow_control(uint8_t status);
+    void handle_flow_control(const uint8_t* data, uint8_t length,
+                             uint32_t now_ms);
+    void handle_single(const uint8_t* data, uint8_t length);
+    void handle_first(const uint8_t* data, uint8_t length, uint32_t now_ms);
+    void handle_consecutive(const uint8_t* data, uint8_t length,
+                            uint32_t now_ms);
+    packet make_frame(uint8_t length) const;
+
+   public:
+    session(const session_config& config, std::span<uint8_t> rx_buffer);
+
+    status send(std::span<const uint8_t> data);
+    status tx_result() const;
+
+    std::span<const uint8_t> received() const;
+    void release();
+    uint32_t get_failures() const;
+
+    bool handle(const packet& frame, uint32_t now_ms);
+    void poll(uint32_t now_ms);
+    bool next_frame(uint32_t now_ms, packet& frame);
+    void frame_sent(uint32_t now_ms);
+};
+
+/**
+ * @brief What a transport needs from the bus: skylab2::can_base, or any
+ * class with the same send_packet().
+ */
+template <typename T>
+concept frame_sink = requires(T& bus, const packet& frame) {
+    { bus.send_packet(frame, uint16_t{0}) } -> std::same_as<status>;
+};
+
+/**
+ * @brief Runs a set of sessions over one bus.
+ *
+ * Call receive() for every frame taken off the bus, from the RX interrupt or
+ * the main loop, and poll() from the main loop. poll() hands each session's
+ * frames to the bus until the session has to wait for STmin or flow control,
+ * or the bus refuses a frame, in which case the same frame is offered again
+ * on the next poll(). With STmin 0 a whole block is queued at once, so it
+ * leaves at the bus rate.
+ *
+ * Example Usage:
+   ........................
+   std::array<uint8_t, 512> calibration;
+   can::isotp::session calib({.tx_id = 0x7E8, .rx_id = 0x7E0,
+                              .block_size = 8},
+                             calibration);
+   can::isotp::transport<skylab2::can_base, 2> isotp(telemetry_can);
+   isotp.add(calib);
+   ........................
+   // RX interrupt, for each received packet
+   isotp.receive(packet, HAL_GetTick());
+   ........................
+   // Main loop
+   isotp.poll(HAL_GetTick());
+   if (!calib.received().empty()) {
+       apply(calib.received());
+       calib.release();
+   }
+   ........................
+ *
+ * @tparam Bus The board CAN class.
+ * @tparam capacity Maximum number of sessions.
+ */
+template <frame_sink Bus, std::size_t capacity>
+class transport {
+   private:
+    Bus& bus;
+    std::array<session*, capacity> sessions = {};
+    std::size_t count = 0;
+
+   public:
+    explicit transport(Bus& bus) : bus(bus) {
+    }
+
+    /**
+     * @brief Add a session. Sessions must outlive the transport.
+     *
+     * @return false The transport is full.
+     */
+    bool add(session& added) {
+        if (count == capacity) {
+            return false;
+        }
+        sessions[count++] = &added;
+        return true;
+    }
+
+    /**
+     * @brief Pass a received frame to the session it belongs to.
+     *
+     * @return true The frame was an ISO-TP frame of one of the sessions.
+     */
+    bool receive(const packet& frame, uint32_t now_ms) {
+        for (std::size_t i = 0; i < count; i++) {
+            if (sessions[i]->handle(frame, now_ms)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Check timeouts and send every frame that is due.
+     */
+    void poll(uint32_t now_ms) {
+        for (std::size_t i = 0; i < count; i++) {
+            session& current = *sessions[i];
+            current.poll(now_ms);
+            packet frame;
+            while (current.next_frame(now_ms, frame)) {
+                if (bus.send_packet(frame, 0) == status::ERROR) {
+                    break;
+                }
+                current.frame_sent(now_ms);
+            }
+        }
+    }
+};
+
+}  // namespace isotp
+}  // namespace can
+}  // namespace umnsvp
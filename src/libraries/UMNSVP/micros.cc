@@ -0,0 +1,37 @@
+/**
+ * @file micros.cc
+ * @brief Monotonic 32-bit microsecond clock.
+ */
+
+#include "micros.h"
+
+#include "hal.h"
+
+namespace umnsvp {
+namespace time {
+
+uint32_t micros() {
+    uint32_t ms;
+    uint32_t count;
+    bool wrapped;
+    do {
+        ms = HAL_GetTick();
+        // When called above the SysTick priority the tick interrupt cannot
+        // run, so a wrap of the down counter shows up only as a pending
+        // SysTick. Sample the flag on both sides of the counter read so the
+        // count always matches the flag.
+        wrapped = (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0;
+        count = SysTick->VAL;
+        if (!wrapped && (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0) {
+            count = SysTick->VAL;
+            wrapped = true;
+        }
+    } while (ms != HAL_GetTick());
+
+    const uint32_t reload = SysTick->LOAD;
+    const uint32_t elapsed_us = ((reload - count) * 1000U) / (reload + 1U);
+    return (ms + (wrapped ? 1U : 0U)) * 1000U + elapsed_us;
+}
+
+}  // namespace time
+}  // namespace umnsvp
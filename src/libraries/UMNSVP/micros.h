@@ -0,0 +1,23 @@
+/**
+ * @file micros.h
+ * @brief Monotonic 32-bit microsecond clock.
+ */
+#pragma once
+
+#include <stdint.h>
+
+namespace umnsvp {
+namespace time {
+
+/**
+ * @brief Microseconds since boot, wrapping every 2^32 us (about 71 minutes).
+ *
+ * Built from the HAL millisecond tick and the SysTick down counter, so it
+ * works on every core we use, including the G0 which has no cycle counter.
+ * Safe to call from any interrupt, including ones that pre-empt SysTick.
+ * Assumes the default 1 kHz HAL tick.
+ */
+uint32_t micros();
+
+}  // namespace time
+}  // namespace umnsvp
@@ -11,6 +11,7 @@
 #pragma once
 
 #include "hal.h"
+#include "irq_tier.h"
 
 #if !(STM32L476xx || STM32G474xx || STM32G473xx || STM32G0B1xx)
 #error "Timer class currently only supports L4, G0, and G4."
@@ -83,11 +84,12 @@ class timer {
    public:
     /**
      * @brief Construct a new timer::timer object
-     * Initializes priority and sub-priority to 7
+     * Runs the timer interrupt in the DRIVER tier (see irq_tier.h). Anything
+     * longer than a few register accesses should be posted as deferred work
+     * from the callback.
      *
      */
-    timer() {
-        timer(7, 7);
+    timer() : timer(irq::priority_of(irq::tier::DRIVER), 0) {
     }
 
     /**
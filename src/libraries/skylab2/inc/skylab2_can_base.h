@@ -1,8 +1,11 @@
 #include <array>
+#include <span>
 
 #include "can_driver_base.h"
 #include "can_packet.h"
-#include "circular_buffer.h"
+#include "can_tx_queue.h"
+#include "critical_section.h"
+#include "skylab2_fields.h"
 #include "skylab2_packets.h"
 #include "triple_buffer.h"
 
@@ -11,28 +14,249 @@
 namespace umnsvp {
 namespace skylab2 {
 
-class can_base {
+/**
+ * @brief Called with every packet a board class receives, from the context
+ * that received it.
+ */
+using rx_observer = void (*)(void* context, const can::packet& packet);
+
+/**
+ * @brief Board CAN class, statically bound to its driver type.
+ *
+ * With a concrete (final) driver such as can::bxcan_driver every driver call
+ * from the RX and TX interrupt paths is a direct call the compiler can
+ * inline. can_base below is the same class over can::can_driver_base for
+ * code that picks the driver at run time.
+ *
+ * @tparam Driver Any type satisfying can::can_driver.
+ */
+template <can::can_driver Driver>
+class basic_can_base {
     // The can_base class will be the base class for the can board classes and
     // will be used as a reference skylab2_boards.cc
    private:
     can::fifo fifo;
-    can::can_driver_base& can_device;
+    Driver& can_device;
+
+    // Sent lowest ID first; 75 entries of 20 bytes.
+    can::tx_queue<75> tx_queue;
+
+    struct observer_entry {
+        rx_observer observer;
+        void* context;
+    };
+    std::array<observer_entry, 4> observers = {};
+    std::size_t observer_count = 0;
 
-    umnsvp::circular_buffer::CircularBuffer<can::packet, 75> tx_buffer;
+    void observe(const can::packet& received_packet) {
+        for (std::size_t i = 0; i < observer_count; i++) {
+            observers[i].observer(observers[i].context, received_packet);
+        }
+    }
 
    protected:
-    can_base(can::can_driver_base& can_driver_ref, can::fifo fifo)
+    basic_can_base(Driver& can_driver_ref, can::fifo fifo)
         : fifo(fifo), can_device(can_driver_ref) {
     }
 
    public:
     void init(can::baud_rate baud_rate, bool extended, const uint32_t* rx_ids,
               size_t length);
-    can::status send_packet(can::packet packet);
+    void init(can::baud_rate baud_rate, bool extended,
+              const uint32_t* urgent_ids, size_t urgent_length,
+              const uint32_t* bulk_ids, size_t bulk_length);
+    can::status send_packet(can::packet packet, uint16_t max_age_ms = 0);
     can::status receive(can::packet& received_packet);
+    std::size_t receive_burst(std::span<can::packet> packets);
+    std::size_t receive_urgent_burst(std::span<can::packet> packets);
     void tx_handler();
+    bool tx_idle();
     void setup_filter(const uint32_t* rx_ids, size_t length);
+    bool add_rx_observer(rx_observer observer, void* context);
 };
 
+/**
+ * @brief Board CAN class over the virtual driver interface.
+ */
+using can_base = basic_can_base<can::can_driver_base>;
+
+/**
+ * @brief
+ *
+ * @param baud_rate
+ * @param extended
+ */
+template <can::can_driver Driver>
+void basic_can_base<Driver>::init(can::baud_rate baud_rate, bool extended,
+                                  const uint32_t* rx_ids, size_t length) {
+    can_device.init(baud_rate, extended);
+    setup_filter(rx_ids, length);
+    can_device.start();
+}
+
+/**
+ * @brief init with the RX IDs split by urgency; urgent IDs are received in
+ * FIFO1 on a higher priority interrupt, bulk IDs in FIFO0
+ *
+ * Drain FIFO1 with receive_urgent_burst() from the FIFO1 interrupt handler.
+ * See can::can_driver_base::filter_priority_list().
+ *
+ * @param baud_rate
+ * @param extended
+ * @param urgent_ids
+ * @param urgent_length
+ * @param bulk_ids
+ * @param bulk_length
+ */
+template <can::can_driver Driver>
+void basic_can_base<Driver>::init(can::baud_rate baud_rate, bool extended,
+                                  const uint32_t* urgent_ids,
+                                  size_t urgent_length,
+                                  const uint32_t* bulk_ids,
+                                  size_t bulk_length) {
+    can_device.init(baud_rate, extended);
+    can_device.filter_priority_list(urgent_ids, urgent_length, bulk_ids,
+                                    bulk_length);
+    can_device.start();
+}
+
+/**
+ * @brief send the given packet to the can device, or queue it by priority
+ * if the hardware is busy or other packets are already waiting
+ *
+ * Packets already in the queue are sent first when they outrank this one,
+ * so a queued status packet never holds back a later command.
+ *
+ * @param packet
+ * @param max_age_ms drop the packet if it is still queued this many ms from
+ * now; 0 never drops it
+ * @return can::status OK if the hardware took the packet, FULL if it was
+ * queued, ERROR if the queue was full and the packet was dropped
+ */
+template <can::can_driver Driver>
+can::status basic_can_base<Driver>::send_packet(can::packet packet,
+                                                uint16_t max_age_ms) {
+    if (tx_queue.empty() && can_device.send(packet) == can::status::OK) {
+        return can::status::OK;
+    }
+    if (!tx_queue.push(packet, HAL_GetTick(), max_age_ms)) {
+        return can::status::ERROR;
+    }
+    can_device.enable_tx_it();
+    return can::status::FULL;
+}
+
+/**
+ * @brief receive a packet from the given FIFO ;
+ * for now, only using FIFO0 to all packets
+ *
+ * @param received_packet
+ * @return can::status
+ */
+template <can::can_driver Driver>
+can::status basic_can_base<Driver>::receive(can::packet& received_packet) {
+    // default the fifo to 0
+    can::status result = can_device.receive(received_packet, fifo);
+    // TODO: FIFO needs checking
+    if (result == can::status::OK) {
+        observe(received_packet);
+    }
+    return result;
+}
+
+/**
+ * @brief Drain every pending packet from this board's FIFO in one call.
+ *
+ * @param packets Destination for the packets, filled from the front.
+ * @return std::size_t Number of packets received.
+ */
+template <can::can_driver Driver>
+std::size_t basic_can_base<Driver>::receive_burst(
+    std::span<can::packet> packets) {
+    const std::size_t count = can_device.receive_burst(packets, fifo);
+    for (std::size_t i = 0; i < count; i++) {
+        observe(packets[i]);
+    }
+    return count;
+}
+
+/**
+ * @brief Drain every pending urgent packet from FIFO1 in one call.
+ *
+ * Only meaningful after the urgent/bulk init().
+ *
+ * @param packets Destination for the packets, filled from the front.
+ * @return std::size_t Number of packets received.
+ */
+template <can::can_driver Driver>
+std::size_t basic_can_base<Driver>::receive_urgent_burst(
+    std::span<can::packet> packets) {
+    const std::size_t count =
+        can_device.receive_burst(packets, can::fifo::FIFO1);
+    for (std::size_t i = 0; i < count; i++) {
+        observe(packets[i]);
+    }
+    return count;
+}
+
+/**
+ * @brief tx_handler for the can_base class
+ *
+ */
+template <can::can_driver Driver>
+void basic_can_base<Driver>::tx_handler() {
+    // Refill the free mailbox with the highest priority waiting packet.
+    if (tx_queue.send_next(HAL_GetTick(), can_device) == can::status::EMPTY) {
+        can_device.disable_tx_it();
+    }
+}
+
+/**
+ * @brief Whether every packet passed to send_packet() has been sent: none
+ * is queued and the hardware has none left to transmit.
+ */
+template <can::can_driver Driver>
+bool basic_can_base<Driver>::tx_idle() {
+    return tx_queue.empty() && can_device.tx_idle();
+}
+
+/**
+ * @brief Call the CAN driver specific filter_list() function
+ * and set up the filters of the specific CAN board class
+ *
+ * @param rx_ids
+ * @param length
+ */
+template <can::can_driver Driver>
+void basic_can_base<Driver>::setup_filter(const uint32_t* rx_ids,
+                                          size_t length) {
+    can_device.filter_list(rx_ids, length);
+}
+
+/**
+ * @brief Add a function to be called with every packet received through
+ * receive(), receive_burst() or receive_urgent_burst(), before the caller
+ * decodes it. Used by skylab2::rx_monitor to stamp arrivals and by
+ * skylab2::rx_subscriptions to wake subscribers.
+ *
+ * @param observer Called from the receiving context.
+ * @param context Passed back to the observer.
+ * @return false Four observers are already set.
+ */
+template <can::can_driver Driver>
+bool basic_can_base<Driver>::add_rx_observer(rx_observer observer,
+                                             void* context) {
+    irq::critical_section lock;
+    if (observer_count == observers.size()) {
+        return false;
+    }
+    observers[observer_count] = {observer, context};
+    observer_count++;
+    return true;
+}
+
+// The virtual flavour is compiled once, in skylab2_can_base.cc.
+extern template class basic_can_base<can::can_driver_base>;
+
 }  // namespace skylab2
-}  // namespace umnsvp
\ No newline at end of file
+}  // namespace umnsvp
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace umnsvp {
+namespace skylab2 {
+
+/**
+ * @brief Unsigned integer of the given size, the wire form of a field.
+ */
+template <std::size_t bytes>
+using wire_uint = std::conditional_t<
+    bytes == 1, uint8_t,
+    std::conditional_t<
+        bytes == 2, uint16_t,
+        std::conditional_t<bytes == 4, uint32_t,
+                           std::conditional_t<bytes == 8, uint64_t, void>>>>;
+
+/**
+ * @brief Read the little endian field of type T at a compile-time offset of
+ * a packet's data.
+ *
+ * At run time on a little endian core this is one unaligned load; floats are
+ * converted with std::bit_cast rather than a union. In constant evaluation,
+ * or on a big endian host, the bytes are assembled by shifts.
+ */
+template <typename T, std::size_t offset>
+constexpr T load_field(const uint8_t* data) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    using raw_t = wire_uint<sizeof(T)>;
+    raw_t raw = 0;
+    if (std::is_constant_evaluated() ||
+        std::endian::native != std::endian::little) {
+        for (std::size_t i = 0; i < sizeof(T); i++) {
+            raw |= static_cast<raw_t>(static_cast<raw_t>(data[offset + i])
+                                      << (8 * i));
+        }
+    } else {
+        std::memcpy(&raw, data + offset, sizeof(T));
+    }
+    return std::bit_cast<T>(raw);
+}
+
+/**
+ * @brief Write the field of type T at a compile-time offset of a packet's
+ * data, little endian; the inverse of load_field().
+ */
+template <typename T, std::size_t offset>
+constexpr void store_field(uint8_t* data, T value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    using raw_t = wire_uint<sizeof(T)>;
+    const raw_t raw = std::bit_cast<raw_t>(value);
+    if (std::is_constant_evaluated() ||
+        std::endian::native != std::endian::little) {
+        for (std::size_t i = 0; i < sizeof(T); i++) {
+            data[offset + i] = static_cast<uint8_t>(raw >> (8 * i));
+        }
+    } else {
+        std::memcpy(data + offset, &raw, sizeof(T));
+    }
+}
+
+/**
+ * @brief Read one bit of a bitfield byte.
+ */
+template <std::size_t offset, unsigned bit>
+constexpr bool load_bit(const uint8_t* data) {
+    return ((data[offset] >> bit) & 1U) != 0;
+}
+
+/**
+ * @brief Set or clear one bit of a bitfield byte, leaving the others.
+ */
+template <std::size_t offset, unsigned bit>
+constexpr void store_bit(uint8_t* data, bool value) {
+    data[offset] = static_cast<uint8_t>(
+        (data[offset] & ~(1U << bit)) | (value ? 1U << bit : 0U));
+}
+
+}  // namespace skylab2
+}  // namespace umnsvp
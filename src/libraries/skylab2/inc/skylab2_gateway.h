@@ -0,0 +1,218 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "can_packet.h"
+#include "critical_section.h"
+#include "hal.h"
+#include "micros.h"
+#include "skylab2_rx_dispatch.h"
+
+namespace umnsvp {
+namespace skylab2 {
+
+/**
+ * @brief Lookup key of a frame arriving on a gateway bus: rx_key() with the
+ * bus index in bits 29 and 30, which no CAN ID uses.
+ */
+constexpr uint32_t route_key(uint8_t bus, uint32_t id, bool extended) {
+    return rx_key(id, extended) | (static_cast<uint32_t>(bus & 0x3U) << 29);
+}
+
+/**
+ * @brief One route of a gateway board, as generated into skylab2_dispatch.h.
+ */
+struct route {
+    /// route_key() of the frames this route takes.
+    uint32_t key;
+    uint8_t to;
+    /// ID to send the frame with; the source ID unless it is remapped.
+    uint32_t to_id;
+    bool to_extended;
+    /// Forward at most one frame this often; 0 forwards every one.
+    uint16_t min_interval_ms;
+    /// Forward one in every decimate frames.
+    uint8_t decimate;
+};
+
+/**
+ * @brief Counters of one route since the last reset_stats().
+ */
+struct route_stats {
+    uint32_t forwarded = 0;
+    /// Held back on purpose by the rate limit or decimation.
+    uint32_t filtered = 0;
+    /// Lost because the destination's TX queue was full.
+    uint32_t dropped = 0;
+    /// Reception to hand-off to the destination bus, in us. Frames without
+    /// a hardware timestamp are not counted.
+    uint32_t max_latency_us = 0;
+    uint32_t total_latency_us = 0;
+    uint32_t timed = 0;
+
+    float mean_latency_us() const {
+        return timed == 0 ? 0.0f
+                          : static_cast<float>(total_latency_us) / timed;
+    }
+};
+
+/**
+ * @brief Forwards frames between a board's buses by its generated route
+ * table.
+ *
+ * The gateway is an RX observer on every bus: a frame is looked up in the
+ * route hash (constant time) and handed straight to the destination bus's
+ * send_packet() from the RX interrupt, going into a free mailbox or the
+ * destination's priority TX queue. There is no intermediate buffer; only a
+ * frame whose ID is remapped is rebuilt. One frame may have several routes,
+ * which are contiguous in the table.
+ *
+ * Rate limits and decimation keep a slow auxiliary bus from being flooded
+ * by a busy main bus. Each route counts what it forwarded, held back and
+ * lost, and the time from reception to hand-off.
+ *
+ * Only frames the bus's hardware filter accepts reach the gateway, so the
+ * generator refuses a route whose packet is not in the board's receive list.
+ *
+ * Example Usage:
+   ........................
+   // Generated for a board with routes
+   skylab2::dash_routes::gateway<skylab2::can_base> bridge(
+       {&main_can, &aux_can});
+   ........................
+   bridge.attach();
+   main_can.init(...);
+   aux_can.init(...);
+   ........................
+ *
+ * @tparam Bus The board's bus class, with add_rx_observer() and
+ * send_packet().
+ * @tparam bus_count Number of buses, at most 4.
+ * @tparam hash Generated rx_hash from route_key() to the first route.
+ * @tparam routes Generated route table.
+ */
+template <typename Bus, std::size_t bus_count, const auto& hash,
+          const auto& routes>
+class gateway {
+    static_assert(bus_count > 0 && bus_count <= 4);
+
+   private:
+    static constexpr std::size_t route_count = routes.size();
+
+    /// Observer context of each bus.
+    struct port {
+        gateway* self;
+        uint8_t index;
+    };
+
+    std::array<Bus*, bus_count> busses;
+    std::array<port, bus_count> ports;
+    std::array<uint32_t, route_count> last_ms = {};
+    std::array<uint8_t, route_count> skipped = {};
+    std::array<bool, route_count> started = {};
+    std::array<route_stats, route_count> stats = {};
+
+    bool admit(std::size_t index, uint32_t now_ms) {
+        const route& r = routes[index];
+        if (r.decimate > 1) {
+            if (skipped[index] + 1 < r.decimate) {
+                skipped[index]++;
+                return false;
+            }
+            skipped[index] = 0;
+        }
+        if (r.min_interval_ms > 0) {
+            if (started[index] && now_ms - last_ms[index] < r.min_interval_ms) {
+                return false;
+            }
+            started[index] = true;
+            last_ms[index] = now_ms;
+        }
+        return true;
+    }
+
+    void forward(uint8_t from, const can::packet& packet) {
+        const uint32_t key =
+            route_key(from, packet.get_id(), packet.is_extended());
+        std::size_t index = hash.find(key);
+        if (index >= route_count) {
+            return;
+        }
+        const uint32_t now_ms = HAL_GetTick();
+        for (; index < route_count && routes[index].key == key; index++) {
+            const route& r = routes[index];
+            route_stats& counts = stats[index];
+            if (!admit(index, now_ms)) {
+                counts.filtered++;
+                continue;
+            }
+            can::status result;
+            if (r.to_id == packet.get_id() &&
+                r.to_extended == packet.is_extended()) {
+                result = busses[r.to]->send_packet(packet);
+            } else {
+                result = busses[r.to]->send_packet(
+                    can::packet(r.to_id, packet.get_length(),
+                                packet.get_data(), r.to_extended));
+            }
+            if (result == can::status::ERROR) {
+                counts.dropped++;
+                continue;
+            }
+            counts.forwarded++;
+            if (packet.get_timestamp() != 0) {
+                const uint32_t latency =
+                    time::micros() - packet.get_timestamp();
+                counts.timed++;
+                counts.total_latency_us += latency;
+                if (latency > counts.max_latency_us) {
+                    counts.max_latency_us = latency;
+                }
+            }
+        }
+    }
+
+   public:
+    explicit gateway(const std::array<Bus*, bus_count>& busses)
+        : busses(busses) {
+        for (std::size_t i = 0; i < bus_count; i++) {
+            ports[i] = {this, static_cast<uint8_t>(i)};
+        }
+    }
+
+    /**
+     * @brief Start watching every bus. Call before the buses are started.
+     *
+     * @return false A bus has no room for another RX observer.
+     */
+    bool attach() {
+        bool attached = true;
+        for (std::size_t i = 0; i < bus_count; i++) {
+            attached &= busses[i]->add_rx_observer(&observe, &ports[i]);
+        }
+        return attached;
+    }
+
+    /**
+     * @brief RX observer for basic_can_base::add_rx_observer().
+     */
+    static void observe(void* context, const can::packet& packet) {
+        const port& from = *static_cast<port*>(context);
+        from.self->forward(from.index, packet);
+    }
+
+    route_stats get_stats(std::size_t index) const {
+        irq::critical_section lock;
+        return stats[index];
+    }
+
+    void reset_stats() {
+        irq::critical_section lock;
+        stats = {};
+    }
+};
+
+}  // namespace skylab2
+}  // namespace umnsvp
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "critical_section.h"
+
+namespace umnsvp {
+namespace skylab2 {
+
+/**
+ * @brief One periodic message of a board's schedule, as generated into
+ * skylab2_schedule.h.
+ */
+struct periodic_entry {
+    uint32_t id;
+    uint16_t period_ms;
+    /// Offset of the first send within the period.
+    uint16_t phase_ms;
+};
+
+/**
+ * @brief Timing of one periodic message since the last reset_stats().
+ *
+ * Lateness is measured from the slot the message was due in to the tick
+ * that sent it, in whole ms.
+ */
+struct periodic_stats {
+    uint32_t sends = 0;
+    /// Periods that passed without a send because tick() was not called.
+    uint32_t skipped = 0;
+    uint32_t total_late_ms = 0;
+    uint16_t max_late_ms = 0;
+
+    /**
+     * @brief Mean lateness in ms, 0 before the first send.
+     */
+    float mean_late_ms() const {
+        return sends == 0 ? 0.0f
+                          : static_cast<float>(total_late_ms) / sends;
+    }
+};
+
+/**
+ * @brief Sends a board's periodic messages at their rates and phases.
+ *
+ * Each message stays on its own grid of start + phase + n * period, so a late
+ * tick delays one send but never shifts the ones after it, and messages that
+ * share a rate keep the spacing the generator gave them. A message that falls
+ * a whole period behind skips the missed sends instead of sending a burst to
+ * catch up.
+ *
+ * tick() only looks at the table when the earliest message is due, so it can
+ * run every ms from a timer or deferred work. The stats are read with
+ * interrupts off and can be polled from the main loop.
+ *
+ * Example Usage:
+   ........................
+   skylab2::periodic_scheduler<skylab2::lights_schedule::table.size()>
+       schedule{skylab2::lights_schedule::table};
+   ........................
+   schedule.start(HAL_GetTick());
+   ........................
+   // Every ms
+   schedule.tick(HAL_GetTick(), [&](std::size_t message) {
+       switch (message) {
+           case skylab2::lights_schedule::vision_status_front:
+               send_status();
+               break;
+           ...
+       }
+   });
+   ........................
+ *
+ * @tparam size Number of messages in the schedule.
+ */
+template <std::size_t size>
+class periodic_scheduler {
+   private:
+    const std::array<periodic_entry, size>& table;
+    std::array<uint32_t, size> due_ms = {};
+    std::array<periodic_stats, size> stats = {};
+    uint32_t earliest_ms = 0;
+    bool running = false;
+
+    static bool reached(uint32_t now_ms, uint32_t time_ms) {
+        return static_cast<int32_t>(now_ms - time_ms) >= 0;
+    }
+
+   public:
+    explicit periodic_scheduler(const std::array<periodic_entry, size>& table)
+        : table(table) {
+    }
+
+    /**
+     * @brief Start every message's grid at now_ms.
+     */
+    void start(uint32_t now_ms) {
+        earliest_ms = now_ms + 0xFFFF;
+        for (std::size_t i = 0; i < size; i++) {
+            due_ms[i] = now_ms + table[i].phase_ms;
+            if (reached(earliest_ms, due_ms[i])) {
+                earliest_ms = due_ms[i];
+            }
+        }
+        running = true;
+    }
+
+    /**
+     * @brief Call send(index) for every message that is due.
+     *
+     * @param now_ms Current time, usually HAL_GetTick().
+     * @param send Called with the index of the message in the table.
+     */
+    template <typename Send>
+    void tick(uint32_t now_ms, Send&& send) {
+        if (!running || !reached(now_ms, earliest_ms)) {
+            return;
+        }
+        earliest_ms = now_ms + 0xFFFF;
+        for (std::size_t i = 0; i < size; i++) {
+            if (reached(now_ms, due_ms[i])) {
+                const uint32_t late = now_ms - due_ms[i];
+                const uint16_t period = table[i].period_ms;
+                const uint32_t missed = late / period;
+                {
+                    irq::critical_section lock;
+                    periodic_stats& entry = stats[i];
+                    entry.sends++;
+                    entry.skipped += missed;
+                    entry.total_late_ms += late;
+                    if (late > entry.max_late_ms) {
+                        entry.max_late_ms =
+                            late > 0xFFFF ? 0xFFFF
+                                          : static_cast<uint16_t>(late);
+                    }
+                }
+                due_ms[i] += (missed + 1) * period;
+                send(i);
+            }
+            if (reached(earliest_ms, due_ms[i])) {
+                earliest_ms = due_ms[i];
+            }
+        }
+    }
+
+    /**
+     * @brief Timing of the message at index since the last reset_stats().
+     */
+    periodic_stats get_stats(std::size_t index) const {
+        irq::critical_section lock;
+        return stats[index];
+    }
+
+    /**
+     * @brief Largest lateness of any message, in ms.
+     */
+    uint16_t max_late_ms() const {
+        irq::critical_section lock;
+        uint16_t worst = 0;
+        for (const periodic_stats& entry : stats) {
+            if (entry.max_late_ms > worst) {
+                worst = entry.max_late_ms;
+            }
+        }
+        return worst;
+    }
+
+    void reset_stats() {
+        irq::critical_section lock;
+        stats = {};
+    }
+};
+
+}  // namespace skylab2
+}  // namespace umnsvp
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "can_packet.h"
+
+namespace umnsvp {
+namespace skylab2 {
+
+/// Index of a slot that holds no message.
+constexpr uint8_t rx_none = 0xFF;
+
+/**
+ * @brief Lookup key of a CAN ID: the ID, with bit 31 set for extended IDs so
+ * a standard and an extended ID with the same value do not collide.
+ */
+constexpr uint32_t rx_key(uint32_t id, bool extended) {
+    return id | (extended ? 0x80000000U : 0U);
+}
+
+/**
+ * @brief 32-bit integer mixer behind both levels of rx_hash. skylab2.py
+ * computes the same function when it builds the tables.
+ */
+constexpr uint32_t rx_mix(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7FEB352DU;
+    x ^= x >> 15;
+    x *= 0x846CA68BU;
+    x ^= x >> 16;
+    return x;
+}
+
+/**
+ * @brief One slot of an rx_hash.
+ */
+struct rx_slot {
+    uint32_t key = 0;
+    /// Index of the message in the board's RX list, rx_none if empty.
+    uint8_t index = rx_none;
+};
+
+/**
+ * @brief Perfect hash from the CAN IDs a board receives on one bus to the
+ * index of each message, generated into skylab2_dispatch.h.
+ *
+ * Hash and displace: the key's mix picks a bucket, and the bucket's
+ * displacement, chosen by the generator, moves every key of that bucket to a
+ * slot no other key uses. A lookup is two mixes and one compare whatever the
+ * number of messages, with no search and no branch chain, so it suits the RX
+ * interrupt.
+ *
+ * @tparam slots Table size, a power of two.
+ * @tparam buckets Number of displacements, a power of two.
+ */
+template <std::size_t slots, std::size_t buckets>
+struct rx_hash {
+    static_assert(slots > 0 && (slots & (slots - 1)) == 0);
+    static_assert(buckets > 0 && (buckets & (buckets - 1)) == 0);
+
+    std::array<uint16_t, buckets> displacement;
+    std::array<rx_slot, slots> table;
+
+    constexpr std::size_t slot_of(uint32_t key) const {
+        const uint16_t d = displacement[rx_mix(key) & (buckets - 1)];
+        return rx_mix(key ^ (d * 0x9E3779B9U)) & (slots - 1);
+    }
+
+    /**
+     * @brief Index of the message with the given key, rx_none if the board
+     * does not receive it.
+     */
+    constexpr uint8_t find(uint32_t key) const {
+        const rx_slot& slot = table[slot_of(key)];
+        return slot.key == key ? slot.index : rx_none;
+    }
+
+    uint8_t find(const can::packet& packet) const {
+        return find(rx_key(packet.get_id(), packet.is_extended()));
+    }
+
+    /**
+     * @brief True if every message lands in its own slot; checked at compile
+     * time by the generated tables.
+     */
+    constexpr bool valid() const {
+        for (std::size_t i = 0; i < slots; i++) {
+            if (table[i].index != rx_none && slot_of(table[i].key) != i) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/**
+ * @brief Calls the decode function of each received packet through an
+ * rx_hash.
+ *
+ * Example Usage:
+   ........................
+   using namespace skylab2::lights_main_rx;
+   static constexpr skylab2::rx_dispatcher<lights_can, hash.table.size(),
+                                           hash.displacement.size(), count>
+       dispatcher{hash, {&lights_can::decode_vision_headlights_command, ...}};
+   ........................
+   // RX interrupt
+   dispatcher.dispatch(*this, packet);
+   ........................
+ *
+ * @tparam Board The class the decode functions write to.
+ * @tparam slots See rx_hash.
+ * @tparam buckets See rx_hash.
+ * @tparam count Number of messages, in the order of the generated enum.
+ */
+template <typename Board, std::size_t slots, std::size_t buckets,
+          std::size_t count>
+class rx_dispatcher {
+   public:
+    using handler = void (*)(Board& board, const can::packet& packet);
+
+    constexpr rx_dispatcher(const rx_hash<slots, buckets>& hash,
+                            const std::array<handler, count>& handlers)
+        : hash(hash), handlers(handlers) {
+    }
+
+    /**
+     * @brief Decode the packet into the board.
+     *
+     * @return false The board does not receive this ID.
+     */
+    bool dispatch(Board& board, const can::packet& packet) const {
+        const uint8_t index = hash.find(packet);
+        if (index >= count) {
+            return false;
+        }
+        handlers[index](board, packet);
+        return true;
+    }
+
+   private:
+    const rx_hash<slots, buckets>& hash;
+    const std::array<handler, count> handlers;
+};
+
+}  // namespace skylab2
+}  // namespace umnsvp
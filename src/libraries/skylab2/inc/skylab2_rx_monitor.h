@@ -0,0 +1,283 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "can_packet.h"
+#include "critical_section.h"
+#include "skylab2_rx_dispatch.h"
+
+namespace umnsvp {
+namespace skylab2 {
+
+/**
+ * @brief One received periodic message of a board, as generated into
+ * skylab2_schedule.h.
+ */
+struct rx_deadline {
+    /// rx_key() of the message, so a standard and an extended frame with
+    /// the same ID are told apart.
+    uint32_t key;
+    /// Longest gap between two arrivals before the message is stale.
+    uint16_t deadline_ms;
+};
+
+/**
+ * @brief Tracks how fresh each of a board's received periodic messages is.
+ *
+ * Every arrival stamps its message with arrived(), straight from the RX
+ * interrupt; attach the monitor to the board class with
+ * add_rx_observer(rx_monitor::observe, &monitor) and every received packet
+ * is stamped without the application doing anything. A message that misses
+ * its deadline is marked stale and the timeout callback is called once,
+ * from tick(), so the application can fall back to safe values. The next
+ * arrival makes it fresh again.
+ *
+ * Deadlines are kept in a timing wheel of slots resolution_ms wide. An
+ * arrival only stores the new expiry time; the entry stays where it is in
+ * the wheel and is moved to its new slot when its old slot comes round. Each
+ * entry is therefore looked at about once per deadline (or per turn of the
+ * wheel, for deadlines longer than one turn) however often it arrives, and
+ * tick() costs O(1) amortized. A timeout is noticed up to resolution_ms
+ * late.
+ *
+ * Call tick() from a timer or deferred work, not from an interrupt that can
+ * preempt the RX interrupt.
+ *
+ * Example Usage:
+   ........................
+   skylab2::rx_monitor<skylab2::lights_deadlines::table.size()> monitor{
+       skylab2::lights_deadlines::table};
+   ........................
+   monitor.set_timeout_callback(&on_timeout, this);
+   monitor.start(HAL_GetTick());
+   skylab.add_rx_observer(&decltype(monitor)::observe, &monitor);
+   ........................
+   // Every few ms
+   monitor.tick(HAL_GetTick());
+   ........................
+ *
+ * @tparam size Number of messages monitored.
+ * @tparam resolution_ms Width of a wheel slot.
+ * @tparam slots Number of wheel slots.
+ */
+template <std::size_t size, uint16_t resolution_ms = 10,
+          std::size_t slots = 32>
+class rx_monitor {
+    static_assert(size < std::numeric_limits<uint8_t>::max(),
+                  "entries are linked by uint8_t index");
+    static_assert(resolution_ms > 0 && slots > 1);
+
+   public:
+    using timeout_callback = void (*)(void* context, std::size_t index);
+
+   private:
+    static constexpr uint8_t none = std::numeric_limits<uint8_t>::max();
+
+    const std::array<rx_deadline, size>& table;
+
+    /// Time each message goes stale unless it arrives again.
+    std::array<volatile uint32_t, size> expiry_ms = {};
+    std::array<volatile uint32_t, size> last_ms = {};
+    std::array<volatile bool, size> stale = {};
+    /// In the wheel; entries leave it when they time out.
+    std::array<volatile bool, size> armed = {};
+    std::array<uint32_t, size> timeouts = {};
+
+    /// Singly linked list of the entries in each slot.
+    std::array<uint8_t, slots> heads;
+    std::array<uint8_t, size> next = {};
+    /// Slot the wheel last processed, and the time it covers up to.
+    std::size_t current = 0;
+    uint32_t wheel_ms = 0;
+
+    timeout_callback on_timeout = nullptr;
+    void* callback_context = nullptr;
+
+    static bool reached(uint32_t now_ms, uint32_t time_ms) {
+        return static_cast<int32_t>(now_ms - time_ms) >= 0;
+    }
+
+    /**
+     * @brief Put an entry in the slot its expiry falls in. Expiries more
+     * than one turn out go in the slot one turn out and are looked at again.
+     */
+    void insert(std::size_t index) {
+        const int32_t distance =
+            static_cast<int32_t>(expiry_ms[index] - wheel_ms);
+        std::size_t steps = 1;
+        if (distance > 0) {
+            steps = (static_cast<uint32_t>(distance) + resolution_ms - 1) /
+                    resolution_ms;
+            if (steps > slots) {
+                steps = slots;
+            }
+        }
+        const std::size_t slot = (current + steps) % slots;
+        next[index] = heads[slot];
+        heads[slot] = static_cast<uint8_t>(index);
+    }
+
+    /**
+     * @brief Expire or reschedule every entry of the current slot.
+     */
+    void expire_slot(uint32_t now_ms) {
+        uint8_t index;
+        {
+            irq::critical_section lock;
+            index = heads[current];
+            heads[current] = none;
+        }
+        while (index != none) {
+            const uint8_t following = next[index];
+            bool expired = false;
+            {
+                irq::critical_section lock;
+                if (reached(now_ms, expiry_ms[index])) {
+                    // Out of the wheel until arrived() puts it back.
+                    stale[index] = true;
+                    armed[index] = false;
+                    timeouts[index]++;
+                    expired = true;
+                } else {
+                    insert(index);
+                }
+            }
+            if (expired && on_timeout != nullptr) {
+                on_timeout(callback_context, index);
+            }
+            index = following;
+        }
+    }
+
+   public:
+    explicit rx_monitor(const std::array<rx_deadline, size>& table)
+        : table(table) {
+        heads.fill(none);
+    }
+
+    void set_timeout_callback(timeout_callback callback, void* context) {
+        on_timeout = callback;
+        callback_context = context;
+    }
+
+    /**
+     * @brief Arm every deadline from now_ms. A message that never arrives
+     * times out one deadline after start().
+     */
+    void start(uint32_t now_ms) {
+        irq::critical_section lock;
+        heads.fill(none);
+        current = 0;
+        wheel_ms = now_ms;
+        for (std::size_t i = 0; i < size; i++) {
+            expiry_ms[i] = now_ms + table[i].deadline_ms;
+            last_ms[i] = now_ms;
+            stale[i] = true;
+            armed[i] = true;
+            insert(i);
+        }
+    }
+
+    /**
+     * @brief Stamp an arrival of the message at index.
+     */
+    void arrived(std::size_t index, uint32_t now_ms) {
+        last_ms[index] = now_ms;
+        expiry_ms[index] = now_ms + table[index].deadline_ms;
+        stale[index] = false;
+        if (!armed[index]) {
+            irq::critical_section lock;
+            if (!armed[index]) {
+                armed[index] = true;
+                insert(index);
+            }
+        }
+    }
+
+    /**
+     * @brief Index of the message with the given rx_key(), or size if it is
+     * not monitored. The table is sorted by key.
+     */
+    std::size_t find(uint32_t key) const {
+        std::size_t low = 0;
+        std::size_t high = size;
+        while (low < high) {
+            const std::size_t middle = (low + high) / 2;
+            if (table[middle].key < key) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low < size && table[low].key == key ? low : size;
+    }
+
+    /**
+     * @brief Stamp an arrival by ID; IDs not monitored are ignored.
+     */
+    void arrived_id(uint32_t id, bool extended, uint32_t now_ms) {
+        const std::size_t index = find(rx_key(id, extended));
+        if (index < size) {
+            arrived(index, now_ms);
+        }
+    }
+
+    /**
+     * @brief RX observer for basic_can_base::add_rx_observer().
+     *
+     * @param monitor The rx_monitor.
+     * @param packet The received packet.
+     */
+    static void observe(void* monitor, const can::packet& packet) {
+        static_cast<rx_monitor*>(monitor)->arrived_id(packet.get_id(),
+                                                      packet.is_extended(),
+                                                      HAL_GetTick());
+    }
+
+    /**
+     * @brief Move the wheel up to now_ms, calling the timeout callback for
+     * every message that went stale.
+     */
+    void tick(uint32_t now_ms) {
+        uint32_t steps = (now_ms - wheel_ms) / resolution_ms;
+        if (steps > slots) {
+            // Every slot gets looked at once; the skipped turns are made up
+            // by comparing expiries against now_ms.
+            wheel_ms += (steps - slots) * resolution_ms;
+            steps = slots;
+        }
+        for (uint32_t i = 0; i < steps; i++) {
+            wheel_ms += resolution_ms;
+            current = (current + 1) % slots;
+            expire_slot(now_ms);
+        }
+    }
+
+    /**
+     * @brief True if the message has arrived within its deadline.
+     */
+    bool is_fresh(std::size_t index) const {
+        return !stale[index];
+    }
+
+    /**
+     * @brief Time since the message last arrived, or since start() if it
+     * never has.
+     */
+    uint32_t age_ms(std::size_t index, uint32_t now_ms) const {
+        return now_ms - last_ms[index];
+    }
+
+    /**
+     * @brief Number of times the message has gone stale.
+     */
+    uint32_t get_timeouts(std::size_t index) const {
+        return timeouts[index];
+    }
+};
+
+}  // namespace skylab2
+}  // namespace umnsvp
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "can_packet.h"
+#include "critical_section.h"
+#include "deferred_work.h"
+#include "hal.h"
+#include "skylab2_rx_dispatch.h"
+
+namespace umnsvp {
+namespace skylab2 {
+
+/**
+ * @brief Delivers received packets to per-packet handlers, or wakes the main
+ * loop, instead of the application polling every buffer.
+ *
+ * Attach it to the board class with add_rx_observer(observe, &subscriptions).
+ * The RX interrupt then looks each packet up in the board's generated RX
+ * hash, keeps it as the latest of its type and sets its bit in the ready
+ * mask:
+ * - Packets with a handler are handed to it from deferred work (PendSV),
+ *   after the interrupt returns. Several arrivals of one type before the
+ *   handler runs are merged into the latest, as the buffers did.
+ * - Packets without a handler keep their bit set for the main loop, which
+ *   can sleep in wait() until one arrives and read it with latest().
+ *
+ * Example Usage:
+   ........................
+   skylab2::lights_main_rx::subscriptions rx;
+   ........................
+   rx.subscribe(skylab2::lights_main_rx::vision_headlights_command,
+                &on_headlights, this);
+   skylab.add_rx_observer(&decltype(rx)::observe, &rx);
+   ........................
+   while (1) {
+       rx.wait(1U << skylab2::lights_main_rx::bms_kill_reason);
+       ...
+   }
+   ........................
+ *
+ * @tparam hash The board's generated rx_hash for the bus.
+ * @tparam count Number of packet types the board receives on the bus.
+ */
+template <const auto& hash, std::size_t count>
+class rx_subscriptions {
+    static_assert(count <= 32, "the ready mask has one bit per packet type");
+
+   public:
+    using handler = void (*)(void* context, const can::packet& packet);
+
+   private:
+    struct subscriber {
+        handler fn = nullptr;
+        void* context = nullptr;
+    };
+
+    std::array<can::packet, count> packets = {};
+    std::array<subscriber, count> subscribers = {};
+    /// Packet types that arrived and have not been handled or taken yet.
+    volatile uint32_t ready = 0;
+    /// Packet types with a handler.
+    uint32_t subscribed = 0;
+    volatile bool posted = false;
+    uint32_t merged = 0;
+
+    static void run(void* self) {
+        static_cast<rx_subscriptions*>(self)->deliver();
+    }
+
+    void deliver() {
+        posted = false;
+        uint32_t pending = ready & subscribed;
+        while (pending != 0) {
+            const std::size_t index = __builtin_ctz(pending);
+            pending &= pending - 1;
+            can::packet packet;
+            {
+                irq::critical_section lock;
+                packet = packets[index];
+                ready &= ~(1U << index);
+            }
+            subscribers[index].fn(subscribers[index].context, packet);
+        }
+    }
+
+   public:
+    /**
+     * @brief Hand every packet of one type to fn, from deferred work.
+     *
+     * @param index The packet's entry in the generated message enum.
+     * @param fn Handler; nullptr leaves the packet to the main loop.
+     * @param context Passed back to fn.
+     */
+    void subscribe(std::size_t index, handler fn, void* context) {
+        irq::critical_section lock;
+        subscribers[index] = {fn, context};
+        if (fn != nullptr) {
+            subscribed |= 1U << index;
+        } else {
+            subscribed &= ~(1U << index);
+        }
+    }
+
+    /**
+     * @brief Record an arrival; called from the RX interrupt.
+     */
+    void notify(const can::packet& packet) {
+        const uint8_t index = hash.find(packet);
+        if (index >= count) {
+            return;
+        }
+        const uint32_t bit = 1U << index;
+        {
+            irq::critical_section lock;
+            if ((ready & bit) != 0) {
+                merged++;
+            }
+            packets[index] = packet;
+            ready |= bit;
+        }
+        if ((subscribed & bit) != 0 && !posted) {
+            posted = irq::post(&run, this);
+        }
+    }
+
+    /**
+     * @brief RX observer for basic_can_base::add_rx_observer().
+     */
+    static void observe(void* self, const can::packet& packet) {
+        static_cast<rx_subscriptions*>(self)->notify(packet);
+    }
+
+    /**
+     * @brief Clear and return the ready bits in mask without waiting.
+     */
+    uint32_t take(uint32_t mask) {
+        irq::critical_section lock;
+        const uint32_t taken = ready & mask;
+        ready &= ~taken;
+        return taken;
+    }
+
+    /**
+     * @brief Sleep until a packet type in mask is ready, then clear and
+     * return its ready bits. Call from the main loop only.
+     *
+     * Interrupts are masked while the mask is checked, so an arrival
+     * between the check and the WFI still wakes the core.
+     */
+    uint32_t wait(uint32_t mask) {
+        while (true) {
+            __disable_irq();
+            const uint32_t taken = ready & mask;
+            if (taken != 0) {
+                ready &= ~taken;
+                __enable_irq();
+                return taken;
+            }
+            __WFI();
+            __enable_irq();
+        }
+    }
+
+    /**
+     * @brief The last packet of a type that arrived.
+     */
+    can::packet latest(std::size_t index) const {
+        irq::critical_section lock;
+        return packets[index];
+    }
+
+    /**
+     * @brief Arrivals that replaced a packet before it was handled or
+     * taken.
+     */
+    uint32_t get_merged() const {
+        return merged;
+    }
+};
+
+}  // namespace skylab2
+}  // namespace umnsvp
@@ -0,0 +1,105 @@
+/**
+ * @file boost_plant.cc
+ * @brief State space averaged model of the boost power stage.
+ */
+
+#include "boost_plant.h"
+
+#include <algorithm>
+
+namespace umnsvp {
+namespace boost_sim {
+
+boost_plant::boost_plant(const plant_params& params) : params(params) {
+}
+
+/**
+ * @brief Advance the model by one fixed step.
+ *
+ * @param duty MOSFET on fraction for this step, clamped to [0, 1].
+ * @param dt_s Integration step in seconds.
+ */
+void boost_plant::step(float duty, float dt_s) {
+    duty = std::clamp(duty, 0.0f, 1.0f);
+
+    const state k1 = derivative(x, duty);
+    const state x2 = {x.current + 0.5f * dt_s * k1.current,
+                      x.voltage + 0.5f * dt_s * k1.voltage};
+    const state k2 = derivative(x2, duty);
+    const state x3 = {x.current + 0.5f * dt_s * k2.current,
+                      x.voltage + 0.5f * dt_s * k2.voltage};
+    const state k3 = derivative(x3, duty);
+    const state x4 = {x.current + dt_s * k3.current,
+                      x.voltage + dt_s * k3.voltage};
+    const state k4 = derivative(x4, duty);
+
+    x.current += dt_s / 6.0f *
+                 (k1.current + 2.0f * k2.current + 2.0f * k3.current +
+                  k4.current);
+    x.voltage += dt_s / 6.0f *
+                 (k1.voltage + 2.0f * k2.voltage + 2.0f * k3.voltage +
+                  k4.voltage);
+
+    // The diode stops the inductor current from reversing.
+    x.current = std::max(x.current, 0.0f);
+    x.voltage = std::max(x.voltage, 0.0f);
+}
+
+void boost_plant::set_source_voltage(float volts) {
+    source_v = volts;
+}
+
+void boost_plant::set_load_ohms(float ohms) {
+    load_ohms = std::max(ohms, 1e-3f);
+}
+
+float boost_plant::get_source_voltage() const {
+    return source_v;
+}
+
+float boost_plant::get_input_voltage() const {
+    return source_v - x.current * params.source_ohms;
+}
+
+float boost_plant::get_output_voltage() const {
+    return x.voltage;
+}
+
+float boost_plant::get_inductor_current() const {
+    return x.current;
+}
+
+float boost_plant::get_output_current() const {
+    return x.voltage / load_ohms;
+}
+
+float boost_plant::get_load_ohms() const {
+    return load_ohms;
+}
+
+float boost_plant::get_losses(float duty) const {
+    duty = std::clamp(duty, 0.0f, 1.0f);
+    const float i = x.current;
+    return i * i *
+               (params.source_ohms + params.inductor_ohms +
+                duty * params.mosfet_ohms) +
+           (1.0f - duty) * i * params.diode_drop_v;
+}
+
+boost_plant::state boost_plant::derivative(const state& s, float duty) const {
+    const float off = 1.0f - duty;
+    const float r_on = params.source_ohms + params.inductor_ohms +
+                       duty * params.mosfet_ohms;
+    float di = (source_v - s.current * r_on -
+                off * (s.voltage + params.diode_drop_v)) /
+               params.inductance_h;
+    if (s.current <= 0.0f && di < 0.0f) {
+        di = 0.0f;
+    }
+    const float dv =
+        (off * s.current - s.voltage / load_ohms) / params.capacitance_f;
+    return {di, dv};
+}
+
+}  // namespace boost_sim
+}  // namespace umnsvp
@@ -0,0 +1,66 @@
+/**
+ * @file boost_plant.h
+ * @brief State space averaged model of the boost power stage.
+ *
+ * Over one switching period the MOSFET conducts for d and the diode for
+ * (1 - d), so the averaged equations are
+ *
+ *   L dI/dt = Vin - I (R_src + R_L + d R_ds) - (1 - d) (Vc + V_f)
+ *   C dVc/dt = (1 - d) I - Vc / R_load
+ *
+ * The diode blocks reverse current, so the inductor current is held at zero
+ * instead of going negative (a crude discontinuous conduction model). The
+ * equations are integrated with a fixed step fourth order Runge-Kutta.
+ */
+
+#pragma once
+
+namespace umnsvp {
+namespace boost_sim {
+
+struct plant_params {
+    float inductance_h = 47e-6f;
+    float capacitance_f = 470e-6f;
+    float inductor_ohms = 0.020f;
+    float mosfet_ohms = 0.010f;
+    float diode_drop_v = 0.5f;
+    float source_ohms = 0.010f;
+};
+
+class boost_plant {
+   public:
+    explicit boost_plant(const plant_params& params);
+
+    void step(float duty, float dt_s);
+
+    void set_source_voltage(float volts);
+    void set_load_ohms(float ohms);
+
+    float get_source_voltage() const;
+    float get_input_voltage() const;
+    float get_output_voltage() const;
+    float get_inductor_current() const;
+    float get_output_current() const;
+    float get_load_ohms() const;
+
+    /**
+     * @brief Conduction and diode losses at the present operating point [W].
+     */
+    float get_losses(float duty) const;
+
+   private:
+    struct state {
+        float current;
+        float voltage;
+    };
+
+    state derivative(const state& s, float duty) const;
+
+    const plant_params params;
+    float source_v = 0.0f;
+    float load_ohms = 1e6f;
+    state x = {0.0f, 0.0f};
+};
+
+}  // namespace boost_sim
+}  // namespace umnsvp
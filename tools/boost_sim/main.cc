@@ -0,0 +1,355 @@
+/**
+ * @file main.cc
+ * @brief Host simulator for the boost converter control loop.
+ *
+ * Runs the firmware's boost_control, current_share, mosfet_pwm and adc
+ * sources unchanged against a mocked TIM1 and SPI-ADC and closes the loop
+ * through an averaged model of the power stage. The firmware is stepped at
+ * its main loop rate, the plant at a much finer fixed step.
+ *
+ * usage: boost_sim [options] scenario.txt
+ *   --out-dir DIR     directory for the default outputs (default: the
+ *                     build directory)
+ *   --waveform FILE   waveform CSV (default DIR/waveform.csv)
+ *   --timing FILE     control loop timing CSV (default DIR/timing.csv)
+ *   --step-us N       plant integration step (default 1)
+ *   --log-us N        waveform sample interval (default 100)
+ *   --control-us N    control loop period (default BOOST_MAIN_LOOP_DELAY_MS)
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "boost_control.h"
+#include "boost_plant.h"
+#include "current_share.h"
+#include "main.h"
+#include "mosfet_pwm.h"
+#include "scenario.h"
+#include "sim_mock.h"
+
+namespace umnsvp {
+namespace boost_sim {
+namespace {
+
+constexpr float short_ohms = 0.05f;
+constexpr float open_ohms = 1e6f;
+constexpr int32_t adc_full_scale = (1 << 23) - 1;
+
+// Set by CMake so that runs from the source tree do not leave CSVs in it.
+#ifndef BOOST_SIM_OUTPUT_DIR
+#define BOOST_SIM_OUTPUT_DIR "."
+#endif
+
+struct options {
+    std::string scenario;
+    std::string out_dir = BOOST_SIM_OUTPUT_DIR;
+    // Empty until given, then out_dir/waveform.csv and out_dir/timing.csv.
+    std::string waveform;
+    std::string timing;
+    uint32_t step_us = 1;
+    uint32_t log_us = 100;
+    uint32_t control_us = BOOST_MAIN_LOOP_DELAY_MS * 1000U;
+};
+
+bool parse_args(int argc, char** argv, options& opts) {
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--out-dir") == 0 && has_value) {
+            opts.out_dir = argv[++i];
+        } else if (std::strcmp(argv[i], "--waveform") == 0 && has_value) {
+            opts.waveform = argv[++i];
+        } else if (std::strcmp(argv[i], "--timing") == 0 && has_value) {
+            opts.timing = argv[++i];
+        } else if (std::strcmp(argv[i], "--step-us") == 0 && has_value) {
+            opts.step_us = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--log-us") == 0 && has_value) {
+            opts.log_us = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--control-us") == 0 && has_value) {
+            opts.control_us = std::strtoul(argv[++i], nullptr, 10);
+        } else if (argv[i][0] != '-' && opts.scenario.empty()) {
+            opts.scenario = argv[i];
+        } else {
+            return false;
+        }
+    }
+    if (opts.waveform.empty()) {
+        opts.waveform = opts.out_dir + "/waveform.csv";
+    }
+    if (opts.timing.empty()) {
+        opts.timing = opts.out_dir + "/timing.csv";
+    }
+    return !opts.scenario.empty() && opts.step_us > 0 && opts.log_us > 0 &&
+           opts.control_us >= opts.step_us;
+}
+
+int32_t to_code(float value, float per_count) {
+    const float code = std::round(value / per_count);
+    return static_cast<int32_t>(std::clamp(
+        code, -static_cast<float>(adc_full_scale),
+        static_cast<float>(adc_full_scale)));
+}
+
+uint8_t sensor_channel(fault_target target) {
+    switch (target) {
+        case fault_target::VIN_SENSOR:
+            return BOOST_ADC_VIN_CHANNEL;
+        case fault_target::IOUT_SENSOR:
+            return BOOST_ADC_IOUT_CHANNEL;
+        default:
+            return BOOST_ADC_VOUT_CHANNEL;
+    }
+}
+
+float expect_value(const boost_plant& plant, expect_signal signal) {
+    switch (signal) {
+        case expect_signal::VIN:
+            return plant.get_input_voltage();
+        case expect_signal::IOUT:
+            return plant.get_output_current();
+        case expect_signal::DUTY:
+            return BoostControl_GetDuty();
+        default:
+            return plant.get_output_voltage();
+    }
+}
+
+const char* signal_name(expect_signal signal) {
+    switch (signal) {
+        case expect_signal::VIN:
+            return "vin";
+        case expect_signal::IOUT:
+            return "iout";
+        case expect_signal::DUTY:
+            return "duty";
+        default:
+            return "vout";
+    }
+}
+
+/**
+ * @brief Percentile of an already sorted sample set.
+ */
+uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    const std::size_t index = static_cast<std::size_t>(
+        std::ceil(p / 100.0 * static_cast<double>(sorted.size())));
+    return sorted[std::min(sorted.size() - 1, index > 0 ? index - 1 : 0)];
+}
+
+bool write_timing(const std::string& path, std::vector<uint64_t> exec_ns,
+                  uint32_t spi_transfers, double sim_s, double wall_s) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+    std::sort(exec_ns.begin(), exec_ns.end());
+    uint64_t total = 0;
+    for (uint64_t ns : exec_ns) {
+        total += ns;
+    }
+    const std::size_t steps = exec_ns.size();
+
+    std::fprintf(file, "metric,value\n");
+    std::fprintf(file, "control_steps,%zu\n", steps);
+    std::fprintf(file, "exec_min_ns,%llu\n",
+                 static_cast<unsigned long long>(steps ? exec_ns.front() : 0));
+    std::fprintf(file, "exec_mean_ns,%.1f\n",
+                 steps ? static_cast<double>(total) / steps : 0.0);
+    std::fprintf(file, "exec_p50_ns,%llu\n",
+                 static_cast<unsigned long long>(percentile(exec_ns, 50.0)));
+    std::fprintf(file, "exec_p99_ns,%llu\n",
+                 static_cast<unsigned long long>(percentile(exec_ns, 99.0)));
+    std::fprintf(file, "exec_max_ns,%llu\n",
+                 static_cast<unsigned long long>(steps ? exec_ns.back() : 0));
+    std::fprintf(file, "spi_transfers_per_step,%.2f\n",
+                 steps ? static_cast<double>(spi_transfers) / steps : 0.0);
+    std::fprintf(file, "simulated_s,%.6f\n", sim_s);
+    std::fprintf(file, "wall_s,%.6f\n", wall_s);
+    std::fprintf(file, "realtime_factor,%.1f\n",
+                 wall_s > 0.0 ? sim_s / wall_s : 0.0);
+    std::fclose(file);
+    return true;
+}
+
+int run(const options& opts) {
+    std::vector<event> events;
+    std::string error;
+    if (!load_scenario(opts.scenario, events, error)) {
+        std::fprintf(stderr, "boost_sim: %s\n", error.c_str());
+        return 2;
+    }
+
+    FILE* waveform = std::fopen(opts.waveform.c_str(), "w");
+    if (waveform == nullptr) {
+        std::fprintf(stderr, "boost_sim: cannot write %s\n",
+                     opts.waveform.c_str());
+        return 2;
+    }
+    std::fprintf(waveform,
+                 "t_s,vsrc_v,vin_v,vout_v,il_a,iout_a,load_ohms,compare,"
+                 "duty,loss_w,exec_ns\n");
+
+    boost_plant plant{plant_params{}};
+    // A single module; the node id only matters with peers on the bus.
+    boost::current_share share(0, BOOST_SHARE_TIMEOUT_MS,
+                               BOOST_SHARE_DROOP_OHMS, BOOST_SHARE_GAIN,
+                               BOOST_SHARE_MAX_TRIM_V, BOOST_SHARE_DECAY_S);
+
+    // Same bring up order as main().
+    MOSFET_PWM_Init();
+    BoostControl_Init();
+
+    const uint32_t spi_at_start = get_spi_transfers();
+    const float control_dt_s = opts.control_us * 1e-6f;
+    const float step_s = opts.step_us * 1e-6f;
+    float scripted_load = plant.get_load_ohms();
+    bool load_fault = false;
+    int failures = 0;
+    uint64_t last_exec_ns = 0;
+    std::vector<uint64_t> exec_ns;
+    std::size_t next_event = 0;
+    uint64_t now_us = 0;
+    bool done = false;
+
+    const auto wall_start = std::chrono::steady_clock::now();
+    while (!done) {
+        const double now_s = now_us * 1e-6;
+
+        while (next_event < events.size() &&
+               events[next_event].time_s <= now_s) {
+            const event& e = events[next_event++];
+            switch (e.type) {
+                case event_type::VIN:
+                    plant.set_source_voltage(e.value);
+                    break;
+                case event_type::LOAD:
+                    scripted_load = e.value;
+                    if (!load_fault) {
+                        plant.set_load_ohms(scripted_load);
+                    }
+                    break;
+                case event_type::FAULT:
+                    if (e.fault == fault_target::SHORT ||
+                        e.fault == fault_target::OPEN) {
+                        load_fault = e.active;
+                        plant.set_load_ohms(
+                            !e.active ? scripted_load
+                            : e.fault == fault_target::SHORT ? short_ohms
+                                                             : open_ohms);
+                    } else {
+                        set_adc_stuck(sensor_channel(e.fault), e.active);
+                    }
+                    break;
+                case event_type::EXPECT: {
+                    const float value = expect_value(plant, e.signal);
+                    if (value < e.min || value > e.max) {
+                        std::fprintf(stderr,
+                                     "FAIL line %d: t=%.4f s %s=%.4f not in "
+                                     "[%.4f, %.4f]\n",
+                                     e.line, e.time_s, signal_name(e.signal),
+                                     value, e.min, e.max);
+                        failures++;
+                    }
+                    break;
+                }
+                case event_type::END:
+                    done = true;
+                    break;
+            }
+        }
+        if (done) {
+            break;
+        }
+
+        if (now_us % opts.control_us == 0) {
+            set_adc_code(BOOST_ADC_VIN_CHANNEL,
+                         to_code(plant.get_input_voltage(),
+                                 BOOST_ADC_VIN_VOLTS_PER_COUNT));
+            set_adc_code(BOOST_ADC_VOUT_CHANNEL,
+                         to_code(plant.get_output_voltage(),
+                                 BOOST_ADC_VOUT_VOLTS_PER_COUNT));
+            set_adc_code(BOOST_ADC_IOUT_CHANNEL,
+                         to_code(plant.get_output_current(),
+                                 BOOST_ADC_IOUT_AMPS_PER_COUNT));
+            set_tick(static_cast<uint32_t>(now_us / 1000U));
+
+            // One pass of the firmware main loop.
+            const auto start = std::chrono::steady_clock::now();
+            BoostMeasurements meas;
+            BoostControl_Sample(&meas);
+            const float trim = share.vref_trim(
+                meas.iout, static_cast<uint32_t>(now_us / 1000U),
+                control_dt_s);
+            BoostControl_Step(&meas, trim, control_dt_s);
+            const auto stop = std::chrono::steady_clock::now();
+
+            last_exec_ns = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(stop -
+                                                                     start)
+                    .count());
+            exec_ns.push_back(last_exec_ns);
+        }
+
+        const uint32_t compare = get_compare();
+        const float duty =
+            static_cast<float>(compare) / static_cast<float>(get_period() + 1);
+
+        if (now_us % opts.log_us == 0) {
+            std::fprintf(waveform,
+                         "%.6f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%u,%.4f,%.4f,"
+                         "%llu\n",
+                         now_s, plant.get_source_voltage(),
+                         plant.get_input_voltage(), plant.get_output_voltage(),
+                         plant.get_inductor_current(),
+                         plant.get_output_current(), plant.get_load_ohms(),
+                         compare, duty, plant.get_losses(duty),
+                         static_cast<unsigned long long>(last_exec_ns));
+        }
+
+        plant.step(duty, step_s);
+        now_us += opts.step_us;
+    }
+    const auto wall_stop = std::chrono::steady_clock::now();
+    std::fclose(waveform);
+
+    const double wall_s =
+        std::chrono::duration<double>(wall_stop - wall_start).count();
+    if (!write_timing(opts.timing, exec_ns,
+                      get_spi_transfers() - spi_at_start, now_us * 1e-6,
+                      wall_s)) {
+        std::fprintf(stderr, "boost_sim: cannot write %s\n",
+                     opts.timing.c_str());
+        return 2;
+    }
+
+    std::printf("boost_sim: %.3f s simulated in %.3f s, %zu control steps, "
+                "%d failed expectation(s)\n",
+                now_us * 1e-6, wall_s, exec_ns.size(), failures);
+    return failures == 0 ? 0 : 1;
+}
+
+}  // namespace
+}  // namespace boost_sim
+}  // namespace umnsvp
+
+int main(int argc, char** argv) {
+    umnsvp::boost_sim::options opts;
+    if (!umnsvp::boost_sim::parse_args(argc, argv, opts)) {
+        std::fprintf(stderr,
+                     "usage: %s [--out-dir DIR] [--waveform FILE] [--timing FILE] "
+                     "[--step-us N] [--log-us N] [--control-us N] "
+                     "scenario.txt\n",
+                     argv[0]);
+        return 2;
+    }
+    return umnsvp::boost_sim::run(opts);
+}
@@ -0,0 +1,110 @@
+/**
+ * @file hal_mock.cc
+ * @brief Host implementation of the HAL calls reached by the boost control
+ * sources.
+ *
+ * The timer calls copy their configuration into the TIM1 register block the
+ * same way the real HAL does, so the plant sees the period and compare value
+ * exactly as the firmware programmed them.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "sim_mock.h"
+#include "stm32l4xx_hal.h"
+
+namespace {
+
+uint32_t tick_ms = 0;
+
+}  // namespace
+
+namespace umnsvp {
+namespace boost_sim {
+
+void set_tick(uint32_t now_ms) {
+    tick_ms = now_ms;
+}
+
+uint32_t get_compare() {
+    return sim_tim1.CCR1;
+}
+
+uint32_t get_period() {
+    return sim_tim1.ARR;
+}
+
+}  // namespace boost_sim
+}  // namespace umnsvp
+
+extern "C" {
+
+TIM_TypeDef sim_tim1 = {};
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* htim) {
+    if (htim == nullptr || htim->Instance == nullptr) {
+        return HAL_ERROR;
+    }
+    htim->Instance->PSC = htim->Init.Prescaler;
+    htim->Instance->ARR = htim->Init.Period;
+    htim->Instance->RCR = htim->Init.RepetitionCounter;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_ConfigClockSource(TIM_HandleTypeDef* htim,
+                                            TIM_ClockConfigTypeDef*) {
+    return htim == nullptr ? HAL_ERROR : HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef* htim) {
+    return HAL_TIM_Base_Init(htim);
+}
+
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(
+    TIM_HandleTypeDef* htim, TIM_MasterConfigTypeDef*) {
+    return htim == nullptr ? HAL_ERROR : HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef* htim,
+                                            TIM_OC_InitTypeDef* sConfig,
+                                            uint32_t Channel) {
+    if (htim == nullptr || sConfig == nullptr) {
+        return HAL_ERROR;
+    }
+    __HAL_TIM_SET_COMPARE(htim, Channel, sConfig->Pulse);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_ConfigBreakDeadTime(
+    TIM_HandleTypeDef* htim, TIM_BreakDeadTimeConfigTypeDef*) {
+    return htim == nullptr ? HAL_ERROR : HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* htim, uint32_t) {
+    if (htim == nullptr) {
+        return HAL_ERROR;
+    }
+    htim->Instance->CR1 |= 1U;
+    return HAL_OK;
+}
+
+void HAL_TIM_MspPostInit(TIM_HandleTypeDef*) {
+}
+
+uint32_t HAL_GetTick(void) {
+    return tick_ms;
+}
+
+void HAL_NVIC_SetPriority(IRQn_Type, uint32_t, uint32_t) {
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type) {
+}
+
+void Error_Handler(void) {
+    std::fprintf(stderr, "boost_sim: Error_Handler reached\n");
+    std::abort();
+}
+
+}  // extern "C"
@@ -0,0 +1,52 @@
+/**
+ * @file sim_mock.h
+ * @brief Simulator side of the mocked TIM1 and SPI-ADC.
+ *
+ * The firmware only ever sees the HAL and SPI calls; the simulator uses
+ * these hooks to read back what the firmware commanded and to put the plant
+ * state on the ADC inputs.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+namespace umnsvp {
+namespace boost_sim {
+
+/**
+ * @brief Number of multiplexer inputs on the external ADC.
+ */
+constexpr uint8_t adc_channels = 16;
+
+/**
+ * @brief Put a raw 24-bit two's complement code on an ADC input.
+ */
+void set_adc_code(uint8_t channel, int32_t code);
+
+/**
+ * @brief Freeze an ADC input at its current code, emulating a stuck or
+ * disconnected sensor. Writes with set_adc_code() are ignored until the
+ * channel is released.
+ */
+void set_adc_stuck(uint8_t channel, bool stuck);
+
+/**
+ * @brief Number of SPI transfers the firmware has made since start up.
+ */
+uint32_t get_spi_transfers();
+
+void set_tick(uint32_t now_ms);
+
+/**
+ * @brief Value the firmware last wrote to TIM1 CCR1.
+ */
+uint32_t get_compare();
+
+/**
+ * @brief TIM1 auto reload value as programmed by the firmware.
+ */
+uint32_t get_period();
+
+}  // namespace boost_sim
+}  // namespace umnsvp
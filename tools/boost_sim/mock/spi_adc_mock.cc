@@ -0,0 +1,93 @@
+/**
+ * @file spi_adc_mock.cc
+ * @brief Mocked SPI link to the external ADC.
+ *
+ * The firmware's adc.c is built unchanged and talks to this file through
+ * send_bytes_SPI() / send_receive_bytes_SPI(). The frames are decoded the
+ * same way the ADC does it: the high nibble of the first byte is the opcode
+ * and the low nibble the register. A write to the MUX register selects the
+ * input and a read of the DATA register returns its code, MSB first.
+ */
+
+#include <array>
+
+#include "sim_mock.h"
+#include "spi.h"
+
+namespace {
+
+constexpr uint8_t opcode_rreg = 0x01;
+constexpr uint8_t opcode_wreg = 0x05;
+constexpr uint8_t reg_mux = 0x01;
+constexpr uint8_t reg_data = 0x0D;
+
+struct adc_input {
+    int32_t code = 0;
+    bool stuck = false;
+};
+
+std::array<adc_input, umnsvp::boost_sim::adc_channels> inputs = {};
+uint8_t selected = 0;
+uint32_t transfers = 0;
+
+}  // namespace
+
+namespace umnsvp {
+namespace boost_sim {
+
+void set_adc_code(uint8_t channel, int32_t code) {
+    if (channel >= inputs.size() || inputs[channel].stuck) {
+        return;
+    }
+    inputs[channel].code = code;
+}
+
+void set_adc_stuck(uint8_t channel, bool stuck) {
+    if (channel < inputs.size()) {
+        inputs[channel].stuck = stuck;
+    }
+}
+
+uint32_t get_spi_transfers() {
+    return transfers;
+}
+
+}  // namespace boost_sim
+}  // namespace umnsvp
+
+extern "C" {
+
+SPI_HandleTypeDef hspi1 = {};
+DMA_HandleTypeDef hdma_spi1_rx = {};
+DMA_HandleTypeDef hdma_spi1_tx = {};
+
+void SPI_Init(void) {
+}
+
+void send_bytes_SPI(uint8_t* send, uint32_t num) {
+    transfers++;
+    if (num < 3) {
+        return;
+    }
+    const uint8_t opcode = send[0] >> 4;
+    const uint8_t reg = send[0] & 0x0F;
+    if (opcode == opcode_wreg && reg == reg_mux) {
+        // MUX register: positive input in the high nibble.
+        selected = (send[2] >> 4) % inputs.size();
+    }
+}
+
+void send_receive_bytes_SPI(uint8_t* send, uint8_t* receive, uint32_t num) {
+    transfers++;
+    const uint8_t opcode = send[0] >> 4;
+    const uint8_t reg = send[0] & 0x0F;
+    if (opcode != opcode_rreg || reg != reg_data || num < 3) {
+        return;
+    }
+    const uint32_t code = static_cast<uint32_t>(inputs[selected].code);
+    receive[0] = static_cast<uint8_t>(code >> 16);
+    receive[1] = static_cast<uint8_t>(code >> 8);
+    receive[2] = static_cast<uint8_t>(code);
+}
+
+}  // extern "C"
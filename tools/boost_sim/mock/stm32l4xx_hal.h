@@ -0,0 +1,163 @@
+/**
+ * @file stm32l4xx_hal.h
+ * @brief Host stand-in for the STM32L4 HAL used by the boost simulator.
+ *
+ * Only the types, constants and calls reached by the control sources built
+ * into boost_sim are provided. TIM1 is a plain register block in host memory
+ * so the compare value the control code writes can be read back by the
+ * plant model.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+/* Timer ------------------------------------------------------------------*/
+
+typedef struct {
+    volatile uint32_t CR1;
+    volatile uint32_t PSC;
+    volatile uint32_t ARR;
+    volatile uint32_t RCR;
+    volatile uint32_t CCR1;
+    volatile uint32_t CCR2;
+    volatile uint32_t CCR3;
+    volatile uint32_t CCR4;
+} TIM_TypeDef;
+
+extern TIM_TypeDef sim_tim1;
+#define TIM1 (&sim_tim1)
+
+typedef struct {
+    uint32_t Prescaler;
+    uint32_t CounterMode;
+    uint32_t Period;
+    uint32_t ClockDivision;
+    uint32_t RepetitionCounter;
+    uint32_t AutoReloadPreload;
+} TIM_Base_InitTypeDef;
+
+typedef struct {
+    TIM_TypeDef* Instance;
+    TIM_Base_InitTypeDef Init;
+} TIM_HandleTypeDef;
+
+typedef struct {
+    uint32_t ClockSource;
+} TIM_ClockConfigTypeDef;
+
+typedef struct {
+    uint32_t MasterOutputTrigger;
+    uint32_t MasterOutputTrigger2;
+    uint32_t MasterSlaveMode;
+} TIM_MasterConfigTypeDef;
+
+typedef struct {
+    uint32_t OCMode;
+    uint32_t Pulse;
+    uint32_t OCPolarity;
+    uint32_t OCNPolarity;
+    uint32_t OCFastMode;
+    uint32_t OCIdleState;
+    uint32_t OCNIdleState;
+} TIM_OC_InitTypeDef;
+
+typedef struct {
+    uint32_t OffStateRunMode;
+    uint32_t OffStateIDLEMode;
+    uint32_t LockLevel;
+    uint32_t DeadTime;
+    uint32_t BreakState;
+    uint32_t BreakPolarity;
+    uint32_t BreakFilter;
+    uint32_t Break2State;
+    uint32_t Break2Polarity;
+    uint32_t Break2Filter;
+    uint32_t AutomaticOutput;
+} TIM_BreakDeadTimeConfigTypeDef;
+
+#define TIM_CHANNEL_1 0x00000000U
+#define TIM_CHANNEL_2 0x00000004U
+#define TIM_CHANNEL_3 0x00000008U
+#define TIM_CHANNEL_4 0x0000000CU
+
+#define TIM_COUNTERMODE_UP 0U
+#define TIM_CLOCKDIVISION_DIV1 0U
+#define TIM_AUTORELOAD_PRELOAD_ENABLE 1U
+#define TIM_CLOCKSOURCE_INTERNAL 0U
+#define TIM_TRGO_RESET 0U
+#define TIM_TRGO2_RESET 0U
+#define TIM_MASTERSLAVEMODE_DISABLE 0U
+#define TIM_OCMODE_PWM1 0U
+#define TIM_OCPOLARITY_HIGH 0U
+#define TIM_OCNPOLARITY_HIGH 0U
+#define TIM_OCFAST_DISABLE 0U
+#define TIM_OCIDLESTATE_RESET 0U
+#define TIM_OCNIDLESTATE_RESET 0U
+#define TIM_OSSR_DISABLE 0U
+#define TIM_OSSI_DISABLE 0U
+#define TIM_LOCKLEVEL_OFF 0U
+#define TIM_BREAK_DISABLE 0U
+#define TIM_BREAKPOLARITY_HIGH 0U
+#define TIM_BREAK2_DISABLE 0U
+#define TIM_BREAK2POLARITY_HIGH 0U
+#define TIM_AUTOMATICOUTPUT_DISABLE 0U
+
+#define __HAL_TIM_SET_COMPARE(__HANDLE__, __CHANNEL__, __COMPARE__) \
+    (*(&((__HANDLE__)->Instance->CCR1) + ((__CHANNEL__) >> 2U)) =   \
+         (__COMPARE__))
+#define __HAL_TIM_GET_AUTORELOAD(__HANDLE__) ((__HANDLE__)->Instance->ARR)
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIM_ConfigClockSource(
+    TIM_HandleTypeDef* htim, TIM_ClockConfigTypeDef* sClockSourceConfig);
+HAL_StatusTypeDef HAL_TIM_PWM_Init(TIM_HandleTypeDef* htim);
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(
+    TIM_HandleTypeDef* htim, TIM_MasterConfigTypeDef* sMasterConfig);
+HAL_StatusTypeDef HAL_TIM_PWM_ConfigChannel(TIM_HandleTypeDef* htim,
+                                            TIM_OC_InitTypeDef* sConfig,
+                                            uint32_t Channel);
+HAL_StatusTypeDef HAL_TIMEx_ConfigBreakDeadTime(
+    TIM_HandleTypeDef* htim,
+    TIM_BreakDeadTimeConfigTypeDef* sBreakDeadTimeConfig);
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* htim, uint32_t Channel);
+void HAL_TIM_MspPostInit(TIM_HandleTypeDef* htim);
+
+/* SPI / DMA --------------------------------------------------------------*/
+
+// The SPI-ADC is mocked at the send_bytes_SPI / send_receive_bytes_SPI level,
+// so the handles only have to exist.
+typedef struct {
+    void* Instance;
+} SPI_HandleTypeDef;
+
+typedef struct {
+    void* Instance;
+} DMA_HandleTypeDef;
+
+/* System -----------------------------------------------------------------*/
+
+#define __NVIC_PRIO_BITS 4U
+
+typedef int32_t IRQn_Type;
+
+uint32_t HAL_GetTick(void);
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority,
+                          uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+
+#ifdef __cplusplus
+}
+#endif
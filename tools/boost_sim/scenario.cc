@@ -0,0 +1,132 @@
+/**
+ * @file scenario.cc
+ * @brief Scenario file parser for the boost simulator.
+ */
+
+#include "scenario.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace umnsvp {
+namespace boost_sim {
+namespace {
+
+bool parse_fault(const std::string& name, fault_target& target) {
+    if (name == "vin") {
+        target = fault_target::VIN_SENSOR;
+    } else if (name == "vout") {
+        target = fault_target::VOUT_SENSOR;
+    } else if (name == "iout") {
+        target = fault_target::IOUT_SENSOR;
+    } else if (name == "short") {
+        target = fault_target::SHORT;
+    } else if (name == "open") {
+        target = fault_target::OPEN;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parse_signal(const std::string& name, expect_signal& signal) {
+    if (name == "vin") {
+        signal = expect_signal::VIN;
+    } else if (name == "vout") {
+        signal = expect_signal::VOUT;
+    } else if (name == "iout") {
+        signal = expect_signal::IOUT;
+    } else if (name == "duty") {
+        signal = expect_signal::DUTY;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool parse_line(std::istringstream& in, event& e) {
+    std::string type;
+    if (!(in >> e.time_s >> type)) {
+        return false;
+    }
+    if (type == "vin") {
+        e.type = event_type::VIN;
+        return static_cast<bool>(in >> e.value) && e.value >= 0.0f;
+    }
+    if (type == "load") {
+        e.type = event_type::LOAD;
+        return static_cast<bool>(in >> e.value) && e.value > 0.0f;
+    }
+    if (type == "fault") {
+        std::string target;
+        std::string state;
+        e.type = event_type::FAULT;
+        if (!(in >> target >> state) || !parse_fault(target, e.fault)) {
+            return false;
+        }
+        e.active = state == "on";
+        return e.active || state == "off";
+    }
+    if (type == "expect") {
+        std::string signal;
+        e.type = event_type::EXPECT;
+        return (in >> signal >> e.min >> e.max) &&
+               parse_signal(signal, e.signal) && e.min <= e.max;
+    }
+    if (type == "end") {
+        e.type = event_type::END;
+        return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+bool load_scenario(const std::string& path, std::vector<event>& events,
+                   std::string& error) {
+    std::ifstream file(path);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    events.clear();
+    std::string text;
+    int line = 0;
+    while (std::getline(file, text)) {
+        line++;
+        const std::size_t comment = text.find('#');
+        if (comment != std::string::npos) {
+            text.erase(comment);
+        }
+        if (text.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
+
+        std::istringstream in(text);
+        event e;
+        e.line = line;
+        if (!parse_line(in, e) || e.time_s < 0.0) {
+            error = path + ":" + std::to_string(line) + ": bad event";
+            return false;
+        }
+        events.push_back(e);
+    }
+
+    if (std::none_of(events.begin(), events.end(), [](const event& e) {
+            return e.type == event_type::END;
+        })) {
+        error = path + ": missing end event";
+        return false;
+    }
+
+    std::stable_sort(events.begin(), events.end(),
+                     [](const event& a, const event& b) {
+                         return a.time_s < b.time_s;
+                     });
+    return true;
+}
+
+}  // namespace boost_sim
+}  // namespace umnsvp
@@ -0,0 +1,59 @@
+/**
+ * @file scenario.h
+ * @brief Scripted events for the boost simulator.
+ *
+ * A scenario is a text file with one event per line, sorted by time:
+ *
+ *   # time_s  event      arguments
+ *   0.000     vin        24
+ *   0.000     load       24
+ *   0.300     load       12          # load step
+ *   0.500     vin        18          # line transient
+ *   0.700     fault      vout on     # freeze the Vout ADC input
+ *   0.750     fault      vout off
+ *   0.950     expect     vout 47 49  # fail the run if outside [47, 49] V
+ *   1.000     end
+ *
+ * Fault targets are the ADC inputs vin, vout and iout (stuck sensor) plus
+ * short and open on the load.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace umnsvp {
+namespace boost_sim {
+
+enum class event_type { VIN, LOAD, FAULT, EXPECT, END };
+
+enum class fault_target { VIN_SENSOR, VOUT_SENSOR, IOUT_SENSOR, SHORT, OPEN };
+
+enum class expect_signal { VIN, VOUT, IOUT, DUTY };
+
+struct event {
+    double time_s = 0.0;
+    event_type type = event_type::END;
+    float value = 0.0f;
+    fault_target fault = fault_target::VOUT_SENSOR;
+    bool active = false;
+    expect_signal signal = expect_signal::VOUT;
+    float min = 0.0f;
+    float max = 0.0f;
+    int line = 0;
+};
+
+/**
+ * @brief Parse a scenario file.
+ *
+ * @param path File to read.
+ * @param events Parsed events, sorted by time.
+ * @param error Description of the first problem found.
+ * @return bool false if the file could not be read or has a bad line.
+ */
+bool load_scenario(const std::string& path, std::vector<event>& events,
+                   std::string& error);
+
+}  // namespace boost_sim
+}  // namespace umnsvp
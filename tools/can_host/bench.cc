@@ -0,0 +1,234 @@
+/**
+ * @file bench.cc
+ * @brief CAN throughput bench for the host drivers.
+ *
+ * Two skylab2 board classes, a sender and a filtered receiver, run over
+ * the loopback bus or a SocketCAN interface. The sender pushes bursts of
+ * frames through send_packet() (and its priority TX queue when the batch is
+ * full), the receiver drains them with receive_burst() the way its RX
+ * interrupt would. Every frame carries a sequence number and its send time,
+ * so losses, reordering and the send to receive latency are measured.
+ *
+ * usage: can_bench [options]
+ *   --iface NAME    SocketCAN interface (default: the loopback bus)
+ *   --frames N      frames to send (default 1000000)
+ *   --ids N         distinct IDs, all received (default 32)
+ *   --burst N       frames sent between receiver runs (default 256)
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "host_irq.h"
+#include "loopback_bus.h"
+#include "micros.h"
+#include "skylab2_can_base.h"
+#include "skylab2_fields.h"
+#include "socketcan_driver.h"
+
+namespace umnsvp {
+namespace can_host {
+namespace {
+
+constexpr uint32_t first_id = 0x100;
+/// The receiver gives up once nothing arrives for this long.
+constexpr int idle_ms = 200;
+
+struct options {
+    std::string iface;
+    uint32_t frames = 1000000;
+    uint32_t ids = 32;
+    uint32_t burst = 256;
+};
+
+bool parse_args(int argc, char** argv, options& opts) {
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--iface") == 0 && has_value) {
+            opts.iface = argv[++i];
+        } else if (std::strcmp(argv[i], "--frames") == 0 && has_value) {
+            opts.frames = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--ids") == 0 && has_value) {
+            opts.ids = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--burst") == 0 && has_value) {
+            opts.burst = std::strtoul(argv[++i], nullptr, 10);
+        } else {
+            return false;
+        }
+    }
+    return opts.frames > 0 && opts.ids > 0 && opts.ids <= 0x600 &&
+           opts.burst > 0;
+}
+
+/**
+ * @brief A board class with nothing generated on it.
+ */
+class bench_node : public skylab2::basic_can_base<can::host_can_driver> {
+   public:
+    explicit bench_node(can::host_can_driver& driver)
+        : basic_can_base(driver, can::fifo::FIFO0) {
+    }
+};
+
+struct results {
+    uint32_t received = 0;
+    uint32_t out_of_order = 0;
+    uint32_t next_sequence = 0;
+    uint64_t total_latency_us = 0;
+    uint32_t max_latency_us = 0;
+    uint32_t observed = 0;
+
+    void record(const can::packet& packet) {
+        const uint32_t sequence =
+            skylab2::load_field<uint32_t, 0>(packet.get_data());
+        const uint32_t sent_us =
+            skylab2::load_field<uint32_t, 4>(packet.get_data());
+        if (sequence < next_sequence) {
+            out_of_order++;
+        }
+        next_sequence = std::max(next_sequence, sequence + 1);
+        const uint32_t latency = packet.get_timestamp() - sent_us;
+        total_latency_us += latency;
+        max_latency_us = std::max(max_latency_us, latency);
+        received++;
+    }
+
+    static void observe(void* self, const can::packet&) {
+        static_cast<results*>(self)->observed++;
+    }
+};
+
+/**
+ * @brief Move the sender's batch and queue onto the bus, as its TX
+ * interrupt would.
+ */
+void service_tx(bench_node& node, can::host_can_driver& driver) {
+    interrupt irq;
+    driver.flush();
+    while (driver.tx_it_enabled() && driver.tx_ready()) {
+        node.tx_handler();
+    }
+}
+
+/**
+ * @brief Drain the receiver, as its RX interrupt would.
+ */
+void service_rx(bench_node& node, results& counts) {
+    std::array<can::packet, can::host_batch> packets;
+    interrupt irq;
+    std::size_t count;
+    while ((count = node.receive_burst(packets)) > 0) {
+        for (std::size_t i = 0; i < count; i++) {
+            counts.record(packets[i]);
+        }
+    }
+}
+
+int run(const options& opts) {
+    can::loopback_bus bus;
+    std::unique_ptr<can::host_can_driver> tx_driver;
+    std::unique_ptr<can::host_can_driver> rx_driver;
+    if (opts.iface.empty()) {
+        tx_driver = std::make_unique<can::loopback_driver>(bus);
+        rx_driver = std::make_unique<can::loopback_driver>(bus);
+    } else {
+        tx_driver = std::make_unique<can::socketcan_driver>(opts.iface);
+        rx_driver = std::make_unique<can::socketcan_driver>(opts.iface);
+    }
+
+    bench_node sender(*tx_driver);
+    bench_node receiver(*rx_driver);
+    results counts;
+    receiver.add_rx_observer(&results::observe, &counts);
+
+    std::vector<uint32_t> ids(opts.ids);
+    for (uint32_t i = 0; i < opts.ids; i++) {
+        ids[i] = first_id + i;
+    }
+    // Nothing is received on the sender.
+    sender.init(can::baud_rate::BAUD_RATE_500, false, nullptr, 0);
+    receiver.init(can::baud_rate::BAUD_RATE_500, false, ids.data(),
+                  ids.size());
+    if (!tx_driver->is_started() || !rx_driver->is_started()) {
+        std::fprintf(stderr, "can_bench: cannot open the bus\n");
+        return 2;
+    }
+
+    uint32_t queued = 0;
+    uint32_t refused = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t sequence = 0; sequence < opts.frames;) {
+        const uint32_t end = std::min(opts.frames, sequence + opts.burst);
+        for (; sequence < end; sequence++) {
+            std::array<uint8_t, 8> data = {};
+            skylab2::store_field<uint32_t, 0>(data.data(), sequence);
+            skylab2::store_field<uint32_t, 4>(data.data(), time::micros());
+            const can::status result =
+                sender.send_packet(can::packet(ids[sequence % opts.ids], 8,
+                                               data.data()));
+            if (result == can::status::FULL) {
+                queued++;
+            } else if (result == can::status::ERROR) {
+                refused++;
+            }
+        }
+        service_tx(sender, *tx_driver);
+        service_rx(receiver, counts);
+    }
+    // Let the queue drain and the last frames arrive.
+    do {
+        service_tx(sender, *tx_driver);
+        service_rx(receiver, counts);
+    } while (tx_driver->tx_it_enabled() || rx_driver->wait(idle_ms));
+    const double wall_s =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                      start)
+            .count() -
+        idle_ms / 1000.0;
+
+    const uint32_t lost = opts.frames - counts.received;
+    std::printf("bus            %s\n",
+                opts.iface.empty() ? "loopback" : opts.iface.c_str());
+    std::printf("sent           %u\n", opts.frames);
+    std::printf("received       %u\n", counts.received);
+    std::printf("lost           %u\n", lost);
+    std::printf("out_of_order   %u\n", counts.out_of_order);
+    std::printf("tx_queued      %u\n", queued);
+    std::printf("tx_refused     %u\n", refused);
+    std::printf("observed       %u\n", counts.observed);
+    if (opts.iface.empty()) {
+        std::printf("bus_dropped    %llu\n",
+                    static_cast<unsigned long long>(bus.get_dropped()));
+    }
+    std::printf("frames_per_s   %.0f\n",
+                wall_s > 0.0 ? counts.received / wall_s : 0.0);
+    std::printf("latency_mean   %.1f us\n",
+                counts.received
+                    ? static_cast<double>(counts.total_latency_us) /
+                          counts.received
+                    : 0.0);
+    std::printf("latency_max    %u us\n", counts.max_latency_us);
+    return lost == 0 && counts.out_of_order == 0 ? 0 : 1;
+}
+
+}  // namespace
+}  // namespace can_host
+}  // namespace umnsvp
+
+int main(int argc, char** argv) {
+    umnsvp::can_host::options opts;
+    if (!umnsvp::can_host::parse_args(argc, argv, opts)) {
+        std::fprintf(stderr,
+                     "usage: can_bench [--iface NAME] [--frames N] [--ids N] "
+                     "[--burst N]\n");
+        return 2;
+    }
+    return umnsvp::can_host::run(opts);
+}
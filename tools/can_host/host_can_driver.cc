@@ -0,0 +1,361 @@
+/**
+ * @file host_can_driver.cc
+ * @brief Batched socket I/O shared by the Linux CAN drivers.
+ */
+
+#include "host_can_driver.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "micros.h"
+
+namespace umnsvp {
+namespace can {
+
+host_can_driver::host_can_driver() {
+    link(rx_frames, rx_vectors, rx_messages);
+    link(tx_frames, tx_vectors, tx_messages);
+}
+
+/**
+ * @brief Closes the socket. Derived drivers call stop() from their own
+ * destructor so their close_socket() still runs.
+ */
+host_can_driver::~host_can_driver() {
+    if (fd >= 0) {
+        ::close(fd);
+    }
+}
+
+/**
+ * @brief Point each message of a batch at its own frame, once, so a batch
+ * call only has to fill in frames.
+ */
+void host_can_driver::link(std::array<can_frame, host_batch>& frames,
+                           std::array<iovec, host_batch>& vectors,
+                           std::array<mmsghdr, host_batch>& messages) {
+    for (std::size_t i = 0; i < host_batch; i++) {
+        vectors[i] = {&frames[i], sizeof(can_frame)};
+        messages[i] = {};
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+}
+
+can_frame host_can_driver::to_frame(const packet& source) {
+    can_frame frame = {};
+    frame.can_id = source.is_extended()
+                       ? (source.get_id() & CAN_EFF_MASK) | CAN_EFF_FLAG
+                       : source.get_id() & CAN_SFF_MASK;
+    frame.can_dlc = source.get_length();
+    std::memcpy(frame.data, source.get_data(), source.get_length());
+    return frame;
+}
+
+packet host_can_driver::to_packet(const can_frame& source) {
+    const bool extended = (source.can_id & CAN_EFF_FLAG) != 0;
+    return packet(source.can_id & (extended ? CAN_EFF_MASK : CAN_SFF_MASK),
+                  std::min<uint8_t>(source.can_dlc, CAN_MAX_DLEN),
+                  source.data, extended);
+}
+
+HAL_StatusTypeDef host_can_driver::init(baud_rate baud_rate, bool extended) {
+    filter_extended = extended;
+    stats.set_rate(baud_rate);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef host_can_driver::start() {
+    if (fd >= 0) {
+        return HAL_OK;
+    }
+    fd = open_socket();
+    if (fd < 0) {
+        return HAL_ERROR;
+    }
+    filters_changed();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef host_can_driver::stop() {
+    if (fd < 0) {
+        return HAL_OK;
+    }
+    close_socket();
+    ::close(fd);
+    fd = -1;
+    tx_count = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef host_can_driver::filter_all() {
+    accept_all = true;
+    urgent_ids.clear();
+    bulk_ids.clear();
+    if (fd >= 0) {
+        filters_changed();
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef host_can_driver::filter_list(const uint32_t* ids,
+                                               std::size_t length,
+                                               bool is_extended) {
+    return filter_priority_list(nullptr, 0, ids, length, is_extended);
+}
+
+HAL_StatusTypeDef host_can_driver::filter_priority_list(
+    const uint32_t* urgent_ids, std::size_t urgent_length,
+    const uint32_t* bulk_ids, std::size_t bulk_length, bool is_extended) {
+    accept_all = false;
+    filter_extended = is_extended;
+    this->urgent_ids.assign(urgent_ids, urgent_ids + urgent_length);
+    this->bulk_ids.assign(bulk_ids, bulk_ids + bulk_length);
+    std::sort(this->urgent_ids.begin(), this->urgent_ids.end());
+    std::sort(this->bulk_ids.begin(), this->bulk_ids.end());
+    if (fd >= 0) {
+        filters_changed();
+    }
+    return HAL_OK;
+}
+
+/**
+ * @brief Apply the acceptance filter.
+ *
+ * @param destination Set to the FIFO the frame goes to.
+ * @return false The frame is filtered out.
+ */
+bool host_can_driver::accepts(uint32_t id, bool extended,
+                              fifo& destination) const {
+    destination = fifo::FIFO0;
+    if (accept_all) {
+        return true;
+    }
+    if (extended != filter_extended) {
+        return false;
+    }
+    if (std::binary_search(urgent_ids.begin(), urgent_ids.end(), id)) {
+        destination = fifo::FIFO1;
+        return true;
+    }
+    return std::binary_search(bulk_ids.begin(), bulk_ids.end(), id);
+}
+
+/**
+ * @brief Filter one frame into its receive FIFO, which must have room.
+ *
+ * @return false The frame was filtered out or is not a data frame.
+ */
+bool host_can_driver::accept(const can_frame& frame, uint32_t now_us) {
+    if ((frame.can_id & CAN_ERR_FLAG) != 0) {
+        error_frame(frame);
+        return false;
+    }
+    if ((frame.can_id & CAN_RTR_FLAG) != 0) {
+        return false;
+    }
+    packet received = to_packet(frame);
+    fifo destination;
+    if (!accepts(received.get_id(), received.is_extended(), destination)) {
+        return false;
+    }
+    received.set_timestamp(now_us);
+    rx_fifo& queue = fifos[static_cast<std::size_t>(destination)];
+    queue.packets[(queue.head + queue.count) % host_fifo_depth] = received;
+    queue.count++;
+    stats.record_rx(received);
+    return true;
+}
+
+/**
+ * @brief Room left in the fuller receive FIFO.
+ */
+std::size_t host_can_driver::rx_room() const {
+    return host_fifo_depth - std::max(fifos[0].count, fifos[1].count);
+}
+
+/**
+ * @brief Read every frame waiting on the socket into the receive FIFOs.
+ *
+ * Only as many frames are read as both FIFOs have room for, so a FIFO
+ * never overruns here; a slow reader leaves frames in the kernel's socket
+ * buffer instead, which drops them when it fills.
+ *
+ * @return std::size_t Frames accepted into a FIFO.
+ */
+std::size_t host_can_driver::poll_rx() {
+    if (fd < 0) {
+        return 0;
+    }
+    std::size_t accepted = 0;
+    while (true) {
+        const std::size_t room = std::min(host_batch, rx_room());
+        if (room == 0) {
+            break;
+        }
+        const int count = ::recvmmsg(fd, rx_messages.data(), room,
+                                     MSG_DONTWAIT, nullptr);
+        if (count <= 0) {
+            break;
+        }
+        const uint32_t now_us = time::micros();
+        for (int i = 0; i < count; i++) {
+            if (rx_messages[i].msg_len >= CAN_MTU &&
+                accept(rx_frames[i], now_us)) {
+                accepted++;
+            }
+        }
+        if (static_cast<std::size_t>(count) < room) {
+            break;
+        }
+    }
+    return accepted;
+}
+
+/**
+ * @brief Put frames straight into the receive FIFOs, as if they had just
+ * been read from the bus, without going through the socket.
+ *
+ * Frames are filtered and stamped with time::micros() as poll_rx() would.
+ * Used by log replay to feed a board far faster than any socket could.
+ *
+ * @return std::size_t Frames consumed from the front of frames; fewer than
+ * frames.size() once the FIFOs are full.
+ */
+std::size_t host_can_driver::inject(std::span<const can_frame> frames) {
+    const std::size_t count = std::min(frames.size(), rx_room());
+    const uint32_t now_us = time::micros();
+    for (std::size_t i = 0; i < count; i++) {
+        accept(frames[i], now_us);
+    }
+    return count;
+}
+
+status host_can_driver::receive(packet& received_packet, const fifo fifo) {
+    rx_fifo& queue = fifos[static_cast<std::size_t>(fifo)];
+    if (queue.count == 0) {
+        poll_rx();
+    }
+    if (queue.count == 0) {
+        return status::EMPTY;
+    }
+    received_packet = queue.packets[queue.head];
+    queue.head = (queue.head + 1) % host_fifo_depth;
+    queue.count--;
+    return status::OK;
+}
+
+std::size_t host_can_driver::receive_burst(std::span<packet> packets,
+                                           const fifo fifo) {
+    rx_fifo& queue = fifos[static_cast<std::size_t>(fifo)];
+    if (queue.count < packets.size()) {
+        poll_rx();
+    }
+    const std::size_t count = std::min(packets.size(), queue.count);
+    for (std::size_t i = 0; i < count; i++) {
+        packets[i] = queue.packets[queue.head];
+        queue.head = (queue.head + 1) % host_fifo_depth;
+    }
+    queue.count -= count;
+    return count;
+}
+
+/**
+ * @brief Add the frame to the TX batch.
+ *
+ * @return status OK if batched, FULL if the batch is full and the socket
+ * would not take it, ERROR if the driver is not started.
+ */
+status host_can_driver::send(const packet& send_packet) {
+    if (fd < 0) {
+        return status::ERROR;
+    }
+    if (tx_count == host_batch) {
+        flush();
+        if (tx_count == host_batch) {
+            return status::FULL;
+        }
+    }
+    tx_frames[tx_count] = to_frame(send_packet);
+    tx_count++;
+    stats.record_tx(send_packet);
+    return status::OK;
+}
+
+int host_can_driver::transmit(mmsghdr* messages, unsigned count) {
+    return ::sendmmsg(fd, messages, count, MSG_DONTWAIT);
+}
+
+/**
+ * @brief Send the TX batch. Frames the socket does not take stay batched,
+ * in order, for the next flush().
+ *
+ * @return std::size_t Frames sent.
+ */
+std::size_t host_can_driver::flush() {
+    std::size_t sent = 0;
+    while (fd >= 0 && sent < tx_count) {
+        const int count = transmit(tx_messages.data() + sent,
+                                   static_cast<unsigned>(tx_count - sent));
+        if (count <= 0) {
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        sent += static_cast<std::size_t>(count);
+    }
+    if (sent > 0) {
+        std::copy(tx_frames.begin() + sent, tx_frames.begin() + tx_count,
+                  tx_frames.begin());
+        tx_count -= sent;
+    }
+    return sent;
+}
+
+/**
+ * @brief Sleep until a frame is waiting on the socket or either FIFO.
+ *
+ * @return false Nothing arrived within timeout_ms, or the driver is stopped.
+ */
+bool host_can_driver::wait(int timeout_ms) {
+    if (fifos[0].count > 0 || fifos[1].count > 0) {
+        return true;
+    }
+    if (fd < 0) {
+        return false;
+    }
+    pollfd readable = {fd, POLLIN, 0};
+    return ::poll(&readable, 1, timeout_ms) > 0 &&
+           (readable.revents & POLLIN) != 0;
+}
+
+error_state host_can_driver::get_error_state() {
+    return errors;
+}
+
+void host_can_driver::handle_error() {
+}
+
+void host_can_driver::enable_tx_it() {
+    tx_it = true;
+}
+
+void host_can_driver::disable_tx_it() {
+    tx_it = false;
+}
+
+/**
+ * @brief True once the TX batch has been flushed to the socket.
+ */
+bool host_can_driver::tx_idle() {
+    return tx_count == 0;
+}
+
+}  // namespace can
+}  // namespace umnsvp
@@ -0,0 +1,232 @@
+/**
+ * @file host_can_driver.h
+ * @brief Base of the Linux CAN drivers: batched socket I/O behind
+ * can_driver_base.
+ */
+
+#pragma once
+
+#include <linux/can.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "can_driver_base.h"
+
+namespace umnsvp {
+namespace can {
+
+/// Frames moved per recvmmsg()/sendmmsg() call.
+constexpr std::size_t host_batch = 64;
+
+/// Depth of each software receive FIFO.
+constexpr std::size_t host_fifo_depth = 256;
+
+/**
+ * @brief A can_driver_base over a non-blocking socket of struct can_frame
+ * datagrams, for running board code on Linux.
+ *
+ * There is no interrupt to drive the driver, so the host program runs the
+ * loop the hardware would:
+ * - send() only adds the frame to a TX batch; flush() hands the whole batch
+ *   to the kernel in one sendmmsg(). A full batch that cannot be flushed
+ *   reports FULL, like a controller with every mailbox busy, and the board
+ *   class queues the frame. While tx_it_enabled(), call the board's
+ *   tx_handler() after each flush().
+ * - poll_rx() reads every waiting frame with recvmmsg(), up to host_batch
+ *   per call, applies the acceptance filter and sorts the frames into the
+ *   two FIFOs, stamped with time::micros(). receive() and receive_burst()
+ *   call it when their FIFO is empty.
+ * Run whatever would be an interrupt handler inside a can_host::interrupt
+ * so the firmware's critical sections still hold.
+ *
+ * The acceptance filter is exact (an ID list, urgent IDs to FIFO1) rather
+ * than built from filter banks, so it never widens to accept other IDs.
+ *
+ * Example Usage:
+   ........................
+   can::socketcan_driver driver("vcan0");
+   board.init(can::baud_rate::BAUD_RATE_500, false, ids, count);
+   ........................
+   while (driver.wait(10)) {
+       can_host::interrupt irq;
+       board.receive_burst(packets);
+       driver.flush();
+       while (driver.tx_it_enabled() && driver.tx_ready()) {
+           board.tx_handler();
+       }
+   }
+   ........................
+ */
+class host_can_driver : public can_driver_base {
+   private:
+    int fd = -1;
+    bool accept_all = true;
+    bool filter_extended = false;
+    /// Sorted; urgent IDs go to FIFO1.
+    std::vector<uint32_t> urgent_ids;
+    std::vector<uint32_t> bulk_ids;
+
+    struct rx_fifo {
+        std::array<packet, host_fifo_depth> packets;
+        std::size_t head = 0;
+        std::size_t count = 0;
+    };
+    std::array<rx_fifo, 2> fifos;
+
+    std::array<can_frame, host_batch> rx_frames = {};
+    std::array<iovec, host_batch> rx_vectors = {};
+    std::array<mmsghdr, host_batch> rx_messages = {};
+
+    std::array<can_frame, host_batch> tx_frames = {};
+    std::array<iovec, host_batch> tx_vectors = {};
+    std::array<mmsghdr, host_batch> tx_messages = {};
+    std::size_t tx_count = 0;
+
+    bool tx_it = false;
+
+    bool accepts(uint32_t id, bool extended, fifo& destination) const;
+    bool accept(const can_frame& frame, uint32_t now_us);
+    std::size_t rx_room() const;
+    static void link(std::array<can_frame, host_batch>& frames,
+                     std::array<iovec, host_batch>& vectors,
+                     std::array<mmsghdr, host_batch>& messages);
+
+   protected:
+    /**
+     * @brief Fault confinement state, kept by drivers whose bus reports it.
+     */
+    error_state errors = {};
+
+    /**
+     * @brief Open the non-blocking socket the driver reads and writes.
+     *
+     * @return int The descriptor, or -1.
+     */
+    virtual int open_socket() = 0;
+
+    /**
+     * @brief Release what open_socket() set up. The descriptor is closed by
+     * the base class.
+     */
+    virtual void close_socket() {
+    }
+
+    /**
+     * @brief Hand frames to the bus.
+     *
+     * @return int Number of frames taken, or -1 with errno set.
+     */
+    virtual int transmit(mmsghdr* messages, unsigned count);
+
+    /**
+     * @brief Called when the acceptance filter changes while the socket is
+     * open, and once after it is opened.
+     */
+    virtual void filters_changed() {
+    }
+
+    /**
+     * @brief Handle a frame with CAN_ERR_FLAG set.
+     */
+    virtual void error_frame(const can_frame&) {
+    }
+
+    int get_fd() const {
+        return fd;
+    }
+
+    bool accepts_all() const {
+        return accept_all;
+    }
+
+    bool filters_extended() const {
+        return filter_extended;
+    }
+
+    const std::vector<uint32_t>& get_urgent_ids() const {
+        return urgent_ids;
+    }
+
+    const std::vector<uint32_t>& get_bulk_ids() const {
+        return bulk_ids;
+    }
+
+   public:
+    host_can_driver();
+    virtual ~host_can_driver();
+
+    host_can_driver(const host_can_driver&) = delete;
+    host_can_driver& operator=(const host_can_driver&) = delete;
+
+    /**
+     * @brief The bit rate is set on the interface (ip link); it is only
+     * used here for the bus load statistics.
+     */
+    HAL_StatusTypeDef init(baud_rate baud_rate, bool extended) override;
+    HAL_StatusTypeDef start() override;
+    HAL_StatusTypeDef stop() override;
+    HAL_StatusTypeDef filter_all() override;
+    HAL_StatusTypeDef filter_list(const uint32_t* ids, std::size_t length,
+                                  bool is_extended = false) override;
+    HAL_StatusTypeDef filter_priority_list(const uint32_t* urgent_ids,
+                                           std::size_t urgent_length,
+                                           const uint32_t* bulk_ids,
+                                           std::size_t bulk_length,
+                                           bool is_extended = false) override;
+    status send(const packet& send_packet) override;
+    status receive(packet& received_packet,
+                   const fifo fifo = fifo::FIFO0) override;
+    std::size_t receive_burst(std::span<packet> packets,
+                              const fifo fifo = fifo::FIFO0) override;
+    error_state get_error_state() override;
+    void handle_error() override;
+    void enable_tx_it() override;
+    void disable_tx_it() override;
+    bool tx_idle() override;
+
+    std::size_t poll_rx();
+    std::size_t inject(std::span<const can_frame> frames);
+    std::size_t flush();
+    bool wait(int timeout_ms);
+
+    /**
+     * @brief True once start() has opened the socket.
+     */
+    bool is_started() const {
+        return fd >= 0;
+    }
+
+    /**
+     * @brief True while the board class has frames queued and wants
+     * tx_handler() called.
+     */
+    bool tx_it_enabled() const {
+        return tx_it;
+    }
+
+    /**
+     * @brief True if send() would take another frame without flushing.
+     */
+    bool tx_ready() const {
+        return tx_count < host_batch;
+    }
+
+    /**
+     * @brief Frames waiting in a receive FIFO.
+     */
+    std::size_t rx_pending(fifo fifo = fifo::FIFO0) const {
+        return fifos[static_cast<std::size_t>(fifo)].count;
+    }
+
+    static can_frame to_frame(const packet& source);
+    static packet to_packet(const can_frame& source);
+};
+
+}  // namespace can
+}  // namespace umnsvp
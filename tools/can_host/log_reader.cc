@@ -0,0 +1,404 @@
+/**
+ * @file log_reader.cc
+ * @brief Streaming reader of recorded CAN logs.
+ */
+
+#include "log_reader.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <array>
+#include <cstring>
+
+namespace umnsvp {
+namespace can_host {
+
+namespace {
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\0';
+}
+
+void skip_spaces(const char*& p, const char* end) {
+    while (p < end && is_space(*p)) {
+        p++;
+    }
+}
+
+/**
+ * @brief Parse `seconds[.fraction]` into microseconds; digits past the
+ * sixth decimal are dropped.
+ */
+bool parse_seconds(const char*& p, const char* end, uint64_t& time_us) {
+    const char* start = p;
+    uint64_t seconds = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        seconds = seconds * 10 + static_cast<uint64_t>(*p - '0');
+        p++;
+    }
+    uint64_t fraction = 0;
+    uint64_t scale = 1000000;
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (scale > 1) {
+                scale /= 10;
+                fraction += static_cast<uint64_t>(*p - '0') * scale;
+            }
+            p++;
+        }
+    }
+    time_us = seconds * 1000000 + fraction;
+    return p > start;
+}
+
+/**
+ * @brief Parse a decimal field, skipping the NULs SD card logs are padded
+ * with.
+ */
+bool parse_decimal(const char*& p, const char* end, uint32_t& value) {
+    bool digits = false;
+    value = 0;
+    for (; p < end; p++) {
+        if (*p >= '0' && *p <= '9') {
+            value = value * 10 + static_cast<uint32_t>(*p - '0');
+            digits = true;
+        } else if (*p != '\0') {
+            break;
+        }
+    }
+    return digits;
+}
+
+/**
+ * @brief Parse up to max_digits hex digits.
+ *
+ * @param digits Set to the number of digits read.
+ */
+bool parse_hex(const char*& p, const char* end, std::size_t max_digits,
+               uint32_t& value, std::size_t& digits) {
+    value = 0;
+    digits = 0;
+    for (; p < end && digits < max_digits; p++) {
+        const int nibble = hex_value(*p);
+        if (nibble < 0) {
+            if (*p == '\0') {
+                continue;
+            }
+            break;
+        }
+        value = (value << 4) | static_cast<uint32_t>(nibble);
+        digits++;
+    }
+    return digits > 0;
+}
+
+/**
+ * @brief Parse hex byte pairs up to a character that is not a hex digit.
+ */
+bool parse_data(const char*& p, const char* end, can_frame& frame) {
+    std::size_t nibbles = 0;
+    uint8_t byte = 0;
+    for (; p < end; p++) {
+        const int nibble = hex_value(*p);
+        if (nibble < 0) {
+            if (*p == '\0') {
+                continue;
+            }
+            break;
+        }
+        byte = static_cast<uint8_t>((byte << 4) | nibble);
+        nibbles++;
+        if (nibbles % 2 == 0) {
+            if (nibbles / 2 > CAN_MAX_DLEN) {
+                return false;
+            }
+            frame.data[nibbles / 2 - 1] = byte;
+            byte = 0;
+        }
+    }
+    frame.can_dlc = static_cast<uint8_t>(nibbles / 2);
+    return nibbles % 2 == 0;
+}
+
+/**
+ * @brief Set the ID, extended if it does not fit in 11 bits.
+ */
+void set_id(can_frame& frame, uint32_t id) {
+    frame.can_id = id > CAN_SFF_MASK ? (id & CAN_EFF_MASK) | CAN_EFF_FLAG : id;
+}
+
+/**
+ * @brief Days from 1970-01-01 to a civil date.
+ */
+int64_t days_from_civil(int64_t year, uint32_t month, uint32_t day) {
+    year -= month <= 2 ? 1 : 0;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const int64_t year_of_era = year - era * 400;
+    const int64_t day_of_year =
+        (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int64_t day_of_era = year_of_era * 365 + year_of_era / 4 -
+                               year_of_era / 100 + day_of_year;
+    return era * 146097 + day_of_era - 719468;
+}
+
+}  // namespace
+
+log_reader::~log_reader() {
+    close();
+}
+
+/**
+ * @brief Map a log and detect its format from the first line.
+ *
+ * @return false The file cannot be opened or mapped.
+ */
+bool log_reader::open(const char* path) {
+    close();
+    fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (::fstat(fd, &info) < 0) {
+        close();
+        return false;
+    }
+    length = static_cast<std::size_t>(info.st_size);
+    if (length > 0) {
+        void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close();
+            return false;
+        }
+        ::madvise(mapping, length, MADV_SEQUENTIAL);
+        begin = static_cast<const char*>(mapping);
+    }
+    end = begin + length;
+    rewind();
+    detect_format();
+    return true;
+}
+
+void log_reader::close() {
+    if (begin != nullptr) {
+        ::munmap(const_cast<char*>(begin), length);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    fd = -1;
+    begin = end = cursor = nullptr;
+    length = 0;
+}
+
+/**
+ * @brief Start reading from the first line again.
+ */
+void log_reader::rewind() {
+    cursor = begin;
+    malformed = 0;
+    lines = 0;
+}
+
+void log_reader::set_format(log_format format) {
+    this->format = format;
+}
+
+/**
+ * @brief Pick the format from the first non-empty line: candump lines
+ * start with the parenthesised time, SD card lines are comma separated and
+ * anything else is taken as ptelem.
+ *
+ * @return false The log has no non-empty line.
+ */
+bool log_reader::detect_format() {
+    const char* p = begin;
+    while (p < end) {
+        const char* eol = static_cast<const char*>(
+            std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+        if (eol == nullptr) {
+            eol = end;
+        }
+        skip_spaces(p, eol);
+        if (p < eol) {
+            if (*p == '(') {
+                format = log_format::CANDUMP;
+            } else if (std::memchr(p, ',', static_cast<std::size_t>(
+                                               eol - p)) != nullptr) {
+                format = log_format::SD_CSV;
+            } else {
+                format = log_format::PTELEM;
+            }
+            return true;
+        }
+        p = eol + 1;
+    }
+    return false;
+}
+
+bool log_reader::parse_ptelem(const char* p, const char* eol,
+                              log_frame& out) const {
+    if (!parse_seconds(p, eol, out.time_us)) {
+        return false;
+    }
+    skip_spaces(p, eol);
+    uint32_t id;
+    std::size_t digits;
+    // The ID is always the first 3 digits, with the data straight after.
+    if (!parse_hex(p, eol, 3, id, digits) || digits != 3) {
+        return false;
+    }
+    out.frame.can_id = id;
+    if (!parse_data(p, eol, out.frame)) {
+        return false;
+    }
+    skip_spaces(p, eol);
+    return p == eol;
+}
+
+bool log_reader::parse_sd(const char* p, const char* eol,
+                          log_frame& out) const {
+    std::array<uint32_t, 7> fields;
+    for (uint32_t& field : fields) {
+        if (!parse_decimal(p, eol, field) || p == eol || *p != ',') {
+            return false;
+        }
+        p++;
+    }
+    const auto [year, month, day, hour, minute, second, millisecond] = fields;
+    if (month < 1 || month > 12 || day < 1 || day > 31) {
+        return false;
+    }
+    uint64_t micro = static_cast<uint64_t>(millisecond) * 1000;
+    // Same as parse_can_log.py, which clamps 1000 ms to the last us.
+    if (micro == 1000000) {
+        micro -= 1;
+    }
+    const int64_t days = days_from_civil(year, month, day);
+    out.time_us = static_cast<uint64_t>(
+                      ((days * 24 + hour) * 60 + minute) * 60 + second) *
+                      1000000 +
+                  micro;
+
+    uint32_t id;
+    std::size_t digits;
+    if (!parse_hex(p, eol, 8, id, digits) || p == eol || *p != ',') {
+        return false;
+    }
+    p++;
+    set_id(out.frame, id);
+    if (!parse_data(p, eol, out.frame)) {
+        return false;
+    }
+    skip_spaces(p, eol);
+    return p == eol;
+}
+
+bool log_reader::parse_candump(const char* p, const char* eol,
+                               log_frame& out) const {
+    if (*p != '(') {
+        return false;
+    }
+    p++;
+    if (!parse_seconds(p, eol, out.time_us) || p == eol || *p != ')') {
+        return false;
+    }
+    p++;
+    skip_spaces(p, eol);
+    // Interface name, not needed.
+    while (p < eol && !is_space(*p)) {
+        p++;
+    }
+    skip_spaces(p, eol);
+    uint32_t id;
+    std::size_t digits;
+    if (!parse_hex(p, eol, 8, id, digits) || p == eol || *p != '#') {
+        return false;
+    }
+    p++;
+    // candump prints extended IDs with 8 digits.
+    out.frame.can_id =
+        digits > 3 ? (id & CAN_EFF_MASK) | CAN_EFF_FLAG : id & CAN_SFF_MASK;
+    if (p < eol && *p == 'R') {
+        out.frame.can_id |= CAN_RTR_FLAG;
+        out.frame.can_dlc = 0;
+        return true;
+    }
+    if (p < eol && *p == '#') {
+        // CAN FD: skip the flags digit; payloads over 8 bytes fail below.
+        p += 2;
+        if (p > eol) {
+            return false;
+        }
+    }
+    if (!parse_data(p, eol, out.frame)) {
+        return false;
+    }
+    skip_spaces(p, eol);
+    return p == eol;
+}
+
+/**
+ * @brief Read the next frames of the log.
+ *
+ * @return std::size_t Frames written to the front of frames; 0 at the end
+ * of the log.
+ */
+std::size_t log_reader::read(std::span<log_frame> frames) {
+    std::size_t count = 0;
+    while (cursor < end && count < frames.size()) {
+        const char* eol = static_cast<const char*>(
+            std::memchr(cursor, '\n', static_cast<std::size_t>(end - cursor)));
+        if (eol == nullptr) {
+            eol = end;
+        }
+        const char* p = cursor;
+        cursor = eol < end ? eol + 1 : end;
+        skip_spaces(p, eol);
+        if (p == eol) {
+            continue;
+        }
+        lines++;
+
+        log_frame& out = frames[count];
+        out.frame = {};
+        bool parsed;
+        switch (format) {
+            case log_format::SD_CSV:
+                parsed = parse_sd(p, eol, out);
+                break;
+            case log_format::CANDUMP:
+                parsed = parse_candump(p, eol, out);
+                break;
+            default:
+                parsed = parse_ptelem(p, eol, out);
+                break;
+        }
+        if (parsed) {
+            count++;
+        } else {
+            malformed++;
+        }
+    }
+    return count;
+}
+
+}  // namespace can_host
+}  // namespace umnsvp
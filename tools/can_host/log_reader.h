@@ -0,0 +1,128 @@
+/**
+ * @file log_reader.h
+ * @brief Streaming reader of recorded CAN logs.
+ */
+
+#pragma once
+
+#include <linux/can.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace umnsvp {
+namespace can_host {
+
+/**
+ * @brief The log formats tools/can_packet_parser/parse_can_log.py reads.
+ */
+enum class log_format
+{
+    /**
+     * @brief server.py telemetry log: `1689000000.123 1A40011223344` with the
+     * 3 digit ID and the data run together.
+     */
+    PTELEM,
+    /**
+     * @brief Telemetry SD card CSV: `2023,7,14,10,22,33,123,1A4,00112233`,
+     * local date and time to the ms, padded with NULs.
+     */
+    SD_CSV,
+    /**
+     * @brief candump -L: `(1689000000.123456) can0 1A4#00112233`.
+     */
+    CANDUMP,
+};
+
+/**
+ * @brief One recorded frame.
+ */
+struct log_frame {
+    /// Recording time in us, on the log's own clock.
+    uint64_t time_us;
+    can_frame frame;
+};
+
+/**
+ * @brief Reads the frames of a CAN log straight out of a memory mapping.
+ *
+ * The whole file is mapped read only and tokenized in place, one line per
+ * frame, with hand-written decimal and hex parsing: nothing is copied and
+ * nothing is allocated per frame, so a day of logging reads at memory
+ * speed. Lines that do not parse are counted and skipped, as
+ * parse_can_log.py prints and skips them.
+ *
+ * Example Usage:
+   ........................
+   can_host::log_reader reader;
+   if (!reader.open("race_day.txt")) {
+       ...
+   }
+   std::array<can_host::log_frame, 256> frames;
+   std::size_t count;
+   while ((count = reader.read(frames)) > 0) {
+       ...
+   }
+   ........................
+ */
+class log_reader {
+   private:
+    int fd = -1;
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    const char* cursor = nullptr;
+    std::size_t length = 0;
+
+    log_format format = log_format::PTELEM;
+    uint64_t malformed = 0;
+    uint64_t lines = 0;
+
+    bool parse_ptelem(const char* p, const char* eol, log_frame& out) const;
+    bool parse_sd(const char* p, const char* eol, log_frame& out) const;
+    bool parse_candump(const char* p, const char* eol,
+                       log_frame& out) const;
+
+   public:
+    log_reader() = default;
+    ~log_reader();
+
+    log_reader(const log_reader&) = delete;
+    log_reader& operator=(const log_reader&) = delete;
+
+    bool open(const char* path);
+    void close();
+    void rewind();
+    void set_format(log_format format);
+    bool detect_format();
+
+    std::size_t read(std::span<log_frame> frames);
+
+    log_format get_format() const {
+        return format;
+    }
+
+    /**
+     * @brief Lines skipped because they did not parse.
+     */
+    uint64_t get_malformed() const {
+        return malformed;
+    }
+
+    /**
+     * @brief Non-empty lines read so far.
+     */
+    uint64_t get_lines() const {
+        return lines;
+    }
+
+    /**
+     * @brief Bytes in the log.
+     */
+    std::size_t size() const {
+        return length;
+    }
+};
+
+}  // namespace can_host
+}  // namespace umnsvp
@@ -0,0 +1,111 @@
+/**
+ * @file loopback_bus.cc
+ * @brief In-process CAN bus for host builds that need no kernel module.
+ */
+
+#include "loopback_bus.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+
+namespace umnsvp {
+namespace can {
+
+namespace {
+
+/// Socket buffer per node; a datagram costs more than its 16 bytes.
+constexpr int socket_buffer_bytes = 4 * 1024 * 1024;
+
+}  // namespace
+
+/**
+ * @brief Add a node to the bus.
+ *
+ * @return int The node's read end, or -1 if the bus is full.
+ */
+int loopback_bus::join(loopback_driver* driver) {
+    int pair[2];
+    if (::socketpair(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0,
+                     pair) < 0) {
+        std::perror("loopback_bus: socketpair");
+        return -1;
+    }
+    ::setsockopt(pair[0], SOL_SOCKET, SO_RCVBUF, &socket_buffer_bytes,
+                 sizeof(socket_buffer_bytes));
+    ::setsockopt(pair[1], SOL_SOCKET, SO_SNDBUF, &socket_buffer_bytes,
+                 sizeof(socket_buffer_bytes));
+
+    std::lock_guard<std::mutex> guard(lock);
+    for (node& slot : nodes) {
+        if (slot.driver == nullptr) {
+            slot = {driver, pair[1]};
+            return pair[0];
+        }
+    }
+    ::close(pair[0]);
+    ::close(pair[1]);
+    std::fprintf(stderr, "loopback_bus: more than %zu nodes\n", max_nodes);
+    return -1;
+}
+
+void loopback_bus::leave(loopback_driver* driver) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (node& slot : nodes) {
+        if (slot.driver == driver) {
+            ::close(slot.inject);
+            slot = {};
+        }
+    }
+}
+
+/**
+ * @brief Deliver a batch to every node but the sender.
+ *
+ * @return int Always count; the bus itself never refuses a frame.
+ */
+int loopback_bus::broadcast(const loopback_driver* from, mmsghdr* messages,
+                            unsigned count) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (const node& slot : nodes) {
+        if (slot.driver == nullptr || slot.driver == from) {
+            continue;
+        }
+        unsigned sent = 0;
+        while (sent < count) {
+            const int result = ::sendmmsg(slot.inject, messages + sent,
+                                          count - sent, MSG_DONTWAIT);
+            if (result <= 0) {
+                break;
+            }
+            sent += static_cast<unsigned>(result);
+        }
+        if (sent < count) {
+            dropped.fetch_add(count - sent, std::memory_order_relaxed);
+        }
+    }
+    return static_cast<int>(count);
+}
+
+loopback_driver::loopback_driver(loopback_bus& bus) : bus(bus) {
+}
+
+loopback_driver::~loopback_driver() {
+    stop();
+}
+
+int loopback_driver::open_socket() {
+    return bus.join(this);
+}
+
+void loopback_driver::close_socket() {
+    bus.leave(this);
+}
+
+int loopback_driver::transmit(mmsghdr* messages, unsigned count) {
+    return bus.broadcast(this, messages, count);
+}
+
+}  // namespace can
+}  // namespace umnsvp
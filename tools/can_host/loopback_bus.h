@@ -0,0 +1,89 @@
+/**
+ * @file loopback_bus.h
+ * @brief In-process CAN bus for host builds that need no kernel module.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "host_can_driver.h"
+
+namespace umnsvp {
+namespace can {
+
+class loopback_driver;
+
+/**
+ * @brief A CAN bus shared by the loopback_drivers of one process.
+ *
+ * Every node reads a datagram socketpair of its own; a node's flush()
+ * writes its TX batch to every other node's socket with one sendmmsg()
+ * each, so a batch costs one system call per receiving node and nothing
+ * else on the bus. As on SocketCAN, a node does not receive its own frames.
+ *
+ * The bus has no arbitration and no bit timing: frames arrive in the order
+ * they were flushed, as fast as the nodes can move them, which is what a
+ * load test wants. A node whose socket is full misses the frames, as a
+ * controller with a full FIFO would; get_dropped() counts them.
+ *
+ * Example Usage:
+   ........................
+   can::loopback_bus bus;
+   can::loopback_driver vcu_driver(bus);
+   can::loopback_driver lights_driver(bus);
+   ........................
+ */
+class loopback_bus {
+   public:
+    static constexpr std::size_t max_nodes = 16;
+
+    /**
+     * @brief Frames lost because a node's receive socket was full.
+     */
+    uint64_t get_dropped() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+   private:
+    friend class loopback_driver;
+
+    struct node {
+        loopback_driver* driver = nullptr;
+        /// Write end of the node's socketpair.
+        int inject = -1;
+    };
+
+    std::mutex lock;
+    std::array<node, max_nodes> nodes;
+    std::atomic<uint64_t> dropped = 0;
+
+    int join(loopback_driver* driver);
+    void leave(loopback_driver* driver);
+    int broadcast(const loopback_driver* from, mmsghdr* messages,
+                  unsigned count);
+};
+
+/**
+ * @brief A driver for one node on a loopback_bus.
+ */
+class loopback_driver final : public host_can_driver {
+   private:
+    loopback_bus& bus;
+
+   protected:
+    int open_socket() override;
+    void close_socket() override;
+    int transmit(mmsghdr* messages, unsigned count) override;
+
+   public:
+    explicit loopback_driver(loopback_bus& bus);
+    ~loopback_driver() override;
+};
+
+}  // namespace can
+}  // namespace umnsvp
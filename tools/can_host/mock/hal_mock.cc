@@ -0,0 +1,154 @@
+/**
+ * @file hal_mock.cc
+ * @brief Host implementation of the HAL tick, micros(), the interrupt
+ * mask and PendSV.
+ *
+ * Both clocks count from start up on the monotonic clock, or follow the
+ * time given to hold_clock(), and wrap exactly as the target's do.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "deferred_work.h"
+#include "host_clock.h"
+#include "host_irq.h"
+#include "micros.h"
+#include "stm32l4xx_hal.h"
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+const clock_type::time_point boot = clock_type::now();
+
+std::atomic<bool> held = false;
+std::atomic<uint64_t> held_us = 0;
+
+uint64_t now_us() {
+    if (held.load(std::memory_order_acquire)) {
+        return held_us.load(std::memory_order_relaxed);
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               clock_type::now() - boot)
+        .count();
+}
+
+/// Held by whichever thread has "interrupts" masked.
+std::mutex mask_lock;
+thread_local bool masked = false;
+
+/// Counts finished interrupts, for __WFI().
+std::mutex wake_lock;
+std::condition_variable wake;
+uint64_t interrupts = 0;
+
+}  // namespace
+
+namespace umnsvp {
+namespace time {
+
+uint32_t micros() {
+    return static_cast<uint32_t>(now_us());
+}
+
+}  // namespace time
+
+namespace can_host {
+
+void hold_clock(uint64_t time_us) {
+    held_us.store(time_us, std::memory_order_relaxed);
+    held.store(true, std::memory_order_release);
+}
+
+void release_clock() {
+    held.store(false, std::memory_order_release);
+}
+
+interrupt::interrupt() : primask(__get_PRIMASK()) {
+    __disable_irq();
+}
+
+interrupt::~interrupt() {
+    // PendSV is the lowest tier: it tail-chains once the outermost handler
+    // is done, still with the other "interrupts" held off.
+    if (primask == 0) {
+        while ((SCB->ICSR & SCB_ICSR_PENDSVSET_Msk) != 0) {
+            SCB->ICSR = 0;
+            irq::run_deferred();
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(wake_lock);
+        interrupts++;
+    }
+    __set_PRIMASK(primask);
+    wake.notify_all();
+}
+
+}  // namespace can_host
+}  // namespace umnsvp
+
+extern "C" {
+
+SCB_Type host_scb = {};
+
+void HAL_NVIC_SetPriority(IRQn_Type, uint32_t, uint32_t) {
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type) {
+}
+
+uint32_t HAL_GetTick(void) {
+    return static_cast<uint32_t>(now_us() / 1000U);
+}
+
+uint32_t __get_PRIMASK(void) {
+    return masked ? 1U : 0U;
+}
+
+void __set_PRIMASK(uint32_t priMask) {
+    if (priMask != 0) {
+        __disable_irq();
+    } else {
+        __enable_irq();
+    }
+}
+
+void __disable_irq(void) {
+    if (!masked) {
+        mask_lock.lock();
+        masked = true;
+    }
+}
+
+void __enable_irq(void) {
+    if (masked) {
+        masked = false;
+        mask_lock.unlock();
+    }
+}
+
+void __WFI(void) {
+    const bool was_masked = masked;
+    uint64_t seen;
+    {
+        std::lock_guard<std::mutex> lock(wake_lock);
+        seen = interrupts;
+    }
+    // On the core a masked interrupt still ends WFI and runs once the
+    // caller unmasks; here the lock must be released for it to run at all.
+    __enable_irq();
+    {
+        std::unique_lock<std::mutex> lock(wake_lock);
+        wake.wait_for(lock, std::chrono::milliseconds(1),
+                      [seen] { return interrupts != seen; });
+    }
+    if (was_masked) {
+        __disable_irq();
+    }
+}
+
+}  // extern "C"
@@ -0,0 +1,29 @@
+/**
+ * @file host_clock.h
+ * @brief Control of the time HAL_GetTick() and time::micros() report on the
+ * host.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace umnsvp {
+namespace can_host {
+
+/**
+ * @brief Make HAL_GetTick() and time::micros() report now_us from here on,
+ * instead of the monotonic clock, until release_clock().
+ *
+ * A replay sets the time of each recorded frame before injecting it, so
+ * the board code sees the recorded timing however fast it is replayed.
+ */
+void hold_clock(uint64_t now_us);
+
+/**
+ * @brief Go back to the monotonic clock.
+ */
+void release_clock();
+
+}  // namespace can_host
+}  // namespace umnsvp
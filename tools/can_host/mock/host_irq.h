@@ -0,0 +1,41 @@
+/**
+ * @file host_irq.h
+ * @brief Interrupt context for code the host build runs in place of an
+ * interrupt handler.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace umnsvp {
+namespace can_host {
+
+/**
+ * @brief Runs the enclosing block as an interrupt handler would run on the
+ * target: never while another thread has interrupts masked, and waking any
+ * thread waiting in __WFI() when it ends.
+ *
+ * Example Usage:
+   ........................
+   // Host loop, in place of the CAN RX interrupt
+   {
+       can_host::interrupt irq;
+       count = board.receive_burst(packets);
+   }
+   ........................
+ */
+class interrupt {
+   public:
+    interrupt();
+    ~interrupt();
+
+    interrupt(const interrupt&) = delete;
+    interrupt& operator=(const interrupt&) = delete;
+
+   private:
+    const uint32_t primask;
+};
+
+}  // namespace can_host
+}  // namespace umnsvp
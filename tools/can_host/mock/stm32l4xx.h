@@ -0,0 +1,9 @@
+/**
+ * @file stm32l4xx.h
+ * @brief Host stand-in for the CMSIS device header, reached through UMNSVP
+ * hal.h.
+ */
+
+#pragma once
+
+#include "stm32l4xx_hal.h"
@@ -0,0 +1,100 @@
+/**
+ * @file stm32l4xx_hal.h
+ * @brief Host stand-in for the STM32L4 HAL used by the CAN host build.
+ *
+ * Only what the UMNSVP CAN sources and skylab2 reach is provided: the bxCAN
+ * header types can_packet.cc converts to and from, the HAL tick, the CMSIS
+ * interrupt mask intrinsics and the PendSV pend bit deferred_work.cc sets.
+ *
+ * PRIMASK is emulated with one process wide lock. Code that masks
+ * interrupts takes it, and the host drivers take it around everything they
+ * run in place of an interrupt handler (see can::host_interrupt), so a
+ * critical section excludes the "interrupts" exactly as on the target, even
+ * when they are serviced from another thread.
+ *
+ * PendSV is pended through SCB->ICSR as on the target and tail-chains when
+ * the outermost can_host::interrupt ends, so work an RX interrupt posts
+ * (skylab2::rx_subscriptions handlers) runs before the interrupt is
+ * counted as done.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// can_packet.h picks the bxCAN header types by this.
+#define CAN1 ((void*)0)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+/* CAN --------------------------------------------------------------------*/
+
+typedef struct {
+    uint32_t StdId;
+    uint32_t ExtId;
+    uint32_t IDE;
+    uint32_t RTR;
+    uint32_t DLC;
+    uint32_t TransmitGlobalTime;
+} CAN_TxHeaderTypeDef;
+
+typedef struct {
+    uint32_t StdId;
+    uint32_t ExtId;
+    uint32_t IDE;
+    uint32_t RTR;
+    uint32_t DLC;
+    uint32_t Timestamp;
+    uint32_t FilterMatchIndex;
+} CAN_RxHeaderTypeDef;
+
+#define CAN_ID_STD 0x00000000U
+#define CAN_ID_EXT 0x00000004U
+#define CAN_RTR_DATA 0x00000000U
+#define CAN_RTR_REMOTE 0x00000002U
+
+/* System -----------------------------------------------------------------*/
+
+#define __NVIC_PRIO_BITS 4U
+
+typedef enum {
+    PendSV_IRQn = -2,
+} IRQn_Type;
+
+typedef struct {
+    volatile uint32_t ICSR;
+} SCB_Type;
+
+extern SCB_Type host_scb;
+#define SCB (&host_scb)
+#define SCB_ICSR_PENDSVSET_Msk (1UL << 28U)
+
+void HAL_NVIC_SetPriority(IRQn_Type IRQn, uint32_t PreemptPriority,
+                          uint32_t SubPriority);
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+
+uint32_t HAL_GetTick(void);
+
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+void __disable_irq(void);
+void __enable_irq(void);
+
+/**
+ * @brief Waits, unmasked, until an interrupt has run or 1 ms has passed.
+ */
+void __WFI(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,179 @@
+/**
+ * @file replay.cc
+ * @brief Replays a recorded CAN log into host built board code.
+ *
+ * Reads the ptelem, SD card CSV and candump logs parse_can_log.py reads,
+ * feeds every frame to a replay target with the clock held at its recorded
+ * time, and reports how fast the log decoded and replayed and how long the
+ * target took to take each frame.
+ *
+ * usage: can_replay [options] LOG
+ *   --format F      ptelem, sd or candump (default: from the first line)
+ *   --speed X       recorded seconds per second; 0 is flat out (default 0)
+ *   --tick-ms N     target tick period in recorded time (default 1)
+ *   --target NAME   board code to run (default bus)
+ *   --list          list the targets
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "log_reader.h"
+#include "replay_engine.h"
+#include "replay_targets.h"
+
+namespace umnsvp {
+namespace can_host {
+namespace {
+
+struct options {
+    std::string log;
+    std::string format;
+    std::string target = "bus";
+    replay_options replay;
+    bool list = false;
+};
+
+bool parse_args(int argc, char** argv, options& opts) {
+    for (int i = 1; i < argc; i++) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--format") == 0 && has_value) {
+            opts.format = argv[++i];
+        } else if (std::strcmp(argv[i], "--speed") == 0 && has_value) {
+            opts.replay.speed = std::strtod(argv[++i], nullptr);
+        } else if (std::strcmp(argv[i], "--tick-ms") == 0 && has_value) {
+            opts.replay.tick_ms = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--target") == 0 && has_value) {
+            opts.target = argv[++i];
+        } else if (std::strcmp(argv[i], "--list") == 0) {
+            opts.list = true;
+        } else if (argv[i][0] != '-' && opts.log.empty()) {
+            opts.log = argv[i];
+        } else {
+            return false;
+        }
+    }
+    return opts.list || (!opts.log.empty() && opts.replay.speed >= 0.0 &&
+                         opts.replay.tick_ms > 0);
+}
+
+bool parse_format(const std::string& name, log_format& format) {
+    if (name == "ptelem") {
+        format = log_format::PTELEM;
+    } else if (name == "sd") {
+        format = log_format::SD_CSV;
+    } else if (name == "candump") {
+        format = log_format::CANDUMP;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* format_name(log_format format) {
+    switch (format) {
+        case log_format::SD_CSV:
+            return "sd";
+        case log_format::CANDUMP:
+            return "candump";
+        default:
+            return "ptelem";
+    }
+}
+
+double per_second(double count, double seconds) {
+    return seconds > 0.0 ? count / seconds : 0.0;
+}
+
+void print_report(const options& opts, const log_reader& reader,
+                  const replay_report& report) {
+    std::printf("log            %s (%s, %.1f MB)\n", opts.log.c_str(),
+                format_name(reader.get_format()), report.bytes / 1e6);
+    std::printf("frames         %llu\n",
+                static_cast<unsigned long long>(report.frames));
+    std::printf("malformed      %llu\n",
+                static_cast<unsigned long long>(report.malformed));
+    std::printf("accepted       %llu\n",
+                static_cast<unsigned long long>(report.accepted));
+    std::printf("overruns       %llu\n",
+                static_cast<unsigned long long>(report.overruns));
+    std::printf("responses      %llu\n",
+                static_cast<unsigned long long>(report.responses));
+    std::printf("ticks          %llu\n",
+                static_cast<unsigned long long>(report.ticks));
+    std::printf("log_time       %.1f s\n", report.log_s);
+    std::printf("wall_time      %.3f s\n", report.wall_s);
+    std::printf("speedup        %.0fx\n",
+                per_second(report.log_s, report.wall_s));
+    std::printf("decode         %.0f frames/s\n",
+                per_second(report.frames, report.parse_s));
+    std::printf("replay         %.0f frames/s\n",
+                per_second(report.frames, report.wall_s));
+    std::printf("reaction_mean  %.0f ns\n", report.reaction.mean_ns());
+    std::printf("reaction_p50   %llu ns\n",
+                static_cast<unsigned long long>(
+                    report.reaction.percentile(50.0)));
+    std::printf("reaction_p99   %llu ns\n",
+                static_cast<unsigned long long>(
+                    report.reaction.percentile(99.0)));
+    std::printf("reaction_max   %llu ns\n",
+                static_cast<unsigned long long>(report.reaction.get_max_ns()));
+}
+
+int run(const options& opts) {
+    if (opts.list) {
+        list_targets(stdout);
+        return 0;
+    }
+    std::unique_ptr<replay_target> target = make_target(opts.target);
+    if (target == nullptr) {
+        std::fprintf(stderr, "can_replay: no target %s\n",
+                     opts.target.c_str());
+        return 2;
+    }
+
+    log_reader reader;
+    if (!reader.open(opts.log.c_str())) {
+        std::fprintf(stderr, "can_replay: cannot read %s\n",
+                     opts.log.c_str());
+        return 2;
+    }
+    if (!opts.format.empty()) {
+        log_format format;
+        if (!parse_format(opts.format, format)) {
+            std::fprintf(stderr, "can_replay: unknown format %s\n",
+                         opts.format.c_str());
+            return 2;
+        }
+        reader.set_format(format);
+    }
+
+    replay_engine engine(opts.replay);
+    replay_report report;
+    if (!engine.run(reader, *target, report)) {
+        std::fprintf(stderr, "can_replay: target %s did not start\n",
+                     opts.target.c_str());
+        return 2;
+    }
+    print_report(opts, reader, report);
+    target->report(stdout);
+    return 0;
+}
+
+}  // namespace
+}  // namespace can_host
+}  // namespace umnsvp
+
+int main(int argc, char** argv) {
+    umnsvp::can_host::options opts;
+    if (!umnsvp::can_host::parse_args(argc, argv, opts)) {
+        std::fprintf(stderr,
+                     "usage: can_replay [--format ptelem|sd|candump] "
+                     "[--speed X] [--tick-ms N] [--target NAME] [--list] "
+                     "LOG\n");
+        return 2;
+    }
+    return umnsvp::can_host::run(opts);
+}
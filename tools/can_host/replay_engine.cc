@@ -0,0 +1,262 @@
+/**
+ * @file replay_engine.cc
+ * @brief Feeds a recorded CAN log into host built board code.
+ */
+
+#include "replay_engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <thread>
+
+#include "host_clock.h"
+#include "host_irq.h"
+#include "loopback_bus.h"
+
+namespace umnsvp {
+namespace can_host {
+
+namespace {
+
+using wall_clock = std::chrono::steady_clock;
+
+/// The board boots this long, in recorded time, before the first frame.
+constexpr uint64_t boot_us = 1000000;
+
+/// Frames tokenized per log_reader::read().
+constexpr std::size_t read_chunk = 1024;
+
+}  // namespace
+
+/**
+ * @brief Values under 8 ns get a bucket each; above that each octave is
+ * split into 8 by the 3 bits under the leading one.
+ */
+std::size_t latency_histogram::bucket_of(uint64_t ns) {
+    if (ns < sub_buckets) {
+        return static_cast<std::size_t>(ns);
+    }
+    const unsigned msb = 63U - static_cast<unsigned>(__builtin_clzll(ns));
+    return (msb - 2) * sub_buckets + ((ns >> (msb - 3)) & (sub_buckets - 1));
+}
+
+uint64_t latency_histogram::upper_bound(std::size_t bucket) {
+    if (bucket < sub_buckets) {
+        return bucket;
+    }
+    const unsigned msb = static_cast<unsigned>(bucket / sub_buckets + 2);
+    const uint64_t sub = bucket % sub_buckets;
+    const uint64_t width = uint64_t{1} << (msb - 3);
+    return (sub_buckets + sub) * width + width - 1;
+}
+
+void latency_histogram::record(uint64_t ns) {
+    buckets[bucket_of(ns)]++;
+    count++;
+    total_ns += ns;
+    max_ns = std::max(max_ns, ns);
+}
+
+/**
+ * @brief Latency p percent of the samples are at or under, to within an
+ * eighth of an octave.
+ */
+uint64_t latency_histogram::percentile(double p) const {
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(
+        1, static_cast<uint64_t>(std::ceil(p / 100.0 * count)));
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(upper_bound(i), max_ns);
+        }
+    }
+    return max_ns;
+}
+
+replay_engine::replay_engine(const replay_options& options)
+    : options(options) {
+}
+
+/**
+ * @brief Replay the whole log into the target.
+ *
+ * @return false The target or the engine's bus could not be started.
+ */
+bool replay_engine::run(log_reader& reader, replay_target& target,
+                        replay_report& report) {
+    can::loopback_bus bus;
+    can::loopback_driver driver(bus);
+    // Receives what the target sends.
+    can::loopback_driver sink(bus);
+
+    uint64_t now_us = boot_us;
+    hold_clock(now_us);
+    sink.init(can::baud_rate::BAUD_RATE_500, false);
+    sink.filter_all();
+    bool started = sink.start() == HAL_OK;
+    if (started) {
+        interrupt irq;
+        started = target.start(driver) && driver.is_started();
+    }
+    if (!started) {
+        release_clock();
+        return false;
+    }
+
+    const auto wall_start = wall_clock::now();
+    const auto wall_ns = [wall_start] {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                wall_clock::now() - wall_start)
+                .count());
+    };
+
+    const auto rx_pending = [&driver] {
+        return driver.rx_pending(can::fifo::FIFO0) +
+               driver.rx_pending(can::fifo::FIFO1);
+    };
+
+    // Injection times of the frames waiting for the RX interrupt.
+    std::array<uint64_t, can::host_batch> injected_ns;
+    std::size_t batch = 0;
+
+    // As on the target, the RX interrupt fires while a FIFO holds frames.
+    const auto run_rx = [&] {
+        if (batch == 0 && rx_pending() == 0) {
+            return;
+        }
+        {
+            interrupt irq;
+            target.receive();
+        }
+        const uint64_t done_ns = wall_ns();
+        for (std::size_t i = 0; i < batch; i++) {
+            report.reaction.record(done_ns - injected_ns[i]);
+        }
+        batch = 0;
+    };
+
+    std::array<can::packet, can::host_batch> responses;
+    const auto run_tx = [&] {
+        {
+            interrupt irq;
+            driver.flush();
+            while (driver.tx_it_enabled() && driver.tx_ready()) {
+                target.transmit();
+            }
+        }
+        driver.flush();
+        std::size_t count;
+        while ((count = sink.receive_burst(responses)) > 0) {
+            report.responses += count;
+        }
+    };
+
+    const uint64_t tick_us = uint64_t{options.tick_ms} * 1000;
+    const uint64_t max_gap_us = uint64_t{options.max_gap_ms} * 1000;
+    uint64_t next_tick_us = now_us + tick_us;
+    const auto run_ticks = [&](uint64_t until_us) {
+        if (until_us > next_tick_us + max_gap_us) {
+            // Jump to the last tick before until_us, on the same grid.
+            next_tick_us = until_us - (until_us - next_tick_us) % tick_us;
+        }
+        while (next_tick_us <= until_us) {
+            run_rx();
+            hold_clock(next_tick_us);
+            {
+                interrupt irq;
+                target.tick(static_cast<uint32_t>(next_tick_us / 1000));
+            }
+            report.ticks++;
+            run_tx();
+            next_tick_us += tick_us;
+        }
+    };
+
+    std::array<log_frame, read_chunk> frames;
+    bool have_origin = false;
+    uint64_t origin_us = 0;
+    while (true) {
+        const auto parse_start = wall_clock::now();
+        const std::size_t count = reader.read(frames);
+        report.parse_s +=
+            std::chrono::duration<double>(wall_clock::now() - parse_start)
+                .count();
+        if (count == 0) {
+            break;
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            const log_frame& recorded = frames[i];
+            if (!have_origin) {
+                origin_us = recorded.time_us;
+                have_origin = true;
+            }
+            // Merged or rolled over logs can step back; time never does.
+            const uint64_t offset_us = recorded.time_us > origin_us
+                                           ? recorded.time_us - origin_us
+                                           : 0;
+            now_us = std::max(now_us, boot_us + offset_us);
+            run_ticks(now_us);
+
+            if (options.speed > 0.0) {
+                const auto due =
+                    wall_start +
+                    std::chrono::duration_cast<wall_clock::duration>(
+                        std::chrono::duration<double, std::micro>(
+                            (now_us - boot_us) / options.speed));
+                if (due > wall_clock::now()) {
+                    std::this_thread::sleep_until(due);
+                }
+            }
+
+            if (batch == can::host_batch) {
+                run_rx();
+            }
+            hold_clock(now_us);
+            std::size_t pending = rx_pending();
+            const uint64_t at_ns = wall_ns();
+            std::span<const can_frame> one(&recorded.frame, 1);
+            if (driver.inject(one) == 0) {
+                // The target left its FIFOs full; give it one more go.
+                run_rx();
+                pending = rx_pending();
+                if (driver.inject(one) == 0) {
+                    report.overruns++;
+                }
+            }
+            if (rx_pending() > pending) {
+                report.accepted++;
+                injected_ns[batch] = at_ns;
+                batch++;
+            }
+            report.frames++;
+            if (options.speed > 0.0) {
+                run_rx();
+            }
+        }
+    }
+    run_ticks(now_us + tick_us);
+    run_rx();
+    run_tx();
+
+    report.wall_s =
+        std::chrono::duration<double>(wall_clock::now() - wall_start)
+            .count();
+    report.log_s = static_cast<double>(now_us - boot_us) / 1e6;
+    report.lines = reader.get_lines();
+    report.malformed = reader.get_malformed();
+    report.bytes = reader.size();
+
+    driver.stop();
+    sink.stop();
+    release_clock();
+    return true;
+}
+
+}  // namespace can_host
+}  // namespace umnsvp
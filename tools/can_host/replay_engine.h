@@ -0,0 +1,159 @@
+/**
+ * @file replay_engine.h
+ * @brief Feeds a recorded CAN log into host built board code.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include "host_can_driver.h"
+#include "log_reader.h"
+
+namespace umnsvp {
+namespace can_host {
+
+/**
+ * @brief Board code run by a replay: a board class over the replay's
+ * driver, and whatever application logic is built with it.
+ *
+ * The engine calls these in place of the board's interrupts and main loop,
+ * inside a can_host::interrupt, with HAL_GetTick() and time::micros() held
+ * at the recorded time.
+ */
+class replay_target {
+   public:
+    virtual ~replay_target() = default;
+
+    /**
+     * @brief Set the board class up on driver and init() it, which starts
+     * the driver.
+     *
+     * @return false The board could not be started.
+     */
+    virtual bool start(can::host_can_driver& driver) = 0;
+
+    /**
+     * @brief RX interrupt: frames are waiting in the driver's FIFOs.
+     */
+    virtual void receive() = 0;
+
+    /**
+     * @brief TX interrupt: called while the driver's TX interrupt is
+     * enabled and it has room, normally the board's tx_handler().
+     */
+    virtual void transmit() = 0;
+
+    /**
+     * @brief Timers and main loop work, every tick of recorded time.
+     */
+    virtual void tick(uint32_t now_ms) = 0;
+
+    /**
+     * @brief Print what the target measured, after the run.
+     */
+    virtual void report(FILE*) const {
+    }
+};
+
+/**
+ * @brief Distribution of latencies in ns, in buckets an eighth of an octave
+ * wide, so percentiles are within 12.5% without storing samples.
+ */
+class latency_histogram {
+   private:
+    static constexpr std::size_t sub_buckets = 8;
+    std::array<uint64_t, 64 * sub_buckets> buckets = {};
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+
+    static std::size_t bucket_of(uint64_t ns);
+    static uint64_t upper_bound(std::size_t bucket);
+
+   public:
+    void record(uint64_t ns);
+    uint64_t percentile(double p) const;
+
+    uint64_t get_count() const {
+        return count;
+    }
+
+    double mean_ns() const {
+        return count == 0 ? 0.0 : static_cast<double>(total_ns) / count;
+    }
+
+    uint64_t get_max_ns() const {
+        return max_ns;
+    }
+};
+
+struct replay_options {
+    /// Recorded time per wall time; 0 replays as fast as possible.
+    double speed = 0.0;
+    /// Period of replay_target::tick() in recorded time.
+    uint32_t tick_ms = 1;
+    /// Gaps in the log longer than this (logger off) are skipped with a
+    /// single tick rather than ticked through.
+    uint32_t max_gap_ms = 1000;
+};
+
+struct replay_report {
+    uint64_t frames = 0;
+    /// Frames that passed the target's acceptance filter.
+    uint64_t accepted = 0;
+    /// Frames lost because the target left its FIFOs full.
+    uint64_t overruns = 0;
+    uint64_t lines = 0;
+    uint64_t malformed = 0;
+    uint64_t bytes = 0;
+    uint64_t ticks = 0;
+    /// Frames the target sent.
+    uint64_t responses = 0;
+    /// Recorded time covered.
+    double log_s = 0.0;
+    /// Time spent tokenizing the log.
+    double parse_s = 0.0;
+    double wall_s = 0.0;
+    /// Injection of a frame to the end of the RX interrupt that took it and
+    /// of the deferred work (subscriber handlers) that interrupt posted.
+    latency_histogram reaction;
+};
+
+/**
+ * @brief Replays a CAN log into a replay_target.
+ *
+ * The log is read in chunks with log_reader. Each frame is injected
+ * straight into the target's driver FIFOs (host_can_driver::inject()),
+ * with the clock held at its recorded time, so the board sees the recorded
+ * timing whether the replay runs at the original speed, a multiple of it,
+ * or flat out. The target's RX interrupt runs after every batch of frames
+ * and before each tick; at a set speed it runs after every frame. Frames
+ * the target sends go out over a loopback bus to the engine, which counts
+ * them.
+ *
+ * Example Usage:
+   ........................
+   can_host::log_reader reader;
+   reader.open(path);
+   can_host::replay_engine engine({.speed = 0.0});
+   can_host::replay_report report;
+   engine.run(reader, target, report);
+   ........................
+ */
+class replay_engine {
+   private:
+    const replay_options options;
+
+   public:
+    explicit replay_engine(const replay_options& options);
+
+    bool run(log_reader& reader, replay_target& target,
+             replay_report& report);
+};
+
+}  // namespace can_host
+}  // namespace umnsvp
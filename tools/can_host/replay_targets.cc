@@ -0,0 +1,288 @@
+/**
+ * @file replay_targets.cc
+ * @brief The board code can_replay can run.
+ *
+ * A target is a board class over the replay's driver plus the application
+ * code built with it. To replay into a board's application, build its
+ * skylab2 board class and the sources under test into can_replay, wrap them
+ * in a replay_target and add it to the table at the bottom.
+ *
+ * The engine's reaction latency ends with the RX interrupt and the deferred
+ * work it posted. For the bus target that is only draining the FIFO; the
+ * lights target runs the generated lights_can dispatch and subscriber
+ * handlers in it and times the handlers themselves as well.
+ */
+
+#include "replay_targets.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "skylab2_boards.h"
+#include "skylab2_can_base.h"
+#include "skylab2_dispatch.h"
+#include "skylab2_rx_dispatch.h"
+#include "skylab2_schedule.h"
+#include "skylab2_views.h"
+
+namespace umnsvp {
+namespace can_host {
+
+namespace {
+
+/**
+ * @brief A board class with nothing generated on it.
+ */
+class replay_board : public skylab2::basic_can_base<can::host_can_driver> {
+   public:
+    explicit replay_board(can::host_can_driver& driver)
+        : basic_can_base(driver, can::fifo::FIFO0) {
+    }
+};
+
+/**
+ * @brief The skylab2 board class alone, receiving every ID: counts each
+ * ID through an RX observer and the bus load through the driver's bus
+ * statistics.
+ */
+class bus_target final : public replay_target {
+   private:
+    can::host_can_driver* driver = nullptr;
+    std::unique_ptr<replay_board> board;
+    std::array<can::packet, can::host_batch> packets;
+
+    /// rx_key() of each ID seen, and its count.
+    std::unordered_map<uint32_t, uint64_t> counts;
+    uint16_t peak_load_permille = 0;
+    uint32_t reports = 0;
+
+    static void observe(void* self, const can::packet& packet) {
+        const uint32_t key =
+            skylab2::rx_key(packet.get_id(), packet.is_extended());
+        static_cast<bus_target*>(self)->counts[key]++;
+    }
+
+   public:
+    bool start(can::host_can_driver& driver) override {
+        this->driver = &driver;
+        board = std::make_unique<replay_board>(driver);
+        board->add_rx_observer(&observe, this);
+        board->init(can::baud_rate::BAUD_RATE_500, false, nullptr, 0);
+        // Receive standard and extended IDs alike.
+        driver.filter_all();
+        return driver.is_started();
+    }
+
+    void receive() override {
+        while (board->receive_burst(packets) > 0) {
+        }
+    }
+
+    void transmit() override {
+        board->tx_handler();
+    }
+
+    void tick(uint32_t now_ms) override {
+        if (driver->poll_stats(now_ms)) {
+            reports++;
+            peak_load_permille =
+                std::max(peak_load_permille,
+                         driver->get_stats().get_report().load_permille);
+        }
+    }
+
+    void report(FILE* out) const override {
+        std::vector<std::pair<uint32_t, uint64_t>> busiest(counts.begin(),
+                                                           counts.end());
+        std::sort(busiest.begin(), busiest.end(),
+                  [](const auto& a, const auto& b) {
+                      return a.second > b.second;
+                  });
+        std::fprintf(out, "ids            %zu\n", counts.size());
+        std::fprintf(out, "peak_load      %.1f %% (%u windows)\n",
+                     peak_load_permille / 10.0, reports);
+        for (std::size_t i = 0; i < std::min<std::size_t>(busiest.size(), 5);
+             i++) {
+            const uint32_t key = busiest[i].first;
+            std::fprintf(out, "busiest        %s%X %llu\n",
+                         (key & skylab2::rx_key(0, true)) != 0 ? "x" : "",
+                         key & CAN_EFF_MASK,
+                         static_cast<unsigned long long>(busiest[i].second));
+        }
+    }
+};
+
+/**
+ * @brief The lights board's CAN side: the generated lights_can class with
+ * its RX subscriptions and deadline monitor wired up as in lights/src/app.cc,
+ * and handlers that decode each command into the state of the lights.
+ *
+ * handler latency is from the start of the RX interrupt to the subscriber
+ * handler, which runs from deferred work (PendSV) once the interrupt
+ * returns.
+ */
+class lights_target final : public replay_target {
+   private:
+    using wall_clock = std::chrono::steady_clock;
+
+    can::host_can_driver* driver = nullptr;
+    std::unique_ptr<skylab2::lights_can> skylab;
+    skylab2::lights_main_rx::subscriptions rx;
+    skylab2::rx_monitor<skylab2::lights_deadlines::table.size()> monitor{
+        skylab2::lights_deadlines::table};
+
+    struct lights_state {
+        bool high_beams = false;
+        bool headlights = false;
+        float brightness = 0.0f;
+        bool left_turn = false;
+        bool right_turn = false;
+        bool brake = false;
+    };
+    lights_state lights;
+
+    wall_clock::time_point rx_start;
+    latency_histogram handler;
+
+    void record_handled() {
+        handler.record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                wall_clock::now() - rx_start)
+                .count()));
+    }
+
+    static void on_headlights(void* context, const can::packet& packet) {
+        lights_target& self = *static_cast<lights_target*>(context);
+        const skylab2::can_view_vision_headlights_command cmd(packet);
+        self.lights.high_beams = cmd.lights_high_beams();
+        self.lights.headlights = cmd.lights_headlights();
+        self.lights.brightness = cmd.brightness();
+        self.record_handled();
+    }
+
+    static void on_turn_signals(void* context, const can::packet& packet) {
+        lights_target& self = *static_cast<lights_target*>(context);
+        const skylab2::can_view_vision_turn_signals_command cmd(packet);
+        self.lights.left_turn = cmd.lights_left_turn_signal();
+        self.lights.right_turn = cmd.lights_right_turn_signal();
+        self.record_handled();
+    }
+
+    static void on_brake_lights(void* context, const can::packet& packet) {
+        lights_target& self = *static_cast<lights_target*>(context);
+        const skylab2::can_view_vision_brake_lights_command cmd(packet);
+        self.lights.brake = cmd.lights_brake_lights();
+        self.record_handled();
+    }
+
+    /// Turn signals go off when their command stops, as on the board.
+    static void on_timeout(void* context, std::size_t msg) {
+        lights_target& self = *static_cast<lights_target*>(context);
+        if (msg == skylab2::lights_deadlines::vision_turn_signals_command) {
+            self.lights.left_turn = false;
+            self.lights.right_turn = false;
+        }
+    }
+
+   public:
+    bool start(can::host_can_driver& driver) override {
+        this->driver = &driver;
+        skylab = std::make_unique<skylab2::lights_can>(driver,
+                                                       can::fifo::FIFO0);
+        rx.subscribe(skylab2::lights_main_rx::vision_headlights_command,
+                     &on_headlights, this);
+        rx.subscribe(skylab2::lights_main_rx::vision_turn_signals_command,
+                     &on_turn_signals, this);
+        rx.subscribe(skylab2::lights_main_rx::vision_brake_lights_command,
+                     &on_brake_lights, this);
+        skylab->add_rx_observer(&decltype(rx)::observe, &rx);
+
+        monitor.set_timeout_callback(&on_timeout, this);
+        monitor.start(HAL_GetTick());
+        skylab->add_rx_observer(&decltype(monitor)::observe, &monitor);
+        // Filters on the IDs lights receives, as on the board.
+        skylab->init();
+        return driver.is_started();
+    }
+
+    void receive() override {
+        rx_start = wall_clock::now();
+        skylab->main_bus_rx_handler();
+    }
+
+    void transmit() override {
+        skylab->main_bus_tx_handler();
+    }
+
+    void tick(uint32_t now_ms) override {
+        monitor.tick(now_ms);
+        driver->poll_stats(now_ms);
+    }
+
+    void report(FILE* out) const override {
+        using namespace skylab2::lights_deadlines;
+        std::fprintf(out, "handled        %llu\n",
+                     static_cast<unsigned long long>(handler.get_count()));
+        std::fprintf(out, "handler_mean   %.0f ns\n", handler.mean_ns());
+        std::fprintf(out, "handler_p50    %llu ns\n",
+                     static_cast<unsigned long long>(
+                         handler.percentile(50.0)));
+        std::fprintf(out, "handler_p99    %llu ns\n",
+                     static_cast<unsigned long long>(
+                         handler.percentile(99.0)));
+        std::fprintf(out, "handler_max    %llu ns\n",
+                     static_cast<unsigned long long>(handler.get_max_ns()));
+        std::fprintf(out, "merged         %u\n", rx.get_merged());
+        std::fprintf(out, "timeouts       headlights %u, turn %u, brake %u\n",
+                     monitor.get_timeouts(vision_headlights_command),
+                     monitor.get_timeouts(vision_turn_signals_command),
+                     monitor.get_timeouts(vision_brake_lights_command));
+        std::fprintf(out,
+                     "lights         high %d head %d (%.2f) left %d right %d "
+                     "brake %d\n",
+                     lights.high_beams, lights.headlights, lights.brightness,
+                     lights.left_turn, lights.right_turn, lights.brake);
+    }
+};
+
+struct target_entry {
+    const char* name;
+    const char* description;
+    std::unique_ptr<replay_target> (*make)();
+};
+
+template <typename Target>
+std::unique_ptr<replay_target> make() {
+    return std::make_unique<Target>();
+}
+
+const target_entry targets[] = {
+    {"bus", "skylab2 board class receiving every ID, with bus statistics",
+     &make<bus_target>},
+    {"lights", "generated lights_can with its RX subscriptions and deadlines",
+     &make<lights_target>},
+};
+
+}  // namespace
+
+std::unique_ptr<replay_target> make_target(const std::string& name) {
+    for (const target_entry& entry : targets) {
+        if (name == entry.name) {
+            return entry.make();
+        }
+    }
+    return nullptr;
+}
+
+void list_targets(FILE* out) {
+    for (const target_entry& entry : targets) {
+        std::fprintf(out, "%-14s %s\n", entry.name, entry.description);
+    }
+}
+
+}  // namespace can_host
+}  // namespace umnsvp
@@ -0,0 +1,29 @@
+/**
+ * @file replay_targets.h
+ * @brief The board code can_replay can run.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "replay_engine.h"
+
+namespace umnsvp {
+namespace can_host {
+
+/**
+ * @brief Build the target registered under name.
+ *
+ * @return std::unique_ptr<replay_target> nullptr if there is none.
+ */
+std::unique_ptr<replay_target> make_target(const std::string& name);
+
+/**
+ * @brief Print the registered targets and what they run.
+ */
+void list_targets(FILE* out);
+
+}  // namespace can_host
+}  // namespace umnsvp
@@ -0,0 +1,124 @@
+/**
+ * @file socketcan_driver.cc
+ * @brief CAN driver over a Linux SocketCAN interface.
+ */
+
+#include "socketcan_driver.h"
+
+#include <linux/can/error.h>
+#include <linux/can/raw.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace umnsvp {
+namespace can {
+
+socketcan_driver::socketcan_driver(const std::string& interface)
+    : interface(interface) {
+}
+
+socketcan_driver::~socketcan_driver() {
+    stop();
+}
+
+int socketcan_driver::open_socket() {
+    const int fd =
+        ::socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
+    if (fd < 0) {
+        std::perror("socketcan_driver: socket");
+        return -1;
+    }
+    ifreq request = {};
+    std::strncpy(request.ifr_name, interface.c_str(), IFNAMSIZ - 1);
+    if (::ioctl(fd, SIOCGIFINDEX, &request) < 0) {
+        std::fprintf(stderr, "socketcan_driver: no interface %s\n",
+                     interface.c_str());
+        ::close(fd);
+        return -1;
+    }
+
+    const can_err_mask_t error_mask =
+        CAN_ERR_LOSTARB | CAN_ERR_CRTL | CAN_ERR_BUSOFF | CAN_ERR_RESTARTED;
+    ::setsockopt(fd, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &error_mask,
+                 sizeof(error_mask));
+
+    sockaddr_can address = {};
+    address.can_family = AF_CAN;
+    address.can_ifindex = request.ifr_ifindex;
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) <
+        0) {
+        std::perror("socketcan_driver: bind");
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * @brief Give the ID list to the kernel. An empty list receives nothing,
+ * as on the target.
+ */
+void socketcan_driver::filters_changed() {
+    std::vector<can_filter> filters;
+    if (accepts_all()) {
+        filters.push_back({0, 0});
+    } else {
+        const canid_t mask = filters_extended()
+                                 ? CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_EFF_MASK
+                                 : CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_SFF_MASK;
+        const canid_t flag = filters_extended() ? CAN_EFF_FLAG : 0;
+        for (const auto* ids : {&get_urgent_ids(), &get_bulk_ids()}) {
+            for (uint32_t id : *ids) {
+                filters.push_back({id | flag, mask});
+            }
+        }
+    }
+    ::setsockopt(get_fd(), SOL_CAN_RAW, CAN_RAW_FILTER, filters.data(),
+                 static_cast<socklen_t>(filters.size() * sizeof(can_filter)));
+}
+
+/**
+ * @brief Track the fault confinement state from the interface's error
+ * frames.
+ */
+void socketcan_driver::error_frame(const can_frame& frame) {
+    if ((frame.can_id & CAN_ERR_LOSTARB) != 0) {
+        stats.record_lost_arbitration();
+    }
+    if ((frame.can_id & CAN_ERR_CRTL) != 0) {
+        const uint8_t controller = frame.data[1];
+        if ((controller & CAN_ERR_CRTL_RX_OVERFLOW) != 0) {
+            stats.record_overrun();
+        }
+        if ((controller &
+             (CAN_ERR_CRTL_RX_WARNING | CAN_ERR_CRTL_TX_WARNING)) != 0) {
+            errors.warning = true;
+        }
+        if ((controller &
+             (CAN_ERR_CRTL_RX_PASSIVE | CAN_ERR_CRTL_TX_PASSIVE)) != 0) {
+            errors.passive = true;
+        }
+        if ((controller & CAN_ERR_CRTL_ACTIVE) != 0) {
+            errors.warning = false;
+            errors.passive = false;
+        }
+    }
+    if ((frame.can_id & CAN_ERR_BUSOFF) != 0) {
+        errors.bus_off = true;
+    }
+    if ((frame.can_id & CAN_ERR_RESTARTED) != 0) {
+        errors.bus_off = false;
+    }
+    if ((frame.can_id & CAN_ERR_CNT) != 0) {
+        errors.tec = frame.data[6];
+        errors.rec = frame.data[7];
+    }
+}
+
+}  // namespace can
+}  // namespace umnsvp
@@ -0,0 +1,42 @@
+/**
+ * @file socketcan_driver.h
+ * @brief CAN driver over a Linux SocketCAN interface.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "host_can_driver.h"
+
+namespace umnsvp {
+namespace can {
+
+/**
+ * @brief A driver for a Linux SocketCAN interface: a real adapter (can0) or
+ * a virtual bus (vcan0).
+ *
+ * The acceptance filter is also given to the kernel (CAN_RAW_FILTER), so
+ * frames this node does not receive are never copied to it. The interface
+ * reports bus errors as error frames, which keep get_error_state() and the
+ * lost arbitration and overrun counts up to date; vcan has none.
+ *
+ * Bring the interface up first, as for the HITL suite:
+ * `sudo ip link set can0 type can bitrate 500000 && sudo ip link set up can0`
+ */
+class socketcan_driver final : public host_can_driver {
+   private:
+    const std::string interface;
+
+   protected:
+    int open_socket() override;
+    void filters_changed() override;
+    void error_frame(const can_frame& frame) override;
+
+   public:
+    explicit socketcan_driver(const std::string& interface);
+    ~socketcan_driver() override;
+};
+
+}  // namespace can
+}  // namespace umnsvp